@@ -0,0 +1,350 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "pberr.h"
+#include "pbphys.h"
+
+#define RANDOMSEED 0
+
+// Counter of heap allocations, reported per step of the scenarios
+#include "pbphys-alloc.c"
+
+// Maximum number of values in the lists of sizes and dimensions
+#define BENCH_MAXNBVAL 16
+
+// Distance between the centers of neighbour particles of diameter 1.0
+// in the dense and dilute configurations
+#define BENCH_DENSESPACING 1.25
+#define BENCH_DILUTESPACING 10.0
+
+// Parameters of the benchmark, given on the command line
+typedef struct BenchParam {
+  // Numbers of particles swept by the scenarios
+  int _nbPart[BENCH_MAXNBVAL];
+  int _nbNbPart;
+  // Dimensions swept by the scenarios
+  int _dim[BENCH_MAXNBVAL];
+  int _nbDim;
+  // Minimum duration of the timed loop of each case, in seconds
+  double _minTime;
+  // Settings of the PBPhys
+  int _nbThread;
+  PBPhysStorage _storage;
+  PBPhysBroadPhase _broadPhase;
+  PBPhysGravitySolver _solver;
+  PBPhysScheduler _scheduler;
+} BenchParam;
+
+// Data of the operation timed by a scenario
+typedef struct BenchData {
+  // Benchmarked system
+  PBPhys* _phys;
+  // System loaded or cloned by the I/O scenarios
+  PBPhys* _other;
+  // Temporary file of the I/O scenarios
+  FILE* _stream;
+} BenchData;
+
+// Operation repeated in the timed loop of a scenario
+typedef void (*BenchOp)(BenchData* const data);
+
+// Scenario of the benchmark
+typedef struct BenchScenario {
+  // Name on the command line and in the results
+  const char* _name;
+  // Spacing of the particles
+  float _spacing;
+  // Gravity between particles
+  float _gravity;
+  // Operation timed, and operation run once before the timed loop
+  // (may be null)
+  BenchOp _op;
+  BenchOp _init;
+} BenchScenario;
+
+void BenchOpNext(BenchData* const data) {
+  PBPhysNext(data->_phys);
+}
+
+void BenchOpStep(BenchData* const data) {
+  PBPhysStep(data->_phys);
+}
+
+void BenchOpSave(BenchData* const data) {
+  rewind(data->_stream);
+  if (!PBPhysSave(data->_phys, data->_stream, true)) {
+    fprintf(stderr, "PBPhysSave failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void BenchOpLoad(BenchData* const data) {
+  rewind(data->_stream);
+  if (!PBPhysLoad(&(data->_other), data->_stream)) {
+    fprintf(stderr, "PBPhysLoad failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void BenchOpSaveBinary(BenchData* const data) {
+  rewind(data->_stream);
+  if (!PBPhysSaveBinary(data->_phys, data->_stream)) {
+    fprintf(stderr, "PBPhysSaveBinary failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void BenchOpLoadBinary(BenchData* const data) {
+  rewind(data->_stream);
+  if (!PBPhysLoadBinary(&(data->_other), data->_stream)) {
+    fprintf(stderr, "PBPhysLoadBinary failed\n");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void BenchOpClone(BenchData* const data) {
+  PBPhysFree(&(data->_other));
+  data->_other = PBPhysClone(data->_phys);
+}
+
+const BenchScenario benchScenarios[] = {
+  {"free", BENCH_DILUTESPACING, 0.0, BenchOpNext, NULL}, 
+  {"nbody", BENCH_DILUTESPACING, 1.0, BenchOpNext, NULL}, 
+  {"dense", BENCH_DENSESPACING, 0.0, BenchOpStep, NULL}, 
+  {"dilute", BENCH_DILUTESPACING, 0.0, BenchOpStep, NULL}, 
+  {"save", BENCH_DILUTESPACING, 0.0, BenchOpSave, NULL}, 
+  {"load", BENCH_DILUTESPACING, 0.0, BenchOpLoad, BenchOpSave}, 
+  {"savebin", BENCH_DILUTESPACING, 0.0, BenchOpSaveBinary, NULL}, 
+  {"loadbin", BENCH_DILUTESPACING, 0.0, BenchOpLoadBinary, 
+    BenchOpSaveBinary}, 
+  {"clone", BENCH_DILUTESPACING, 0.0, BenchOpClone, NULL}
+};
+const int benchNbScenario = 
+  sizeof(benchScenarios) / sizeof(benchScenarios[0]);
+
+// Return the current time in seconds
+double BenchGetTime() {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)(t.tv_sec) + 1e-9 * (double)(t.tv_nsec);
+}
+
+// Create the system of 'nbPart' spheroids of diameter 1.0 in dimension
+// 'dim' for the scenario 'scenario'
+// The particles are on a lattice of step 'scenario->_spacing' with a
+// random jitter which keeps them apart, and have random speeds in
+// [-1.0, 1.0]
+PBPhys* BenchCreatePhys(const BenchScenario* const scenario, 
+  const BenchParam* const param, const int dim, const int nbPart) {
+  srandom(RANDOMSEED);
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysSetGravity(phys, scenario->_gravity);
+  PBPhysSetStorage(phys, param->_storage);
+  PBPhysSetBroadPhase(phys, param->_broadPhase);
+  PBPhysSetGravitySolver(phys, param->_solver);
+  PBPhysSetScheduler(phys, param->_scheduler);
+  PBPhysSetNbThread(phys, param->_nbThread);
+  PBPhysAddParticles(phys, nbPart, ShapoidTypeSpheroid);
+  int nbSide = (int)ceil(pow((double)nbPart, 1.0 / (double)dim));
+  float jitter = 0.5 * (scenario->_spacing - 1.0);
+  VecFloat* v = VecFloatCreate(dim);
+  for (int iPart = 0; iPart < nbPart; ++iPart) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    int iCell = iPart;
+    for (int iDim = 0; iDim < dim; ++iDim) {
+      VecSet(v, iDim, scenario->_spacing * (float)(iCell % nbSide) + 
+        jitter * (2.0 * rnd() - 1.0));
+      iCell /= nbSide;
+    }
+    PBPhysParticleSetPos(part, v);
+    for (int iDim = 0; iDim < dim; ++iDim)
+      VecSet(v, iDim, 2.0 * rnd() - 1.0);
+    PBPhysParticleSetSpeed(part, v);
+    PBPhysParticleSetMass(part, 1.0);
+  }
+  VecFree(&v);
+  return phys;
+}
+
+// Run the scenario 'scenario' for 'nbPart' particles in dimension 'dim'
+// and print its result as one CSV line on stdout
+// The case runs in its own process to measure its own peak RSS
+void BenchRunCase(const BenchScenario* const scenario, 
+  const BenchParam* const param, const int dim, const int nbPart) {
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(EXIT_FAILURE);
+  }
+  if (pid > 0) {
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS)
+      fprintf(stderr, "%s dim=%d nbPart=%d failed\n", 
+        scenario->_name, dim, nbPart);
+    return;
+  }
+  BenchData data = {NULL, NULL, NULL};
+  data._phys = BenchCreatePhys(scenario, param, dim, nbPart);
+  data._stream = tmpfile();
+  if (data._stream == NULL) {
+    perror("tmpfile");
+    exit(EXIT_FAILURE);
+  }
+  if (scenario->_init != NULL)
+    scenario->_init(&data);
+  // Run the operation once before the timed loop to exclude the
+  // allocation of the buffers reused from one step to the next
+  scenario->_op(&data);
+  unsigned long nbAllocStart = atomic_load(&nbAlloc);
+  long nbStep = 0;
+  double start = BenchGetTime();
+  double elapsed = 0.0;
+  do {
+    scenario->_op(&data);
+    ++nbStep;
+    elapsed = BenchGetTime() - start;
+  } while (elapsed < param->_minTime);
+  unsigned long nbAllocStep = atomic_load(&nbAlloc) - nbAllocStart;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  printf("%s,%d,%d,%d,%ld,%.6f,%.3f,%.3f,%.3f,%ld\n", 
+    scenario->_name, dim, nbPart, param->_nbThread, nbStep, elapsed, 
+    (double)nbStep / elapsed, 
+    1e9 * elapsed / ((double)nbStep * (double)nbPart), 
+    (double)nbAllocStep / (double)nbStep, (long)(usage.ru_maxrss));
+  fflush(stdout);
+  fclose(data._stream);
+  PBPhysFree(&(data._other));
+  PBPhysFree(&(data._phys));
+  exit(EXIT_SUCCESS);
+}
+
+// Parse the comma separated list of positive integers 'str' into 'vals'
+// Return the number of values, 0 if the list is invalid
+int BenchParseList(const char* const str, int* const vals) {
+  int nb = 0;
+  const char* ptr = str;
+  while (*ptr != '\0') {
+    char* end = NULL;
+    long val = strtol(ptr, &end, 10);
+    if (end == ptr || val <= 0 || nb == BENCH_MAXNBVAL || 
+      (*end != ',' && *end != '\0'))
+      return 0;
+    vals[nb++] = (int)val;
+    ptr = (*end == ',' ? end + 1 : end);
+  }
+  return nb;
+}
+
+void BenchUsage(FILE* const stream, const char* const exe) {
+  fprintf(stream, 
+    "usage: %s [-n nbPart,...] [-d dim,...] [-t minTime] [-j nbThread]"
+    " [-s] [-g] [-p] [-v] [-l] [-b] [-e] [scenario ...]\n"
+    "  -n  numbers of particles (default 100,1000)\n"
+    "  -d  dimensions (default 2,3)\n"
+    "  -t  minimum duration of each case in seconds (default 0.5)\n"
+    "  -j  number of threads (default 1)\n"
+    "  -s  structure of arrays storage\n"
+    "  -g  grid broad phase\n"
+    "  -p  sweep and prune broad phase\n"
+    "  -v  bounding volume hierarchy broad phase\n"
+    "  -l  Verlet neighbour lists broad phase\n"
+    "  -b  Barnes-Hut gravity solver\n"
+    "  -e  event driven scheduler\n"
+    "scenarios:", exe);
+  for (int iScenario = 0; iScenario < benchNbScenario; ++iScenario)
+    fprintf(stream, " %s", benchScenarios[iScenario]._name);
+  fprintf(stream, " (default all)\n"
+    "output: one CSV line per case, the time per step is the time per "
+    "call for the I/O scenarios\n");
+}
+
+int main(int argc, char** argv) {
+  BenchParam param = {
+    {100, 1000}, 2, {2, 3}, 2, 0.5, 1, PBPhysStorageAoS, 
+    PBPhysBroadPhaseNone, PBPhysGravitySolverExact, 
+    PBPhysSchedulerSequential};
+  int opt = 0;
+  while ((opt = getopt(argc, argv, "n:d:t:j:sgpvlbeh")) != -1) {
+    switch (opt) {
+      case 'n':
+        param._nbNbPart = BenchParseList(optarg, param._nbPart);
+        break;
+      case 'd':
+        param._nbDim = BenchParseList(optarg, param._dim);
+        break;
+      case 't':
+        param._minTime = atof(optarg);
+        break;
+      case 'j':
+        param._nbThread = atoi(optarg);
+        break;
+      case 's':
+        param._storage = PBPhysStorageSoA;
+        break;
+      case 'g':
+        param._broadPhase = PBPhysBroadPhaseGrid;
+        break;
+      case 'p':
+        param._broadPhase = PBPhysBroadPhaseSAP;
+        break;
+      case 'v':
+        param._broadPhase = PBPhysBroadPhaseBVH;
+        break;
+      case 'l':
+        param._broadPhase = PBPhysBroadPhaseVerlet;
+        break;
+      case 'b':
+        param._solver = PBPhysGravitySolverBarnesHut;
+        break;
+      case 'e':
+        param._scheduler = PBPhysSchedulerEventDriven;
+        break;
+      case 'h':
+        BenchUsage(stdout, argv[0]);
+        return EXIT_SUCCESS;
+      default:
+        BenchUsage(stderr, argv[0]);
+        return EXIT_FAILURE;
+    }
+  }
+  if (param._nbNbPart == 0 || param._nbDim == 0 || 
+    param._minTime < 0.0 || param._nbThread < 1) {
+    BenchUsage(stderr, argv[0]);
+    return EXIT_FAILURE;
+  }
+  // Select the scenarios
+  bool selected[sizeof(benchScenarios) / sizeof(benchScenarios[0])];
+  for (int iScenario = 0; iScenario < benchNbScenario; ++iScenario)
+    selected[iScenario] = (optind == argc);
+  for (int iArg = optind; iArg < argc; ++iArg) {
+    int iScenario = 0;
+    while (iScenario < benchNbScenario && 
+      strcmp(argv[iArg], benchScenarios[iScenario]._name) != 0)
+      ++iScenario;
+    if (iScenario == benchNbScenario) {
+      fprintf(stderr, "unknown scenario %s\n", argv[iArg]);
+      BenchUsage(stderr, argv[0]);
+      return EXIT_FAILURE;
+    }
+    selected[iScenario] = true;
+  }
+  printf("scenario,dim,nbPart,nbThread,nbStep,time,stepPerSec,"
+    "nsPerPartStep,allocPerStep,peakRSSKB\n");
+  for (int iScenario = 0; iScenario < benchNbScenario; ++iScenario)
+    if (selected[iScenario])
+      for (int iDim = 0; iDim < param._nbDim; ++iDim)
+        for (int iNb = 0; iNb < param._nbNbPart; ++iNb)
+          BenchRunCase(benchScenarios + iScenario, &param, 
+            param._dim[iDim], param._nbPart[iNb]);
+  return EXIT_SUCCESS;
+}
@@ -10,6 +10,10 @@
 
 #define RANDOMSEED 0
 
+// Counter of heap allocations, used to check the hot paths don't 
+// allocate memory
+#include "pbphys-alloc.c"
+
 void UnitTestPBPhysParticleCreateFreePrint() {
   PBPhysParticle* particle = PBPhysParticleCreate(2, 
     ShapoidTypeSpheroid);
@@ -229,6 +233,50 @@ void UnitTestPBPhysParticleLoadSave() {
   printf("UnitTestPBPhysParticleLoadSave OK\n");
 }
 
+void UnitTestPBPhysParticleLoadSaveBinary() {
+  PBPhysParticle* particle = PBPhysParticleCreate(3, 
+    ShapoidTypeFacoid);
+  VecFloat3D v = VecFloatCreateStatic3D();
+  VecSet(&v, 0, 1.0 / 3.0); VecSet(&v, 1, 2.0); VecSet(&v, 2, -0.1);
+  PBPhysParticleSetPos(particle, &v);
+  ShapoidScale(PBPhysParticleShape(particle), 0.7);
+  VecSet(&v, 0, 4.0 / 3.0); VecSet(&v, 1, 5.0); VecSet(&v, 2, 1e-7);
+  PBPhysParticleSetSpeed(particle, &v);
+  VecSet(&v, 0, 6.0); VecSet(&v, 1, -7.0 / 3.0); VecSet(&v, 2, 0.0);
+  PBPhysParticleSetAccel(particle, &v);
+  PBPhysParticleSetMass(particle, 8.0 / 3.0);
+  PBPhysParticleSetDrag(particle, 0.1);
+  PBPhysParticleSetFixed(particle, true);
+  FILE* fd = fopen("./particle.bin", "wb");
+  if (PBPhysParticleSaveBinary(particle, fd) == false) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysParticleSaveBinary failed");
+    PBErrCatch(PBPhysErr);
+  }
+  fclose(fd);
+  fd = fopen("./particle.bin", "rb");
+  PBPhysParticle* loaded = PBPhysParticleCreate(2, 
+    ShapoidTypeSpheroid);
+  // Values are restored exactly
+  if (PBPhysParticleLoadBinary(&loaded, fd) == false ||
+    PBPhysParticleIsSame(loaded, particle) == false ||
+    PBPhysParticleGetShapeType(loaded) != ShapoidTypeFacoid ||
+    PBPhysParticleGetMass(loaded) != PBPhysParticleGetMass(particle) ||
+    PBPhysParticleGetDrag(loaded) != PBPhysParticleGetDrag(particle) ||
+    VecGet(PBPhysParticleSpeed(loaded), 2) != 
+      VecGet(PBPhysParticleSpeed(particle), 2) ||
+    VecGet(ShapoidAxis(PBPhysParticleShape(loaded), 1), 1) != 
+      VecGet(ShapoidAxis(PBPhysParticleShape(particle), 1), 1)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysParticleLoadBinary failed");
+    PBErrCatch(PBPhysErr);
+  }
+  fclose(fd);
+  PBPhysParticleFree(&loaded);
+  PBPhysParticleFree(&particle);
+  printf("UnitTestPBPhysParticleLoadSaveBinary OK\n");
+}
+
 void UnitTestPBPhysParticleAccelMove() {
   PBPhysParticle* particle = PBPhysParticleCreate(2, 
     ShapoidTypeSpheroid);
@@ -330,6 +378,7 @@ void UnitTestPBPhysParticle() {
   UnitTestPBPhysParticleGetSet();
   UnitTestPBPhysParticleCloneIsSame();
   UnitTestPBPhysParticleLoadSave();
+  UnitTestPBPhysParticleLoadSaveBinary();
   UnitTestPBPhysParticleAccelMove();
   UnitTestPBPhysParticleTestTrajectory();
   printf("UnitTestPBPhysParticle OK\n");
@@ -494,193 +543,2371 @@ void UnitTestPBPhysLoadSave() {
   PBPhysFree(&loaded);
   printf("UnitTestPBPhysLoadSave OK\n");
 }
+void UnitTestPBPhysLoadSaveBinary() {
+  srandom(RANDOMSEED);
+  int dim = 3;
+  // More particles than PBPHYS_BINBLOCK to check the packing by blocks
+  int nbPart = 2 * PBPHYS_BINBLOCK + 10;
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysSetCurTime(phys, 1.0 / 3.0);
+  PBPhysSetDeltaT(phys, 0.001);
+  PBPhysSetDownGravity(phys, PBPHYS_Gn);
+  PBPhysSetGravity(phys, PBPHYS_G);
+  PBPhysAddParticles(phys, nbPart, ShapoidTypeSpheroid);
+  VecFloat* v = VecFloatCreate(dim);
+  for (int iPart = nbPart; iPart--;) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    for (int iDim = dim; iDim--;)
+      VecSet(v, iDim, (rnd() - 0.5) * 1000.0);
+    PBPhysParticleSetPos(part, v);
+    for (int iDim = dim; iDim--;)
+      VecSet(v, iDim, rnd() - 0.5);
+    PBPhysParticleSetSpeed(part, v);
+    PBPhysParticleSetMass(part, rnd());
+    PBPhysParticleSetDrag(part, rnd());
+    PBPhysParticleSetFixed(part, (iPart % 7 == 0));
+    ShapoidScale(PBPhysParticleShape(part), 0.5 + rnd());
+  }
+  VecFree(&v);
+  FILE* fd = fopen("./phys.bin", "wb");
+  if (!PBPhysSaveBinary(phys, fd)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSaveBinary failed");
+    PBErrCatch(PBPhysErr);
+  }
+  fclose(fd);
+  PBPhys* loaded = PBPhysCreate(2);
+  fd = fopen("./phys.bin", "rb");
+  if (!PBPhysLoadBinary(&loaded, fd) ||
+    !PBPhysIsSame(phys, loaded) || 
+    PBPhysGetCurTime(phys) != PBPhysGetCurTime(loaded)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysLoadBinary failed");
+    PBErrCatch(PBPhysErr);
+  }
+  fclose(fd);
+  // Values are restored exactly
+  for (int iPart = nbPart; iPart--;) {
+    const VecFloat* posA = 
+      ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, iPart)));
+    const VecFloat* posB = 
+      ShapoidPos(PBPhysParticleShape(PBPhysPart(loaded, iPart)));
+    for (int iDim = dim; iDim--;) {
+      if (VecGet(posA, iDim) != VecGet(posB, iDim)) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, "PBPhysLoadBinary failed (not exact)");
+        PBErrCatch(PBPhysErr);
+      }
+    }
+  }
+  // A particle is not a PBPhys
+  fd = fopen("./particle.bin", "rb");
+  if (PBPhysLoadBinary(&loaded, fd) || loaded != NULL) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysLoadBinary failed (invalid file)");
+    PBErrCatch(PBPhysErr);
+  }
+  fclose(fd);
+  PBPhysFree(&phys);
+  printf("UnitTestPBPhysLoadSaveBinary OK\n");
+}
 
-void UnitTestPBPhysStepFree() {
-  int dim = 2;
+void UnitTestPBPhysSnapshot() {
+  srandom(RANDOMSEED);
+  int dim = 3;
+  int nbPart = 100;
   PBPhys* phys = PBPhysCreate(dim);
-  PBPhysAddParticles(phys, 1, ShapoidTypeSpheroid);
-  VecFloat2D v = VecFloatCreateStatic2D();
-  VecSet(&v, 0, 1.0); VecSet(&v, 1, 0.5);
-  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
-  float check[20] = {
-    0.010000,0.005000,0.020000,0.010000,0.030000,0.015000,0.040000,
-    0.020000,0.050000,0.025000,0.060000,0.030000,0.070000,0.035000,
-    0.080000,0.040000,0.090000,0.045000,.100000,0.050000};
-  for (int i = 0; i < 10; ++i) {
-    PBPhysNext(phys);
-    VecSet(&v, 0, check[2 * i]); VecSet(&v, 1, check[2 * i + 1]);
-    if (!VecIsEqual(
-      ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, 0))),
-      &v)) {
+  PBPhysSetCurTime(phys, 1.0 / 3.0);
+  PBPhysSetDeltaT(phys, 0.01);
+  PBPhysSetDownGravity(phys, PBPHYS_Gn);
+  PBPhysAddParticles(phys, nbPart, ShapoidTypeSpheroid);
+  VecFloat* v = VecFloatCreate(dim);
+  for (int iPart = nbPart; iPart--;) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    for (int iDim = dim; iDim--;)
+      VecSet(v, iDim, (rnd() - 0.5) * 100.0);
+    PBPhysParticleSetPos(part, v);
+    for (int iDim = dim; iDim--;)
+      VecSet(v, iDim, rnd() - 0.5);
+    PBPhysParticleSetSpeed(part, v);
+    PBPhysParticleSetMass(part, 0.5 + rnd());
+    PBPhysParticleSetFixed(part, (iPart % 7 == 0));
+  }
+  VecFree(&v);
+  FILE* fd = fopen("./phys.bin", "wb");
+  (void)PBPhysSaveBinary(phys, fd);
+  fclose(fd);
+  PBPhysSnapshot* snap = PBPhysSnapshotOpen("./phys.bin");
+  if (snap == NULL || PBPhysSnapshotGetDim(snap) != dim ||
+    PBPhysSnapshotGetNbParticle(snap) != nbPart) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSnapshotOpen failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // Particles are materialised once, on demand
+  for (int iPart = 0; iPart < nbPart; iPart += 3) {
+    PBPhysParticle* part = PBPhysSnapshotParticle(snap, iPart);
+    if (part == NULL || 
+      !PBPhysParticleIsSame(part, PBPhysPart(phys, iPart)) ||
+      PBPhysSnapshotParticle(snap, iPart) != part) {
       PBPhysErr->_type = PBErrTypeUnitTestFailed;
-      sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+      sprintf(PBPhysErr->_msg, "PBPhysSnapshotParticle failed");
       PBErrCatch(PBPhysErr);
     }
   }
+  // Restore the PBPhys in both storage modes
+  PBPhys* aos = PBPhysSnapshotGetPBPhys(snap, PBPhysStorageAoS);
+  PBPhys* soa = PBPhysSnapshotGetPBPhys(snap, PBPhysStorageSoA);
+  if (aos == NULL || soa == NULL || !PBPhysIsSame(phys, aos) || 
+    !PBPhysIsSame(phys, soa) || 
+    PBPhysGetStorage(soa) != PBPhysStorageSoA ||
+    PBPhysGetCurTime(soa) != PBPhysGetCurTime(phys)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSnapshotGetPBPhys failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysSnapshotClose(&snap);
+  if (snap != NULL) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSnapshotClose failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // The restored PBPhys are independant from the snapshot and evolve 
+  // identically
+  for (int iStep = 10; iStep--;) {
+    PBPhysNext(aos);
+    PBPhysNext(soa);
+  }
+  if (!PBPhysIsSame(aos, soa)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSnapshotGetPBPhys failed (step)");
+    PBErrCatch(PBPhysErr);
+  }
+  // A particle is not a PBPhys
+  snap = PBPhysSnapshotOpen("./particle.bin");
+  if (snap != NULL) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSnapshotOpen failed (invalid file)");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysFree(&aos);
+  PBPhysFree(&soa);
   PBPhysFree(&phys);
-  printf("UnitTestPBPhysStepFree OK\n");
+  printf("UnitTestPBPhysSnapshot OK\n");
 }
 
-void UnitTestPBPhysStepDownGravity() {
+void UnitTestPBPhysRecorder() {
   int dim = 2;
+  int nbPart = 10;
   PBPhys* phys = PBPhysCreate(dim);
   PBPhysSetDownGravity(phys, PBPHYS_Gn);
-  PBPhysAddParticles(phys, 1, ShapoidTypeSpheroid);
+  PBPhysAddParticles(phys, nbPart, ShapoidTypeSpheroid);
   VecFloat2D v = VecFloatCreateStatic2D();
-  VecSet(&v, 0, 1.0); VecSet(&v, 1, 0.5);
-  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
-  float check[20] = {
-    0.010000,0.004510,0.020000,0.008039,0.030000,0.010587,0.040000,
-    0.012155,0.050000,0.012742,0.060000,0.012348,0.070000,0.010974,
-    0.080000,0.008619,0.090000,0.005283,0.100000,0.000967};
-  for (int i = 0; i < 10; ++i) {
-    PBPhysNext(phys);
-    VecSet(&v, 0, check[2 * i]); VecSet(&v, 1, check[2 * i + 1]);
-    if (!VecIsEqual(
-      ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, 0))),
-      &v)) {
+  for (int iPart = nbPart; iPart--;) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    VecSet(&v, 0, 10.0 * iPart); VecSet(&v, 1, 0.0);
+    PBPhysParticleSetPos(part, &v);
+    VecSet(&v, 0, 0.1 * iPart); VecSet(&v, 1, 1.0);
+    PBPhysParticleSetSpeed(part, &v);
+    PBPhysParticleSetFixed(part, (iPart == 3));
+  }
+  PBPhysRecorder* rec = PBPhysRecorderCreate(phys);
+  if (PBPhysRecorderGetFields(rec) != PBPHYS_RECFIELDS ||
+    PBPhysRecorderGetStride(rec) != 1 ||
+    PBPhysRecorderGetDrop(rec) != false ||
+    PBPhysRecorderGetRingSize(rec) != PBPHYS_RECRING ||
+    PBPhysRecorderIsRunning(rec)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysRecorderCreate failed");
+    PBErrCatch(PBPhysErr);
+  }
+  int fields = (1 << PBPhysBinFieldPos) | (1 << PBPhysBinFieldFixed);
+  PBPhysRecorderSetFields(rec, fields);
+  long parts[3] = {7, 1, 3};
+  PBPhysRecorderSetParticles(rec, 3, parts);
+  PBPhysRecorderSetStride(rec, 2);
+  PBPhysRecorderSetRingSize(rec, 2);
+  if (PBPhysRecorderGetFields(rec) != fields || 
+    PBPhysRecorderGetStride(rec) != 2 || 
+    PBPhysRecorderGetRingSize(rec) != 2 ||
+    !PBPhysRecorderStart(rec, "./traj.bin") || 
+    !PBPhysRecorderIsRunning(rec)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysRecorderStart failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // Step and memorize the expected records
+  int nbStep = 21;
+  int nbRecord = (nbStep + 1) / 2;
+  float check[11][7];
+  for (int iStep = 0; iStep < nbStep; ++iStep) {
+    PBPhysStep(phys);
+    if (iStep % 2 == 0) {
+      float* c = check[iStep / 2];
+      c[0] = PBPhysGetCurTime(phys);
+      for (int i = 0; i < 3; ++i) {
+        const VecFloat* pos = 
+          ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, parts[i])));
+        c[1 + 2 * i] = VecGet(pos, 0);
+        c[2 + 2 * i] = VecGet(pos, 1);
+      }
+    }
+  }
+  PBPhysRecorderStop(rec);
+  PBPhysRecorderStats stats = PBPhysRecorderGetStats(rec);
+  if (PBPhysRecorderIsRunning(rec) || phys->_recorder != NULL ||
+    stats._nbStep != nbStep || stats._nbRecord != nbRecord || 
+    stats._nbWritten != nbRecord || stats._nbDropped != 0 ||
+    stats._maxPending < 1 || stats._maxPending > 2 || stats._error) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysRecorderStop failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // Check the file
+  FILE* fd = fopen("./traj.bin", "rb");
+  char magic[5] = {0};
+  uint32_t version = 0;
+  int32_t fileDim = 0;
+  uint32_t fileFields = 0;
+  int64_t fileNbPart = 0;
+  int64_t index[3] = {0};
+  if (fread(magic, 1, 4, fd) != 4 || 
+    strcmp(magic, PBPHYS_BINMAGICRECORD) != 0 ||
+    fread(&version, sizeof(uint32_t), 1, fd) != 1 || 
+    version != PBPHYS_BINVERSION ||
+    fread(&fileDim, sizeof(int32_t), 1, fd) != 1 || fileDim != dim ||
+    fread(&fileFields, sizeof(uint32_t), 1, fd) != 1 || 
+    fileFields != (uint32_t)fields ||
+    fread(&fileNbPart, sizeof(int64_t), 1, fd) != 1 || 
+    fileNbPart != 3 ||
+    fread(index, sizeof(int64_t), 3, fd) != 3 || 
+    index[0] != 7 || index[1] != 1 || index[2] != 3) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysRecorder failed (header)");
+    PBErrCatch(PBPhysErr);
+  }
+  for (int iRecord = 0; iRecord < nbRecord; ++iRecord) {
+    float record[7];
+    uint8_t fixed[3];
+    if (fread(record, sizeof(float), 7, fd) != 7 ||
+      memcmp(record, check[iRecord], sizeof(float) * 7) != 0 ||
+      fread(fixed, 1, 3, fd) != 3 || 
+      fixed[0] != 0 || fixed[1] != 0 || fixed[2] != 1) {
       PBPhysErr->_type = PBErrTypeUnitTestFailed;
-      sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+      sprintf(PBPhysErr->_msg, "PBPhysRecorder failed (record %d)", 
+        iRecord);
       PBErrCatch(PBPhysErr);
     }
   }
+  if (fgetc(fd) != EOF) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysRecorder failed (end of file)");
+    PBErrCatch(PBPhysErr);
+  }
+  fclose(fd);
+  // With the drop policy every record is either written or dropped
+  PBPhysRecorderSetParticles(rec, 0, NULL);
+  PBPhysRecorderSetFields(rec, PBPHYS_RECFIELDS);
+  PBPhysRecorderSetStride(rec, 1);
+  PBPhysRecorderSetRingSize(rec, 1);
+  PBPhysRecorderSetDrop(rec, true);
+  (void)PBPhysRecorderStart(rec, "./traj.bin");
+  for (int iStep = 0; iStep < 100; ++iStep)
+    PBPhysNext(phys);
+  // Freeing the PBPhys stops the recorder
   PBPhysFree(&phys);
-  printf("UnitTestPBPhysStepDownGravity OK\n");
+  stats = PBPhysRecorderGetStats(rec);
+  fd = fopen("./traj.bin", "rb");
+  fseek(fd, 0, SEEK_END);
+  long sizeFile = ftell(fd);
+  fclose(fd);
+  long sizeHeader = 4 + 4 + 4 + 4 + 8 + 8 * nbPart;
+  long sizeRecord = 4 + 2 * dim * 4 * nbPart;
+  if (PBPhysRecorderIsRunning(rec) || stats._nbStep != 100 || 
+    stats._nbRecord + stats._nbDropped != 100 || 
+    stats._nbWritten != stats._nbRecord || 
+    stats._nbStall != 0 || stats._maxPending != 1 ||
+    sizeFile != sizeHeader + sizeRecord * stats._nbWritten) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysRecorder failed (drop)");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysRecorderFree(&rec);
+  if (rec != NULL) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysRecorderFree failed");
+    PBErrCatch(PBPhysErr);
+  }
+  printf("UnitTestPBPhysRecorder OK\n");
 }
 
-void UnitTestPBPhysStepGravity() {
+void UnitTestPBPhysTraj() {
+  srandom(RANDOMSEED);
   int dim = 2;
+  int nbPart = 30;
+  int nbFrame = 100;
+  int keyInterval = 16;
+  float errPos = 0.001;
+  float errSpeed = 0.0001;
   PBPhys* phys = PBPhysCreate(dim);
-  PBPhysSetGravity(phys, 1.0);
-  PBPhysAddParticles(phys, 2, ShapoidTypeSpheroid);
+  PBPhysSetDownGravity(phys, PBPHYS_Gn);
+  PBPhysAddParticles(phys, nbPart, ShapoidTypeSpheroid);
   VecFloat2D v = VecFloatCreateStatic2D();
-  VecSet(&v, 0, 1.0); VecSet(&v, 1, 0.5);
-  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
-  PBPhysParticleSetMass(PBPhysPart(phys, 0), 1.0);
-  VecSet(&v, 0, 1.0); VecSet(&v, 1, 1.0);
-  PBPhysParticleSetPos(PBPhysPart(phys, 1), &v);
-  PBPhysParticleSetMass(PBPhysPart(phys, 1), 1.0);
-  PBPhysParticleSetFixed(PBPhysPart(phys, 1), true);
-  float check[20] = {
-    0.010018,0.005018,0.020089,0.010089,0.030249,0.015249,0.040535,
-    0.020537,0.050984,0.025988,0.061633,0.031642,0.072520,0.037538,
-    0.083684,0.043716,0.095164,0.050216,0.107000,0.057080
-    };
-  for (int i = 0; i < 10; ++i) {
+  for (int iPart = nbPart; iPart--;) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    VecSet(&v, 0, 10.0 * iPart); VecSet(&v, 1, 100.0 * rnd());
+    PBPhysParticleSetPos(part, &v);
+    VecSet(&v, 0, rnd() - 0.5); VecSet(&v, 1, 2.0 * rnd());
+    PBPhysParticleSetSpeed(part, &v);
+  }
+  PBPhysTrajWriter* writer = PBPhysTrajWriterOpen("./traj.bin", phys, 
+    errPos, errSpeed, keyInterval);
+  // Memorize the exact trajectory
+  int nbVal = 2 * dim * nbPart;
+  float* check = PBErrMalloc(PBPhysErr, 
+    sizeof(float) * nbFrame * (nbVal + 1));
+  for (int iFrame = 0; iFrame < nbFrame; ++iFrame) {
     PBPhysNext(phys);
-    VecSet(&v, 0, check[2 * i]); VecSet(&v, 1, check[2 * i + 1]);
-    if (!VecIsEqual(
-      ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, 0))),
-      &v)) {
+    if (!PBPhysTrajWriterAdd(writer, phys)) {
       PBPhysErr->_type = PBErrTypeUnitTestFailed;
-      sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+      sprintf(PBPhysErr->_msg, "PBPhysTrajWriterAdd failed");
+      PBErrCatch(PBPhysErr);
+    }
+    float* c = check + iFrame * (nbVal + 1);
+    c[0] = PBPhysGetCurTime(phys);
+    for (int iPart = 0; iPart < nbPart; ++iPart) {
+      PBPhysParticle* part = PBPhysPart(phys, iPart);
+      for (int iDim = 0; iDim < dim; ++iDim) {
+        c[1 + iPart * dim + iDim] = 
+          VecGet(ShapoidPos(PBPhysParticleShape(part)), iDim);
+        c[1 + (nbPart + iPart) * dim + iDim] = 
+          VecGet(PBPhysParticleSpeed(part), iDim);
+      }
+    }
+  }
+  if (PBPhysTrajWriterGetNbFrame(writer) != nbFrame || 
+    !PBPhysTrajWriterClose(&writer) || writer != NULL) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysTrajWriterClose failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // The trajectory is smaller than the raw floats
+  FILE* fd = fopen("./traj.bin", "rb");
+  fseek(fd, 0, SEEK_END);
+  long sizeFile = ftell(fd);
+  fclose(fd);
+  if (sizeFile * 2 > (long)sizeof(float) * nbFrame * (nbVal + 1)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysTrajWriter failed (size %ld)", 
+      sizeFile);
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysTrajReader* reader = PBPhysTrajReaderOpen("./traj.bin");
+  if (reader == NULL || PBPhysTrajReaderGetDim(reader) != dim ||
+    PBPhysTrajReaderGetNbParticle(reader) != nbPart ||
+    PBPhysTrajReaderGetNbFrame(reader) != nbFrame ||
+    PBPhysTrajReaderGetKeyInterval(reader) != keyInterval ||
+    PBPhysTrajReaderGetIFrame(reader) != -1) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysTrajReaderOpen failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // Decode sequentially, then randomly
+  int order[8] = {73, 5, 99, 74, 0, 16, 15, 31};
+  for (int iCheck = 0; iCheck < nbFrame + 8; ++iCheck) {
+    int iFrame = (iCheck < nbFrame ? iCheck : order[iCheck - nbFrame]);
+    bool ret = (iCheck < nbFrame ? PBPhysTrajReaderNext(reader) : 
+      PBPhysTrajReaderSeek(reader, iFrame));
+    float* c = check + iFrame * (nbVal + 1);
+    if (!ret || PBPhysTrajReaderGetIFrame(reader) != iFrame ||
+      PBPhysTrajReaderGetCurTime(reader) != c[0]) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysTrajReader failed (frame %d)", 
+        iFrame);
+      PBErrCatch(PBPhysErr);
+    }
+    for (int iVal = 0; iVal < nbVal; ++iVal) {
+      float val = (iVal < nbVal / 2 ? 
+        PBPhysTrajReaderPos(reader)[iVal] : 
+        PBPhysTrajReaderSpeed(reader)[iVal - nbVal / 2]);
+      float err = (iVal < nbVal / 2 ? errPos : errSpeed);
+      if (fabs(val - c[1 + iVal]) > err * 1.001 + fabs(c[1 + iVal]) * 1e-6) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, 
+          "PBPhysTrajReader failed (frame %d, value %d)", iFrame, iVal);
+        PBErrCatch(PBPhysErr);
+      }
+    }
+    if (iCheck == nbFrame - 1 && PBPhysTrajReaderNext(reader)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysTrajReaderNext failed (end)");
       PBErrCatch(PBPhysErr);
     }
   }
+  if (PBPhysTrajReaderGetKeyAt(reader, check[50 * (nbVal + 1)]) != 3 ||
+    PBPhysTrajReaderGetKeyAt(reader, -1.0) != 0 ||
+    PBPhysTrajReaderGetKeyAt(reader, 1000.0) != 6) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysTrajReaderGetKeyAt failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // Restore the state of a frame into a PBPhys
+  (void)PBPhysTrajReaderSeek(reader, 42);
+  PBPhysTrajReaderApply(reader, phys);
+  if (PBPhysGetCurTime(phys) != check[42 * (nbVal + 1)] ||
+    fabs(VecGet(ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, 7))), 1) -
+    check[42 * (nbVal + 1) + 1 + 7 * dim + 1]) > errPos * 1.001) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysTrajReaderApply failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysTrajReaderClose(&reader);
+  // A PBPhys is not a trajectory
+  reader = PBPhysTrajReaderOpen("./phys.bin");
+  if (reader != NULL) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysTrajReaderOpen failed (invalid)");
+    PBErrCatch(PBPhysErr);
+  }
+  free(check);
   PBPhysFree(&phys);
-  printf("UnitTestPBPhysStepGravity OK\n");
+  printf("UnitTestPBPhysTraj OK\n");
 }
 
-void UnitTestPBPhysStepToCollisionApplyElasticCollision() {
+void UnitTestPBPhysArchive() {
+  srandom(RANDOMSEED);
   int dim = 2;
+  int nbPart = 20;
+  int nbStep = 50;
+  int keyInterval = 8;
   PBPhys* phys = PBPhysCreate(dim);
-  PBPhysAddParticles(phys, 3, ShapoidTypeSpheroid);
+  PBPhysSetDownGravity(phys, PBPHYS_Gn);
+  PBPhysAddParticles(phys, nbPart, ShapoidTypeSpheroid);
   VecFloat2D v = VecFloatCreateStatic2D();
-  VecSet(&v, 0, 1.0); VecSet(&v, 1, 1.0);
-  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
-  PBPhysParticleSetMass(PBPhysPart(phys, 0), 1.0);
-  VecSet(&v, 0, 0.0); VecSet(&v, 1, 2.0);
-  PBPhysParticleSetPos(PBPhysPart(phys, 1), &v);
-  VecSet(&v, 0, 0.5); VecSet(&v, 1, -0.5);
-  PBPhysParticleSetSpeed(PBPhysPart(phys, 1), &v);
-  PBPhysParticleSetMass(PBPhysPart(phys, 1), 1.0);
-  VecSet(&v, 0, 2.0); VecSet(&v, 1, 2.0);
-  PBPhysParticleSetPos(PBPhysPart(phys, 2), &v);
-  VecSet(&v, 0, -1.0); VecSet(&v, 1, -1.0);
-  PBPhysParticleSetSpeed(PBPhysPart(phys, 2), &v);
-  PBPhysParticleSetMass(PBPhysPart(phys, 2), 2.0);
-  PBPhysSetDeltaT(phys, 2.0);
-  GSetPBPhysParticle* set = PBPhysStepToCollision(phys);
-  if (!ISEQUALF(PBPhysGetCurTime(phys), 0.646447) ||
-    !ISEQUALF(PBPhysPart(phys,0)->_shape->_pos->_val[0], 0.646447) ||
-    !ISEQUALF(PBPhysPart(phys,0)->_shape->_pos->_val[1], 0.646447) ||
-    !ISEQUALF(PBPhysPart(phys,1)->_shape->_pos->_val[0], 0.323223) ||
-    !ISEQUALF(PBPhysPart(phys,1)->_shape->_pos->_val[1], 1.676777) ||
-    !ISEQUALF(PBPhysPart(phys,2)->_shape->_pos->_val[0], 1.353553) ||
-    !ISEQUALF(PBPhysPart(phys,2)->_shape->_pos->_val[1], 1.353553) ||
-    GSetNbElem(set) != 2 ||
-    GSetGet(set, 0) != PBPhysPart(phys,0) ||
-    GSetGet(set, 1) != PBPhysPart(phys,2)) {
+  for (int iPart = nbPart; iPart--;) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    VecSet(&v, 0, 3.0 * iPart); VecSet(&v, 1, 10.0 * rnd());
+    PBPhysParticleSetPos(part, &v);
+    VecSet(&v, 0, 20.0 * (rnd() - 0.5)); VecSet(&v, 1, 5.0 * rnd());
+    PBPhysParticleSetSpeed(part, &v);
+    PBPhysParticleSetMass(part, 0.5 + rnd());
+  }
+  VecSet(&v, 0, 1.0); VecSet(&v, 1, 2.0);
+  PBPhysParticleSetAccel(PBPhysPart(phys, 0), &v);
+  PBPhysArchive* archive = 
+    PBPhysArchiveOpen(phys, "./archive.bin", keyInterval);
+  if (archive == NULL || phys->_archive != archive ||
+    PBPhysArchiveGetKeyInterval(archive) != keyInterval ||
+    PBPhysArchiveGetNbRecord(archive) != 1) {
     PBPhysErr->_type = PBErrTypeUnitTestFailed;
-    sprintf(PBPhysErr->_msg, "PBPhysStepToCollision failed");
+    sprintf(PBPhysErr->_msg, "PBPhysArchiveOpen failed");
     PBErrCatch(PBPhysErr);
   }
-  PBPhysParticleApplyElasticCollision(GSetGet(set, 0), GSetGet(set, 1));
-  if (!ISEQUALF(PBPhysPart(phys,0)->_speed->_val[0], -1.666667) ||
-    !ISEQUALF(PBPhysPart(phys,0)->_speed->_val[1], -1.666667) ||
-    !ISEQUALF(PBPhysPart(phys,2)->_speed->_val[0], 0.333334) ||
-    !ISEQUALF(PBPhysPart(phys,2)->_speed->_val[1], 0.333334)) {
+  // Step and memorize the states, a particle is added in the middle
+  PBPhys* check[51];
+  check[0] = PBPhysClone(phys);
+  for (int iStep = 1; iStep <= nbStep; ++iStep) {
+    if (iStep == 20) {
+      PBPhysAddParticles(phys, 1, ShapoidTypeSpheroid);
+      VecSet(&v, 0, 1000.0); VecSet(&v, 1, 1000.0);
+      PBPhysParticleSetPos(PBPhysPart(phys, nbPart), &v);
+    }
+    if (iStep % 2 == 0)
+      PBPhysStep(phys);
+    else
+      PBPhysNext(phys);
+    check[iStep] = PBPhysClone(phys);
+  }
+  if (PBPhysArchiveGetNbRecord(archive) != nbStep + 1 ||
+    !PBPhysArchiveClose(&archive) || archive != NULL || 
+    phys->_archive != NULL) {
     PBPhysErr->_type = PBErrTypeUnitTestFailed;
-    sprintf(PBPhysErr->_msg, 
-      "PBPhysParticleApplyElasticCollision failed");
+    sprintf(PBPhysErr->_msg, "PBPhysArchiveClose failed");
     PBErrCatch(PBPhysErr);
   }
-  GSetFree(&set);
-  set = PBPhysStepToCollision(phys);
-  if (!ISEQUALF(PBPhysGetCurTime(phys), 0.878937) ||
-    !ISEQUALF(PBPhysPart(phys,0)->_shape->_pos->_val[0], 0.258963) ||
-    !ISEQUALF(PBPhysPart(phys,0)->_shape->_pos->_val[1], 0.258963) ||
-    !ISEQUALF(PBPhysPart(phys,1)->_shape->_pos->_val[0], 0.439468) ||
-    !ISEQUALF(PBPhysPart(phys,1)->_shape->_pos->_val[1], 1.560532) ||
-    !ISEQUALF(PBPhysPart(phys,2)->_shape->_pos->_val[0], 1.431050) ||
-    !ISEQUALF(PBPhysPart(phys,2)->_shape->_pos->_val[1], 1.431050) ||
-    GSetNbElem(set) != 2 ||
-    GSetGet(set, 0) != PBPhysPart(phys,1) ||
-    GSetGet(set, 1) != PBPhysPart(phys,2)) {
+  PBPhysArchiveReader* reader = PBPhysArchiveReaderOpen("./archive.bin");
+  if (reader == NULL || PBPhysArchiveReaderPBPhys(reader) != NULL ||
+    PBPhysArchiveReaderGetNbRecord(reader) != nbStep + 1 ||
+    PBPhysArchiveReaderGetIRecord(reader) != -1 ||
+    PBPhysArchiveReaderGetFirstTime(reader) != 
+      PBPhysGetCurTime(check[0]) ||
+    PBPhysArchiveReaderGetLastTime(reader) != 
+      PBPhysGetCurTime(check[nbStep]) ||
+    PBPhysArchiveReaderSeek(reader, -1.0)) {
     PBPhysErr->_type = PBErrTypeUnitTestFailed;
-    sprintf(PBPhysErr->_msg, "PBPhysStepToCollision failed");
+    sprintf(PBPhysErr->_msg, "PBPhysArchiveReaderOpen failed");
     PBErrCatch(PBPhysErr);
   }
-  PBPhysParticleApplyElasticCollision(GSetGet(set, 0), GSetGet(set, 1));
-  if (!ISEQUALF(PBPhysPart(phys,1)->_speed->_val[0], 0.138846) ||
-    !ISEQUALF(PBPhysPart(phys,1)->_speed->_val[1], -0.452840) ||
-    !ISEQUALF(PBPhysPart(phys,2)->_speed->_val[0], 0.513910) ||
-    !ISEQUALF(PBPhysPart(phys,2)->_speed->_val[1], 0.309754)) {
+  // Restore the states sequentially, then randomly, between two steps
+  int order[8] = {37, 3, 49, 20, 21, 0, 50, 19};
+  for (int iCheck = 0; iCheck < nbStep + 1 + 8; ++iCheck) {
+    int iStep = (iCheck <= nbStep ? iCheck : order[iCheck - nbStep - 1]);
+    float t = PBPhysGetCurTime(check[iStep]) + 
+      (iCheck > nbStep ? 0.5 * PBPhysGetDeltaT(phys) : 0.0);
+    const PBPhys* restored = NULL;
+    bool same = PBPhysArchiveReaderSeek(reader, t) &&
+      PBPhysArchiveReaderGetIRecord(reader) == iStep &&
+      (restored = PBPhysArchiveReaderPBPhys(reader)) != NULL &&
+      PBPhysGetCurTime(restored) == PBPhysGetCurTime(check[iStep]) &&
+      PBPhysGetNbParticle(restored) == PBPhysGetNbParticle(check[iStep]);
+    for (int iPart = 0; same && 
+      iPart < PBPhysGetNbParticle(check[iStep]); ++iPart) {
+      PBPhysParticle* a = PBPhysPart(restored, iPart);
+      PBPhysParticle* b = PBPhysPart(check[iStep], iPart);
+      for (int iDim = 0; iDim < dim; ++iDim)
+        same = same && 
+          VecGet(ShapoidPos(PBPhysParticleShape(a)), iDim) == 
+          VecGet(ShapoidPos(PBPhysParticleShape(b)), iDim) &&
+          VecGet(PBPhysParticleSpeed(a), iDim) == 
+          VecGet(PBPhysParticleSpeed(b), iDim) &&
+          VecGet(PBPhysParticleAccel(a), iDim) == 
+          VecGet(PBPhysParticleAccel(b), iDim);
+      same = same && 
+        PBPhysParticleGetMass(a) == PBPhysParticleGetMass(b);
+    }
+    if (!same) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysArchiveReaderSeek failed (%d)", 
+        iStep);
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  PBPhysArchiveReaderClose(&reader);
+  for (int iStep = 0; iStep <= nbStep; ++iStep)
+    PBPhysFree(check + iStep);
+  // A trajectory is not an archive
+  reader = PBPhysArchiveReaderOpen("./traj.bin");
+  if (reader != NULL) {
     PBPhysErr->_type = PBErrTypeUnitTestFailed;
-    sprintf(PBPhysErr->_msg, 
-      "PBPhysParticleApplyElasticCollision failed");
+    sprintf(PBPhysErr->_msg, "PBPhysArchiveReaderOpen failed (invalid)");
     PBErrCatch(PBPhysErr);
   }
-  GSetFree(&set);
-  VecSet(&v, 0, 0.0); VecSet(&v, 1, 0.0);
-  PBPhysParticleSetPos(PBPhysPart(phys, 0), &v);
-  VecSet(&v, 0, 1.0); VecSet(&v, 1, 1.0);
-  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
-  VecSet(&v, 0, 0.0); VecSet(&v, 1, 2.0);
-  PBPhysParticleSetPos(PBPhysPart(phys, 1), &v);
-  VecSet(&v, 0, 0.5); VecSet(&v, 1, -0.5);
-  PBPhysParticleSetSpeed(PBPhysPart(phys, 1), &v);
-  VecSet(&v, 0, 2.0); VecSet(&v, 1, 2.0);
-  PBPhysParticleSetPos(PBPhysPart(phys, 2), &v);
-  VecSet(&v, 0, -1.0); VecSet(&v, 1, -1.0);
-  PBPhysParticleSetSpeed(PBPhysPart(phys, 2), &v);
-  ShapoidScale(PBPhysParticleShape(PBPhysPart(phys, 2)), (float)2.0);
-  PBPhysSetDeltaT(phys, 0.05);
-  PBPhysSetCurTime(phys, 0.0);
-  FILE* fd = fopen("./collision.txt", "w");
-  for (int i = 0; i < 20; ++i) {
-    PBPhysStep(phys);
-    fprintf(fd, "%f %f %f %f %f %f %f\n", PBPhysGetCurTime(phys), 
-      PBPhysPart(phys,0)->_shape->_pos->_val[0],
-      PBPhysPart(phys,0)->_shape->_pos->_val[1],
-      PBPhysPart(phys,1)->_shape->_pos->_val[0],
-      PBPhysPart(phys,1)->_shape->_pos->_val[1],
-      PBPhysPart(phys,2)->_shape->_pos->_val[0],
-      PBPhysPart(phys,2)->_shape->_pos->_val[1]);
+  // The archive can be closed after its PBPhys is freed
+  archive = PBPhysArchiveOpen(phys, "./archive.bin", keyInterval);
+  PBPhysNext(phys);
+  PBPhysFree(&phys);
+  if (PBPhysArchiveGetNbRecord(archive) != 2 || 
+    PBPhysArchiveAdd(archive) || !PBPhysArchiveClose(&archive)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysArchiveClose failed (freed PBPhys)");
+    PBErrCatch(PBPhysErr);
+  }
+  printf("UnitTestPBPhysArchive OK\n");
+}
+void UnitTestPBPhysSaveStream() {
+  srandom(RANDOMSEED);
+  int dim = 3;
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysSetCurTime(phys, 0.125);
+  PBPhysSetDownGravity(phys, 9.75);
+  PBPhysAddParticles(phys, 5, ShapoidTypeSpheroid);
+  PBPhysAddParticles(phys, 3, ShapoidTypeFacoid);
+  VecFloat* v = VecFloatCreate(dim);
+  for (int iPart = PBPhysGetNbParticle(phys); iPart--;) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    // Values exactly represented with 6 decimals to reload them as is
+    for (int iDim = dim; iDim--;)
+      VecSet(v, iDim, (float)(random() % 400 - 200) * 0.25);
+    PBPhysParticleSetPos(part, v);
+    PBPhysParticleSetSpeed(part, v);
+    PBPhysParticleSetMass(part, 0.5 + 0.25 * (float)iPart);
+    PBPhysParticleSetFixed(part, (iPart % 3 == 0));
+  }
+  VecFree(&v);
+  // The streamed text must be the one of the JSONNode, in both forms
+  for (int compact = 0; compact < 2; ++compact) {
+    FILE* fd = fopen("./physStream.txt", "w");
+    bool ret = PBPhysSave(phys, fd, compact);
+    fclose(fd);
+    JSONNode* json = PBPhysEncodeAsJSON(phys);
+    fd = fopen("./physTree.txt", "w");
+    ret = ret && JSONSave(json, fd, compact);
+    fclose(fd);
+    JSONFree(&json);
+    FILE* fdA = fopen("./physStream.txt", "r");
+    FILE* fdB = fopen("./physTree.txt", "r");
+    int c = 0;
+    while (ret && c != EOF) {
+      c = fgetc(fdA);
+      ret = (c == fgetc(fdB));
+    }
+    fclose(fdA);
+    fclose(fdB);
+    if (!ret) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSave failed (compact %d)", 
+        compact);
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  PBPhys* loaded = NULL;
+  FILE* fd = fopen("./physStream.txt", "r");
+  if (!PBPhysLoad(&loaded, fd) || !PBPhysIsSame(phys, loaded)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysLoad failed");
+    PBErrCatch(PBPhysErr);
+  }
+  fclose(fd);
+  PBPhysFree(&loaded);
+  // A PBPhys without particle can be saved and loaded
+  PBPhys* empty = PBPhysCreate(dim);
+  fd = fopen("./physStream.txt", "w");
+  if (!PBPhysSave(empty, fd, false)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSave failed (empty)");
+    PBErrCatch(PBPhysErr);
+  }
+  fclose(fd);
+  fd = fopen("./physStream.txt", "r");
+  if (!PBPhysLoad(&loaded, fd) || !PBPhysIsSame(empty, loaded)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysLoad failed (empty)");
+    PBErrCatch(PBPhysErr);
   }
   fclose(fd);
+  PBPhysFree(&loaded);
+  PBPhysFree(&empty);
   PBPhysFree(&phys);
-  printf("UnitTestPBPhysStepToCollisionApplyElasticCollision OK\n");
+  printf("UnitTestPBPhysSaveStream OK\n");
+}
+// Data of the progress function of UnitTestPBPhysLoadProgress
+typedef struct UnitTestPBPhysLoadProgressData {
+  long _nbCall;
+  long _nbByte;
+  bool _ok;
+} UnitTestPBPhysLoadProgressData;
+void UnitTestPBPhysLoadProgressFun(void* const data, 
+  const long nbLoaded, const long nbParticle, const long nbByte) {
+  UnitTestPBPhysLoadProgressData* d = 
+    (UnitTestPBPhysLoadProgressData*)data;
+  ++(d->_nbCall);
+  if (nbLoaded != d->_nbCall || nbParticle != 6 || nbByte <= d->_nbByte)
+    d->_ok = false;
+  d->_nbByte = nbByte;
+}
+void UnitTestPBPhysLoadProgress() {
+  int dim = 2;
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysSetCurTime(phys, 0.5);
+  PBPhysAddParticles(phys, 4, ShapoidTypeSpheroid);
+  PBPhysAddParticles(phys, 2, ShapoidTypeFacoid);
+  VecFloat* v = VecFloatCreate(dim);
+  for (int iPart = PBPhysGetNbParticle(phys); iPart--;) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    VecSet(v, 0, 0.25 * (float)iPart);
+    VecSet(v, 1, -1.5);
+    PBPhysParticleSetPos(part, v);
+    PBPhysParticleSetSpeed(part, v);
+    PBPhysParticleSetMass(part, 1.0 + (float)iPart);
+    PBPhysParticleSetDrag(part, 0.125);
+  }
+  VecFree(&v);
+  // Load in both forms with the progress reported per particle
+  for (int compact = 0; compact < 2; ++compact) {
+    FILE* fd = fopen("./physProgress.txt", "w");
+    PBPhysSave(phys, fd, compact);
+    fclose(fd);
+    UnitTestPBPhysLoadProgressData data = {0, 0, true};
+    PBPhys* loaded = NULL;
+    fd = fopen("./physProgress.txt", "r");
+    if (!PBPhysLoadWithProgress(&loaded, fd, 
+      UnitTestPBPhysLoadProgressFun, &data) || 
+      !PBPhysIsSame(phys, loaded) || !data._ok || data._nbCall != 6) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysLoadWithProgress failed (%d)", 
+        compact);
+      PBErrCatch(PBPhysErr);
+    }
+    fclose(fd);
+    PBPhysFree(&loaded);
+  }
+  PBPhysFree(&phys);
+  // Properties in another order and unknown properties are accepted
+  char part[500];
+  sprintf(part, "{\"_type\":\"%d\",\"_dim\":\"1\",\"_mass\":\"2.0\","
+    "\"_shape\":{\"_dim\":\"1\",\"_type\":\"%d\",\"_pos\":{\"_dim\":\"1\","
+    "\"_val\":[\"3.0\"]},\"_axis\":[{\"_dim\":\"1\",\"_val\":[\"1.0\"]}]},"
+    "\"_speed\":{\"_dim\":\"1\",\"_val\":[\"-1.0\"]},\"_accel\":{\"_dim\":"
+    "\"1\",\"_val\":[\"0.0\"]},\"_drag\":\"0.0\",\"_fixed\":\"1\"}", 
+    ShapoidTypeSpheroid, ShapoidTypeSpheroid);
+  FILE* fd = fopen("./physProgress.txt", "w");
+  fprintf(fd, "{ \"_user\" : {\"_a\":[\"1\", {}]},\n\"_dim\":\"1\", "
+    "\"_curTime\":\"1.0\", \"_deltaT\":\"0.5\",\"_gravity\":\"0.0\", "
+    "\"_particles\":[%s,\n %s], \"_downGravity\":\"2.0\", "
+    "\"_nbParticle\":\"2\" }\n", part, part);
+  fclose(fd);
+  PBPhys* loaded = NULL;
+  fd = fopen("./physProgress.txt", "r");
+  if (!PBPhysLoad(&loaded, fd) || PBPhysGetNbParticle(loaded) != 2 ||
+    ISEQUALF(PBPhysGetDeltaT(loaded), 0.5) == false ||
+    ISEQUALF(PBPhysGetDownGravity(loaded), 2.0) == false ||
+    ISEQUALF(PBPhysParticleGetMass(PBPhysPart(loaded, 1)), 2.0) == false ||
+    !PBPhysParticleIsFixed(PBPhysPart(loaded, 1)) ||
+    ISEQUALF(VecGet(PBPhysParticleSpeed(PBPhysPart(loaded, 0)), 0), 
+      -1.0) == false) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysLoad failed (order)");
+    PBErrCatch(PBPhysErr);
+  }
+  fclose(fd);
+  // The number of particles must match _nbParticle, and truncated or 
+  // invalid texts, particles of another dimension than the system and 
+  // invalid types of shape are refused
+  char badPart[500];
+  sprintf(badPart, "%s", part);
+  badPart[10] = '9';
+  const char* invalid[6] = {
+    "{\"_dim\":\"1\",\"_curTime\":\"1.0\",\"_deltaT\":\"0.5\","
+      "\"_downGravity\":\"2.0\",\"_gravity\":\"0.0\","
+      "\"_nbParticle\":\"3\",\"_particles\":[%s,%s]}",
+    "{\"_dim\":\"1\",\"_curTime\":\"1.0\",\"_deltaT\":\"0.5\","
+      "\"_downGravity\":\"2.0\",\"_gravity\":\"0.0\","
+      "\"_nbParticle\":\"1\",\"_particles\":[%s,%s]}",
+    "{\"_dim\":\"1\",\"_curTime\":\"1.0\",\"_deltaT\":\"0.5\","
+      "\"_downGravity\":\"2.0\",\"_gravity\":\"0.0\","
+      "\"_nbParticle\":\"2\",\"_particles\":[%s,%s",
+    "{\"_dim\":\"1\",\"_curTime\":\"1.0\",\"_deltaT\":\"0.5\","
+      "\"_downGravity\":\"2.0\",\"_gravity\":\"0.0\","
+      "\"_nbParticle\":\"2\",\"_particles\":[%s %s]}",
+    "{\"_dim\":\"2\",\"_curTime\":\"1.0\",\"_deltaT\":\"0.5\","
+      "\"_downGravity\":\"2.0\",\"_gravity\":\"0.0\","
+      "\"_nbParticle\":\"2\",\"_particles\":[%s,%s]}",
+    "{\"_dim\":\"1\",\"_curTime\":\"1.0\",\"_deltaT\":\"0.5\","
+      "\"_downGravity\":\"2.0\",\"_gravity\":\"0.0\","
+      "\"_nbParticle\":\"2\",\"_particles\":[%s,%s]}"
+  };
+  for (int iTest = 0; iTest < 6; ++iTest) {
+    const char* str = (iTest == 5 ? badPart : part);
+    fd = fopen("./physProgress.txt", "w");
+    fprintf(fd, invalid[iTest], str, str);
+    fclose(fd);
+    fd = fopen("./physProgress.txt", "r");
+    if (PBPhysLoad(&loaded, fd)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysLoad failed (invalid %d)", iTest);
+      PBErrCatch(PBPhysErr);
+    }
+    fclose(fd);
+  }
+  PBPhysFree(&loaded);
+  printf("UnitTestPBPhysLoadProgress OK\n");
+}
+void UnitTestPBPhysStats() {
+  // Two particles colliding once, with both schedulers
+  PBPhys* phys = PBPhysCreate(2);
+  PBPhysAddParticles(phys, 2, ShapoidTypeSpheroid);
+  VecFloat2D v = VecFloatCreateStatic2D();
+  VecSet(&v, 0, 3.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 1), &v);
+  VecSet(&v, 0, 10.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
+  VecSet(&v, 0, -10.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 1), &v);
+  PBPhysParticleSetMass(PBPhysPart(phys, 0), 1.0);
+  PBPhysParticleSetMass(PBPhysPart(phys, 1), 1.0);
+  PBPhys* event = PBPhysClone(phys);
+  PBPhysSetScheduler(event, PBPhysSchedulerEventDriven);
+  unsigned long nbStep = 20;
+  for (unsigned long iStep = nbStep; iStep--;) {
+    PBPhysStep(phys);
+    PBPhysStep(event);
+  }
+  PBPhysNext(phys);
+  PBPhysStats stats = PBPhysGetStats(phys);
+  PBPhysStats statsEvent = PBPhysGetStats(event);
+#if PBPHYS_STATS
+  // The sequential scheduler sweeps once per step plus once per 
+  // collision, the event driven one once per step
+  if (stats._nbStep != nbStep + 1 || stats._nbCollision != 1 ||
+    stats._nbSweep != nbStep + 1 || stats._nbPairTest != nbStep + 1 ||
+    stats._nbTOISolve == 0 || stats._nbTOISolve > stats._nbPairTest ||
+    stats._nbAlloc == 0 || statsEvent._nbStep != nbStep || 
+    statsEvent._nbCollision != 1 || statsEvent._nbSweep != nbStep ||
+    statsEvent._nbPairTest < nbStep || statsEvent._nbTOISolve == 0) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysGetStats failed");
+    PBErrCatch(PBPhysErr);
+  }
+  for (int iPhase = 0; iPhase < PBPhysPhaseNb; ++iPhase) {
+    if (stats._time[iPhase] < 0.0 || statsEvent._time[iPhase] < 0.0) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysGetStats failed (time)");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+#else
+  // The statistics are compiled out
+  if (stats._nbStep != 0 || stats._nbSweep != 0 || 
+    stats._nbAlloc != 0 || statsEvent._nbStep != 0 || 
+    statsEvent._nbPairTest != 0) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysGetStats failed (disabled)");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  FILE* fd = fopen("./stats.txt", "w");
+  PBPhysStatsPrintln(&stats, fd);
+  fclose(fd);
+  PBPhysResetStats(phys);
+  stats = PBPhysGetStats(phys);
+  if (stats._nbStep != 0 || stats._nbCollision != 0 || 
+    stats._nbPairTest != 0 || stats._time[PBPhysPhaseSearch] != 0.0) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysResetStats failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysFree(&phys);
+  PBPhysFree(&event);
+  // The counters don't depend on the number of threads
+  srandom(RANDOMSEED);
+  int nbPart = 60;
+  phys = PBPhysCreate(2);
+  PBPhysAddParticles(phys, nbPart, ShapoidTypeSpheroid);
+  for (int iPart = nbPart; iPart--;) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    VecSet(&v, 0, (float)(iPart % 8) * 2.0);
+    VecSet(&v, 1, (float)(iPart / 8) * 2.0);
+    PBPhysParticleSetPos(part, &v);
+    VecSet(&v, 0, (rnd() - 0.5) * 50.0);
+    VecSet(&v, 1, (rnd() - 0.5) * 50.0);
+    PBPhysParticleSetSpeed(part, &v);
+    PBPhysParticleSetMass(part, 1.0);
+  }
+  PBPhys* threaded = PBPhysClone(phys);
+  PBPhysSetNbThread(threaded, 2);
+  for (int iStep = 5; iStep--;) {
+    PBPhysStep(phys);
+    PBPhysStep(threaded);
+  }
+  stats = PBPhysGetStats(phys);
+  PBPhysStats statsThreaded = PBPhysGetStats(threaded);
+  if (stats._nbCollision != statsThreaded._nbCollision || 
+    stats._nbSweep != statsThreaded._nbSweep ||
+    stats._nbPairTest != statsThreaded._nbPairTest ||
+    stats._nbTOISolve != statsThreaded._nbTOISolve) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysGetStats failed (threads)");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysFree(&phys);
+  PBPhysFree(&threaded);
+  printf("UnitTestPBPhysStats OK\n");
+}
+void UnitTestPBPhysTrace() {
+  // Two particles colliding once
+  PBPhys* phys = PBPhysCreate(2);
+  PBPhysAddParticles(phys, 2, ShapoidTypeSpheroid);
+  VecFloat2D v = VecFloatCreateStatic2D();
+  VecSet(&v, 0, 3.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 1), &v);
+  VecSet(&v, 0, 10.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
+  VecSet(&v, 0, -10.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 1), &v);
+  PBPhysParticleSetMass(PBPhysPart(phys, 0), 1.0);
+  PBPhysParticleSetMass(PBPhysPart(phys, 1), 1.0);
+  if (PBPhysIsTracing(phys) || PBPhysGetTrace(phys) != NULL) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysIsTracing failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysSetTracing(phys, true);
+  int nbStep = 20;
+  for (int iStep = nbStep; iStep--;)
+    PBPhysStep(phys);
+  PBPhysSetTracing(phys, false);
+  PBPhysTrace* trace = PBPhysGetTrace(phys);
+  long nbEvent = PBPhysTraceGetNbEvent(trace);
+  // No more events once the tracing is stopped
+  PBPhysStep(phys);
+  if (PBPhysIsTracing(phys) || trace == NULL || 
+    trace->_nbBuffer != 1 || nbEvent == 0 || 
+    PBPhysTraceGetNbEvent(trace) != nbEvent) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSetTracing failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // The events are nested and in chronological order, each step 
+  // calls PBPhysStepToCollision once more than it has collisions
+  PBPhysTraceBuffer* buffer = trace->_buffers;
+  const char* stack[10];
+  int depth = 0;
+  int nbStepEvent = 0;
+  int nbStepToColl = 0;
+  for (long iEvent = 0; iEvent < buffer->_nb; ++iEvent) {
+    PBPhysTraceEvent* event = buffer->_events + iEvent;
+    if ((iEvent > 0 && event->_time < event[-1]._time) || 
+      (event->_type == 'B' && depth == 10) || 
+      (event->_type == 'E' && 
+      (depth == 0 || strcmp(stack[depth - 1], event->_name) != 0))) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysTrace failed (event %ld)", iEvent);
+      PBErrCatch(PBPhysErr);
+    }
+    if (event->_type == 'B') {
+      stack[depth++] = event->_name;
+      if (strcmp(event->_name, "step") == 0)
+        ++nbStepEvent;
+      if (strcmp(event->_name, "step to collision") == 0)
+        ++nbStepToColl;
+    } else {
+      --depth;
+    }
+  }
+  if (depth != 0 || nbStepEvent != nbStep || 
+    nbStepToColl != nbStep + 1) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysTrace failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // Save the trace, one line per event and per thread plus the 
+  // opening and closing lines
+  FILE* fd = fopen("./trace.json", "w");
+  if (!PBPhysSaveTrace(phys, fd)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSaveTrace failed");
+    PBErrCatch(PBPhysErr);
+  }
+  fclose(fd);
+  fd = fopen("./trace.json", "r");
+  char line[200];
+  long nbLine = 0;
+  bool isHeader = (fgets(line, 200, fd) != NULL && 
+    strcmp(line, "{\"traceEvents\":[\n") == 0);
+  do {
+    ++nbLine;
+  } while (fgets(line, 200, fd) != NULL);
+  fclose(fd);
+  if (!isHeader || nbLine != nbEvent + 3 || 
+    strcmp(line, "],\"displayTimeUnit\":\"ms\"}\n") != 0) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSaveTrace failed (file)");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysTraceReset(trace);
+  if (PBPhysTraceGetNbEvent(trace) != 0) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysTraceReset failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // The jobs of the workers are recorded in their own buffer
+  PBPhysSetNbThread(phys, 2);
+  PBPhysSetTracing(phys, true);
+  PBPhysStep(phys);
+  if (trace->_nbBuffer != 2 || trace->_buffers[1]._nb == 0 || 
+    trace->_buffers[1]._nb % 2 != 0 || 
+    strcmp(trace->_buffers[1]._events[0]._name, "sys accel job") != 0) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysTrace failed (threads)");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysFree(&phys);
+  printf("UnitTestPBPhysTrace OK\n");
+}
+void UnitTestPBPhysHisto() {
+  PBPhysHisto* histo = PBPhysHistoCreate();
+  if (PBPhysHistoGetNb(histo) != 0 || 
+    PBPhysHistoGetPercentile(histo, 50.0) != 0 || 
+    PBPhysHistoGetMax(histo) != 0) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysHistoCreate failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // The low values are exact, the other ones are within the relative 
+  // precision of the histogram
+  for (unsigned long val = 1; val <= 10000; ++val)
+    PBPhysHistoAdd(histo, val);
+  float percents[5] = {0.0, 1.0, 50.0, 99.0, 100.0};
+  unsigned long checks[5] = {1, 100, 5000, 9900, 10000};
+  for (int iCheck = 0; iCheck < 5; ++iCheck) {
+    unsigned long val = 
+      PBPhysHistoGetPercentile(histo, percents[iCheck]);
+    if (val < checks[iCheck] || val > checks[iCheck] + 
+      checks[iCheck] / (1 << (PBPHYS_HISTOSUBBITS - 1))) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, 
+        "PBPhysHistoGetPercentile failed (%f: %lu)", 
+        percents[iCheck], val);
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  if (PBPhysHistoGetNb(histo) != 10000 || 
+    PBPhysHistoGetMin(histo) != 1 || 
+    PBPhysHistoGetMax(histo) != 10000 ||
+    !ISEQUALF(PBPhysHistoGetMean(histo), 5000.5)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysHistoAdd failed");
+    PBErrCatch(PBPhysErr);
+  }
+  // The values above the range are clamped but the highest one is kept
+  PBPhysHistoAdd(histo, 1UL << 50);
+  if (PBPhysHistoGetPercentile(histo, 100.0) != 1UL << 50) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysHistoGetPercentile failed (max)");
+    PBErrCatch(PBPhysErr);
+  }
+  FILE* fd = fopen("./histo.txt", "w");
+  PBPhysHistoPrintln(histo, fd);
+  fclose(fd);
+  PBPhysHistoReset(histo);
+  if (PBPhysHistoGetNb(histo) != 0 || PBPhysHistoGetMin(histo) != 0) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysHistoReset failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysHistoFree(&histo);
+  // Two particles colliding once, with both schedulers
+  PBPhys* phys = PBPhysCreate(2);
+  PBPhysAddParticles(phys, 2, ShapoidTypeSpheroid);
+  VecFloat2D v = VecFloatCreateStatic2D();
+  VecSet(&v, 0, 3.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 1), &v);
+  VecSet(&v, 0, 10.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
+  VecSet(&v, 0, -10.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 1), &v);
+  PBPhysParticleSetMass(PBPhysPart(phys, 0), 1.0);
+  PBPhysParticleSetMass(PBPhysPart(phys, 1), 1.0);
+  PBPhys* event = PBPhysClone(phys);
+  PBPhysSetScheduler(event, PBPhysSchedulerEventDriven);
+  if (PBPhysGetStepTimeHisto(phys) != NULL || 
+    PBPhysGetStepIterHisto(phys) != NULL) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysGetStepTimeHisto failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysSetStepHistos(phys, true);
+  PBPhysSetStepHistos(event, true);
+  for (int iStep = 20; iStep--;) {
+    PBPhysStep(phys);
+    PBPhysStep(event);
+  }
+  PBPhysNext(phys);
+  // One step has two sub-steps, the other ones only one, PBPhysNext 
+  // has no sub-step
+  for (int iPhys = 0; iPhys < 2; ++iPhys) {
+    PBPhys* p = (iPhys == 0 ? phys : event);
+    PBPhysHisto* timeHisto = PBPhysGetStepTimeHisto(p);
+    PBPhysHisto* iterHisto = PBPhysGetStepIterHisto(p);
+    if (PBPhysHistoGetNb(timeHisto) != (iPhys == 0 ? 21 : 20) || 
+      PBPhysHistoGetNb(iterHisto) != 20 || 
+      PBPhysHistoGetMin(iterHisto) != 1 || 
+      PBPhysHistoGetMax(iterHisto) != 2 || 
+      PBPhysHistoGetPercentile(iterHisto, 90.0) != 1 || 
+      PBPhysHistoGetPercentile(iterHisto, 100.0) != 2 || 
+      PBPhysHistoGetPercentile(timeHisto, 50.0) > 
+      PBPhysHistoGetMax(timeHisto)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSetStepHistos failed (%d)", 
+        iPhys);
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  PBPhysSetStepHistos(phys, false);
+  PBPhysStep(phys);
+  if (PBPhysGetStepTimeHisto(phys) != NULL || 
+    PBPhysGetStepIterHisto(phys) != NULL) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSetStepHistos failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysFree(&phys);
+  PBPhysFree(&event);
+  printf("UnitTestPBPhysHisto OK\n");
+}
+
+
+void UnitTestPBPhysStepFree() {
+  int dim = 2;
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysAddParticles(phys, 1, ShapoidTypeSpheroid);
+  VecFloat2D v = VecFloatCreateStatic2D();
+  VecSet(&v, 0, 1.0); VecSet(&v, 1, 0.5);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
+  float check[20] = {
+    0.010000,0.005000,0.020000,0.010000,0.030000,0.015000,0.040000,
+    0.020000,0.050000,0.025000,0.060000,0.030000,0.070000,0.035000,
+    0.080000,0.040000,0.090000,0.045000,.100000,0.050000};
+  for (int i = 0; i < 10; ++i) {
+    PBPhysNext(phys);
+    VecSet(&v, 0, check[2 * i]); VecSet(&v, 1, check[2 * i + 1]);
+    if (!VecIsEqual(
+      ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, 0))),
+      &v)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  PBPhysFree(&phys);
+  printf("UnitTestPBPhysStepFree OK\n");
+}
+
+void UnitTestPBPhysStepDownGravity() {
+  int dim = 2;
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysSetDownGravity(phys, PBPHYS_Gn);
+  PBPhysAddParticles(phys, 1, ShapoidTypeSpheroid);
+  VecFloat2D v = VecFloatCreateStatic2D();
+  VecSet(&v, 0, 1.0); VecSet(&v, 1, 0.5);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
+  float check[20] = {
+    0.010000,0.004510,0.020000,0.008039,0.030000,0.010587,0.040000,
+    0.012155,0.050000,0.012742,0.060000,0.012348,0.070000,0.010974,
+    0.080000,0.008619,0.090000,0.005283,0.100000,0.000967};
+  for (int i = 0; i < 10; ++i) {
+    PBPhysNext(phys);
+    VecSet(&v, 0, check[2 * i]); VecSet(&v, 1, check[2 * i + 1]);
+    if (!VecIsEqual(
+      ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, 0))),
+      &v)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  PBPhysFree(&phys);
+  printf("UnitTestPBPhysStepDownGravity OK\n");
+}
+
+void UnitTestPBPhysStepGravity() {
+  int dim = 2;
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysSetGravity(phys, 1.0);
+  PBPhysAddParticles(phys, 2, ShapoidTypeSpheroid);
+  VecFloat2D v = VecFloatCreateStatic2D();
+  VecSet(&v, 0, 1.0); VecSet(&v, 1, 0.5);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
+  PBPhysParticleSetMass(PBPhysPart(phys, 0), 1.0);
+  VecSet(&v, 0, 1.0); VecSet(&v, 1, 1.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 1), &v);
+  PBPhysParticleSetMass(PBPhysPart(phys, 1), 1.0);
+  PBPhysParticleSetFixed(PBPhysPart(phys, 1), true);
+  float check[20] = {
+    0.010018,0.005018,0.020089,0.010089,0.030249,0.015249,0.040535,
+    0.020537,0.050984,0.025988,0.061633,0.031642,0.072520,0.037538,
+    0.083684,0.043716,0.095164,0.050216,0.107000,0.057080
+    };
+  for (int i = 0; i < 10; ++i) {
+    PBPhysNext(phys);
+    VecSet(&v, 0, check[2 * i]); VecSet(&v, 1, check[2 * i + 1]);
+    if (!VecIsEqual(
+      ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, 0))),
+      &v)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  PBPhysFree(&phys);
+  printf("UnitTestPBPhysStepGravity OK\n");
+}
+
+void UnitTestPBPhysStepToCollisionApplyElasticCollision() {
+  int dim = 2;
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysAddParticles(phys, 3, ShapoidTypeSpheroid);
+  VecFloat2D v = VecFloatCreateStatic2D();
+  VecSet(&v, 0, 1.0); VecSet(&v, 1, 1.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
+  PBPhysParticleSetMass(PBPhysPart(phys, 0), 1.0);
+  VecSet(&v, 0, 0.0); VecSet(&v, 1, 2.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 1), &v);
+  VecSet(&v, 0, 0.5); VecSet(&v, 1, -0.5);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 1), &v);
+  PBPhysParticleSetMass(PBPhysPart(phys, 1), 1.0);
+  VecSet(&v, 0, 2.0); VecSet(&v, 1, 2.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 2), &v);
+  VecSet(&v, 0, -1.0); VecSet(&v, 1, -1.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 2), &v);
+  PBPhysParticleSetMass(PBPhysPart(phys, 2), 2.0);
+  PBPhysSetDeltaT(phys, 2.0);
+  GSetPBPhysParticle* set = PBPhysStepToCollision(phys);
+  if (!ISEQUALF(PBPhysGetCurTime(phys), 0.646447) ||
+    !ISEQUALF(PBPhysPart(phys,0)->_shape->_pos->_val[0], 0.646447) ||
+    !ISEQUALF(PBPhysPart(phys,0)->_shape->_pos->_val[1], 0.646447) ||
+    !ISEQUALF(PBPhysPart(phys,1)->_shape->_pos->_val[0], 0.323223) ||
+    !ISEQUALF(PBPhysPart(phys,1)->_shape->_pos->_val[1], 1.676777) ||
+    !ISEQUALF(PBPhysPart(phys,2)->_shape->_pos->_val[0], 1.353553) ||
+    !ISEQUALF(PBPhysPart(phys,2)->_shape->_pos->_val[1], 1.353553) ||
+    GSetNbElem(set) != 2 ||
+    GSetGet(set, 0) != PBPhysPart(phys,0) ||
+    GSetGet(set, 1) != PBPhysPart(phys,2)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysStepToCollision failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysParticleApplyElasticCollision(GSetGet(set, 0), GSetGet(set, 1));
+  if (!ISEQUALF(PBPhysPart(phys,0)->_speed->_val[0], -1.666667) ||
+    !ISEQUALF(PBPhysPart(phys,0)->_speed->_val[1], -1.666667) ||
+    !ISEQUALF(PBPhysPart(phys,2)->_speed->_val[0], 0.333334) ||
+    !ISEQUALF(PBPhysPart(phys,2)->_speed->_val[1], 0.333334)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, 
+      "PBPhysParticleApplyElasticCollision failed");
+    PBErrCatch(PBPhysErr);
+  }
+  GSetFree(&set);
+  set = PBPhysStepToCollision(phys);
+  if (!ISEQUALF(PBPhysGetCurTime(phys), 0.878937) ||
+    !ISEQUALF(PBPhysPart(phys,0)->_shape->_pos->_val[0], 0.258963) ||
+    !ISEQUALF(PBPhysPart(phys,0)->_shape->_pos->_val[1], 0.258963) ||
+    !ISEQUALF(PBPhysPart(phys,1)->_shape->_pos->_val[0], 0.439468) ||
+    !ISEQUALF(PBPhysPart(phys,1)->_shape->_pos->_val[1], 1.560532) ||
+    !ISEQUALF(PBPhysPart(phys,2)->_shape->_pos->_val[0], 1.431050) ||
+    !ISEQUALF(PBPhysPart(phys,2)->_shape->_pos->_val[1], 1.431050) ||
+    GSetNbElem(set) != 2 ||
+    GSetGet(set, 0) != PBPhysPart(phys,1) ||
+    GSetGet(set, 1) != PBPhysPart(phys,2)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysStepToCollision failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysParticleApplyElasticCollision(GSetGet(set, 0), GSetGet(set, 1));
+  if (!ISEQUALF(PBPhysPart(phys,1)->_speed->_val[0], 0.138846) ||
+    !ISEQUALF(PBPhysPart(phys,1)->_speed->_val[1], -0.452840) ||
+    !ISEQUALF(PBPhysPart(phys,2)->_speed->_val[0], 0.513910) ||
+    !ISEQUALF(PBPhysPart(phys,2)->_speed->_val[1], 0.309754)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, 
+      "PBPhysParticleApplyElasticCollision failed");
+    PBErrCatch(PBPhysErr);
+  }
+  GSetFree(&set);
+  VecSet(&v, 0, 0.0); VecSet(&v, 1, 0.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 0), &v);
+  VecSet(&v, 0, 1.0); VecSet(&v, 1, 1.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
+  VecSet(&v, 0, 0.0); VecSet(&v, 1, 2.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 1), &v);
+  VecSet(&v, 0, 0.5); VecSet(&v, 1, -0.5);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 1), &v);
+  VecSet(&v, 0, 2.0); VecSet(&v, 1, 2.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 2), &v);
+  VecSet(&v, 0, -1.0); VecSet(&v, 1, -1.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 2), &v);
+  ShapoidScale(PBPhysParticleShape(PBPhysPart(phys, 2)), (float)2.0);
+  PBPhysSetDeltaT(phys, 0.05);
+  PBPhysSetCurTime(phys, 0.0);
+  FILE* fd = fopen("./collision.txt", "w");
+  for (int i = 0; i < 20; ++i) {
+    PBPhysStep(phys);
+    fprintf(fd, "%f %f %f %f %f %f %f\n", PBPhysGetCurTime(phys), 
+      PBPhysPart(phys,0)->_shape->_pos->_val[0],
+      PBPhysPart(phys,0)->_shape->_pos->_val[1],
+      PBPhysPart(phys,1)->_shape->_pos->_val[0],
+      PBPhysPart(phys,1)->_shape->_pos->_val[1],
+      PBPhysPart(phys,2)->_shape->_pos->_val[0],
+      PBPhysPart(phys,2)->_shape->_pos->_val[1]);
+  }
+  fclose(fd);
+  PBPhysFree(&phys);
+  printf("UnitTestPBPhysStepToCollisionApplyElasticCollision OK\n");
+}
+
+void UnitTestPBPhysStorage() {
+  int dim = 2;
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysSetGravity(phys, 1.0);
+  PBPhysAddParticles(phys, 3, ShapoidTypeSpheroid);
+  VecFloat2D v = VecFloatCreateStatic2D();
+  VecSet(&v, 0, 1.0); VecSet(&v, 1, 1.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 0), &v);
+  PBPhysParticleSetMass(PBPhysPart(phys, 0), 1.0);
+  PBPhysParticleSetMass(PBPhysPart(phys, 1), 1.0);
+  VecSet(&v, 0, 0.0); VecSet(&v, 1, 2.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 1), &v);
+  VecSet(&v, 0, 0.5); VecSet(&v, 1, -0.5);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 1), &v);
+  VecSet(&v, 0, 2.0); VecSet(&v, 1, 2.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 2), &v);
+  PBPhysParticleSetMass(PBPhysPart(phys, 2), 2.0);
+  PBPhys* soa = PBPhysClone(phys);
+  if (PBPhysGetStorage(soa) != PBPhysStorageAoS) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysGetStorage failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysSetStorage(soa, PBPhysStorageSoA);
+  if (PBPhysGetStorage(soa) != PBPhysStorageSoA ||
+    !PBPhysIsSame(soa, phys)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSetStorage failed");
+    PBErrCatch(PBPhysErr);
+  }
+  for (int iPart = 3; iPart--;) {
+    PBPhysParticle* part = PBPhysPart(soa, iPart);
+    if (part->_speed != 
+      PBPhysSoAVec(soa->_soa, soa->_soa->_speed, iPart) ||
+      part->_shape->_pos != 
+      PBPhysSoAVec(soa->_soa, soa->_soa->_pos, iPart) ||
+      !ISEQUALF(soa->_soa->_mass[iPart], 
+      PBPhysParticleGetMass(part))) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSetStorage failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  PBPhysAddParticles(phys, 1, ShapoidTypeSpheroid);
+  PBPhysAddParticles(soa, 1, ShapoidTypeSpheroid);
+  VecSet(&v, 0, 3.0); VecSet(&v, 1, 0.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 3), &v);
+  PBPhysParticleSetPos(PBPhysPart(soa, 3), &v);
+  PBPhysParticleSetFixed(PBPhysPart(phys, 3), true);
+  PBPhysParticleSetFixed(PBPhysPart(soa, 3), true);
+  PBPhysParticleSetMass(PBPhysPart(phys, 3), 1.0);
+  PBPhysParticleSetMass(PBPhysPart(soa, 3), 1.0);
+  if (PBPhysPart(soa, 3)->_phys != soa ||
+    !soa->_soa->_fixed[3]) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysAddParticles failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysParticleSetSize(PBPhysPart(phys, 3), (float)2.0);
+  PBPhysParticleSetSize(PBPhysPart(soa, 3), (float)2.0);
+  if (!ISEQUALF(soa->_soa->_radius[3], 
+    ShapoidGetBoundingRadius(PBPhysParticleShape(PBPhysPart(soa, 3))))) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysParticleSetSize failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhys* physCol = PBPhysClone(phys);
+  PBPhys* soaCol = PBPhysClone(soa);
+  for (int i = 0; i < 10; ++i) {
+    PBPhysNext(phys);
+    PBPhysNext(soa);
+    if (!PBPhysIsSame(soa, phys)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysNext failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  PBPhysSetGravity(physCol, 0.0);
+  PBPhysSetGravity(soaCol, 0.0);
+  PBPhysSetDeltaT(physCol, 0.05);
+  PBPhysSetDeltaT(soaCol, 0.05);
+  for (int i = 0; i < 20; ++i) {
+    PBPhysStep(physCol);
+    PBPhysStep(soaCol);
+    if (!PBPhysIsSame(soaCol, physCol)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  PBPhysFree(&physCol);
+  PBPhysFree(&soaCol);
+  PBPhysSetStorage(soa, PBPhysStorageAoS);
+  if (PBPhysGetStorage(soa) != PBPhysStorageAoS ||
+    PBPhysPart(soa, 0)->_phys != NULL ||
+    !PBPhysIsSame(soa, phys)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSetStorage failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysFree(&phys);
+  PBPhysFree(&soa);
+  printf("UnitTestPBPhysStorage OK\n");
+}
+
+void UnitTestPBPhysNoAlloc() {
+  srandom(RANDOMSEED);
+  int dim = 3;
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysSetDownGravity(phys, PBPHYS_Gn);
+  PBPhysAddParticles(phys, 10, ShapoidTypeSpheroid);
+  VecFloat3D v = VecFloatCreateStatic3D();
+  for (int iPart = 10; iPart--;) {
+    for (int iDim = dim; iDim--;)
+      VecSet(&v, iDim, rnd() * 10.0);
+    PBPhysParticleSetPos(PBPhysPart(phys, iPart), &v);
+    for (int iDim = dim; iDim--;)
+      VecSet(&v, iDim, rnd() - 0.5);
+    PBPhysParticleSetSpeed(PBPhysPart(phys, iPart), &v);
+    PBPhysParticleSetMass(PBPhysPart(phys, iPart), 1.0);
+    PBPhysParticleSetDrag(PBPhysPart(phys, iPart), 0.1);
+  }
+  PBPhys* soa = PBPhysClone(phys);
+  PBPhysSetGravity(soa, 1.0);
+  PBPhysSetStorage(soa, PBPhysStorageSoA);
+  PBPhys* single = PBPhysCreate(dim);
+  PBPhysAddParticles(single, 1, ShapoidTypeSpheroid);
+  PBPhysParticleSetPos(PBPhysPart(single, 0), &v);
+  PBPhysParticleSetSpeed(PBPhysPart(single, 0), &v);
+  // Particles far enough to not collide, the pairs are tested with 
+  // the scratch of the PBPhys
+  PBPhys* spread = PBPhysCreate(dim);
+  PBPhysAddParticles(spread, 10, ShapoidTypeSpheroid);
+  for (int iPart = 10; iPart--;) {
+    for (int iDim = dim; iDim--;)
+      VecSet(&v, iDim, 10.0 * iPart + iDim);
+    PBPhysParticleSetPos(PBPhysPart(spread, iPart), &v);
+    for (int iDim = dim; iDim--;)
+      VecSet(&v, iDim, rnd() - 0.5);
+    PBPhysParticleSetSpeed(PBPhysPart(spread, iPart), &v);
+  }
+  // Warm-up
+  PBPhysNext(phys);
+  PBPhysNext(soa);
+  PBPhysStep(single);
+  PBPhysStep(spread);
+  unsigned long nb = atomic_load(&nbAlloc);
+  for (int i = 0; i < 10; ++i) {
+    PBPhysNext(phys);
+    PBPhysNext(soa);
+    PBPhysStep(single);
+    PBPhysStep(spread);
+  }
+  unsigned long nbEnd = atomic_load(&nbAlloc);
+  if (nbEnd != nb) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysNext allocated memory (%lu)", 
+      nbEnd - nb);
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysFree(&phys);
+  PBPhysFree(&soa);
+  PBPhysFree(&single);
+  PBPhysFree(&spread);
+  printf("UnitTestPBPhysNoAlloc OK\n");
+}
+
+void UnitTestPBPhysGravityBH() {
+  srandom(RANDOMSEED);
+  for (int dim = 2; dim <= 3; ++dim) {
+    PBPhys* phys = PBPhysCreate(dim);
+    PBPhysSetGravity(phys, 1.0);
+    PBPhysAddParticles(phys, 200, ShapoidTypeSpheroid);
+    VecFloat* v = VecFloatCreate(dim);
+    for (int iPart = 200; iPart--;) {
+      for (int iDim = dim; iDim--;)
+        VecSet(v, iDim, rnd() * 100.0);
+      // Two particles share the same position
+      if (iPart == 1)
+        VecCopy(v, ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, 2))));
+      PBPhysParticleSetPos(PBPhysPart(phys, iPart), v);
+      PBPhysParticleSetMass(PBPhysPart(phys, iPart), 1.0 + rnd());
+    }
+    VecFree(&v);
+    if (PBPhysGetGravitySolver(phys) != PBPhysGravitySolverExact ||
+      !ISEQUALF(PBPhysGetGravityTheta(phys), PBPHYS_BHTHETA)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysCreate failed");
+      PBErrCatch(PBPhysErr);
+    }
+    PBPhysSetGravityTheta(phys, 0.0);
+    PBPhysGravityReport report = PBPhysGetGravityReport(phys);
+    if (report._nbParticle != 200 ||
+      report._nbInteractionExact != 200 * 199 ||
+      report._maxRelErr > 0.001) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysGetGravityReport failed (%f)",
+        report._maxRelErr);
+      PBErrCatch(PBPhysErr);
+    }
+    PBPhysSetGravityTheta(phys, PBPHYS_BHTHETA);
+    report = PBPhysGetGravityReport(phys);
+    PBPhysSetGravityTheta(phys, 0.2);
+    PBPhysGravityReport reportFine = PBPhysGetGravityReport(phys);
+    if (report._nbInteraction >= reportFine._nbInteraction ||
+      reportFine._nbInteraction >= reportFine._nbInteractionExact ||
+      report._meanRelErr > 0.05 || 
+      reportFine._meanRelErr >= report._meanRelErr) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, 
+        "PBPhysGetGravityReport failed (%ld %f %f)",
+        report._nbInteraction, report._meanRelErr, report._maxRelErr);
+      PBErrCatch(PBPhysErr);
+    }
+    PBPhysSetGravityTheta(phys, PBPHYS_BHTHETA);
+    PBPhysSetGravitySolver(phys, PBPhysGravitySolverBarnesHut);
+    PBPhys* soa = PBPhysClone(phys);
+    PBPhysSetStorage(soa, PBPhysStorageSoA);
+    if (PBPhysGetGravitySolver(soa) != PBPhysGravitySolverBarnesHut) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysClone failed");
+      PBErrCatch(PBPhysErr);
+    }
+    for (int i = 0; i < 10; ++i) {
+      PBPhysNext(phys);
+      PBPhysNext(soa);
+    }
+    if (!PBPhysIsSame(phys, soa)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysNext failed");
+      PBErrCatch(PBPhysErr);
+    }
+    PBPhysFree(&phys);
+    PBPhysFree(&soa);
+  }
+  // Two particles too close to be separated by the tree are merged in 
+  // one leaf, each one is attracted only by the other one
+  PBPhys* phys = PBPhysCreate(2);
+  PBPhysSetGravity(phys, 1.0);
+  PBPhysAddParticles(phys, 3, ShapoidTypeSpheroid);
+  VecFloat2D v = VecFloatCreateStatic2D();
+  VecSet(&v, 0, 0.0); VecSet(&v, 1, 0.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 0), &v);
+  VecSet(&v, 0, 0.0); VecSet(&v, 1, 0.0001);
+  PBPhysParticleSetPos(PBPhysPart(phys, 1), &v);
+  VecSet(&v, 0, 4000000.0); VecSet(&v, 1, 1.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 2), &v);
+  for (int iPart = 3; iPart--;)
+    PBPhysParticleSetMass(PBPhysPart(phys, iPart), 1.0 + iPart);
+  PBPhysSetGravityTheta(phys, 0.0);
+  PBPhysGravityReport report = PBPhysGetGravityReport(phys);
+  if (report._maxRelErr > 0.001) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysGetGravityReport failed (%f)",
+      report._maxRelErr);
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysFree(&phys);
+  // The cells containing a particle are never approximated for this 
+  // particle, whatever the dimension and the opening angle
+  float thetas[2] = {PBPHYS_BHTHETA, 1.5};
+  for (int dim = 2; dim <= 5; ++dim) {
+    for (int iTheta = 2; iTheta--;) {
+      phys = PBPhysCreate(dim);
+      PBPhysSetGravity(phys, 1.0);
+      PBPhysAddParticles(phys, 2, ShapoidTypeSpheroid);
+      VecFloat* w = VecFloatCreate(dim);
+      for (int iPart = 2; iPart--;) {
+        for (int iDim = dim; iDim--;)
+          VecSet(w, iDim, rnd() * 100.0);
+        PBPhysParticleSetPos(PBPhysPart(phys, iPart), w);
+        PBPhysParticleSetMass(PBPhysPart(phys, iPart), 1.0 + rnd());
+      }
+      VecFree(&w);
+      PBPhysSetGravityTheta(phys, thetas[iTheta]);
+      report = PBPhysGetGravityReport(phys);
+      if (report._maxRelErr > 0.001) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, 
+          "PBPhysGetGravityReport failed (%d %f %f)", dim, 
+          thetas[iTheta], report._maxRelErr);
+        PBErrCatch(PBPhysErr);
+      }
+      PBPhysFree(&phys);
+    }
+  }
+  printf("UnitTestPBPhysGravityBH OK\n");
+}
+
+// Create a PBPhys of dimension 'dim' with 'nbPart' spheroids placed 
+// on a lattice of step 'spacing' to avoid initial overlaps, with a 
+// random speed in [-0.5*speed, 0.5*speed] along each axis, a random 
+// mass and a random size
+static PBPhys* UnitTestCreateLatticePhys(const int dim, const int nbPart, 
+  const float spacing, const float speed) {
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysAddParticles(phys, nbPart, ShapoidTypeSpheroid);
+  VecFloat* v = VecFloatCreate(dim);
+  for (int iPart = nbPart; iPart--;) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    for (int iDim = dim, k = iPart; iDim--; k /= 20)
+      VecSet(v, iDim, (float)(k % 20) * spacing);
+    PBPhysParticleSetPos(part, v);
+    for (int iDim = dim; iDim--;)
+      VecSet(v, iDim, (rnd() - 0.5) * speed);
+    PBPhysParticleSetSpeed(part, v);
+    PBPhysParticleSetMass(part, 1.0 + rnd());
+    float size = 0.5 + rnd();
+    PBPhysParticleSetSize(part, size);
+  }
+  VecFree(&v);
+  return phys;
+}
+
+// Return a clone of the PBPhys 'that' created with 
+// UnitTestCreateLatticePhys, the size of the shapes is not cloned so 
+// it's copied here
+static PBPhys* UnitTestCloneLatticePhys(const PBPhys* const that) {
+  PBPhys* clone = PBPhysClone(that);
+  for (long iPart = PBPhysGetNbParticle(that); iPart--;) {
+    float size = VecNorm(PBPhysParticleAxis(PBPhysPart(that, iPart), 0));
+    PBPhysParticleSetSize(PBPhysPart(clone, iPart), size);
+  }
+  return clone;
+}
+
+void UnitTestPBPhysBroadPhaseGrid() {
+  srandom(RANDOMSEED);
+  int nbPart = 300;
+  for (int dim = 2; dim <= 3; ++dim) {
+    PBPhys* phys = UnitTestCreateLatticePhys(dim, nbPart, 2.0, 20.0);
+    PBPhys* grid = UnitTestCloneLatticePhys(phys);
+    PBPhysSetBroadPhase(grid, PBPhysBroadPhaseGrid);
+    if (PBPhysGetBroadPhase(phys) != PBPhysBroadPhaseNone ||
+      PBPhysGetBroadPhase(grid) != PBPhysBroadPhaseGrid) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSetBroadPhase failed");
+      PBErrCatch(PBPhysErr);
+    }
+    for (int i = 0; i < 10; ++i) {
+      PBPhysStep(phys);
+      PBPhysStep(grid);
+      if (!PBPhysIsSame(phys, grid) ||
+        grid->_nbPair >= nbPart * (nbPart - 1) / 2) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+        PBErrCatch(PBPhysErr);
+      }
+    }
+    PBPhysFree(&phys);
+    PBPhysFree(&grid);
+  }
+  printf("UnitTestPBPhysBroadPhaseGrid OK\n");
+}
+
+void UnitTestPBPhysBroadPhaseSAP() {
+  srandom(RANDOMSEED);
+  int nbPart = 300;
+  for (int dim = 2; dim <= 3; ++dim) {
+    PBPhys* phys = UnitTestCreateLatticePhys(dim, nbPart, 2.0, 20.0);
+    PBPhys* grid = UnitTestCloneLatticePhys(phys);
+    PBPhysSetBroadPhase(grid, PBPhysBroadPhaseGrid);
+    PBPhys* sap = UnitTestCloneLatticePhys(phys);
+    PBPhysSetBroadPhase(sap, PBPhysBroadPhaseSAP);
+    if (PBPhysGetBroadPhase(sap) != PBPhysBroadPhaseSAP) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSetBroadPhase failed");
+      PBErrCatch(PBPhysErr);
+    }
+    // The pairs selected by the last search are the ones of the grid, 
+    // the particles are fully sorted at the first search and then only 
+    // updated
+    for (int i = 0; i < 10; ++i) {
+      PBPhysStep(phys);
+      PBPhysStep(grid);
+      PBPhysStep(sap);
+      if (!PBPhysIsSame(phys, sap) ||
+        sap->_nbPair >= nbPart * (nbPart - 1) / 2) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+        PBErrCatch(PBPhysErr);
+      }
+      if (sap->_nbPair != grid->_nbPair || 
+        (sap->_nbPair > 0 && memcmp(sap->_pairs, grid->_pairs, 
+        sizeof(long) * 2 * sap->_nbPair) != 0) || 
+        (i > 0 && sap->_sap->_nbSwap < 0)) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, "PBPhysSAPGetPairs failed");
+        PBErrCatch(PBPhysErr);
+      }
+    }
+    // Adding a particle discards the order of the previous step
+    PBPhysAddParticles(sap, 1, ShapoidTypeSpheroid);
+    GSetPBPhysParticle* set = PBPhysStepToCollision(sap);
+    if (set != NULL)
+      GSetFree(&set);
+    if (sap->_sap->_nbPart != nbPart + 1 || 
+      sap->_sap->_nbSwap != -1) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSAPSetNbPart failed");
+      PBErrCatch(PBPhysErr);
+    }
+    PBPhysFree(&phys);
+    PBPhysFree(&grid);
+    PBPhysFree(&sap);
+  }
+  printf("UnitTestPBPhysBroadPhaseSAP OK\n");
+}
+
+void UnitTestPBPhysBroadPhaseBVH() {
+  srandom(RANDOMSEED);
+  int nbPart = 300;
+  int nbFixed = (nbPart + 6) / 7;
+  for (int dim = 2; dim <= 3; ++dim) {
+    PBPhys* phys = UnitTestCreateLatticePhys(dim, nbPart, 4.0, 20.0);
+    // One particle out of seven is fixed, and a few moving particles 
+    // are much larger than the others
+    for (int iPart = nbPart; iPart--;) {
+      PBPhysParticle* part = PBPhysPart(phys, iPart);
+      PBPhysParticleSetFixed(part, iPart % 7 == 0);
+      if (iPart % 50 == 1) {
+        float size = 3.0 * VecNorm(PBPhysParticleAxis(part, 0));
+        PBPhysParticleSetSize(part, size);
+      }
+    }
+    PBPhys* grid = UnitTestCloneLatticePhys(phys);
+    PBPhysSetBroadPhase(grid, PBPhysBroadPhaseGrid);
+    PBPhys* bvh = UnitTestCloneLatticePhys(phys);
+    PBPhysSetBroadPhase(bvh, PBPhysBroadPhaseBVH);
+    if (PBPhysGetBroadPhase(bvh) != PBPhysBroadPhaseBVH) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSetBroadPhase failed");
+      PBErrCatch(PBPhysErr);
+    }
+    // The pairs selected by the last search are the ones of the grid 
+    // without the pairs of fixed particles, the static tree is built 
+    // once and only the particles leaving their enlarged box are moved
+    for (int i = 0; i < 10; ++i) {
+      PBPhysStep(phys);
+      PBPhysStep(grid);
+      PBPhysStep(bvh);
+      if (!PBPhysIsSame(phys, bvh)) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+        PBErrCatch(PBPhysErr);
+      }
+      long nbPair = 0;
+      bool same = true;
+      for (long iPair = 0; iPair < grid->_nbPair; ++iPair) {
+        long* pair = grid->_pairs + 2 * iPair;
+        if (!PBPhysParticleIsFixed(PBPhysPart(grid, pair[0])) || 
+          !PBPhysParticleIsFixed(PBPhysPart(grid, pair[1]))) {
+          same = same && nbPair < bvh->_nbPair && 
+            memcmp(pair, bvh->_pairs + 2 * nbPair, 
+            sizeof(long) * 2) == 0;
+          ++nbPair;
+        }
+      }
+      if (!same || nbPair != bvh->_nbPair || 
+        bvh->_bvh->_nbStaticBuild != 1 || 
+        (i > 0 && bvh->_bvh->_nbReinsert >= nbPart - nbFixed)) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, "PBPhysBVHGetPairs failed");
+        PBErrCatch(PBPhysErr);
+      }
+    }
+    // Releasing a fixed particle rebuilds the static tree
+    PBPhysParticleSetFixed(PBPhysPart(phys, 0), false);
+    PBPhysParticleSetFixed(PBPhysPart(bvh, 0), false);
+    PBPhysStep(phys);
+    PBPhysStep(bvh);
+    if (!PBPhysIsSame(phys, bvh) || 
+      bvh->_bvh->_nbStaticBuild != 2 || bvh->_bvh->_inStatic[0] || 
+      bvh->_bvh->_leaf[0] == -1) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysBVHUpdate failed");
+      PBErrCatch(PBPhysErr);
+    }
+    // Adding a particle discards the trees of the previous step
+    PBPhysAddParticles(bvh, 1, ShapoidTypeSpheroid);
+    GSetPBPhysParticle* set = PBPhysStepToCollision(bvh);
+    if (set != NULL)
+      GSetFree(&set);
+    if (bvh->_bvh->_nbPart != nbPart + 1 || 
+      bvh->_bvh->_nbStaticBuild != 3 || 
+      bvh->_bvh->_nbReinsert != nbPart + 2 - nbFixed) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysBVHSetNbPart failed");
+      PBErrCatch(PBPhysErr);
+    }
+    PBPhysFree(&phys);
+    PBPhysFree(&grid);
+    PBPhysFree(&bvh);
+  }
+  printf("UnitTestPBPhysBroadPhaseBVH OK\n");
+}
+
+void UnitTestPBPhysBroadPhaseVerlet() {
+  srandom(RANDOMSEED);
+  int nbPart = 300;
+  for (int dim = 2; dim <= 3; ++dim) {
+    PBPhys* phys = UnitTestCreateLatticePhys(dim, nbPart, 3.0, 10.0);
+    // One particle out of seven is fixed
+    for (int iPart = nbPart; iPart--;)
+      PBPhysParticleSetFixed(PBPhysPart(phys, iPart), iPart % 7 == 0);
+    VecFloat* v = VecFloatCreate(dim);
+    PBPhys* verlet = UnitTestCloneLatticePhys(phys);
+    PBPhysSetBroadPhase(verlet, PBPhysBroadPhaseVerlet);
+    if (PBPhysGetBroadPhase(verlet) != PBPhysBroadPhaseVerlet || 
+      !ISEQUALF(PBPhysGetVerletSkin(verlet), PBPHYS_VERLETSKIN) || 
+      PBPhysGetVerletNbUpdate(verlet) != 0 || 
+      PBPhysGetVerletNbBuild(verlet) != 0) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSetBroadPhase failed");
+      PBErrCatch(PBPhysErr);
+    }
+    // The result is the same as without broad phase, and the lists are 
+    // built again only once in a while
+    for (int i = 0; i < 30; ++i) {
+      PBPhysStep(phys);
+      PBPhysStep(verlet);
+      if (!PBPhysIsSame(phys, verlet)) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+        PBErrCatch(PBPhysErr);
+      }
+    }
+    long nbUpdate = PBPhysGetVerletNbUpdate(verlet);
+    long nbBuild = PBPhysGetVerletNbBuild(verlet);
+    if (nbUpdate < 30 || nbBuild < 2 || 2 * nbBuild > nbUpdate) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysIsVerletValid failed");
+      PBErrCatch(PBPhysErr);
+    }
+    // Moving a particle, changing of broad phase or changing the skin 
+    // builds the lists again
+    for (int iDim = dim; iDim--;)
+      VecSet(v, iDim, -10.0);
+    PBPhysParticleSetPos(PBPhysPart(phys, 1), v);
+    PBPhysParticleSetPos(PBPhysPart(verlet, 1), v);
+    PBPhysStep(phys);
+    PBPhysStep(verlet);
+    if (!PBPhysIsSame(phys, verlet) || 
+      PBPhysGetVerletNbBuild(verlet) == nbBuild) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysIsVerletValid failed");
+      PBErrCatch(PBPhysErr);
+    }
+    nbBuild = PBPhysGetVerletNbBuild(verlet);
+    PBPhysSetBroadPhase(verlet, PBPhysBroadPhaseGrid);
+    PBPhysStep(phys);
+    PBPhysStep(verlet);
+    PBPhysSetBroadPhase(verlet, PBPhysBroadPhaseVerlet);
+    PBPhysStep(phys);
+    PBPhysStep(verlet);
+    if (!PBPhysIsSame(phys, verlet) || 
+      PBPhysGetVerletNbBuild(verlet) == nbBuild) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSetBroadPhase failed");
+      PBErrCatch(PBPhysErr);
+    }
+    // Without skin the lists are built at each search
+    PBPhysSetVerletSkin(verlet, 0.0);
+    nbUpdate = PBPhysGetVerletNbUpdate(verlet);
+    nbBuild = PBPhysGetVerletNbBuild(verlet);
+    for (int i = 0; i < 5; ++i) {
+      PBPhysStep(phys);
+      PBPhysStep(verlet);
+    }
+    if (!PBPhysIsSame(phys, verlet) || 
+      PBPhysGetVerletNbBuild(verlet) - nbBuild != 
+      PBPhysGetVerletNbUpdate(verlet) - nbUpdate) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSetVerletSkin failed");
+      PBErrCatch(PBPhysErr);
+    }
+    VecFree(&v);
+    PBPhysFree(&phys);
+    PBPhysFree(&verlet);
+  }
+  printf("UnitTestPBPhysBroadPhaseVerlet OK\n");
+}
+
+void UnitTestPBPhysFixedPartition() {
+  srandom(RANDOMSEED);
+  int dim = 2;
+  long nbPart = 200;
+  long nbFixed = nbPart / 4;
+  PBPhys* phys = PBPhysCreate(dim);
+  PBPhysAddParticles(phys, nbPart, ShapoidTypeSpheroid);
+  VecFloat* v = VecFloatCreate(dim);
+  // One particle out of four is fixed, the fixed particles make an 
+  // overlapping wall below the other ones which are on a lattice
+  for (long iPart = nbPart; iPart--;) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    if (iPart % 4 == 0) {
+      VecSet(v, 0, (float)iPart * 0.1);
+      VecSet(v, 1, -3.0);
+      PBPhysParticleSetPos(part, v);
+      PBPhysParticleSetFixed(part, true);
+    } else {
+      VecSet(v, 0, (float)(iPart % 10) * 2.0);
+      VecSet(v, 1, (float)(iPart / 10) * 2.0);
+      PBPhysParticleSetPos(part, v);
+      VecSet(v, 0, (rnd() - 0.5) * 5.0);
+      VecSet(v, 1, -rnd() * 5.0);
+      PBPhysParticleSetSpeed(part, v);
+    }
+    PBPhysParticleSetMass(part, 1.0 + rnd());
+  }
+  VecFree(&v);
+  // The pairs of fixed particles are never tested
+#if PBPHYS_STATS
+  PBPhys* clone = PBPhysClone(phys);
+  PBPhysResetStats(clone);
+  GSetPBPhysParticle* set = PBPhysStepToCollision(clone);
+  if (set != NULL)
+    GSetFree(&set);
+  PBPhysStats stats = PBPhysGetStats(clone);
+  if (stats._nbPairTest != (unsigned long)(nbPart * (nbPart - 1) / 2 - 
+    nbFixed * (nbFixed - 1) / 2)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSearchContacts failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysFree(&clone);
+#endif
+  // The result is the same with all the broad phases and several 
+  // threads, and the fixed particles don't move
+  PBPhys* others[4];
+  for (int iOther = 4; iOther--;)
+    others[iOther] = PBPhysClone(phys);
+  PBPhysSetBroadPhase(others[0], PBPhysBroadPhaseGrid);
+  PBPhysSetBroadPhase(others[1], PBPhysBroadPhaseSAP);
+  PBPhysSetBroadPhase(others[2], PBPhysBroadPhaseBVH);
+  PBPhysSetNbThread(others[3], 3);
+  PBPhys* ref = PBPhysClone(phys);
+  for (int i = 0; i < 10; ++i) {
+    PBPhysStep(phys);
+    for (int iOther = 4; iOther--;) {
+      PBPhysStep(others[iOther]);
+      if (!PBPhysIsSame(phys, others[iOther])) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+        PBErrCatch(PBPhysErr);
+      }
+    }
+  }
+  for (long iPart = nbPart; iPart--;) {
+    bool same = PBPhysParticleIsSame(PBPhysPart(phys, iPart), 
+      PBPhysPart(ref, iPart));
+    if (same != (iPart % 4 == 0)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysStep failed (fixed)");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  if (phys->_nbDynamic != nbPart - nbFixed) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysUpdatePartition failed");
+    PBErrCatch(PBPhysErr);
+  }
+  for (long iPart = phys->_nbDynamic; iPart--;) {
+    if (phys->_dynamicPart[iPart] != iPart + iPart / 3 + 1) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysUpdatePartition failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  // A particle changes of partition when its flag changes
+  PBPhysParticle* part = PBPhysPart(phys, 1);
+  PBPhysParticleSetFixed(part, true);
+  VecFloat* pos = PBPhysParticleGetPos(part);
+  PBPhysStep(phys);
+  VecFloat* posFixed = PBPhysParticleGetPos(part);
+  if (phys->_nbDynamic != nbPart - nbFixed - 1 || 
+    phys->_dynamicPart[0] != 2 || !VecIsEqual(pos, posFixed) || 
+    VecNorm(PBPhysParticleSysAccel(part)) > PBMATH_EPSILON) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysUpdatePartition failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysParticleSetFixed(part, false);
+  VecSet(pos, 0, 1.0);
+  VecSet(pos, 1, 0.0);
+  PBPhysParticleSetSpeed(part, pos);
+  PBPhysNext(phys);
+  VecFree(&pos);
+  pos = PBPhysParticleGetPos(part);
+  if (phys->_nbDynamic != nbPart - nbFixed || 
+    phys->_dynamicPart[0] != 1 || VecIsEqual(pos, posFixed)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysUpdatePartition failed");
+    PBErrCatch(PBPhysErr);
+  }
+  VecFree(&pos);
+  VecFree(&posFixed);
+  for (int iOther = 4; iOther--;)
+    PBPhysFree(others + iOther);
+  PBPhysFree(&ref);
+  PBPhysFree(&phys);
+  printf("UnitTestPBPhysFixedPartition OK\n");
+}
+
+void UnitTestPBPhysSleep() {
+  int dim = 2;
+  long nbPart = 5;
+  PBPhys* phys = PBPhysCreate(dim);
+  if (!ISEQUALF(PBPhysGetSleepSpeed(phys), 0.0) || 
+    !ISEQUALF(PBPhysGetSleepDelay(phys), PBPHYS_SLEEPDELAY)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysCreate failed (sleep)");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysSetSleepSpeed(phys, 0.5);
+  PBPhysSetSleepDelay(phys, 0.05);
+  if (!ISEQUALF(PBPhysGetSleepSpeed(phys), 0.5) || 
+    !ISEQUALF(PBPhysGetSleepDelay(phys), 0.05)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSetSleepSpeed failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysAddParticles(phys, nbPart, ShapoidTypeSpheroid);
+  VecFloat2D v = VecFloatCreateStatic2D();
+  // Four particles at rest on a line, and one moving above them
+  for (long iPart = nbPart; iPart--;) {
+    PBPhysParticle* part = PBPhysPart(phys, iPart);
+    PBPhysParticleSetMass(part, 1.0);
+    VecSet(&v, 0, (iPart < 4 ? (float)iPart * 5.0 : 0.0));
+    VecSet(&v, 1, (iPart < 4 ? 0.0 : 20.0));
+    PBPhysParticleSetPos(part, &v);
+  }
+  VecSet(&v, 0, 2.0);
+  VecSet(&v, 1, 0.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 4), &v);
+  // The particles at rest fall asleep after the delay and leave the 
+  // partition, the moving one stays awake
+  for (int i = 0; i < 10; ++i)
+    PBPhysStep(phys);
+  for (long iPart = nbPart; iPart--;) {
+    if (PBPhysParticleIsAsleep(PBPhysPart(phys, iPart)) != 
+      (iPart < 4)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysUpdateSleep failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  PBPhysStep(phys);
+  if (phys->_nbDynamic != 1 || phys->_dynamicPart[0] != 4) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysUpdatePartition failed (sleep)");
+    PBErrCatch(PBPhysErr);
+  }
+  // The clone keeps the sleep state
+  PBPhys* clone = PBPhysClone(phys);
+  if (!PBPhysParticleIsAsleep(PBPhysPart(clone, 0)) || 
+    PBPhysParticleIsAsleep(PBPhysPart(clone, 4))) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysClone failed (sleep)");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysFree(&clone);
+  // Setting the speed wakes up a particle
+  VecSetNull(&v);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 3), &v);
+  if (PBPhysParticleIsAsleep(PBPhysPart(phys, 3))) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysParticleSetSpeed failed (sleep)");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysStep(phys);
+  if (phys->_nbDynamic != 2) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysUpdatePartition failed (sleep)");
+    PBErrCatch(PBPhysErr);
+  }
+  // Adding to the speed or the position wakes up a particle, and the
+  // one whose speed has been increased moves at the next step
+  VecFloat* posAdd = PBPhysParticleGetPos(PBPhysPart(phys, 2));
+  VecSet(&v, 0, 2.0);
+  VecSet(&v, 1, 0.0);
+  PBPhysParticleAddSpeed(PBPhysPart(phys, 2), &v, 1.0);
+  PBPhysParticleAddPos(PBPhysPart(phys, 1), &v, 0.1);
+  if (PBPhysParticleIsAsleep(PBPhysPart(phys, 2)) ||
+    PBPhysParticleIsAsleep(PBPhysPart(phys, 1))) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg,
+      "PBPhysParticleAddSpeed/AddPos failed (sleep)");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysStep(phys);
+  VecFloat* posMoved = PBPhysParticleGetPos(PBPhysPart(phys, 2));
+  if (phys->_nbDynamic != 4 ||
+    VecGet(posMoved, 0) <= VecGet(posAdd, 0)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysParticleAddSpeed failed (sleep)");
+    PBErrCatch(PBPhysErr);
+  }
+  VecFree(&posAdd);
+  VecFree(&posMoved);
+  // Throw the moving particle on the first sleeping one, the collision 
+  // wakes it up with the sequential and event driven schedulers and 
+  // all the broad phases
+  VecSet(&v, 0, -3.0);
+  VecSet(&v, 1, 0.0);
+  PBPhysParticleSetPos(PBPhysPart(phys, 4), &v);
+  VecSet(&v, 0, 10.0);
+  PBPhysParticleSetSpeed(PBPhysPart(phys, 4), &v);
+  PBPhys* others[4];
+  for (int iOther = 4; iOther--;)
+    others[iOther] = PBPhysClone(phys);
+  PBPhysSetBroadPhase(others[0], PBPhysBroadPhaseGrid);
+  PBPhysSetBroadPhase(others[1], PBPhysBroadPhaseSAP);
+  PBPhysSetBroadPhase(others[2], PBPhysBroadPhaseBVH);
+  PBPhysSetScheduler(others[3], PBPhysSchedulerEventDriven);
+  VecFloat* pos = PBPhysParticleGetPos(PBPhysPart(phys, 0));
+  for (int i = 0; i < 25; ++i) {
+    PBPhysStep(phys);
+    for (int iOther = 4; iOther--;)
+      PBPhysStep(others[iOther]);
+  }
+  for (int iOther = 4; iOther--;) {
+    if (iOther < 3 && !PBPhysIsSame(phys, others[iOther])) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysStep failed (sleep)");
+      PBErrCatch(PBPhysErr);
+    }
+    PBPhysParticle* part = PBPhysPart(others[iOther], 0);
+    VecFloat* posWoken = PBPhysParticleGetPos(part);
+    if (PBPhysParticleIsAsleep(part) || 
+      VecGet(PBPhysParticleSpeed(part), 0) < 5.0 || 
+      VecGet(posWoken, 0) <= VecGet(pos, 0)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, 
+        "PBPhysParticleApplyElasticCollision failed (sleep)");
+      PBErrCatch(PBPhysErr);
+    }
+    VecFree(&posWoken);
+  }
+  VecFree(&pos);
+  // Disabling the sleep wakes up all the particles
+  PBPhysSetSleepSpeed(phys, 0.0);
+  for (long iPart = nbPart; iPart--;) {
+    if (PBPhysParticleIsAsleep(PBPhysPart(phys, iPart))) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSetSleepSpeed failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  for (int iOther = 4; iOther--;)
+    PBPhysFree(others + iOther);
+  PBPhysFree(&phys);
+  // A particle under a weak down gravity falls asleep and keeps its 
+  // acceleration, under a strong one it never falls asleep
+  for (int iGravity = 2; iGravity--;) {
+    float gravity = (iGravity == 0 ? 1.0 : 100.0);
+    phys = PBPhysCreate(dim);
+    PBPhysSetSleepSpeed(phys, 0.5);
+    PBPhysSetSleepDelay(phys, 0.05);
+    PBPhysSetDownGravity(phys, gravity);
+    PBPhysAddParticles(phys, 1, ShapoidTypeSpheroid);
+    PBPhysParticle* part = PBPhysPart(phys, 0);
+    PBPhysParticleSetMass(part, 1.0);
+    for (int i = 0; i < 10; ++i)
+      PBPhysStep(phys);
+    if (PBPhysParticleIsAsleep(part) != (iGravity == 0) || 
+      (iGravity == 0 && 
+      !ISEQUALF(VecGet(PBPhysParticleAccel(part), 1), -gravity))) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysUpdateSleep failed (accel)");
+      PBErrCatch(PBPhysErr);
+    }
+    PBPhysFree(&phys);
+  }
+  printf("UnitTestPBPhysSleep OK\n");
+}
+
+void UnitTestPBPhysEventDriven() {
+  srandom(RANDOMSEED);
+  int nbPart = 300;
+  for (int dim = 2; dim <= 3; ++dim) {
+    PBPhys* phys = UnitTestCreateLatticePhys(dim, nbPart, 2.0, 50.0);
+    // One event driven system per broad phase
+    int nbEvent = PBPhysBroadPhaseVerlet + 1;
+    PBPhys* events[PBPhysBroadPhaseVerlet + 1];
+    for (int iEvent = nbEvent; iEvent--;) {
+      events[iEvent] = UnitTestCloneLatticePhys(phys);
+      PBPhysSetScheduler(events[iEvent], PBPhysSchedulerEventDriven);
+      PBPhysSetBroadPhase(events[iEvent], (PBPhysBroadPhase)iEvent);
+    }
+    if (PBPhysGetScheduler(phys) != PBPhysSchedulerSequential ||
+      PBPhysGetScheduler(events[0]) != PBPhysSchedulerEventDriven) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysSetScheduler failed");
+      PBErrCatch(PBPhysErr);
+    }
+    // The results differ by the rounding errors, amplified by the 
+    // successive collisions
+    long nbCollision = 0;
+    for (int i = 0; i < 10; ++i) {
+      PBPhysStep(phys);
+      for (int iEvent = nbEvent; iEvent--;) {
+        PBPhys* event = events[iEvent];
+        PBPhysStep(event);
+        PBPhysEventQueue* queue = event->_events;
+        if (iEvent == PBPhysBroadPhaseNone)
+          nbCollision += queue->_nbCollision;
+        float maxDist = 0.0;
+        for (int iPart = nbPart; iPart--;) {
+          VecFloat* posA = PBPhysParticleGetPos(PBPhysPart(phys, iPart));
+          VecFloat* posB = PBPhysParticleGetPos(PBPhysPart(event, iPart));
+          float dist = VecDist(posA, posB);
+          if (dist > maxDist)
+            maxDist = dist;
+          VecFree(&posA);
+          VecFree(&posB);
+        }
+        // Only the particles involved in a collision are predicted 
+        // again, and with a broad phase only against their neighbours
+        long maxTest = nbPart * (nbPart - 1) / 2 + 
+          4 * (nbPart - 1) * queue->_nbCollision;
+        if (iEvent != PBPhysBroadPhaseNone)
+          maxTest = nbPart * (nbPart - 1) / 20;
+        if (!ISEQUALF(PBPhysGetCurTime(phys), PBPhysGetCurTime(event)) ||
+          maxDist > 0.05 || queue->_nbTest > maxTest) {
+          PBPhysErr->_type = PBErrTypeUnitTestFailed;
+          sprintf(PBPhysErr->_msg, "PBPhysStep failed (%d)", iEvent);
+          PBErrCatch(PBPhysErr);
+        }
+      }
+    }
+    if (nbCollision == 0) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysStep failed (no collision)");
+      PBErrCatch(PBPhysErr);
+    }
+    PBPhysFree(&phys);
+    for (int iEvent = nbEvent; iEvent--;)
+      PBPhysFree(events + iEvent);
+  }
+  printf("UnitTestPBPhysEventDriven OK\n");
+}
+
+void UnitTestPBPhysStepToCollisions() {
+  // Pairs of particles colliding all at the same time
+  int nbPair = 20;
+  PBPhys* phys = PBPhysCreate(2);
+  PBPhysAddParticles(phys, 2 * nbPair, ShapoidTypeSpheroid);
+  VecFloat2D v = VecFloatCreateStatic2D();
+  for (int iPair = nbPair; iPair--;) {
+    for (int iPart = 2; iPart--;) {
+      PBPhysParticle* part = PBPhysPart(phys, 2 * iPair + iPart);
+      VecSet(&v, 0, 3.0 * iPart); VecSet(&v, 1, 4.0 * iPair);
+      PBPhysParticleSetPos(part, &v);
+      VecSet(&v, 0, 1.0 - 2.0 * iPart); VecSet(&v, 1, 0.0);
+      PBPhysParticleSetSpeed(part, &v);
+      PBPhysParticleSetMass(part, 1.0);
+    }
+  }
+  PBPhysSetDeltaT(phys, 2.0);
+  PBPhys* seq = PBPhysClone(phys);
+  PBPhys* batch = PBPhysClone(phys);
+  GSetPBPhysParticle* set = PBPhysStepToCollision(seq);
+  GSetPBPhysParticle* setAll = PBPhysStepToCollisions(batch, 0.0001);
+  if (GSetNbElem(set) != 2 || GSetNbElem(setAll) != 2 * nbPair ||
+    !ISEQUALF(PBPhysGetCurTime(seq), 1.0) ||
+    !ISEQUALF(PBPhysGetCurTime(batch), 1.0)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysStepToCollisions failed");
+    PBErrCatch(PBPhysErr);
+  }
+  for (int iPart = 2 * nbPair; iPart--;) {
+    if (GSetGet(setAll, iPart) != PBPhysPart(batch, iPart)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, "PBPhysStepToCollisions failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  PBPhysParticleApplyElasticCollisions(setAll);
+  for (int iPart = 2 * nbPair; iPart--;) {
+    PBPhysParticle* part = PBPhysPart(batch, iPart);
+    if (!ISEQUALF(VecGet(PBPhysParticleSpeed(part), 0), 
+      (iPart % 2 == 0 ? -1.0 : 1.0)) ||
+      !ISEQUALF(VecGet(PBPhysParticleSpeed(part), 1), 0.0)) {
+      PBPhysErr->_type = PBErrTypeUnitTestFailed;
+      sprintf(PBPhysErr->_msg, 
+        "PBPhysParticleApplyElasticCollisions failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  GSetFree(&set);
+  GSetFree(&setAll);
+  PBPhysFree(&seq);
+  PBPhysFree(&batch);
+  // Same result with PBPhysStep, in one sweep instead of one per pair
+  seq = PBPhysClone(phys);
+  batch = PBPhysClone(phys);
+  PBPhysSetContactTolerance(batch, 0.0001);
+  if (!ISEQUALF(PBPhysGetContactTolerance(seq), 0.0) ||
+    !ISEQUALF(PBPhysGetContactTolerance(batch), 0.0001)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysSetContactTolerance failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysStep(seq);
+  PBPhysStep(batch);
+  if (!PBPhysIsSame(seq, batch)) {
+    PBPhysErr->_type = PBErrTypeUnitTestFailed;
+    sprintf(PBPhysErr->_msg, "PBPhysStep failed");
+    PBErrCatch(PBPhysErr);
+  }
+  PBPhysFree(&seq);
+  PBPhysFree(&batch);
+  PBPhysFree(&phys);
+  printf("UnitTestPBPhysStepToCollisions OK\n");
+}
+
+void UnitTestPBPhysThreadPool() {
+  srandom(RANDOMSEED);
+  int nbPart = 100;
+  for (int dim = 2; dim <= 3; ++dim) {
+    // Stepping without collision with the Barnes-Hut tree, with 
+    // collisions with and without broad phase and tolerance, and 
+    // without collision with the exact gravity
+    for (int iCase = 0; iCase < 4; ++iCase) {
+      PBPhys* phys = UnitTestCreateLatticePhys(dim, nbPart, 2.0, 50.0);
+      PBPhysSetDownGravity(phys, 9.8);
+      PBPhysSetGravity(phys, 10.0);
+      if (iCase == 0)
+        PBPhysSetGravitySolver(phys, PBPhysGravitySolverBarnesHut);
+      if (iCase == 1) {
+        PBPhysSetBroadPhase(phys, PBPhysBroadPhaseGrid);
+        PBPhysSetContactTolerance(phys, 0.001);
+      }
+      PBPhys* threaded = UnitTestCloneLatticePhys(phys);
+      PBPhysSetNbThread(threaded, 4);
+      if (PBPhysGetNbThread(phys) != 1 || 
+        PBPhysGetNbThread(threaded) != 4) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, "PBPhysSetNbThread failed");
+        PBErrCatch(PBPhysErr);
+      }
+      // The threads must give the same results as a single thread
+      for (int i = 0; i < 10; ++i) {
+        if (iCase == 0 || iCase == 3) {
+          PBPhysNext(phys);
+          PBPhysNext(threaded);
+        } else {
+          PBPhysStep(phys);
+          PBPhysStep(threaded);
+        }
+        if (!PBPhysIsSame(phys, threaded)) {
+          PBPhysErr->_type = PBErrTypeUnitTestFailed;
+          sprintf(PBPhysErr->_msg, "PBPhysStep failed (case %d)", 
+            iCase);
+          PBErrCatch(PBPhysErr);
+        }
+      }
+      // Back to a single thread
+      PBPhysSetNbThread(threaded, 1);
+      if (PBPhysGetNbThread(threaded) != 1 || 
+        threaded->_threadPool != NULL) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, "PBPhysSetNbThread failed");
+        PBErrCatch(PBPhysErr);
+      }
+      PBPhysFree(&phys);
+      PBPhysFree(&threaded);
+    }
+  }
+  printf("UnitTestPBPhysThreadPool OK\n");
+}
+
+void UnitTestPBPhysStepTwoPhase() {
+  // Two symmetric particles must stay symmetric whatever their order
+  // in the set
+  for (int dim = 2; dim <= 3; ++dim) {
+    PBPhys* phys = PBPhysCreate(dim);
+    PBPhysSetGravity(phys, 1.0);
+    PBPhysAddParticles(phys, 2, ShapoidTypeSpheroid);
+    VecFloat* v = VecFloatCreate(dim);
+    VecSet(v, 0, -1.0);
+    PBPhysParticleSetPos(PBPhysPart(phys, 0), v);
+    VecSet(v, 0, 1.0);
+    PBPhysParticleSetPos(PBPhysPart(phys, 1), v);
+    VecFree(&v);
+    PBPhysParticleSetMass(PBPhysPart(phys, 0), 1.0);
+    PBPhysParticleSetMass(PBPhysPart(phys, 1), 1.0);
+    for (int i = 0; i < 10; ++i) {
+      PBPhysNext(phys);
+      float xA = VecGet(
+        ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, 0))), 0);
+      float xB = VecGet(
+        ShapoidPos(PBPhysParticleShape(PBPhysPart(phys, 1))), 0);
+      if (xA >= -0.5 || xA != -xB) {
+        PBPhysErr->_type = PBErrTypeUnitTestFailed;
+        sprintf(PBPhysErr->_msg, "PBPhysNext failed");
+        PBErrCatch(PBPhysErr);
+      }
+    }
+    PBPhysFree(&phys);
+  }
+  printf("UnitTestPBPhysStepTwoPhase OK\n");
 }
 
 void UnitTestPBPhysNext() {
@@ -688,6 +2915,7 @@ void UnitTestPBPhysNext() {
   UnitTestPBPhysStepDownGravity();
   UnitTestPBPhysStepGravity();
   UnitTestPBPhysStepToCollisionApplyElasticCollision();
+  UnitTestPBPhysStepTwoPhase();
   printf("UnitTestPBPhysStep OK\n");
 }
 
@@ -696,7 +2924,29 @@ void UnitTestPBPhys() {
   UnitTestPBPhysGetSetAdd();
   UnitTestPBPhysCloneIsSame();
   UnitTestPBPhysLoadSave();
+  UnitTestPBPhysLoadSaveBinary();
+  UnitTestPBPhysSnapshot();
+  UnitTestPBPhysRecorder();
+  UnitTestPBPhysTraj();
+  UnitTestPBPhysArchive();
+  UnitTestPBPhysSaveStream();
+  UnitTestPBPhysLoadProgress();
   UnitTestPBPhysNext();
+  UnitTestPBPhysStorage();
+  UnitTestPBPhysNoAlloc();
+  UnitTestPBPhysGravityBH();
+  UnitTestPBPhysBroadPhaseGrid();
+  UnitTestPBPhysBroadPhaseSAP();
+  UnitTestPBPhysBroadPhaseBVH();
+  UnitTestPBPhysBroadPhaseVerlet();
+  UnitTestPBPhysFixedPartition();
+  UnitTestPBPhysSleep();
+  UnitTestPBPhysEventDriven();
+  UnitTestPBPhysStepToCollisions();
+  UnitTestPBPhysThreadPool();
+  UnitTestPBPhysStats();
+  UnitTestPBPhysTrace();
+  UnitTestPBPhysHisto();
 
   printf("UnitTestPBPhys OK\n");
 }
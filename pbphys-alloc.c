@@ -0,0 +1,28 @@
+// Counter of heap allocations shared by the unit tests and the 
+// benchmark, included once by their main file
+// The allocation functions are wrapped only if PBPHYS_COUNTALLOC is 
+// defined at compilation and with the glibc, elsewhere the counter 
+// stays null and the checks are always successful. The wrappers 
+// replace the allocator of the whole process, leave PBPHYS_COUNTALLOC 
+// undefined when compiling with a sanitizer
+// The counter is atomic as the threads of the pool and the writer of 
+// the recorder allocate concurrently with the main thread
+#include <stdatomic.h>
+atomic_ulong nbAlloc = 0;
+#if defined(PBPHYS_COUNTALLOC) && defined(__GLIBC__)
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t nb, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+void* malloc(size_t size) {
+  atomic_fetch_add_explicit(&nbAlloc, 1, memory_order_relaxed);
+  return __libc_malloc(size);
+}
+void* calloc(size_t nb, size_t size) {
+  atomic_fetch_add_explicit(&nbAlloc, 1, memory_order_relaxed);
+  return __libc_calloc(nb, size);
+}
+void* realloc(void* ptr, size_t size) {
+  atomic_fetch_add_explicit(&nbAlloc, 1, memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+#endif
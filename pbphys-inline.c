@@ -133,12 +133,12 @@ VecFloat* PBPhysParticleGetPos(const PBPhysParticle* const that) {
   return ShapoidGetCenter(that->_shape);
 }
 
-// Set the speed of the particle 'that' to 'speed'
+// Set the speed of the particle 'that' to 'speed' and wake it up
 // If the particle is fixed do nothing
 #if BUILDMODE != 0
 static inline
 #endif
-void _PBPhysParticleSetSpeed(const PBPhysParticle* const that, 
+void _PBPhysParticleSetSpeed(PBPhysParticle* const that, 
   const VecFloat* const speed) {
 #if BUILDMODE == 0
   if (that == NULL) {
@@ -158,17 +158,19 @@ void _PBPhysParticleSetSpeed(const PBPhysParticle* const that,
     PBErrCatch(PBPhysErr);
   }
 #endif
-  if (!PBPhysParticleIsFixed(that))
+  if (!PBPhysParticleIsFixed(that)) {
     VecCopy(that->_speed, speed);
+    PBPhysParticleWakeUp(that);
+  }
 }
 
 // Add to the speed of the particle 'that' the vector 'v' multiplied 
-// by 'c'
+// by 'c' and wake it up
 // If the particle is fixed do nothing
 #if BUILDMODE != 0
 static inline
 #endif
-void _PBPhysParticleAddSpeed(const PBPhysParticle* const that, 
+void _PBPhysParticleAddSpeed(PBPhysParticle* const that, 
   const VecFloat* const v, const float c) {
 #if BUILDMODE == 0
   if (that == NULL) {
@@ -188,8 +190,10 @@ void _PBPhysParticleAddSpeed(const PBPhysParticle* const that,
     PBErrCatch(PBPhysErr);
   }
 #endif
-  if (!PBPhysParticleIsFixed(that))
+  if (!PBPhysParticleIsFixed(that)) {
     VecOp(that->_speed, 1.0, v, c);
+    PBPhysParticleWakeUp(that);
+  }
 }
 
 // Add to the system accel of the particle 'that' the vector 'v' 
@@ -224,7 +228,8 @@ void _PBPhysParticleAddSysAccel(const PBPhysParticle* const that,
 
 
 
-// Set the acceleration of the particle 'that' to 'accel'
+// Set the acceleration of the particle 'that' to 'accel' and wake it 
+// up
 // If the particle is fixed do nothing
 #if BUILDMODE != 0
 static inline
@@ -249,8 +254,10 @@ void _PBPhysParticleSetAccel(PBPhysParticle* const that,
     PBErrCatch(PBPhysErr);
   }
 #endif
-  if (!PBPhysParticleIsFixed(that))
+  if (!PBPhysParticleIsFixed(that)) {
     VecCopy(that->_accel, accel);
+    PBPhysParticleWakeUp(that);
+  }
 }
 
 // Reset the system acceleration of the particle 'that'
@@ -287,7 +294,8 @@ void PBPhysParticleApplyGravity(PBPhysParticle* const that,
     VecSetAdd(that->_accel, 1, -1.0 * gravity);
 }
 
-// Set the position of the center of the particle 'that' to 'pos'
+// Set the position of the center of the particle 'that' to 'pos' and 
+// wake it up
 #if BUILDMODE != 0
 static inline
 #endif
@@ -312,10 +320,11 @@ void _PBPhysParticleSetPos(PBPhysParticle* const that,
   }
 #endif
   ShapoidSetCenterPos(that->_shape, pos);
+  PBPhysParticleWakeUp(that);
 }
 
 // Add to the position of the center of the particle 'that' the 
-// vector 'v' multiplied by 'c'
+// vector 'v' multiplied by 'c' and wake it up
 #if BUILDMODE != 0
 static inline
 #endif
@@ -343,6 +352,7 @@ void _PBPhysParticleAddPos(PBPhysParticle* const that,
   VecOp(pos, 1.0, v, c);
   ShapoidSetCenterPos(that->_shape, pos);
   VecFree(&pos);
+  PBPhysParticleWakeUp(that);
 }
 
 // Return true if the particle 'that' is the same is the particle 'tho'
@@ -404,6 +414,8 @@ void _PBPhysParticleSetSizeVec(PBPhysParticle* const that,
       VecNorm(ShapoidAxis(PBPhysParticleShape(that), iAxis));
     ShapoidAxisScale(that->_shape, iAxis, scale);
   }
+  if (that->_phys != NULL)
+    PBPhysSoAUpdateShapeOf(that->_phys->_soa, that->_iSoA);
 }
 
 #if BUILDMODE != 0
@@ -423,6 +435,8 @@ void _PBPhysParticleSetSizeScalar(PBPhysParticle* const that,
       VecNorm(ShapoidAxis(PBPhysParticleShape(that), iAxis));
     ShapoidAxisScale(that->_shape, iAxis, scale);
   }
+  if (that->_phys != NULL)
+    PBPhysSoAUpdateShapeOf(that->_phys->_soa, that->_iSoA);
 }
 
 // Return the mass of the particle 'that'
@@ -454,6 +468,8 @@ void PBPhysParticleSetMass(PBPhysParticle* const that,
   }
 #endif
   that->_mass = mass;
+  if (that->_phys != NULL)
+    that->_phys->_soa->_mass[that->_iSoA] = mass;
 }
 
 // Return the drag of the particle 'that'
@@ -485,6 +501,8 @@ void PBPhysParticleSetDrag(PBPhysParticle* const that,
   }
 #endif
   that->_drag = drag;
+  if (that->_phys != NULL)
+    that->_phys->_soa->_drag[that->_iSoA] = drag;
 }
 
 // Return true if the particle 'that' is fixed
@@ -517,10 +535,49 @@ void PBPhysParticleSetFixed(PBPhysParticle* const that,
   }
 #endif
   that->_fixed = fixed;
+  if (that->_phys != NULL)
+    that->_phys->_soa->_fixed[that->_iSoA] = fixed;
   if (fixed) {
     VecSetNull(that->_speed);
     VecSetNull(that->_accel);
+    VecSetNull(that->_sysAccel);
+  }
+  // A fixed particle is never asleep, and a particle released from 
+  // its fixed position starts awake
+  PBPhysParticleWakeUp(that);
+}
+
+// Return true if the particle 'that' is asleep
+// Return false else
+#if BUILDMODE != 0
+static inline
+#endif
+bool PBPhysParticleIsAsleep(const PBPhysParticle* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_asleep;
+}
+
+// Wake up the particle 'that' if it's asleep, and restart the count of 
+// the time during which its speed stays under the sleep threshold
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysParticleWakeUp(PBPhysParticle* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
   }
+#endif
+  that->_asleep = false;
+  that->_idleTime = 0.0;
 }
 
 // Set the user data of the particle 'that' to 'data'
@@ -554,6 +611,135 @@ void* PBPhysParticleData(const PBPhysParticle* const that) {
   return that->_data;
 }
 
+// ------------ PBPhysSoA
+
+// ================ Functions implementation ====================
+
+// Return the VecFloat record of the 'iPart'-th particle in the array
+// of records 'arr' of the PBPhysSoA 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+VecFloat* PBPhysSoAVec(const PBPhysSoA* const that, char* const arr,
+  const long iPart) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (arr == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'arr' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (iPart < 0 || iPart >= that->_capacity) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'iPart' is invalid (0<=%ld<%ld)", 
+      iPart, that->_capacity);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return (VecFloat*)(arr + that->_stride * iPart);
+}
+
+// Return the 'iDim'-th coordinate of the center of the 'iPart'-th
+// particle in the PBPhysSoA 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysSoAGetCenter(const PBPhysSoA* const that, const long iPart,
+  const int iDim) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (iPart < 0 || iPart >= that->_nb) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'iPart' is invalid (0<=%ld<%ld)", 
+      iPart, that->_nb);
+    PBErrCatch(PBPhysErr);
+  }
+  if (iDim < 0 || iDim >= that->_dim) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'iDim' is invalid (0<=%d<%d)", 
+      iDim, that->_dim);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return PBPhysSoAVec(that, that->_pos, iPart)->_val[iDim] + 
+    that->_centerOffset[that->_dim * iPart + iDim];
+}
+
+// ------------ PBPhysHisto
+
+// ================ Functions implementation ====================
+
+// Return the number of values recorded in the PBPhysHisto 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+unsigned long PBPhysHistoGetNb(const PBPhysHisto* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_nb;
+}
+
+// Return the lowest value recorded in the PBPhysHisto 'that' (0 if it 
+// is empty)
+#if BUILDMODE != 0
+static inline
+#endif
+unsigned long PBPhysHistoGetMin(const PBPhysHisto* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return (that->_nb > 0 ? that->_min : 0);
+}
+
+// Return the highest value recorded in the PBPhysHisto 'that' (0 if it 
+// is empty)
+#if BUILDMODE != 0
+static inline
+#endif
+unsigned long PBPhysHistoGetMax(const PBPhysHisto* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_max;
+}
+
+// Return the mean of the values recorded in the PBPhysHisto 'that' (0 
+// if it is empty)
+#if BUILDMODE != 0
+static inline
+#endif
+double PBPhysHistoGetMean(const PBPhysHisto* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return (that->_nb > 0 ? that->_sum / (double)(that->_nb) : 0.0);
+}
+
 // ------------ PBPhys
 
 // ================ Functions implementation ====================
@@ -768,5 +954,913 @@ void PBPhysAddParticles(PBPhys* const that, const int nb,
     PBPhysParticle* particle = 
       PBPhysParticleCreate(PBPhysGetDim(that), shape);
     GSetAppend(&(that->_particles), particle);
+    if (that->_soa != NULL)
+      PBPhysSoAAttach(that->_soa, that, particle);
+  }
+}
+
+// Return the storage mode of the particles of the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysStorage PBPhysGetStorage(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return (that->_soa != NULL ? PBPhysStorageSoA : PBPhysStorageAoS);
+}
+
+// Set the solver used for the gravity between particles of the PBPhys 
+// 'that' to 'solver'
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetGravitySolver(PBPhys* const that, 
+  const PBPhysGravitySolver solver) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_gravitySolver = solver;
+}
+
+// Return the solver used for the gravity between particles of the 
+// PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysGravitySolver PBPhysGetGravitySolver(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_gravitySolver;
+}
+
+// Set the opening angle of the Barnes-Hut tree of the PBPhys 'that' to 
+// 'theta'
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetGravityTheta(PBPhys* const that, const float theta) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (theta < 0.0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'theta' is invalid (0.0<=%f)", theta);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_gravityTheta = theta;
+}
+
+// Return the opening angle of the Barnes-Hut tree of the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysGetGravityTheta(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_gravityTheta;
+}
+
+// Set the broad phase used to select the pairs of particles tested for 
+// collision in the PBPhys 'that' to 'broadPhase'
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetBroadPhase(PBPhys* const that, 
+  const PBPhysBroadPhase broadPhase) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // The pairs of the other broad phases overwrite the Verlet 
+  // neighbour lists
+  if (that->_verlet != NULL && broadPhase != that->_broadPhase)
+    that->_verlet->_isBuilt = false;
+  that->_broadPhase = broadPhase;
+}
+
+// Return the broad phase used to select the pairs of particles tested 
+// for collision in the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysBroadPhase PBPhysGetBroadPhase(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_broadPhase;
+}
+
+// Set the skin distance of the Verlet neighbour lists of the PBPhys 
+// 'that' to 'skin'
+// A larger skin builds the lists less often but selects more pairs
+// The lists are built again at the next step
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetVerletSkin(PBPhys* const that, const float skin) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (skin < 0.0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'skin' is invalid (0.0<=%f)", skin);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_verletSkin = skin;
+  if (that->_verlet != NULL)
+    that->_verlet->_isBuilt = false;
+}
+
+// Return the skin distance of the Verlet neighbour lists of the PBPhys 
+// 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysGetVerletSkin(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_verletSkin;
+}
+
+// Return the number of updates of the pairs with the Verlet broad 
+// phase of the PBPhys 'that', one per search of collisions
+// Return 0 if the Verlet broad phase has never been used
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysGetVerletNbUpdate(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
   }
+#endif
+  return (that->_verlet != NULL ? that->_verlet->_nbUpdate : 0);
+}
+
+// Return the number of builds of the Verlet neighbour lists of the 
+// PBPhys 'that', divided by the number of updates it gives the rebuild 
+// frequency to tune the skin
+// Return 0 if the Verlet broad phase has never been used
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysGetVerletNbBuild(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return (that->_verlet != NULL ? that->_verlet->_nbBuild : 0);
+}
+
+// Set the scheduler of the collisions in PBPhysStep of the PBPhys 
+// 'that' to 'scheduler'
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetScheduler(PBPhys* const that, 
+  const PBPhysScheduler scheduler) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_scheduler = scheduler;
+}
+
+// Return the scheduler of the collisions in PBPhysStep of the PBPhys 
+// 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysScheduler PBPhysGetScheduler(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_scheduler;
+}
+
+// Set the tolerance on the time of the collisions resolved together in 
+// PBPhysStep of the PBPhys 'that' to 'tolerance'
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetContactTolerance(PBPhys* const that, 
+  const float tolerance) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (tolerance < 0.0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'tolerance' is invalid (0.0<=%f)", 
+      tolerance);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_contactTolerance = tolerance;
+}
+
+// Return the tolerance on the time of the collisions resolved together 
+// in PBPhysStep of the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysGetContactTolerance(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_contactTolerance;
+}
+
+// Return the speed under which the particles of the PBPhys 'that' fall 
+// asleep
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysGetSleepSpeed(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_sleepSpeed;
+}
+
+// Set the time during which the speed of a particle of the PBPhys 
+// 'that' must stay under the sleep threshold before it falls asleep 
+// to 'delay'
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetSleepDelay(PBPhys* const that, const float delay) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (delay < 0.0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'delay' is invalid (0.0<=%f)", delay);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_sleepDelay = delay;
+}
+
+// Return the time during which the speed of a particle of the PBPhys 
+// 'that' must stay under the sleep threshold before it falls asleep
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysGetSleepDelay(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_sleepDelay;
+}
+
+// Return the number of threads used by the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysGetNbThread(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return (that->_threadPool == NULL ? 1 : that->_threadPool->_nbThread);
+}
+
+// Return the statistics of the steps of the PBPhys 'that'
+// They are null if PBPHYS_STATS is 0
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysStats PBPhysGetStats(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_stats;
+}
+
+// Reset the statistics of the steps of the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysResetStats(PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  memset(&(that->_stats), 0, sizeof(PBPhysStats));
+}
+
+// Return true if the steps of the PBPhys 'that' are traced, else false
+#if BUILDMODE != 0
+static inline
+#endif
+bool PBPhysIsTracing(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_tracing;
+}
+
+// Return the trace of the PBPhys 'that' (NULL if it has never been 
+// traced)
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysTrace* PBPhysGetTrace(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_trace;
+}
+
+// Return the histogram of the duration in nanoseconds of the steps 
+// of the PBPhys 'that' (NULL if it's not recorded)
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysHisto* PBPhysGetStepTimeHisto(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_stepTimeHisto;
+}
+
+// Return the histogram of the number of sub-steps of the steps of the 
+// PBPhys 'that' (NULL if it's not recorded)
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysHisto* PBPhysGetStepIterHisto(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_stepIterHisto;
+}
+
+// ------------ PBPhysSnapshot
+
+// ================ Functions implementation ====================
+
+// Return the number of particles in the PBPhysSnapshot 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysSnapshotGetNbParticle(const PBPhysSnapshot* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_nbParticle;
+}
+
+// Return the space dimension of the PBPhysSnapshot 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysSnapshotGetDim(const PBPhysSnapshot* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_dim;
+}
+
+// ------------ PBPhysRecorder
+
+// ================ Functions implementation ====================
+
+// Set the mask of the fields recorded by the PBPhysRecorder 'that' to 
+// 'fields' (1 << PBPhysBinField)
+// The recorder must not be running
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysRecorderSetFields(PBPhysRecorder* const that, 
+  const int fields) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (that->_stream != NULL) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'that' is running");
+    PBErrCatch(PBPhysErr);
+  }
+  if (fields <= 0 || fields >= (1 << PBPhysBinFieldNb)) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'fields' is invalid (0<%d<%d)", 
+      fields, 1 << PBPhysBinFieldNb);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_fields = fields;
+}
+
+// Return the mask of the fields recorded by the PBPhysRecorder 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysRecorderGetFields(const PBPhysRecorder* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_fields;
+}
+
+// Set the number of steps between two records of the PBPhysRecorder 
+// 'that' to 'stride'
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysRecorderSetStride(PBPhysRecorder* const that, 
+  const int stride) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stride <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'stride' is invalid (0<%d)", stride);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_stride = stride;
+}
+
+// Return the number of steps between two records of the 
+// PBPhysRecorder 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysRecorderGetStride(const PBPhysRecorder* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_stride;
+}
+
+// Set the flag to drop the records of the PBPhysRecorder 'that' when 
+// its ring is full to 'drop', if false the stepping thread waits for 
+// the writer
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysRecorderSetDrop(PBPhysRecorder* const that, const bool drop) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_drop = drop;
+}
+
+// Return the flag to drop the records of the PBPhysRecorder 'that' 
+// when its ring is full
+#if BUILDMODE != 0
+static inline
+#endif
+bool PBPhysRecorderGetDrop(const PBPhysRecorder* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_drop;
+}
+
+// Set the number of records the ring of the PBPhysRecorder 'that' can 
+// hold to 'size'
+// The recorder must not be running
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysRecorderSetRingSize(PBPhysRecorder* const that, 
+  const long size) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (that->_stream != NULL) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'that' is running");
+    PBErrCatch(PBPhysErr);
+  }
+  if (size <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'size' is invalid (0<%ld)", size);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_ringSize = size;
+}
+
+// Return the number of records the ring of the PBPhysRecorder 'that' 
+// can hold
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysRecorderGetRingSize(const PBPhysRecorder* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_ringSize;
+}
+
+// Return true if the PBPhysRecorder 'that' is running, false else
+#if BUILDMODE != 0
+static inline
+#endif
+bool PBPhysRecorderIsRunning(const PBPhysRecorder* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return (that->_stream != NULL);
+}
+
+// ------------ PBPhysTraj
+
+// ================ Functions implementation ====================
+
+// Return the number of frames written by the PBPhysTrajWriter 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysTrajWriterGetNbFrame(const PBPhysTrajWriter* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_nbFrame;
+}
+
+// Return the number of frames of the PBPhysTrajReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysTrajReaderGetNbFrame(const PBPhysTrajReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_nbFrame;
+}
+
+// Return the number of frames between two keyframes of the 
+// PBPhysTrajReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysTrajReaderGetKeyInterval(const PBPhysTrajReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_keyInterval;
+}
+
+// Return the number of particles of the PBPhysTrajReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysTrajReaderGetNbParticle(const PBPhysTrajReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_nbPart;
+}
+
+// Return the dimension of the PBPhysTrajReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysTrajReaderGetDim(const PBPhysTrajReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_dim;
+}
+
+// Return the index of the current frame of the PBPhysTrajReader 
+// 'that' (-1 before the first frame)
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysTrajReaderGetIFrame(const PBPhysTrajReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_iFrame;
+}
+
+// Return the time of the current frame of the PBPhysTrajReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysTrajReaderGetCurTime(const PBPhysTrajReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_curTime;
+}
+
+// Return the positions of the particles in the current frame of the 
+// PBPhysTrajReader 'that' (_dim values per particle)
+#if BUILDMODE != 0
+static inline
+#endif
+const float* PBPhysTrajReaderPos(const PBPhysTrajReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_pos;
+}
+
+// Return the speeds of the particles in the current frame of the 
+// PBPhysTrajReader 'that' (_dim values per particle)
+#if BUILDMODE != 0
+static inline
+#endif
+const float* PBPhysTrajReaderSpeed(const PBPhysTrajReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_speed;
+}
+
+// ------------ PBPhysArchive
+
+// ================ Functions implementation ====================
+
+// Return the number of records of the PBPhysArchive 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysArchiveGetNbRecord(const PBPhysArchive* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_nbRecord;
+}
+
+// Return the number of steps between two keyframes of the 
+// PBPhysArchive 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysArchiveGetKeyInterval(const PBPhysArchive* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_keyInterval;
+}
+
+// Return the PBPhys restored by the last PBPhysArchiveReaderSeek of the 
+// PBPhysArchiveReader 'that' (NULL before the first seek)
+// The PBPhys belongs to 'that' and is replaced when a keyframe is 
+// decoded
+#if BUILDMODE != 0
+static inline
+#endif
+const PBPhys* PBPhysArchiveReaderPBPhys(
+  const PBPhysArchiveReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_phys;
+}
+
+// Return the number of records of the PBPhysArchiveReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysArchiveReaderGetNbRecord(
+  const PBPhysArchiveReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_nbRecord;
+}
+
+// Return the index of the current record of the PBPhysArchiveReader 
+// 'that' (-1 before the first seek)
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysArchiveReaderGetIRecord(
+  const PBPhysArchiveReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_iRecord;
+}
+
+// Return the time of the first record of the PBPhysArchiveReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysArchiveReaderGetFirstTime(
+  const PBPhysArchiveReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_keyTime[0];
+}
+
+// Return the time of the last record of the PBPhysArchiveReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysArchiveReaderGetLastTime(
+  const PBPhysArchiveReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return that->_lastTime;
 }
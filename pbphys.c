@@ -2,11 +2,70 @@
 
 // ================= Include =================
 
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sched.h>
+#include <errno.h>
+#include <time.h>
 #include "pbphys.h"
 #if BUILDMODE == 0
 #include "pbphys-inline.c"
 #endif
 
+// ================= Define ==================
+
+#if PBPHYS_STATS
+// Counters of the calling thread used by the statistics of the steps, 
+// they are read before and after a phase to attribute its operations 
+// to the stepped PBPhys
+_Thread_local unsigned long pbphysNbTOISolve = 0;
+_Thread_local unsigned long pbphysNbAlloc = 0;
+// Add 'nb' to the counter of heap allocations of the calling thread
+#define PBPHYS_STATS_ALLOC(nb) (pbphysNbAlloc += (nb))
+// Declare the variable 't' memorizing the start time of a phase
+#define PBPHYS_STATS_START(t) double t = PBPhysGetWallTime()
+// Add the time elapsed since 't' to the phase 'phase' of the PBPhys 
+// 'that'
+#define PBPHYS_STATS_STOP(that, phase, t) \
+  ((that)->_stats._time[(phase)] += PBPhysGetWallTime() - (t))
+// Add 'nb' to the counter 'counter' of the statistics of the PBPhys 
+// 'that'
+#define PBPHYS_STATS_ADD(that, counter, nb) \
+  ((that)->_stats.counter += (nb))
+#else
+#define PBPHYS_STATS_ALLOC(nb)
+#define PBPHYS_STATS_START(t)
+#define PBPHYS_STATS_STOP(that, phase, t)
+#define PBPHYS_STATS_ADD(that, counter, nb)
+#endif
+
+// Record the beginning of the event 'name' by the 'iThread'-th thread 
+// of the PBPhys 'that' if it is traced
+#define PBPHYS_TRACE_BEGIN(that, iThread, name) \
+  ((that)->_tracing ? \
+    PBPhysTraceAdd((that)->_trace, (iThread), (name), 'B') : (void)0)
+// Record the end of the event 'name' by the 'iThread'-th thread of the 
+// PBPhys 'that' if it is traced
+#define PBPHYS_TRACE_END(that, iThread, name) \
+  ((that)->_tracing ? \
+    PBPhysTraceAdd((that)->_trace, (iThread), (name), 'E') : (void)0)
+
+// Start the phase 'phase' of a step of the PBPhys 'that', its start 
+// time is memorized in the variable 't' for the statistics
+#define PBPHYS_PHASE_START(that, phase, t) \
+  PBPHYS_STATS_START(t); \
+  PBPHYS_TRACE_BEGIN(that, 0, pbphysPhaseName[(phase)])
+// Stop the phase 'phase' of a step of the PBPhys 'that' started at 't'
+#define PBPHYS_PHASE_STOP(that, phase, t) \
+  PBPHYS_STATS_STOP(that, phase, t); \
+  PBPHYS_TRACE_END(that, 0, pbphysPhaseName[(phase)])
+
+// Names of the phases of the steps
+static const char* const pbphysPhaseName[PBPhysPhaseNb] = 
+  {"sys accel", "search", "resolve", "move", "record"};
+
 // ------------ PBPhysParticle
 
 // ================ Functions declaration ====================
@@ -16,6 +75,19 @@
 VecFloat* PBPhysParticleGetNextDisplacement(
   const PBPhysParticle* const that, const float dt);
 
+// Return the 'iDim'-th component of the displacement of the particle 
+// from current position to the position after dt
+// Doesn't allocate memory
+float PBPhysParticleGetNextDisplacementAt(
+  const PBPhysParticle* const that, const float dt, const int iDim);
+
+// Copy the position of the center of the particle 'that' into 'pos' 
+// (array of dim values)
+// Doesn't allocate memory if the particle is a spheroid or its state 
+// is stored in a PBPhys
+void PBPhysParticleCopyPos(const PBPhysParticle* const that, 
+  float* const pos);
+
 // Return the coefficients of the polynom describing the square of the 
 // distance between two lines passing through 'posA' and 'posB' and 
 // colinear to 'dirA' and 'dirB' respectively
@@ -23,12 +95,110 @@ VecFloat* PBPhysParticleGetNextDisplacement(
 VecFloat3D PBPhysGetDistPoly(const VecFloat* const posA, 
   const VecFloat* const dirA, const VecFloat* const posB, 
   const VecFloat* const dirB);
+
+// Write the 'nb' values of 'size' bytes in 'data' on the stream 
+// 'stream' in little endian order
+// Return true if we could write the values, false else
+bool PBPhysWriteLE(const void* const data, const size_t size, 
+  const size_t nb, FILE* const stream);
+
+// Read 'nb' values of 'size' bytes in little endian order from the 
+// stream 'stream' into 'data'
+// Return true if we could read the values, false else
+bool PBPhysReadLE(void* const data, const size_t size, const size_t nb, 
+  FILE* const stream);
+
+// Convert the 'nb' values of 'size' bytes in 'data' from little endian 
+// order to the order of the host
+void PBPhysFromLE(void* const data, const size_t size, const size_t nb);
+
+// Write the magic number 'magic' and the version of the binary format 
+// on the stream 'stream'
+// Return true if we could write them, false else
+bool PBPhysWriteBinaryHeader(const char* const magic, 
+  FILE* const stream);
+
+// Read the magic number and the version of the binary format from the 
+// stream 'stream'
+// Return true if the magic number is 'magic' and the version is 
+// supported, false else
+bool PBPhysReadBinaryHeader(const char* const magic, 
+  FILE* const stream);
+
+// Return the number of values per particle of dimension 'dim' of the 
+// field 'field' in the binary format
+long PBPhysBinFieldGetNbVal(const PBPhysBinField field, const int dim);
+
+// Return the size in bytes of one value of the field 'field' in the 
+// binary format
+size_t PBPhysBinFieldGetSize(const PBPhysBinField field);
+
+// Pack the field 'field' of the particle 'that' into 'buffer'
+void PBPhysParticlePackField(const PBPhysParticle* const that, 
+  const PBPhysBinField field, void* const buffer);
+
+// Unpack the field 'field' of the particle 'that' of dimension 'dim' 
+// from 'buffer', 'v' is a vector of dimension 'dim' used as a scratch
+// If the field is the type the particle is created, else it must 
+// already exist
+// Return false if the packed value is invalid, true else
+bool PBPhysParticleUnpackField(PBPhysParticle** const that, 
+  const int dim, const PBPhysBinField field, const void* const buffer, 
+  VecFloat* const v);
+
+// Save the 'nb' particles 'parts' of dimension 'dim' on the stream 
+// 'stream' in binary format, as one packed array per field
+// Return true if we could save the particles, false else
+bool PBPhysParticlesSaveBinary(PBPhysParticle* const* const parts, 
+  const long nb, const int dim, FILE* const stream);
+
+// Load 'nb' particles of dimension 'dim' saved with 
+// PBPhysParticlesSaveBinary from the stream 'stream' into 'parts'
+// The particles are created, 'parts' must be initialised to NULL and 
+// the particles created before a failure must be freed by the caller
+// Return true if we could load the particles, false else
+bool PBPhysParticlesLoadBinary(PBPhysParticle** const parts, 
+  const long nb, const int dim, FILE* const stream);
+
+// Write the indentation of the depth 'depth' of a JSON text on the 
+// stream 'stream', nothing if 'compact' equals true
+void PBPhysJSONWriteIndent(FILE* const stream, const int depth, 
+  const bool compact);
+
+// Write the label 'lbl' of a property of the JSON object at depth 
+// 'depth' on the stream 'stream'
+void PBPhysJSONWriteLbl(FILE* const stream, const char* const lbl, 
+  const int depth, const bool compact);
+
+// Write the property 'lbl' with value 'val' of the JSON object at 
+// depth 'depth' on the stream 'stream', followed by the separator with 
+// the next property if 'last' equals false
+void PBPhysJSONWriteProp(FILE* const stream, const char* const lbl, 
+  const char* const val, const int depth, const bool last, 
+  const bool compact);
+
+// Write the end of a property on the stream 'stream', with the 
+// separator with the next property if 'last' equals false
+void PBPhysJSONWriteEndProp(FILE* const stream, const bool last, 
+  const bool compact);
+
+// Write the JSON encoding of the vector 'that' as an object at depth 
+// 'depth' on the stream 'stream'
+void PBPhysJSONWriteVec(const VecFloat* const that, FILE* const stream, 
+  const int depth, const bool compact);
+
+// Write the JSON encoding of the particle 'that' as an object at depth 
+// 'depth' on the stream 'stream', without creating the JSONNode
+// The text is the one JSONSave writes for PBPhysParticleEncodeAsJSON
+void PBPhysParticleJSONWrite(const PBPhysParticle* const that, 
+  FILE* const stream, const int depth, const bool compact);
   
 // ================ Functions implementation ====================
 
 // Create a new PBPhysParticle with dimension 'dim' and a 'shapeType'
 // shapoid as shape 
-// Default values: _mass = 0.0, _drag = 0.0, _fixed = false
+// Default values: _mass = 0.0, _drag = 0.0, _fixed = false, 
+// _asleep = false
 PBPhysParticle* PBPhysParticleCreate(const int dim, 
   const ShapoidType shapeType) {
 #if BUILDMODE == 0
@@ -48,7 +218,11 @@ PBPhysParticle* PBPhysParticleCreate(const int dim,
   that->_mass = 0.0;
   that->_drag = 0.0;
   that->_fixed = false;
+  that->_asleep = false;
+  that->_idleTime = 0.0;
   that->_data = NULL;
+  that->_phys = NULL;
+  that->_iSoA = -1;
   // Return the new PBPhysParticle
   return that;
 }
@@ -59,6 +233,9 @@ void PBPhysParticleFree(PBPhysParticle** that) {
   if (that == NULL || *that == NULL)
     // Nothing to do
     return;
+  // If the state of the particle is stored in a PBPhys, get it back
+  if ((*that)->_phys != NULL)
+    PBPhysSoADetach((*that)->_phys->_soa, *that);
   // Free memory
   ShapoidFree(&((*that)->_shape));
   VecFree(&((*that)->_speed));
@@ -90,6 +267,9 @@ PBPhysParticle* PBPhysParticleClone(const PBPhysParticle* const that) {
   VecFloat* center = PBPhysParticleGetPos(that);
   PBPhysParticleSetPos(clone, center);
   VecFree(&center);
+  // Copy the sleep state last as the setters wake up the clone
+  clone->_asleep = that->_asleep;
+  clone->_idleTime = that->_idleTime;
   // Return the clone
   return clone;
 }
@@ -268,16 +448,11 @@ bool PBPhysParticleSave(const PBPhysParticle* const that,
     PBErrCatch(PBPhysErr);
   }
 #endif
-  // Get the JSON encoding
-  JSONNode* json = PBPhysParticleEncodeAsJSON(that);
-  // Save the JSON
-  if (!JSONSave(json, stream, compact)) {
-    return false;
-  }
-  // Free memory
-  JSONFree(&json);
+  // Write the JSON encoding directly on the stream
+  PBPhysParticleJSONWrite(that, stream, 0, compact);
+  fprintf(stream, "\n");
   // Return success code
-  return true;
+  return !ferror(stream);
 }
 
 // Load the particle 'that' from the stream 'stream'
@@ -314,6 +489,347 @@ bool PBPhysParticleLoad(PBPhysParticle** that, FILE* const stream) {
   return true;
 }
 
+
+// Save the particle 'that' on the stream 'stream' in binary format
+// The binary format is made of the magic number 
+// PBPHYS_BINMAGICPARTICLE, the version (uint32), the dimension (int32) 
+// and the fields of the particle in the order of PBPhysBinField, all 
+// in little endian
+// Return true if we could save the particle
+// Return false else
+// If user data is attached to the particle it must be saved by the user
+bool PBPhysParticleSaveBinary(const PBPhysParticle* const that, 
+  FILE* const stream) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Save the header
+  int32_t dim = PBPhysParticleGetDim(that);
+  if (!PBPhysWriteBinaryHeader(PBPHYS_BINMAGICPARTICLE, stream) ||
+    !PBPhysWriteLE(&dim, sizeof(int32_t), 1, stream))
+    return false;
+  // Save the fields
+  return PBPhysParticlesSaveBinary((PBPhysParticle* const*)&that, 1, 
+    dim, stream);
+}
+
+// Load the particle 'that' from the stream 'stream' in binary format
+// Return true if we could load the particle
+// Return false else
+// If user data is attached to the particle it must be loaded by the 
+// user
+bool PBPhysParticleLoadBinary(PBPhysParticle** that, 
+  FILE* const stream) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // If 'that' is already allocated
+  if (*that != NULL)
+    // Free memory
+    PBPhysParticleFree(that);
+  // Load the header
+  int32_t dim = 0;
+  if (!PBPhysReadBinaryHeader(PBPHYS_BINMAGICPARTICLE, stream) ||
+    !PBPhysReadLE(&dim, sizeof(int32_t), 1, stream) || dim <= 0)
+    return false;
+  // Load the fields
+  if (!PBPhysParticlesLoadBinary(that, 1, dim, stream)) {
+    PBPhysParticleFree(that);
+    return false;
+  }
+  // Return the success code
+  return true;
+}
+
+// Write the 'nb' values of 'size' bytes in 'data' on the stream 
+// 'stream' in little endian order
+// Return true if we could write the values, false else
+bool PBPhysWriteLE(const void* const data, const size_t size, 
+  const size_t nb, FILE* const stream) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  // Reverse the bytes of each value
+  const unsigned char* bytes = data;
+  unsigned char val[8];
+  for (size_t iVal = 0; iVal < nb; ++iVal) {
+    for (size_t iByte = 0; iByte < size; ++iByte)
+      val[iByte] = bytes[iVal * size + size - 1 - iByte];
+    if (fwrite(val, size, 1, stream) != 1)
+      return false;
+  }
+  return true;
+#else
+  return (fwrite(data, size, nb, stream) == nb);
+#endif
+}
+
+// Read 'nb' values of 'size' bytes in little endian order from the 
+// stream 'stream' into 'data'
+// Return true if we could read the values, false else
+bool PBPhysReadLE(void* const data, const size_t size, const size_t nb, 
+  FILE* const stream) {
+  if (fread(data, size, nb, stream) != nb)
+    return false;
+  PBPhysFromLE(data, size, nb);
+  return true;
+}
+
+// Convert the 'nb' values of 'size' bytes in 'data' from little endian 
+// order to the order of the host
+void PBPhysFromLE(void* const data, const size_t size, const size_t nb) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  // Reverse the bytes of each value
+  unsigned char* bytes = data;
+  for (size_t iVal = 0; iVal < nb; ++iVal) {
+    for (size_t iByte = 0; iByte < size / 2; ++iByte) {
+      unsigned char byte = bytes[iVal * size + iByte];
+      bytes[iVal * size + iByte] = bytes[iVal * size + size - 1 - iByte];
+      bytes[iVal * size + size - 1 - iByte] = byte;
+    }
+  }
+#else
+  (void)data;
+  (void)size;
+  (void)nb;
+#endif
+}
+
+// Write the magic number 'magic' and the version of the binary format 
+// on the stream 'stream'
+// Return true if we could write them, false else
+bool PBPhysWriteBinaryHeader(const char* const magic, 
+  FILE* const stream) {
+  uint32_t version = PBPHYS_BINVERSION;
+  return (fwrite(magic, 1, strlen(magic), stream) == strlen(magic) &&
+    PBPhysWriteLE(&version, sizeof(uint32_t), 1, stream));
+}
+
+// Read the magic number and the version of the binary format from the 
+// stream 'stream'
+// Return true if the magic number is 'magic' and the version is 
+// supported, false else
+bool PBPhysReadBinaryHeader(const char* const magic, 
+  FILE* const stream) {
+  char buffer[8] = {0};
+  uint32_t version = 0;
+  size_t len = strlen(magic);
+  return (fread(buffer, 1, len, stream) == len &&
+    memcmp(buffer, magic, len) == 0 &&
+    PBPhysReadLE(&version, sizeof(uint32_t), 1, stream) &&
+    version >= 1 && version <= PBPHYS_BINVERSION);
+}
+
+// Return the number of values per particle of dimension 'dim' of the 
+// field 'field' in the binary format
+long PBPhysBinFieldGetNbVal(const PBPhysBinField field, const int dim) {
+  switch (field) {
+    case PBPhysBinFieldPos:
+    case PBPhysBinFieldSpeed:
+    case PBPhysBinFieldAccel:
+      return dim;
+    case PBPhysBinFieldAxis:
+      return dim * dim;
+    default:
+      return 1;
+  }
+}
+
+// Return the size in bytes of one value of the field 'field' in the 
+// binary format
+size_t PBPhysBinFieldGetSize(const PBPhysBinField field) {
+  switch (field) {
+    case PBPhysBinFieldType:
+      return sizeof(int32_t);
+    case PBPhysBinFieldFixed:
+      return sizeof(uint8_t);
+    default:
+      return sizeof(float);
+  }
+}
+
+// Pack the field 'field' of the particle 'that' into 'buffer'
+void PBPhysParticlePackField(const PBPhysParticle* const that, 
+  const PBPhysBinField field, void* const buffer) {
+  int dim = PBPhysParticleGetDim(that);
+  float* val = buffer;
+  switch (field) {
+    case PBPhysBinFieldType:
+      *(int32_t*)buffer = PBPhysParticleGetShapeType(that);
+      break;
+    case PBPhysBinFieldPos:
+      for (int iDim = dim; iDim--;)
+        val[iDim] = VecGet(ShapoidPos(PBPhysParticleShape(that)), iDim);
+      break;
+    case PBPhysBinFieldAxis:
+      for (int iAxis = dim; iAxis--;)
+        for (int iDim = dim; iDim--;)
+          val[iAxis * dim + iDim] = 
+            VecGet(ShapoidAxis(PBPhysParticleShape(that), iAxis), iDim);
+      break;
+    case PBPhysBinFieldSpeed:
+      for (int iDim = dim; iDim--;)
+        val[iDim] = VecGet(PBPhysParticleSpeed(that), iDim);
+      break;
+    case PBPhysBinFieldAccel:
+      for (int iDim = dim; iDim--;)
+        val[iDim] = VecGet(PBPhysParticleAccel(that), iDim);
+      break;
+    case PBPhysBinFieldMass:
+      *val = PBPhysParticleGetMass(that);
+      break;
+    case PBPhysBinFieldDrag:
+      *val = PBPhysParticleGetDrag(that);
+      break;
+    case PBPhysBinFieldFixed:
+      *(uint8_t*)buffer = PBPhysParticleIsFixed(that);
+      break;
+    default:
+      break;
+  }
+}
+
+// Unpack the field 'field' of the particle 'that' of dimension 'dim' 
+// from 'buffer', 'v' is a vector of dimension 'dim' used as a scratch
+// If the field is the type the particle is created, else it must 
+// already exist
+// Return false if the packed value is invalid, true else
+bool PBPhysParticleUnpackField(PBPhysParticle** const that, 
+  const int dim, const PBPhysBinField field, const void* const buffer, 
+  VecFloat* const v) {
+  const float* val = buffer;
+  switch (field) {
+    case PBPhysBinFieldType: {
+      int32_t type = *(const int32_t*)buffer;
+      if (type != ShapoidTypeFacoid && type != ShapoidTypeSpheroid &&
+        type != ShapoidTypePyramidoid)
+        return false;
+      *that = PBPhysParticleCreate(dim, (ShapoidType)type);
+      break;
+    }
+    case PBPhysBinFieldPos:
+      for (int iDim = dim; iDim--;)
+        VecSet(v, iDim, val[iDim]);
+      ShapoidSetPos((*that)->_shape, v);
+      break;
+    case PBPhysBinFieldAxis:
+      for (int iAxis = dim; iAxis--;) {
+        for (int iDim = dim; iDim--;)
+          VecSet(v, iDim, val[iAxis * dim + iDim]);
+        ShapoidSetAxis((*that)->_shape, iAxis, v);
+      }
+      break;
+    case PBPhysBinFieldSpeed:
+      for (int iDim = dim; iDim--;)
+        VecSet(v, iDim, val[iDim]);
+      PBPhysParticleSetSpeed(*that, v);
+      break;
+    case PBPhysBinFieldAccel:
+      for (int iDim = dim; iDim--;)
+        VecSet(v, iDim, val[iDim]);
+      PBPhysParticleSetAccel(*that, v);
+      break;
+    case PBPhysBinFieldMass:
+      PBPhysParticleSetMass(*that, *val);
+      break;
+    case PBPhysBinFieldDrag:
+      PBPhysParticleSetDrag(*that, *val);
+      break;
+    case PBPhysBinFieldFixed:
+      PBPhysParticleSetFixed(*that, *(const uint8_t*)buffer != 0);
+      break;
+    default:
+      break;
+  }
+  return true;
+}
+
+// Save the 'nb' particles 'parts' of dimension 'dim' on the stream 
+// 'stream' in binary format, as one packed array per field
+// Return true if we could save the particles, false else
+bool PBPhysParticlesSaveBinary(PBPhysParticle* const* const parts, 
+  const long nb, const int dim, FILE* const stream) {
+  // Declare a buffer to pack the fields of a block of particles, large 
+  // enough for the largest field
+  char* buffer = PBErrMalloc(PBPhysErr, 
+    sizeof(float) * dim * dim * PBPHYS_BINBLOCK);
+  bool ret = true;
+  // Loop on the fields
+  for (int iField = 0; ret && iField < PBPhysBinFieldNb; ++iField) {
+    PBPhysBinField field = (PBPhysBinField)iField;
+    long nbVal = PBPhysBinFieldGetNbVal(field, dim);
+    size_t size = PBPhysBinFieldGetSize(field);
+    // Loop on the blocks of particles
+    for (long iFirst = 0; ret && iFirst < nb; 
+      iFirst += PBPHYS_BINBLOCK) {
+      long nbBlock = (nb - iFirst < PBPHYS_BINBLOCK ? 
+        nb - iFirst : PBPHYS_BINBLOCK);
+      // Pack the field of the particles of the block and save them
+      for (long iPart = 0; iPart < nbBlock; ++iPart)
+        PBPhysParticlePackField(parts[iFirst + iPart], field, 
+          buffer + iPart * nbVal * size);
+      ret = PBPhysWriteLE(buffer, size, nbVal * nbBlock, stream);
+    }
+  }
+  // Free memory
+  free(buffer);
+  // Return the success code
+  return ret;
+}
+
+// Load 'nb' particles of dimension 'dim' saved with 
+// PBPhysParticlesSaveBinary from the stream 'stream' into 'parts'
+// The particles are created, 'parts' must be initialised to NULL and 
+// the particles created before a failure must be freed by the caller
+// Return true if we could load the particles, false else
+bool PBPhysParticlesLoadBinary(PBPhysParticle** const parts, 
+  const long nb, const int dim, FILE* const stream) {
+  // Declare a buffer to load the fields of a block of particles, large 
+  // enough for the largest field
+  char* buffer = PBErrMalloc(PBPhysErr, 
+    sizeof(float) * dim * dim * PBPHYS_BINBLOCK);
+  VecFloat* v = VecFloatCreate(dim);
+  bool ret = true;
+  // Loop on the fields
+  for (int iField = 0; ret && iField < PBPhysBinFieldNb; ++iField) {
+    PBPhysBinField field = (PBPhysBinField)iField;
+    long nbVal = PBPhysBinFieldGetNbVal(field, dim);
+    size_t size = PBPhysBinFieldGetSize(field);
+    // Loop on the blocks of particles
+    for (long iFirst = 0; ret && iFirst < nb; 
+      iFirst += PBPHYS_BINBLOCK) {
+      long nbBlock = (nb - iFirst < PBPHYS_BINBLOCK ? 
+        nb - iFirst : PBPHYS_BINBLOCK);
+      // Load the field of the particles of the block and unpack them
+      ret = PBPhysReadLE(buffer, size, nbVal * nbBlock, stream);
+      for (long iPart = 0; ret && iPart < nbBlock; ++iPart)
+        ret = PBPhysParticleUnpackField(parts + iFirst + iPart, dim, 
+          field, buffer + iPart * nbVal * size, v);
+    }
+  }
+  // Free memory
+  free(buffer);
+  VecFree(&v);
+  // Return the success code
+  return ret;
+}
+
 // Move the particle 'that' over a period of time 'dt'
 // x(t+dt) = x(t) + v(t)*dt + 0.5*(a(t)-drag*v(t))*dt^2
 // v(t+dt) = v(t) + (a(t)-drag*v(t))*dt
@@ -326,19 +842,17 @@ void PBPhysParticleMove(PBPhysParticle* const that, const float dt) {
   }
 #endif
   if (!PBPhysParticleIsFixed(that)) {
-    // Get the displacement
-    VecFloat* disp = PBPhysParticleGetNextDisplacement(that, dt);
-    // Update the position
-    VecFloat* v = VecGetOp(
-      ShapoidPos(PBPhysParticleShape(that)), 1.0, disp, 1.0);
-    PBPhysParticleSetPos(that, v);
-    VecFree(&v);
-    VecFree(&disp);
-    // Update the speed
-    PBPhysParticleAddSpeed(that, 
-      PBPhysParticleSpeed(that), -dt * PBPhysParticleGetDrag(that));
-    PBPhysParticleAddSpeed(that, PBPhysParticleAccel(that), dt);
-    PBPhysParticleAddSpeed(that, PBPhysParticleSysAccel(that), dt);
+    // Update the position in place, component by component to avoid
+    // allocating a displacement vector
+    for (int iDim = PBPhysParticleGetDim(that); iDim--;)
+      VecSetAdd(that->_shape->_pos, iDim, 
+        PBPhysParticleGetNextDisplacementAt(that, dt, iDim));
+    // Update the speed, without going through the setters which would 
+    // wake up the particle and reset its idle time
+    VecOp(that->_speed, 1.0, 
+      that->_speed, -dt * PBPhysParticleGetDrag(that));
+    VecOp(that->_speed, 1.0, PBPhysParticleAccel(that), dt);
+    VecOp(that->_speed, 1.0, PBPhysParticleSysAccel(that), dt);
   }
 }
 
@@ -353,16 +867,80 @@ VecFloat* PBPhysParticleGetNextDisplacement(
     PBErrCatch(PBPhysErr);
   }
 #endif
-  VecFloat* v = VecGetOp(PBPhysParticleAccel(that), 1.0, 
-    PBPhysParticleSpeed(that), -1.0 * PBPhysParticleGetDrag(that));
-  VecOp(v, 1.0, PBPhysParticleSysAccel(that), 1.0);
-  VecOp(v, 0.5 * fsquare(dt), PBPhysParticleSpeed(that), dt);
+  VecFloat* v = VecFloatCreate(PBPhysParticleGetDim(that));
+  for (int iDim = PBPhysParticleGetDim(that); iDim--;)
+    VecSet(v, iDim, 
+      PBPhysParticleGetNextDisplacementAt(that, dt, iDim));
   return v;
 }
 
+// Return the 'iDim'-th component of the displacement of the particle 
+// from current position to the position after dt
+// Doesn't allocate memory
+float PBPhysParticleGetNextDisplacementAt(
+  const PBPhysParticle* const that, const float dt, const int iDim) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (iDim < 0 || iDim >= PBPhysParticleGetDim(that)) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'iDim' is invalid (0<=%d<%d)",
+      iDim, PBPhysParticleGetDim(that));
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Same operations as (a - drag * v + sysA) * dt^2 / 2 + v * dt on
+  // the whole vectors, to get the same rounding
+  float speed = VecGet(PBPhysParticleSpeed(that), iDim);
+  float disp = VecGet(PBPhysParticleAccel(that), iDim) + 
+    (float)(-1.0 * PBPhysParticleGetDrag(that)) * speed;
+  disp = disp + VecGet(PBPhysParticleSysAccel(that), iDim);
+  disp = (float)(0.5 * fsquare(dt)) * disp + dt * speed;
+  return disp;
+}
+
+// Copy the position of the center of the particle 'that' into 'pos' 
+// (array of dim values)
+// Doesn't allocate memory if the particle is a spheroid or its state 
+// is stored in a PBPhys
+void PBPhysParticleCopyPos(const PBPhysParticle* const that, 
+  float* const pos) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (pos == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'pos' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  int dim = PBPhysParticleGetDim(that);
+  if (that->_phys != NULL) {
+    for (int iDim = dim; iDim--;)
+      pos[iDim] = PBPhysSoAGetCenter(that->_phys->_soa, that->_iSoA, 
+        iDim);
+  } else if (PBPhysParticleGetShapeType(that) == ShapoidTypeSpheroid) {
+    // The center of a spheroid is its position
+    for (int iDim = dim; iDim--;)
+      pos[iDim] = VecGet(ShapoidPos(PBPhysParticleShape(that)), iDim);
+  } else {
+    VecFloat* center = PBPhysParticleGetPos(that);
+    for (int iDim = dim; iDim--;)
+      pos[iDim] = VecGet(center, iDim);
+    VecFree(&center);
+  }
+}
+
 // Correct the current speed of the two colliding particles 'that' and 
 // 'tho' under the hypothesis of elastic collision
 // Particles' mass must not be null
+// The particles which are not fixed are woken up
 void PBPhysParticleApplyElasticCollision(PBPhysParticle* const that, 
   PBPhysParticle* const tho) {
 #if BUILDMODE == 0
@@ -403,14 +981,16 @@ void PBPhysParticleApplyElasticCollision(PBPhysParticle* const that,
   float c = 2.0 * prod / 
     ((PBPhysParticleGetMass(that) + PBPhysParticleGetMass(tho)) * 
     fsquare(norm));
-  // Update the speed of 'that' if it's not fixed
-  if (!PBPhysParticleIsFixed(that))
+  // Update the speed of 'that' if it's not fixed, and wake it up
+  if (!PBPhysParticleIsFixed(that)) {
     PBPhysParticleAddSpeed(that, v, 
       -1.0 * c * PBPhysParticleGetMass(tho));
-  // Update the speed of 'tho' if it's not fixed
-  if (!PBPhysParticleIsFixed(tho))
+  }
+  // Update the speed of 'tho' if it's not fixed, and wake it up
+  if (!PBPhysParticleIsFixed(tho)) {
     PBPhysParticleAddSpeed(tho, v, 
       c * PBPhysParticleGetMass(that));
+  }
   // Free memory
   VecFree(&posA);
   VecFree(&posB);
@@ -418,6 +998,38 @@ void PBPhysParticleApplyElasticCollision(PBPhysParticle* const that,
   VecFree(&w);
 }
 
+// Correct the current speed of the colliding particles in the set 
+// 'contacts' under the hypothesis of elastic collision
+// The set contains pairs of colliding particles as consecutive 
+// elements, the collisions are applied in the order of the set
+// Particles' mass must not be null
+void PBPhysParticleApplyElasticCollisions(
+  GSetPBPhysParticle* const contacts) {
+#if BUILDMODE == 0
+  if (contacts == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'contacts' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (GSetNbElem(contacts) % 2 != 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, 
+      "'contacts' has an odd number of elements (%ld)", 
+      GSetNbElem(contacts));
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (GSetNbElem(contacts) == 0)
+    return;
+  GSetIterForward iter = GSetIterForwardCreateStatic(contacts);
+  do {
+    PBPhysParticle* partA = GSetIterGet(&iter);
+    GSetIterStep(&iter);
+    PBPhysParticle* partB = GSetIterGet(&iter);
+    PBPhysParticleApplyElasticCollision(partA, partB);
+  } while (GSetIterStep(&iter));
+}
+
 // Return the coefficients of the polynom describing the square of the 
 // distance between particles 'that' and 'tho'
 // Return a vector such as dist^2(t)=v[0]+v[1]t+v[2]t^2
@@ -444,63 +1056,108 @@ VecFloat3D PBPhysParticleGetDistPoly(const PBPhysParticle* const that,
   return ret;
 }
 
-// ------------ PBPhys
-
-// ================ Functions declaration ====================
-
-// Calculate the system acceleration of the particle 'part' in the 
-// PBPhys 'that'
-void PBPhysUpdateSysAccel(const PBPhys* const that, 
-  PBPhysParticle* const part);
+// Write the indentation of the depth 'depth' of a JSON text on the 
+// stream 'stream', nothing if 'compact' equals true
+void PBPhysJSONWriteIndent(FILE* const stream, const int depth, 
+  const bool compact) {
+#if BUILDMODE == 0
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (!compact)
+    fprintf(stream, "%*s", 2 * depth, "");
+}
 
-// Return the time to collision between two particles of radius 'rA' 
-// and 'rB' and the polynom of the square distance between particles 
-// over time 'distPoly'
-float PBPhysGetTimeToHit(float rA, float rB, VecFloat3D* distPoly);
+// Write the label 'lbl' of a property of the JSON object at depth 
+// 'depth' on the stream 'stream'
+void PBPhysJSONWriteLbl(FILE* const stream, const char* const lbl, 
+  const int depth, const bool compact) {
+#if BUILDMODE == 0
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (lbl == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'lbl' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  PBPhysJSONWriteIndent(stream, depth + 1, compact);
+  fprintf(stream, "\"%s\":", lbl);
+}
 
-// ================ Functions implementation ====================
+// Write the property 'lbl' with value 'val' of the JSON object at 
+// depth 'depth' on the stream 'stream', followed by the separator with 
+// the next property if 'last' equals false
+void PBPhysJSONWriteProp(FILE* const stream, const char* const lbl, 
+  const char* const val, const int depth, const bool last, 
+  const bool compact) {
+#if BUILDMODE == 0
+  if (val == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'val' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  PBPhysJSONWriteLbl(stream, lbl, depth, compact);
+  fprintf(stream, "\"%s\"", val);
+  PBPhysJSONWriteEndProp(stream, last, compact);
+}
 
-// Create a new PBPhys for space dimension 'dim'
-// Default values: _deltaT = 0.01, _downGravity = 0.0, _gravity = 0.0,
-// _curTime = 0.0
-PBPhys* PBPhysCreate(const int dim) {
+// Write the end of a property on the stream 'stream', with the 
+// separator with the next property if 'last' equals false
+void PBPhysJSONWriteEndProp(FILE* const stream, const bool last, 
+  const bool compact) {
 #if BUILDMODE == 0
-  if (dim <= 0) {
-    PBPhysErr->_type = PBErrTypeInvalidArg;
-    sprintf(PBPhysErr->_msg, "'dim' is invalid (0<%d)", dim);
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
     PBErrCatch(PBPhysErr);
   }
 #endif
-  // Allocate memory
-  PBPhys* that = PBErrMalloc(PBPhysErr, sizeof(PBPhys));
-  // Set properties
-  *(int*)&(that->_dim) = dim;
-  that->_particles = GSetPBPhysParticleCreateStatic();
-  that->_deltaT = PBPHYS_DELTAT;
-  that->_downGravity = 0.0; 
-  that->_gravity = false;
-  that->_curTime = 0.0;
-  // Return the new PBPhys
-  return that;
+  if (!last)
+    fprintf(stream, ",");
+  if (!compact)
+    fprintf(stream, "\n");
 }
 
-// Free memory used by the PBPhys 'that'
-void PBPhysFree(PBPhys** that) {
-  // Check argument
-  if (that == NULL || *that == NULL)
-    // Nothing to do
-    return;
-  // Free memory
-  while (PBPhysGetNbParticle(*that) > 0) {
-    PBPhysParticle* particle = GSetPop(PBPhysParticles(*that));
-    PBPhysParticleFree(&particle);
+// Write the JSON encoding of the vector 'that' as an object at depth 
+// 'depth' on the stream 'stream'
+void PBPhysJSONWriteVec(const VecFloat* const that, FILE* const stream, 
+  const int depth, const bool compact) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
   }
-  free(*that);
-  *that = NULL;
+#endif
+  fprintf(stream, "{");
+  PBPhysJSONWriteEndProp(stream, true, compact);
+  char val[100];
+  sprintf(val, "%ld", (long)VecGetDim(that));
+  PBPhysJSONWriteProp(stream, "_dim", val, depth, false, compact);
+  PBPhysJSONWriteLbl(stream, "_val", depth, compact);
+  fprintf(stream, "[");
+  for (long iVal = 0; iVal < VecGetDim(that); ++iVal)
+    fprintf(stream, "%s\"%f\"", (iVal > 0 ? "," : ""), 
+      VecGet(that, iVal));
+  fprintf(stream, "]");
+  PBPhysJSONWriteEndProp(stream, true, compact);
+  PBPhysJSONWriteIndent(stream, depth, compact);
+  fprintf(stream, "}");
 }
 
-// Return a clone of the PBPhys 'that'
-PBPhys* PBPhysClone(const PBPhys* const that) {
+// Write the JSON encoding of the particle 'that' as an object at depth 
+// 'depth' on the stream 'stream', without creating the JSONNode
+// The text is the one JSONSave writes for PBPhysParticleEncodeAsJSON
+void PBPhysParticleJSONWrite(const PBPhysParticle* const that, 
+  FILE* const stream, const int depth, const bool compact) {
 #if BUILDMODE == 0
   if (that == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
@@ -508,342 +1165,7286 @@ PBPhys* PBPhysClone(const PBPhys* const that) {
     PBErrCatch(PBPhysErr);
   }
 #endif
-  // Declare the clone
-  PBPhys* clone = PBPhysCreate(PBPhysGetDim(that));
-  // Copy the properties
-  PBPhysSetGravity(clone, PBPhysGetGravity(that));
-  PBPhysSetCurTime(clone, PBPhysGetCurTime(that));
+  char val[100];
+  fprintf(stream, "{");
+  PBPhysJSONWriteEndProp(stream, true, compact);
+  sprintf(val, "%d", PBPhysParticleGetDim(that));
+  PBPhysJSONWriteProp(stream, "_dim", val, depth, false, compact);
+  sprintf(val, "%d", PBPhysParticleGetShapeType(that));
+  PBPhysJSONWriteProp(stream, "_type", val, depth, false, compact);
+  // Write the shape as ShapoidEncodeAsJSON encodes it
+  const Shapoid* shape = PBPhysParticleShape(that);
+  PBPhysJSONWriteLbl(stream, "_shape", depth, compact);
+  fprintf(stream, "{");
+  PBPhysJSONWriteEndProp(stream, true, compact);
+  sprintf(val, "%d", ShapoidGetDim(shape));
+  PBPhysJSONWriteProp(stream, "_dim", val, depth + 1, false, compact);
+  sprintf(val, "%d", ShapoidGetType(shape));
+  PBPhysJSONWriteProp(stream, "_type", val, depth + 1, false, compact);
+  PBPhysJSONWriteLbl(stream, "_pos", depth + 1, compact);
+  PBPhysJSONWriteVec(ShapoidPos(shape), stream, depth + 2, compact);
+  PBPhysJSONWriteEndProp(stream, false, compact);
+  PBPhysJSONWriteLbl(stream, "_axis", depth + 1, compact);
+  fprintf(stream, "[");
+  PBPhysJSONWriteEndProp(stream, true, compact);
+  for (int iAxis = 0; iAxis < ShapoidGetDim(shape); ++iAxis) {
+    PBPhysJSONWriteIndent(stream, depth + 3, compact);
+    PBPhysJSONWriteVec(ShapoidAxis(shape, iAxis), stream, depth + 3, 
+      compact);
+    PBPhysJSONWriteEndProp(stream, 
+      iAxis == ShapoidGetDim(shape) - 1, compact);
+  }
+  PBPhysJSONWriteIndent(stream, depth + 2, compact);
+  fprintf(stream, "]");
+  PBPhysJSONWriteEndProp(stream, true, compact);
+  PBPhysJSONWriteIndent(stream, depth + 1, compact);
+  fprintf(stream, "}");
+  PBPhysJSONWriteEndProp(stream, false, compact);
+  // Write the speed and acceleration
+  PBPhysJSONWriteLbl(stream, "_speed", depth, compact);
+  PBPhysJSONWriteVec(PBPhysParticleSpeed(that), stream, depth + 1, 
+    compact);
+  PBPhysJSONWriteEndProp(stream, false, compact);
+  PBPhysJSONWriteLbl(stream, "_accel", depth, compact);
+  PBPhysJSONWriteVec(PBPhysParticleAccel(that), stream, depth + 1, 
+    compact);
+  PBPhysJSONWriteEndProp(stream, false, compact);
+  sprintf(val, "%f", that->_mass);
+  PBPhysJSONWriteProp(stream, "_mass", val, depth, false, compact);
+  sprintf(val, "%f", that->_drag);
+  PBPhysJSONWriteProp(stream, "_drag", val, depth, false, compact);
+  sprintf(val, "%d", that->_fixed);
+  PBPhysJSONWriteProp(stream, "_fixed", val, depth, true, compact);
+  PBPhysJSONWriteIndent(stream, depth, compact);
+  fprintf(stream, "}");
+}
+
+// ------------ PBPhysSoA
+
+// ================ Functions declaration ====================
+
+// Return a copy of the array 'arr' of 'nb' elements of size 'size' into
+// a new array of 'capacity' elements, 'arr' is freed
+void* PBPhysSoAGrowArr(void* const arr, const size_t size,
+  const long nb, const long capacity);
+
+// Copy the vector '*vec' into the 'iPart'-th record of the array of
+// records 'arr' of the PBPhysSoA 'that', free '*vec' and replace it
+// by a view on the record
+void PBPhysSoAMoveIn(PBPhysSoA* const that, char* const arr,
+  const long iPart, VecFloat** const vec);
+
+// Replace the view '*vec' on a record by a copy of the record
+void PBPhysSoAMoveOut(VecFloat** const vec);
+
+// Point the vectors of the 'iPart'-th particle of the PBPhysSoA 'that'
+// to their records
+void PBPhysSoAUpdateViews(const PBPhysSoA* const that,
+  const long iPart);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysSoA for particles of dimension 'dim'
+PBPhysSoA* PBPhysSoACreate(const int dim) {
+#if BUILDMODE == 0
+  if (dim <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'dim' is invalid (0<%d)", dim);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate memory
+  PBPhysSoA* that = PBErrMalloc(PBPhysErr, sizeof(PBPhysSoA));
+  // Set properties
+  that->_dim = dim;
+  that->_nb = 0;
+  that->_capacity = 0;
+  // The size of a record is rounded up to keep the records aligned
+  // on the alignment of VecFloat
+  size_t size = sizeof(VecFloat) + sizeof(float) * dim;
+  that->_stride =
+    (size + sizeof(long) - 1) / sizeof(long) * sizeof(long);
+  that->_pos = NULL;
+  that->_speed = NULL;
+  that->_accel = NULL;
+  that->_sysAccel = NULL;
+  that->_centerOffset = NULL;
+  that->_mass = NULL;
+  that->_drag = NULL;
+  that->_radius = NULL;
+  that->_fixed = NULL;
+  that->_particles = NULL;
+  // Return the new PBPhysSoA
+  return that;
+}
+
+// Free the memory used by the PBPhysSoA 'that'
+// The particles stored in 'that' get back the ownership of their state
+void PBPhysSoAFree(PBPhysSoA** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Give back their state to the particles
+  while ((*that)->_nb > 0)
+    PBPhysSoADetach(*that, (*that)->_particles[(*that)->_nb - 1]);
+  // Free memory
+  free((*that)->_pos);
+  free((*that)->_speed);
+  free((*that)->_accel);
+  free((*that)->_sysAccel);
+  free((*that)->_centerOffset);
+  free((*that)->_mass);
+  free((*that)->_drag);
+  free((*that)->_radius);
+  free((*that)->_fixed);
+  free((*that)->_particles);
+  free(*that);
+  *that = NULL;
+}
+
+// Return a copy of the array 'arr' of 'nb' elements of size 'size' into
+// a new array of 'capacity' elements, 'arr' is freed
+void* PBPhysSoAGrowArr(void* const arr, const size_t size,
+  const long nb, const long capacity) {
+  void* grown = PBErrMalloc(PBPhysErr, size * capacity);
+  PBPHYS_STATS_ALLOC(1);
+  if (nb > 0)
+    memcpy(grown, arr, size * nb);
+  free(arr);
+  return grown;
+}
+
+// Ensure the PBPhysSoA 'that' can hold 'capacity' particles without
+// reallocation
+void PBPhysSoAReserve(PBPhysSoA* const that, const long capacity) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // If the arrays are already large enough there is nothing to do
+  if (capacity <= that->_capacity)
+    return;
+  that->_capacity = capacity;
+  // Grow the arrays of records
+  char** arrs[4] =
+    {&(that->_pos), &(that->_speed), &(that->_accel),
+    &(that->_sysAccel)};
+  VecFloat* header = VecFloatCreate(that->_dim);
+  for (int iArr = 4; iArr--;) {
+    *(arrs[iArr]) = PBPhysSoAGrowArr(*(arrs[iArr]), that->_stride,
+      that->_nb, capacity);
+    // Set the header of the new records
+    for (long iPart = that->_nb; iPart < capacity; ++iPart)
+      memcpy(PBPhysSoAVec(that, *(arrs[iArr]), iPart), header,
+        sizeof(VecFloat));
+  }
+  VecFree(&header);
+  // Grow the other arrays
+  that->_centerOffset = PBPhysSoAGrowArr(that->_centerOffset,
+    sizeof(float) * that->_dim, that->_nb, capacity);
+  that->_mass = PBPhysSoAGrowArr(that->_mass, sizeof(float),
+    that->_nb, capacity);
+  that->_drag = PBPhysSoAGrowArr(that->_drag, sizeof(float),
+    that->_nb, capacity);
+  that->_radius = PBPhysSoAGrowArr(that->_radius, sizeof(float),
+    that->_nb, capacity);
+  that->_fixed = PBPhysSoAGrowArr(that->_fixed, sizeof(bool),
+    that->_nb, capacity);
+  that->_particles = PBPhysSoAGrowArr(that->_particles,
+    sizeof(PBPhysParticle*), that->_nb, capacity);
+  // Point the views of the particles to the new arrays
+  for (long iPart = that->_nb; iPart--;)
+    PBPhysSoAUpdateViews(that, iPart);
+}
+
+// Copy the vector '*vec' into the 'iPart'-th record of the array of
+// records 'arr' of the PBPhysSoA 'that', free '*vec' and replace it
+// by a view on the record
+void PBPhysSoAMoveIn(PBPhysSoA* const that, char* const arr,
+  const long iPart, VecFloat** const vec) {
+  VecFloat* rec = PBPhysSoAVec(that, arr, iPart);
+  VecCopy(rec, *vec);
+  VecFree(vec);
+  *vec = rec;
+}
+
+// Replace the view '*vec' on a record by a copy of the record
+void PBPhysSoAMoveOut(VecFloat** const vec) {
+  *vec = VecClone(*vec);
+}
+
+// Point the vectors of the 'iPart'-th particle of the PBPhysSoA 'that'
+// to their records
+void PBPhysSoAUpdateViews(const PBPhysSoA* const that,
+  const long iPart) {
+  PBPhysParticle* part = that->_particles[iPart];
+  part->_shape->_pos = PBPhysSoAVec(that, that->_pos, iPart);
+  part->_speed = PBPhysSoAVec(that, that->_speed, iPart);
+  part->_accel = PBPhysSoAVec(that, that->_accel, iPart);
+  part->_sysAccel = PBPhysSoAVec(that, that->_sysAccel, iPart);
+}
+
+// Move the state of the particle 'part' into the arrays of the
+// PBPhysSoA 'that' of the PBPhys 'phys'
+void PBPhysSoAAttach(PBPhysSoA* const that, struct PBPhys* const phys,
+  PBPhysParticle* const part) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (phys == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'phys' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (part == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'part' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (PBPhysParticleGetDim(part) != that->_dim) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'part' 's dimension is invalid (%d=%d)",
+      PBPhysParticleGetDim(part), that->_dim);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // If the state of the particle is stored in another PBPhys, get
+  // it back first
+  if (part->_phys != NULL)
+    PBPhysSoADetach(part->_phys->_soa, part);
+  // Ensure there is room for the particle
+  if (that->_nb == that->_capacity)
+    PBPhysSoAReserve(that, (that->_capacity == 0 ?
+      PBPHYS_SOACAPACITY : 2 * that->_capacity));
+  // Add the particle at the end of the arrays
+  long iPart = that->_nb;
+  ++(that->_nb);
+  that->_particles[iPart] = part;
+  part->_phys = phys;
+  part->_iSoA = iPart;
+  // Move the vectors of the particle into the arrays
+  PBPhysSoAMoveIn(that, that->_pos, iPart, &(part->_shape->_pos));
+  PBPhysSoAMoveIn(that, that->_speed, iPart, &(part->_speed));
+  PBPhysSoAMoveIn(that, that->_accel, iPart, &(part->_accel));
+  PBPhysSoAMoveIn(that, that->_sysAccel, iPart, &(part->_sysAccel));
+  // Copy the scalar properties
+  that->_mass[iPart] = part->_mass;
+  that->_drag[iPart] = part->_drag;
+  that->_fixed[iPart] = part->_fixed;
+  PBPhysSoAUpdateShapeOf(that, iPart);
+}
+
+// Give back to the particle 'part' the ownership of its state stored
+// in the PBPhysSoA 'that'
+void PBPhysSoADetach(PBPhysSoA* const that, PBPhysParticle* const part) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (part == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'part' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (part->_iSoA < 0 || part->_iSoA >= that->_nb ||
+    that->_particles[part->_iSoA] != part) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'part' is not stored in 'that'");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  long iPart = part->_iSoA;
+  // Give back to the particle the ownership of its vectors
+  PBPhysSoAMoveOut(&(part->_shape->_pos));
+  PBPhysSoAMoveOut(&(part->_speed));
+  PBPhysSoAMoveOut(&(part->_accel));
+  PBPhysSoAMoveOut(&(part->_sysAccel));
+  part->_phys = NULL;
+  part->_iSoA = -1;
+  // Move the last particle into the freed slot to keep the arrays
+  // contiguous
+  long iLast = that->_nb - 1;
+  if (iPart != iLast) {
+    char* arrs[4] =
+      {that->_pos, that->_speed, that->_accel, that->_sysAccel};
+    for (int iArr = 4; iArr--;)
+      memcpy(arrs[iArr] + that->_stride * iPart,
+        arrs[iArr] + that->_stride * iLast, that->_stride);
+    memcpy(that->_centerOffset + that->_dim * iPart,
+      that->_centerOffset + that->_dim * iLast,
+      sizeof(float) * that->_dim);
+    that->_mass[iPart] = that->_mass[iLast];
+    that->_drag[iPart] = that->_drag[iLast];
+    that->_radius[iPart] = that->_radius[iLast];
+    that->_fixed[iPart] = that->_fixed[iLast];
+    that->_particles[iPart] = that->_particles[iLast];
+    that->_particles[iPart]->_iSoA = iPart;
+    PBPhysSoAUpdateViews(that, iPart);
+  }
+  --(that->_nb);
+}
+
+// Update the bounding radius and center offset of the 'iPart'-th
+// particle of the PBPhysSoA 'that' according to its current shape
+// It is called when the particle is attached and when its size is set
+void PBPhysSoAUpdateShapeOf(PBPhysSoA* const that, const long iPart) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (iPart < 0 || iPart >= that->_nb) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'iPart' is invalid (0<=%ld<%ld)", 
+      iPart, that->_nb);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  const PBPhysParticle* part = that->_particles[iPart];
+  that->_radius[iPart] =
+    ShapoidGetBoundingRadius(PBPhysParticleShape(part));
+  float* offset = that->_centerOffset + that->_dim * iPart;
+  // The center of a spheroid is its position
+  if (PBPhysParticleGetShapeType(part) == ShapoidTypeSpheroid) {
+    for (int iDim = that->_dim; iDim--;)
+      offset[iDim] = 0.0;
+  } else {
+    VecFloat* center = PBPhysParticleGetPos(part);
+    const VecFloat* pos = ShapoidPos(PBPhysParticleShape(part));
+    for (int iDim = that->_dim; iDim--;)
+      offset[iDim] = VecGet(center, iDim) - VecGet(pos, iDim);
+    VecFree(&center);
+  }
+}
+
+// ------------ PBPhysBHTree
+
+// ================ Functions declaration ====================
+
+// Add a leaf of center 'center' and half size 'halfSize' to the 
+// PBPhysBHTree 'that' and return its index
+long PBPhysBHTreeAddNode(PBPhysBHTree* const that, 
+  const float* const center, const float halfSize);
+
+// Split the leaf 'iNode' of the PBPhysBHTree 'that' into 2^dim leaves
+void PBPhysBHTreeSplit(PBPhysBHTree* const that, const long iNode);
+
+// Return the index (from 0 to 2^dim-1) of the child of the cell 
+// 'iNode' of the PBPhysBHTree 'that' containing the position 'pos'
+long PBPhysBHTreeGetChild(const PBPhysBHTree* const that, 
+  const long iNode, const float* const pos);
+
+// Insert the 'iBody'-th body in the PBPhysBHTree 'that'
+void PBPhysBHTreeInsert(PBPhysBHTree* const that, const long iBody);
+
+// Add the mass 'mass' at position 'pos' to the node 'iNode' of the 
+// PBPhysBHTree 'that'
+void PBPhysBHTreeAddMass(PBPhysBHTree* const that, const long iNode, 
+  const float* const pos, const float mass);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysBHTree for space dimension 'dim'
+PBPhysBHTree* PBPhysBHTreeCreate(const int dim) {
+#if BUILDMODE == 0
+  if (dim <= 0 || dim >= (int)(sizeof(long) * 8 - 1)) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'dim' is invalid (0<%d<%d)", dim,
+      (int)(sizeof(long) * 8 - 1));
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate memory
+  PBPhysBHTree* that = PBErrMalloc(PBPhysErr, sizeof(PBPhysBHTree));
+  PBPHYS_STATS_ALLOC(1);
+  // Set properties
+  that->_dim = dim;
+  that->_nbChild = 1L << dim;
+  that->_nbNode = 0;
+  that->_nodeCapacity = 0;
+  that->_cellCenter = NULL;
+  that->_halfSize = NULL;
+  that->_mass = NULL;
+  that->_com = NULL;
+  that->_firstChild = NULL;
+  that->_body = NULL;
+  that->_nbBody = 0;
+  that->_bodyCapacity = 0;
+  that->_bodyPos = NULL;
+  that->_bodyMass = NULL;
+  that->_force = NULL;
+  that->_stack = NULL;
+  that->_stackCapacity = 0;
+  that->_nbInteraction = 0;
+  // Return the new PBPhysBHTree
+  return that;
+}
+
+// Free the memory used by the PBPhysBHTree 'that'
+void PBPhysBHTreeFree(PBPhysBHTree** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Free memory
+  free((*that)->_cellCenter);
+  free((*that)->_halfSize);
+  free((*that)->_mass);
+  free((*that)->_com);
+  free((*that)->_firstChild);
+  free((*that)->_body);
+  free((*that)->_bodyPos);
+  free((*that)->_bodyMass);
+  free((*that)->_force);
+  free((*that)->_stack);
+  free(*that);
+  *that = NULL;
+}
+
+// Add a leaf of center 'center' and half size 'halfSize' to the 
+// PBPhysBHTree 'that' and return its index
+long PBPhysBHTreeAddNode(PBPhysBHTree* const that, 
+  const float* const center, const float halfSize) {
+  int dim = that->_dim;
+  // Ensure there is room for the node
+  if (that->_nbNode == that->_nodeCapacity) {
+    long capacity = (that->_nodeCapacity == 0 ? 
+      that->_nbChild + 1 : 2 * that->_nodeCapacity);
+    that->_cellCenter = PBPhysSoAGrowArr(that->_cellCenter, 
+      sizeof(float) * dim, that->_nbNode, capacity);
+    that->_halfSize = PBPhysSoAGrowArr(that->_halfSize, 
+      sizeof(float), that->_nbNode, capacity);
+    that->_mass = PBPhysSoAGrowArr(that->_mass, 
+      sizeof(float), that->_nbNode, capacity);
+    that->_com = PBPhysSoAGrowArr(that->_com, 
+      sizeof(float) * dim, that->_nbNode, capacity);
+    that->_firstChild = PBPhysSoAGrowArr(that->_firstChild, 
+      sizeof(long), that->_nbNode, capacity);
+    that->_body = PBPhysSoAGrowArr(that->_body, 
+      sizeof(long), that->_nbNode, capacity);
+    that->_nodeCapacity = capacity;
+  }
+  // Initialise the node as an empty leaf
+  long iNode = that->_nbNode;
+  ++(that->_nbNode);
+  for (int iDim = dim; iDim--;) {
+    that->_cellCenter[dim * iNode + iDim] = center[iDim];
+    that->_com[dim * iNode + iDim] = 0.0;
+  }
+  that->_halfSize[iNode] = halfSize;
+  that->_mass[iNode] = 0.0;
+  that->_firstChild[iNode] = -1;
+  that->_body[iNode] = -1;
+  // Return the index of the node
+  return iNode;
+}
+
+// Split the leaf 'iNode' of the PBPhysBHTree 'that' into 2^dim leaves
+void PBPhysBHTreeSplit(PBPhysBHTree* const that, const long iNode) {
+  int dim = that->_dim;
+  float halfSize = 0.5 * that->_halfSize[iNode];
+  // The children are added contiguously, the bit iDim of the index of 
+  // a child tells on which side of the cell center it is along iDim
+  // The arrays may be reallocated while adding children so the center 
+  // of the parent is read again for each child
+  for (long iChild = 0; iChild < that->_nbChild; ++iChild) {
+    float center[dim];
+    for (int iDim = dim; iDim--;)
+      center[iDim] = that->_cellCenter[dim * iNode + iDim] +
+        ((iChild >> iDim) & 1L ? halfSize : -halfSize);
+    long iNew = PBPhysBHTreeAddNode(that, center, halfSize);
+    if (iChild == 0)
+      that->_firstChild[iNode] = iNew;
+  }
+}
+
+// Return the index (from 0 to 2^dim-1) of the child of the cell 
+// 'iNode' of the PBPhysBHTree 'that' containing the position 'pos'
+long PBPhysBHTreeGetChild(const PBPhysBHTree* const that, 
+  const long iNode, const float* const pos) {
+  long iChild = 0;
+  for (int iDim = that->_dim; iDim--;)
+    if (pos[iDim] >= that->_cellCenter[that->_dim * iNode + iDim])
+      iChild |= 1L << iDim;
+  return iChild;
+}
+
+// Add the mass 'mass' at position 'pos' to the node 'iNode' of the 
+// PBPhysBHTree 'that'
+void PBPhysBHTreeAddMass(PBPhysBHTree* const that, const long iNode, 
+  const float* const pos, const float mass) {
+  that->_mass[iNode] += mass;
+  // The center of mass is accumulated as the weighted sum of the 
+  // positions and normalised once the tree is built
+  for (int iDim = that->_dim; iDim--;)
+    that->_com[that->_dim * iNode + iDim] += mass * pos[iDim];
+}
+
+// Insert the 'iBody'-th body in the PBPhysBHTree 'that'
+void PBPhysBHTreeInsert(PBPhysBHTree* const that, const long iBody) {
+  const float* pos = that->_bodyPos + that->_dim * iBody;
+  float mass = that->_bodyMass[iBody];
+  // Descend from the root to the leaf where to insert the body
+  long iNode = 0;
+  int depth = 0;
+  while (true) {
+    // If the node is a leaf
+    if (that->_firstChild[iNode] == -1) {
+      // If the leaf is empty, put the body in it
+      if (that->_body[iNode] == -1) {
+        that->_body[iNode] = iBody;
+        PBPhysBHTreeAddMass(that, iNode, pos, mass);
+        return;
+      }
+      // If the leaf can't be split anymore, merge the body with the 
+      // one(s) in it
+      if (depth == PBPHYS_BHMAXDEPTH) {
+        that->_body[iNode] = -2;
+        PBPhysBHTreeAddMass(that, iNode, pos, mass);
+        return;
+      }
+      // Split the leaf and move its body into the appropriate child
+      long iOld = that->_body[iNode];
+      that->_body[iNode] = -1;
+      PBPhysBHTreeSplit(that, iNode);
+      const float* posOld = that->_bodyPos + that->_dim * iOld;
+      long iChild = that->_firstChild[iNode] + 
+        PBPhysBHTreeGetChild(that, iNode, posOld);
+      that->_body[iChild] = iOld;
+      PBPhysBHTreeAddMass(that, iChild, posOld, that->_bodyMass[iOld]);
+    }
+    // Add the body to the cell and go down to the child containing it
+    PBPhysBHTreeAddMass(that, iNode, pos, mass);
+    iNode = that->_firstChild[iNode] + 
+      PBPhysBHTreeGetChild(that, iNode, pos);
+    ++depth;
+  }
+}
+
+// Set the bodies of the PBPhysBHTree 'that' to the 'nb' particles in 
+// the table 'parts' and build the tree
+void PBPhysBHTreeBuild(PBPhysBHTree* const that, 
+  PBPhysParticle** const parts, const long nb) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (parts == NULL && nb > 0) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'parts' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  int dim = that->_dim;
+  // Ensure there is room for the bodies
+  if (nb > that->_bodyCapacity) {
+    free(that->_bodyPos);
+    free(that->_bodyMass);
+    free(that->_force);
+    that->_bodyPos = PBErrMalloc(PBPhysErr, sizeof(float) * dim * nb);
+    that->_bodyMass = PBErrMalloc(PBPhysErr, sizeof(float) * nb);
+    that->_force = PBErrMalloc(PBPhysErr, sizeof(float) * dim * nb);
+    PBPHYS_STATS_ALLOC(3);
+    that->_bodyCapacity = nb;
+  }
+  that->_nbBody = nb;
+  that->_nbNode = 0;
+  if (nb == 0)
+    return;
+  // Copy the center and mass of the particles, and get their bounding 
+  // box
+  float min[dim];
+  float max[dim];
+  for (long iBody = 0; iBody < nb; ++iBody) {
+    const PBPhysParticle* part = parts[iBody];
+    float* pos = that->_bodyPos + dim * iBody;
+    PBPhysParticleCopyPos(part, pos);
+    that->_bodyMass[iBody] = PBPhysParticleGetMass(part);
+    for (int iDim = dim; iDim--;) {
+      if (iBody == 0 || pos[iDim] < min[iDim])
+        min[iDim] = pos[iDim];
+      if (iBody == 0 || pos[iDim] > max[iDim])
+        max[iDim] = pos[iDim];
+    }
+  }
+  // Create the root as the smallest cube containing the bodies
+  float center[dim];
+  float halfSize = 0.0;
+  for (int iDim = dim; iDim--;) {
+    center[iDim] = 0.5 * (min[iDim] + max[iDim]);
+    if (halfSize < 0.5 * (max[iDim] - min[iDim]))
+      halfSize = 0.5 * (max[iDim] - min[iDim]);
+  }
+  if (halfSize < PBMATH_EPSILON)
+    halfSize = 1.0;
+  (void)PBPhysBHTreeAddNode(that, center, halfSize);
+  // Insert the bodies, massless ones have no influence
+  for (long iBody = 0; iBody < nb; ++iBody)
+    if (fabs(that->_bodyMass[iBody]) > PBMATH_EPSILON)
+      PBPhysBHTreeInsert(that, iBody);
+  // Normalise the centers of mass
+  for (long iNode = that->_nbNode; iNode--;)
+    if (fabs(that->_mass[iNode]) > PBMATH_EPSILON)
+      for (int iDim = dim; iDim--;)
+        that->_com[dim * iNode + iDim] /= that->_mass[iNode];
+}
+
+// Calculate the gravity force applied on each body of the 
+// PBPhysBHTree 'that' for the gravity constant 'gravity' and the 
+// opening angle 'theta'
+// The tree must have been built
+void PBPhysBHTreeUpdateForce(PBPhysBHTree* const that, 
+  const float gravity, const float theta) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  int dim = that->_dim;
+  that->_nbInteraction = 0;
+  // Loop on bodies
+  for (long iBody = 0; iBody < that->_nbBody; ++iBody) {
+    const float* pos = that->_bodyPos + dim * iBody;
+    float* force = that->_force + dim * iBody;
+    for (int iDim = dim; iDim--;)
+      force[iDim] = 0.0;
+    // Massless bodies or empty tree are not subject to gravity
+    if (fabs(that->_bodyMass[iBody]) <= PBMATH_EPSILON ||
+      that->_nbNode == 0)
+      continue;
+    // Walk the tree from the root
+    long nbStack = 0;
+    if (that->_stackCapacity == 0) {
+      that->_stackCapacity = 
+        PBPHYS_BHMAXDEPTH * (that->_nbChild - 1) + 1;
+      that->_stack = 
+        PBErrMalloc(PBPhysErr, sizeof(long) * that->_stackCapacity);
+      PBPHYS_STATS_ALLOC(1);
+    }
+    that->_stack[nbStack++] = 0;
+    // Next node on the path from the root to the leaf of the body, the 
+    // same path as its insertion
+    long iPath = 0;
+    while (nbStack > 0) {
+      long iNode = that->_stack[--nbStack];
+      // Skip the empty cells and the body itself
+      if (fabs(that->_mass[iNode]) <= PBMATH_EPSILON ||
+        that->_body[iNode] == iBody)
+        continue;
+      // A cell containing the body is always opened, else the body 
+      // would be attracted by its own mass
+      if (iNode == iPath && that->_firstChild[iNode] != -1) {
+        for (long iChild = that->_nbChild; iChild--;)
+          that->_stack[nbStack++] = that->_firstChild[iNode] + iChild;
+        iPath = that->_firstChild[iNode] + 
+          PBPhysBHTreeGetChild(that, iNode, pos);
+        continue;
+      }
+      const float* com = that->_com + dim * iNode;
+      float dist = 0.0;
+      for (int iDim = dim; iDim--;)
+        dist += fsquare(com[iDim] - pos[iDim]);
+      dist = sqrt(dist);
+      // If the node is the leaf where the body has been merged with 
+      // others, exclude the body from the leaf: the center of mass of 
+      // the other bodies is in the same direction, farther by the 
+      // ratio of the mass of the leaf to the mass of the other bodies
+      float mass = that->_mass[iNode];
+      float distCom = dist;
+      if (iNode == iPath) {
+        float massOther = mass - that->_bodyMass[iBody];
+        if (fabs(massOther) <= PBMATH_EPSILON)
+          continue;
+        distCom = dist * mass / massOther;
+        mass = massOther;
+      }
+      // If the node is a cell too close to be approximated by its 
+      // center of mass, open it
+      if (that->_firstChild[iNode] != -1 &&
+        2.0 * that->_halfSize[iNode] >= theta * dist) {
+        for (long iChild = that->_nbChild; iChild--;)
+          that->_stack[nbStack++] = that->_firstChild[iNode] + iChild;
+        continue;
+      }
+      // Apply the attraction toward the center of mass of the node
+      ++(that->_nbInteraction);
+      if (fabs(dist) > PBMATH_EPSILON) {
+        float mag = gravity * that->_bodyMass[iBody] * mass / 
+          fsquare(distCom);
+        for (int iDim = dim; iDim--;)
+          force[iDim] += mag * (com[iDim] - pos[iDim]) / dist;
+      }
+    }
+  }
+}
+
+// ------------ PBPhysGrid
+
+// ================ Functions declaration ====================
+
+// Ensure the PBPhysGrid 'that' can hold the boxes of 'nb' particles 
+// and set its number of particles to 'nb'
+void PBPhysGridSetNbPart(PBPhysGrid* const that, const long nb);
+
+// Build the PBPhysGrid 'that' from its boxes
+void PBPhysGridBuild(PBPhysGrid* const that);
+
+// Add to the array of pairs '*pairs' of '*nbPair' pairs and capacity 
+// '*capacity' the pairs of particles whose boxes overlap in the 
+// PBPhysGrid 'that', except the pairs of particles whose flags in 
+// 'fixed' are both true
+// Each pair is added once, with the lowest index first
+void PBPhysGridGetPairs(const PBPhysGrid* const that, 
+  const bool* const fixed, long** const pairs, long* const nbPair, 
+  long* const capacity);
+
+// Return the bucket of the cell of coordinates 'cell' in the 
+// PBPhysGrid 'that'
+long PBPhysGridGetBucket(const PBPhysGrid* const that, 
+  const long* const cell);
+
+// Add the pair ('iPart', 'jPart') to the array of pairs '*pairs' of 
+// '*nbPair' pairs and capacity '*capacity'
+void PBPhysAddPair(long** const pairs, long* const nbPair, 
+  long* const capacity, const long iPart, const long jPart);
+
+// Comparison function to sort pairs of particles' index in 
+// lexicographic order with qsort
+int PBPhysComparePairs(const void* a, const void* b);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysGrid for space dimension 'dim'
+PBPhysGrid* PBPhysGridCreate(const int dim) {
+#if BUILDMODE == 0
+  if (dim <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'dim' is invalid (0<%d)", dim);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate memory
+  PBPhysGrid* that = PBErrMalloc(PBPhysErr, sizeof(PBPhysGrid));
+  PBPHYS_STATS_ALLOC(1);
+  // Set properties
+  that->_dim = dim;
+  that->_cellSize = 1.0;
+  that->_nbPart = 0;
+  that->_partCapacity = 0;
+  that->_boxMin = NULL;
+  that->_boxMax = NULL;
+  that->_nbEntry = 0;
+  that->_entryCapacity = 0;
+  that->_entryPart = NULL;
+  that->_entryCell = NULL;
+  that->_entryBucket = NULL;
+  that->_sortedPart = NULL;
+  that->_sortedCell = NULL;
+  that->_nbBucket = 0;
+  that->_bucketCapacity = 0;
+  that->_bucketStart = NULL;
+  // Return the new PBPhysGrid
+  return that;
+}
+
+// Free the memory used by the PBPhysGrid 'that'
+void PBPhysGridFree(PBPhysGrid** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Free memory
+  free((*that)->_boxMin);
+  free((*that)->_boxMax);
+  free((*that)->_entryPart);
+  free((*that)->_entryCell);
+  free((*that)->_entryBucket);
+  free((*that)->_sortedPart);
+  free((*that)->_sortedCell);
+  free((*that)->_bucketStart);
+  free(*that);
+  *that = NULL;
+}
+
+// Ensure the PBPhysGrid 'that' can hold the boxes of 'nb' particles 
+// and set its number of particles to 'nb'
+void PBPhysGridSetNbPart(PBPhysGrid* const that, const long nb) {
+  if (nb > that->_partCapacity) {
+    free(that->_boxMin);
+    free(that->_boxMax);
+    that->_boxMin = 
+      PBErrMalloc(PBPhysErr, sizeof(float) * that->_dim * nb);
+    that->_boxMax = 
+      PBErrMalloc(PBPhysErr, sizeof(float) * that->_dim * nb);
+    PBPHYS_STATS_ALLOC(2);
+    that->_partCapacity = nb;
+  }
+  that->_nbPart = nb;
+}
+
+// Return the bucket of the cell of coordinates 'cell' in the 
+// PBPhysGrid 'that'
+long PBPhysGridGetBucket(const PBPhysGrid* const that, 
+  const long* const cell) {
+  unsigned long hash = 0;
+  for (int iDim = that->_dim; iDim--;)
+    hash = (hash ^ (unsigned long)cell[iDim]) * 0x100000001b3UL + 
+      0x9e3779b97f4a7c15UL;
+  hash ^= hash >> 29;
+  return (long)(hash & (unsigned long)(that->_nbBucket - 1));
+}
+
+// Build the PBPhysGrid 'that' from its boxes
+void PBPhysGridBuild(PBPhysGrid* const that) {
+  int dim = that->_dim;
+  that->_nbEntry = 0;
+  if (that->_nbPart == 0)
+    return;
+  // The size of the cells is the size of the largest box, so that a 
+  // box overlaps at most 2 cells along each axis and 2^dim cells in 
+  // total
+  that->_cellSize = 0.0;
+  for (long iPart = that->_nbPart; iPart--;)
+    for (int iDim = dim; iDim--;) {
+      float size = that->_boxMax[dim * iPart + iDim] - 
+        that->_boxMin[dim * iPart + iDim];
+      if (size > that->_cellSize)
+        that->_cellSize = size;
+    }
+  // Enlarge the cells slightly to be robust to rounding errors
+  that->_cellSize *= 1.001;
+  if (that->_cellSize < PBMATH_EPSILON)
+    that->_cellSize = 1.0;
+  // Ensure there is room for the entries
+  long nbMaxEntry = that->_nbPart << dim;
+  if (nbMaxEntry > that->_entryCapacity) {
+    free(that->_entryPart);
+    free(that->_entryCell);
+    free(that->_entryBucket);
+    free(that->_sortedPart);
+    free(that->_sortedCell);
+    that->_entryPart = PBErrMalloc(PBPhysErr, sizeof(long) * nbMaxEntry);
+    that->_entryCell = 
+      PBErrMalloc(PBPhysErr, sizeof(long) * dim * nbMaxEntry);
+    that->_entryBucket = 
+      PBErrMalloc(PBPhysErr, sizeof(long) * nbMaxEntry);
+    that->_sortedPart = 
+      PBErrMalloc(PBPhysErr, sizeof(long) * nbMaxEntry);
+    that->_sortedCell = 
+      PBErrMalloc(PBPhysErr, sizeof(long) * dim * nbMaxEntry);
+    PBPHYS_STATS_ALLOC(5);
+    that->_entryCapacity = nbMaxEntry;
+  }
+  // Ensure there is room for the buckets, at least twice the number 
+  // of particles
+  that->_nbBucket = 1;
+  while (that->_nbBucket < 2 * that->_nbPart)
+    that->_nbBucket <<= 1;
+  if (that->_nbBucket + 1 > that->_bucketCapacity) {
+    free(that->_bucketStart);
+    that->_bucketStart = 
+      PBErrMalloc(PBPhysErr, sizeof(long) * (that->_nbBucket + 1));
+    PBPHYS_STATS_ALLOC(1);
+    that->_bucketCapacity = that->_nbBucket + 1;
+  }
+  // Insert the particles in the cells overlapped by their box
+  long lo[dim];
+  long hi[dim];
+  long cell[dim];
+  for (long iPart = 0; iPart < that->_nbPart; ++iPart) {
+    for (int iDim = dim; iDim--;) {
+      lo[iDim] = (long)floor(that->_boxMin[dim * iPart + iDim] / 
+        that->_cellSize);
+      hi[iDim] = (long)floor(that->_boxMax[dim * iPart + iDim] / 
+        that->_cellSize);
+      // Protect the arrays against rounding errors on large 
+      // coordinates
+      if (hi[iDim] > lo[iDim] + 1)
+        hi[iDim] = lo[iDim] + 1;
+      cell[iDim] = lo[iDim];
+    }
+    // Loop on the cells from lo to hi
+    bool flag = true;
+    while (flag) {
+      long iEntry = that->_nbEntry;
+      ++(that->_nbEntry);
+      that->_entryPart[iEntry] = iPart;
+      memcpy(that->_entryCell + dim * iEntry, cell, sizeof(long) * dim);
+      that->_entryBucket[iEntry] = PBPhysGridGetBucket(that, cell);
+      flag = false;
+      for (int iDim = 0; iDim < dim && !flag; ++iDim) {
+        if (cell[iDim] < hi[iDim]) {
+          ++(cell[iDim]);
+          flag = true;
+        } else {
+          cell[iDim] = lo[iDim];
+        }
+      }
+    }
+  }
+  // Sort the entries per bucket (counting sort)
+  for (long iBucket = that->_nbBucket + 1; iBucket--;)
+    that->_bucketStart[iBucket] = 0;
+  for (long iEntry = that->_nbEntry; iEntry--;)
+    ++(that->_bucketStart[that->_entryBucket[iEntry] + 1]);
+  for (long iBucket = 0; iBucket < that->_nbBucket; ++iBucket)
+    that->_bucketStart[iBucket + 1] += that->_bucketStart[iBucket];
+  // Entries are placed from the end of their bucket to keep the order 
+  // of insertion, which leaves in _bucketStart[iBucket + 1] the start 
+  // of the bucket iBucket
+  for (long iEntry = that->_nbEntry; iEntry--;) {
+    long iSorted = --(that->_bucketStart[that->_entryBucket[iEntry] + 1]);
+    that->_sortedPart[iSorted] = that->_entryPart[iEntry];
+    memcpy(that->_sortedCell + dim * iSorted, 
+      that->_entryCell + dim * iEntry, sizeof(long) * dim);
+  }
+  for (long iBucket = 0; iBucket < that->_nbBucket; ++iBucket)
+    that->_bucketStart[iBucket] = that->_bucketStart[iBucket + 1];
+  that->_bucketStart[that->_nbBucket] = that->_nbEntry;
+}
+
+// Add the pair ('iPart', 'jPart') to the array of pairs '*pairs' of 
+// '*nbPair' pairs and capacity '*capacity'
+void PBPhysAddPair(long** const pairs, long* const nbPair, 
+  long* const capacity, const long iPart, const long jPart) {
+  if (*nbPair == *capacity) {
+    long newCapacity = (*capacity == 0 ? 
+      PBPHYS_SOACAPACITY : 2 * *capacity);
+    *pairs = PBPhysSoAGrowArr(*pairs, sizeof(long) * 2, *nbPair, 
+      newCapacity);
+    *capacity = newCapacity;
+  }
+  (*pairs)[2 * *nbPair] = (iPart < jPart ? iPart : jPart);
+  (*pairs)[2 * *nbPair + 1] = (iPart < jPart ? jPart : iPart);
+  ++(*nbPair);
+}
+
+// Comparison function to sort pairs of particles' index in 
+// lexicographic order with qsort
+int PBPhysComparePairs(const void* a, const void* b) {
+  const long* pairA = (const long*)a;
+  const long* pairB = (const long*)b;
+  if (pairA[0] != pairB[0])
+    return (pairA[0] < pairB[0] ? -1 : 1);
+  if (pairA[1] != pairB[1])
+    return (pairA[1] < pairB[1] ? -1 : 1);
+  return 0;
+}
+
+// Add to the array of pairs '*pairs' of '*nbPair' pairs and capacity 
+// '*capacity' the pairs of particles whose boxes overlap in the 
+// PBPhysGrid 'that', except the pairs of particles whose flags in 
+// 'fixed' are both true
+// Each pair is added once, with the lowest index first
+void PBPhysGridGetPairs(const PBPhysGrid* const that, 
+  const bool* const fixed, long** const pairs, long* const nbPair, 
+  long* const capacity) {
+  int dim = that->_dim;
+  // Loop on buckets
+  for (long iBucket = 0; iBucket < that->_nbBucket; ++iBucket) {
+    long iEnd = that->_bucketStart[iBucket + 1];
+    // Loop on pairs of entries in the bucket
+    for (long iEntry = that->_bucketStart[iBucket]; iEntry < iEnd; 
+      ++iEntry) {
+      long iPart = that->_sortedPart[iEntry];
+      const long* cell = that->_sortedCell + dim * iEntry;
+      const float* minA = that->_boxMin + dim * iPart;
+      const float* maxA = that->_boxMax + dim * iPart;
+      for (long jEntry = iEntry + 1; jEntry < iEnd; ++jEntry) {
+        long jPart = that->_sortedPart[jEntry];
+        const float* minB = that->_boxMin + dim * jPart;
+        const float* maxB = that->_boxMax + dim * jPart;
+        // The pair is kept if the entries are in the same cell (not 
+        // just the same bucket), the boxes overlap, and this cell 
+        // is the one containing the lowest corner of the overlap, 
+        // to add each pair only once
+        bool keep = (iPart != jPart && 
+          !(fixed[iPart] && fixed[jPart]));
+        for (int iDim = dim; iDim-- && keep;) {
+          float lowest = (minA[iDim] > minB[iDim] ? 
+            minA[iDim] : minB[iDim]);
+          long cellLowest = (long)floor(lowest / that->_cellSize);
+          keep = (cell[iDim] == that->_sortedCell[dim * jEntry + iDim] &&
+            minA[iDim] <= maxB[iDim] && minB[iDim] <= maxA[iDim] &&
+            cell[iDim] == cellLowest);
+        }
+        if (keep)
+          PBPhysAddPair(pairs, nbPair, capacity, iPart, jPart);
+      }
+    }
+  }
+}
+
+// ------------ PBPhysSAP
+
+// ================ Functions declaration ====================
+
+// Ensure the PBPhysSAP 'that' can hold the boxes of 'nb' particles 
+// and set its number of particles to 'nb'
+// If the number of particles changes the order of the previous step 
+// is discarded
+void PBPhysSAPSetNbPart(PBPhysSAP* const that, const long nb);
+
+// Sort the particles of the PBPhysSAP 'that' according to its boxes
+void PBPhysSAPBuild(PBPhysSAP* const that);
+
+// Add to the array of pairs '*pairs' of '*nbPair' pairs and capacity 
+// '*capacity' the pairs of particles whose boxes overlap in the 
+// PBPhysSAP 'that', except the pairs of particles whose flags in 
+// 'fixed' are both true
+// Each pair is added once, with the lowest index first
+void PBPhysSAPGetPairs(const PBPhysSAP* const that, 
+  const bool* const fixed, long** const pairs, long* const nbPair, 
+  long* const capacity);
+
+// Comparison function to sort the PBPhysSAPEntry by lowest bound and 
+// index of particle with qsort
+int PBPhysSAPCompareEntries(const void* a, const void* b);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysSAP for space dimension 'dim'
+PBPhysSAP* PBPhysSAPCreate(const int dim) {
+#if BUILDMODE == 0
+  if (dim <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'dim' is invalid (0<%d)", dim);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate memory
+  PBPhysSAP* that = PBErrMalloc(PBPhysErr, sizeof(PBPhysSAP));
+  PBPHYS_STATS_ALLOC(1);
+  // Set properties
+  that->_dim = dim;
+  that->_nbPart = 0;
+  that->_partCapacity = 0;
+  that->_boxMin = NULL;
+  that->_boxMax = NULL;
+  that->_entries = NULL;
+  that->_axis = -1;
+  that->_nbSwap = -1;
+  // Return the new PBPhysSAP
+  return that;
+}
+
+// Free the memory used by the PBPhysSAP 'that'
+void PBPhysSAPFree(PBPhysSAP** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Free memory
+  free((*that)->_boxMin);
+  free((*that)->_boxMax);
+  free((*that)->_entries);
+  free(*that);
+  *that = NULL;
+}
+
+// Ensure the PBPhysSAP 'that' can hold the boxes of 'nb' particles 
+// and set its number of particles to 'nb'
+// If the number of particles changes the order of the previous step 
+// is discarded
+void PBPhysSAPSetNbPart(PBPhysSAP* const that, const long nb) {
+  if (nb > that->_partCapacity) {
+    free(that->_boxMin);
+    free(that->_boxMax);
+    free(that->_entries);
+    that->_boxMin = 
+      PBErrMalloc(PBPhysErr, sizeof(float) * that->_dim * nb);
+    that->_boxMax = 
+      PBErrMalloc(PBPhysErr, sizeof(float) * that->_dim * nb);
+    that->_entries = PBErrMalloc(PBPhysErr, sizeof(PBPhysSAPEntry) * nb);
+    PBPHYS_STATS_ALLOC(3);
+    that->_partCapacity = nb;
+  }
+  if (nb != that->_nbPart) {
+    for (long iPart = nb; iPart--;)
+      that->_entries[iPart]._part = iPart;
+    that->_axis = -1;
+  }
+  that->_nbPart = nb;
+}
+
+// Sort the particles of the PBPhysSAP 'that' according to its boxes
+void PBPhysSAPBuild(PBPhysSAP* const that) {
+  int dim = that->_dim;
+  long nbPart = that->_nbPart;
+  if (nbPart == 0)
+    return;
+  // Get the axis along which the centers of the boxes are the most 
+  // spread
+  int axis = 0;
+  double spread[dim];
+  for (int iDim = dim; iDim--;) {
+    double sum = 0.0;
+    double sumSq = 0.0;
+    for (long iPart = nbPart; iPart--;) {
+      double center = 0.5 * (that->_boxMin[dim * iPart + iDim] + 
+        that->_boxMax[dim * iPart + iDim]);
+      sum += center;
+      sumSq += center * center;
+    }
+    spread[iDim] = sumSq / (double)nbPart - 
+      (sum / (double)nbPart) * (sum / (double)nbPart);
+    if (spread[iDim] >= spread[axis])
+      axis = iDim;
+  }
+  // Keep the current axis, and the order of the previous step, unless 
+  // another axis is clearly better
+  if (that->_axis != -1 && 
+    spread[axis] <= PBPHYS_SAPAXISRATIO * spread[that->_axis])
+    axis = that->_axis;
+  // Update the lowest bounds of the particles
+  PBPhysSAPEntry* entries = that->_entries;
+  for (long iEntry = nbPart; iEntry--;)
+    entries[iEntry]._min = 
+      that->_boxMin[dim * entries[iEntry]._part + axis];
+  // If the axis has changed, fully sort the particles
+  if (axis != that->_axis) {
+    qsort(entries, nbPart, sizeof(PBPhysSAPEntry), 
+      PBPhysSAPCompareEntries);
+    that->_axis = axis;
+    that->_nbSwap = -1;
+  // Else update the order of the previous step with an insertion sort
+  } else {
+    that->_nbSwap = 0;
+    for (long iEntry = 1; iEntry < nbPart; ++iEntry) {
+      PBPhysSAPEntry entry = entries[iEntry];
+      long jEntry = iEntry;
+      while (jEntry > 0 && 
+        PBPhysSAPCompareEntries(entries + jEntry - 1, &entry) > 0) {
+        entries[jEntry] = entries[jEntry - 1];
+        --jEntry;
+      }
+      entries[jEntry] = entry;
+      that->_nbSwap += iEntry - jEntry;
+    }
+  }
+}
+
+// Add to the array of pairs '*pairs' of '*nbPair' pairs and capacity 
+// '*capacity' the pairs of particles whose boxes overlap in the 
+// PBPhysSAP 'that', except the pairs of particles whose flags in 
+// 'fixed' are both true
+// Each pair is added once, with the lowest index first
+void PBPhysSAPGetPairs(const PBPhysSAP* const that, 
+  const bool* const fixed, long** const pairs, long* const nbPair, 
+  long* const capacity) {
+  int dim = that->_dim;
+  const PBPhysSAPEntry* entries = that->_entries;
+  // Loop on the particles in the order of the axis
+  for (long iEntry = 0; iEntry < that->_nbPart; ++iEntry) {
+    long iPart = entries[iEntry]._part;
+    const float* minA = that->_boxMin + dim * iPart;
+    const float* maxA = that->_boxMax + dim * iPart;
+    float maxAxis = maxA[that->_axis];
+    // Loop on the following particles until their box starts after 
+    // the end of the box of the current one along the axis
+    for (long jEntry = iEntry + 1; jEntry < that->_nbPart && 
+      entries[jEntry]._min <= maxAxis; ++jEntry) {
+      long jPart = entries[jEntry]._part;
+      const float* minB = that->_boxMin + dim * jPart;
+      const float* maxB = that->_boxMax + dim * jPart;
+      // The boxes overlap along the axis, check the other axis, the 
+      // pairs of fixed particles are skipped
+      bool keep = !(fixed[iPart] && fixed[jPart]);
+      for (int iDim = dim; iDim-- && keep;)
+        keep = (minA[iDim] <= maxB[iDim] && minB[iDim] <= maxA[iDim]);
+      if (keep)
+        PBPhysAddPair(pairs, nbPair, capacity, iPart, jPart);
+    }
+  }
+}
+
+// Comparison function to sort the PBPhysSAPEntry by lowest bound and 
+// index of particle with qsort
+int PBPhysSAPCompareEntries(const void* a, const void* b) {
+  const PBPhysSAPEntry* entryA = (const PBPhysSAPEntry*)a;
+  const PBPhysSAPEntry* entryB = (const PBPhysSAPEntry*)b;
+  if (entryA->_min != entryB->_min)
+    return (entryA->_min < entryB->_min ? -1 : 1);
+  if (entryA->_part != entryB->_part)
+    return (entryA->_part < entryB->_part ? -1 : 1);
+  return 0;
+}
+
+// ------------ PBPhysBVH
+
+// ================ Functions declaration ====================
+
+// Initialise the empty PBPhysBVHTree 'that' for space dimension 'dim'
+void PBPhysBVHTreeInit(PBPhysBVHTree* const that, const int dim);
+
+// Free the memory used by the arrays of the PBPhysBVHTree 'that'
+void PBPhysBVHTreeFreeArr(PBPhysBVHTree* const that);
+
+// Remove all the nodes of the PBPhysBVHTree 'that', its arrays are 
+// kept
+void PBPhysBVHTreeClear(PBPhysBVHTree* const that);
+
+// Return the index of a new node of the PBPhysBVHTree 'that'
+// The arrays of nodes may be reallocated
+long PBPhysBVHTreeAllocNode(PBPhysBVHTree* const that);
+
+// Give back the 'iNode'-th node to the free nodes of the 
+// PBPhysBVHTree 'that'
+void PBPhysBVHTreeFreeNode(PBPhysBVHTree* const that, const long iNode);
+
+// Create in the PBPhysBVHTree 'that' a leaf for the 'iPart'-th 
+// particle, whose box is 'boxMin', 'boxMax' enlarged by 'margin' times 
+// its size, insert it in the tree and return its index
+long PBPhysBVHTreeAddLeaf(PBPhysBVHTree* const that, const long iPart, 
+  const float* const boxMin, const float* const boxMax, 
+  const float margin);
+
+// Set the box of the 'iNode'-th node of the PBPhysBVHTree 'that' to 
+// the box 'boxMin', 'boxMax' enlarged by 'margin' times its size
+void PBPhysBVHTreeSetBox(PBPhysBVHTree* const that, const long iNode, 
+  const float* const boxMin, const float* const boxMax, 
+  const float margin);
+
+// Insert the leaf 'iLeaf' in the PBPhysBVHTree 'that', next to the 
+// node whose union with the leaf has the lowest cost
+void PBPhysBVHTreeInsert(PBPhysBVHTree* const that, const long iLeaf);
+
+// Remove the leaf 'iLeaf' from the PBPhysBVHTree 'that', the leaf is 
+// not freed
+void PBPhysBVHTreeRemove(PBPhysBVHTree* const that, const long iLeaf);
+
+// Rotate the subtree of the 'iNode'-th node of the PBPhysBVHTree 'that' 
+// if its children's heights differ by more than one, and return the 
+// index of the node at the root of the subtree
+long PBPhysBVHTreeBalance(PBPhysBVHTree* const that, const long iNode);
+
+// Update the box and height of the 'iNode'-th node of the 
+// PBPhysBVHTree 'that' from its children
+void PBPhysBVHTreeRefit(PBPhysBVHTree* const that, const long iNode);
+
+// Return the sum of the sizes along each axis of the union of the box 
+// of the 'iNode'-th and 'jNode'-th nodes of the PBPhysBVHTree 'that'
+float PBPhysBVHTreeGetUnionCost(const PBPhysBVHTree* const that, 
+  const long iNode, const long jNode);
+
+// Return true if the boxes 'minA', 'maxA' and 'minB', 'maxB' in 
+// dimension 'dim' overlap, else false
+bool PBPhysBVHIsOverlap(const int dim, const float* const minA, 
+  const float* const maxA, const float* const minB, 
+  const float* const maxB);
+
+// Ensure the PBPhysBVH 'that' can hold the boxes of 'nb' particles 
+// and set its number of particles to 'nb'
+// If the number of particles changes the trees of the previous step 
+// are discarded
+void PBPhysBVHSetNbPart(PBPhysBVH* const that, const long nb);
+
+// Update the trees of the PBPhysBVH 'that' according to its boxes and 
+// the flags of its fixed particles
+void PBPhysBVHUpdate(PBPhysBVH* const that);
+
+// Add to the array of pairs '*pairs' of '*nbPair' pairs and capacity 
+// '*capacity' the pairs of particles whose boxes overlap in the 
+// PBPhysBVH 'that', except the pairs of fixed particles
+// Each pair is added once, with the lowest index first
+void PBPhysBVHGetPairs(PBPhysBVH* const that, 
+  long** const pairs, long* const nbPair, long* const capacity);
+
+// Add to the array of pairs '*pairs' of '*nbPair' pairs and capacity 
+// '*capacity' the pairs of particles of the PBPhysBVH 'that' made of a 
+// leaf of the tree 'treeA' and a leaf of the tree 'treeB' whose boxes 
+// overlap
+// If 'treeA' and 'treeB' are the same tree, each pair of its leaves is 
+// considered once
+void PBPhysBVHGetTreePairs(PBPhysBVH* const that, 
+  const PBPhysBVHTree* const treeA, const PBPhysBVHTree* const treeB, 
+  long** const pairs, long* const nbPair, long* const capacity);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysBVH for space dimension 'dim'
+PBPhysBVH* PBPhysBVHCreate(const int dim) {
+#if BUILDMODE == 0
+  if (dim <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'dim' is invalid (0<%d)", dim);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate memory
+  PBPhysBVH* that = PBErrMalloc(PBPhysErr, sizeof(PBPhysBVH));
+  PBPHYS_STATS_ALLOC(1);
+  // Set properties
+  that->_dim = dim;
+  that->_nbPart = 0;
+  that->_partCapacity = 0;
+  that->_boxMin = NULL;
+  that->_boxMax = NULL;
+  that->_fixed = NULL;
+  that->_leaf = NULL;
+  that->_inStatic = NULL;
+  PBPhysBVHTreeInit(&(that->_dynamic), dim);
+  PBPhysBVHTreeInit(&(that->_static), dim);
+  that->_stack = NULL;
+  that->_stackCapacity = 0;
+  that->_nbReinsert = 0;
+  that->_nbStaticBuild = 0;
+  // Return the new PBPhysBVH
+  return that;
+}
+
+// Free the memory used by the PBPhysBVH 'that'
+void PBPhysBVHFree(PBPhysBVH** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Free memory
+  free((*that)->_boxMin);
+  free((*that)->_boxMax);
+  free((*that)->_fixed);
+  free((*that)->_leaf);
+  free((*that)->_inStatic);
+  PBPhysBVHTreeFreeArr(&((*that)->_dynamic));
+  PBPhysBVHTreeFreeArr(&((*that)->_static));
+  free((*that)->_stack);
+  free(*that);
+  *that = NULL;
+}
+
+// Initialise the empty PBPhysBVHTree 'that' for space dimension 'dim'
+void PBPhysBVHTreeInit(PBPhysBVHTree* const that, const int dim) {
+  that->_dim = dim;
+  that->_root = -1;
+  that->_nodes = NULL;
+  that->_boxMin = NULL;
+  that->_boxMax = NULL;
+  that->_nbNode = 0;
+  that->_nodeCapacity = 0;
+  that->_free = -1;
+}
+
+// Free the memory used by the arrays of the PBPhysBVHTree 'that'
+void PBPhysBVHTreeFreeArr(PBPhysBVHTree* const that) {
+  free(that->_nodes);
+  free(that->_boxMin);
+  free(that->_boxMax);
+  PBPhysBVHTreeInit(that, that->_dim);
+}
+
+// Remove all the nodes of the PBPhysBVHTree 'that', its arrays are 
+// kept
+void PBPhysBVHTreeClear(PBPhysBVHTree* const that) {
+  that->_root = -1;
+  that->_nbNode = 0;
+  that->_free = -1;
+}
+
+// Return the index of a new node of the PBPhysBVHTree 'that'
+// The arrays of nodes may be reallocated
+long PBPhysBVHTreeAllocNode(PBPhysBVHTree* const that) {
+  // Reuse a free node if there is one
+  if (that->_free != -1) {
+    long iNode = that->_free;
+    that->_free = that->_nodes[iNode]._parent;
+    return iNode;
+  }
+  if (that->_nbNode == that->_nodeCapacity) {
+    long capacity = (that->_nodeCapacity == 0 ? 
+      PBPHYS_SOACAPACITY : 2 * that->_nodeCapacity);
+    that->_nodes = PBPhysSoAGrowArr(that->_nodes, 
+      sizeof(PBPhysBVHNode), that->_nbNode, capacity);
+    that->_boxMin = PBPhysSoAGrowArr(that->_boxMin, 
+      sizeof(float) * that->_dim, that->_nbNode, capacity);
+    that->_boxMax = PBPhysSoAGrowArr(that->_boxMax, 
+      sizeof(float) * that->_dim, that->_nbNode, capacity);
+    that->_nodeCapacity = capacity;
+  }
+  return (that->_nbNode)++;
+}
+
+// Give back the 'iNode'-th node to the free nodes of the 
+// PBPhysBVHTree 'that'
+void PBPhysBVHTreeFreeNode(PBPhysBVHTree* const that, 
+  const long iNode) {
+  that->_nodes[iNode]._parent = that->_free;
+  that->_nodes[iNode]._height = -1;
+  that->_free = iNode;
+}
+
+// Create in the PBPhysBVHTree 'that' a leaf for the 'iPart'-th 
+// particle, whose box is 'boxMin', 'boxMax' enlarged by 'margin' times 
+// its size, insert it in the tree and return its index
+long PBPhysBVHTreeAddLeaf(PBPhysBVHTree* const that, const long iPart, 
+  const float* const boxMin, const float* const boxMax, 
+  const float margin) {
+  long iLeaf = PBPhysBVHTreeAllocNode(that);
+  PBPhysBVHNode* leaf = that->_nodes + iLeaf;
+  leaf->_parent = -1;
+  leaf->_child[0] = -1;
+  leaf->_child[1] = -1;
+  leaf->_part = iPart;
+  leaf->_height = 0;
+  PBPhysBVHTreeSetBox(that, iLeaf, boxMin, boxMax, margin);
+  PBPhysBVHTreeInsert(that, iLeaf);
+  return iLeaf;
+}
+
+// Set the box of the 'iNode'-th node of the PBPhysBVHTree 'that' to 
+// the box 'boxMin', 'boxMax' enlarged by 'margin' times its size
+void PBPhysBVHTreeSetBox(PBPhysBVHTree* const that, const long iNode, 
+  const float* const boxMin, const float* const boxMax, 
+  const float margin) {
+  int dim = that->_dim;
+  // The margin is the same along all the axis, relative to the largest 
+  // size of the box, so that the large particles get a large margin 
+  // and the small ones a small margin
+  float size = 0.0;
+  for (int iDim = dim; iDim--;)
+    if (boxMax[iDim] - boxMin[iDim] > size)
+      size = boxMax[iDim] - boxMin[iDim];
+  for (int iDim = dim; iDim--;) {
+    that->_boxMin[dim * iNode + iDim] = boxMin[iDim] - margin * size;
+    that->_boxMax[dim * iNode + iDim] = boxMax[iDim] + margin * size;
+  }
+}
+
+// Return the sum of the sizes along each axis of the union of the box 
+// of the 'iNode'-th and 'jNode'-th nodes of the PBPhysBVHTree 'that'
+float PBPhysBVHTreeGetUnionCost(const PBPhysBVHTree* const that, 
+  const long iNode, const long jNode) {
+  int dim = that->_dim;
+  const float* minA = that->_boxMin + dim * iNode;
+  const float* maxA = that->_boxMax + dim * iNode;
+  const float* minB = that->_boxMin + dim * jNode;
+  const float* maxB = that->_boxMax + dim * jNode;
+  float cost = 0.0;
+  for (int iDim = dim; iDim--;)
+    cost += (maxA[iDim] > maxB[iDim] ? maxA[iDim] : maxB[iDim]) - 
+      (minA[iDim] < minB[iDim] ? minA[iDim] : minB[iDim]);
+  return cost;
+}
+
+// Insert the leaf 'iLeaf' in the PBPhysBVHTree 'that', next to the 
+// node whose union with the leaf has the lowest cost
+void PBPhysBVHTreeInsert(PBPhysBVHTree* const that, const long iLeaf) {
+  // If the tree is empty the leaf is the root
+  if (that->_root == -1) {
+    that->_root = iLeaf;
+    that->_nodes[iLeaf]._parent = -1;
+    return;
+  }
+  // Search the best sibling of the leaf, the cost of a node is the 
+  // size of its box and the nodes above it are enlarged by the leaf
+  long iSibling = that->_root;
+  while (that->_nodes[iSibling]._child[0] != -1) {
+    long iChild[2] = {that->_nodes[iSibling]._child[0], 
+      that->_nodes[iSibling]._child[1]};
+    float size = PBPhysBVHTreeGetUnionCost(that, iSibling, iSibling);
+    float combined = PBPhysBVHTreeGetUnionCost(that, iSibling, iLeaf);
+    // Cost of creating a new parent for this node and the leaf
+    float cost = 2.0 * combined;
+    // Cost of pushing the leaf further down the tree
+    float inheritance = 2.0 * (combined - size);
+    float costChild[2];
+    for (int i = 2; i--;) {
+      costChild[i] = 
+        PBPhysBVHTreeGetUnionCost(that, iChild[i], iLeaf) + inheritance;
+      if (that->_nodes[iChild[i]]._child[0] != -1)
+        costChild[i] -= 
+          PBPhysBVHTreeGetUnionCost(that, iChild[i], iChild[i]);
+    }
+    if (cost < costChild[0] && cost < costChild[1])
+      break;
+    iSibling = (costChild[0] < costChild[1] ? iChild[0] : iChild[1]);
+  }
+  // Create a new parent for the sibling and the leaf
+  long iOldParent = that->_nodes[iSibling]._parent;
+  long iParent = PBPhysBVHTreeAllocNode(that);
+  PBPhysBVHNode* parent = that->_nodes + iParent;
+  parent->_parent = iOldParent;
+  parent->_child[0] = iSibling;
+  parent->_child[1] = iLeaf;
+  parent->_part = -1;
+  PBPhysBVHTreeRefit(that, iParent);
+  if (iOldParent != -1) {
+    PBPhysBVHNode* oldParent = that->_nodes + iOldParent;
+    oldParent->_child[(oldParent->_child[0] == iSibling ? 0 : 1)] = 
+      iParent;
+  } else {
+    that->_root = iParent;
+  }
+  that->_nodes[iSibling]._parent = iParent;
+  that->_nodes[iLeaf]._parent = iParent;
+  // Walk back up the tree to balance and refit the ancestors
+  long iNode = that->_nodes[iLeaf]._parent;
+  while (iNode != -1) {
+    iNode = PBPhysBVHTreeBalance(that, iNode);
+    PBPhysBVHTreeRefit(that, iNode);
+    iNode = that->_nodes[iNode]._parent;
+  }
+}
+
+// Remove the leaf 'iLeaf' from the PBPhysBVHTree 'that', the leaf is 
+// not freed
+void PBPhysBVHTreeRemove(PBPhysBVHTree* const that, const long iLeaf) {
+  if (iLeaf == that->_root) {
+    that->_root = -1;
+    return;
+  }
+  // Replace the parent of the leaf by its sibling
+  long iParent = that->_nodes[iLeaf]._parent;
+  long iGrandParent = that->_nodes[iParent]._parent;
+  long iSibling = (that->_nodes[iParent]._child[0] == iLeaf ? 
+    that->_nodes[iParent]._child[1] : that->_nodes[iParent]._child[0]);
+  PBPhysBVHTreeFreeNode(that, iParent);
+  that->_nodes[iSibling]._parent = iGrandParent;
+  if (iGrandParent == -1) {
+    that->_root = iSibling;
+    return;
+  }
+  PBPhysBVHNode* grandParent = that->_nodes + iGrandParent;
+  grandParent->_child[(grandParent->_child[0] == iParent ? 0 : 1)] = 
+    iSibling;
+  // Walk back up the tree to balance and refit the ancestors
+  long iNode = iGrandParent;
+  while (iNode != -1) {
+    iNode = PBPhysBVHTreeBalance(that, iNode);
+    PBPhysBVHTreeRefit(that, iNode);
+    iNode = that->_nodes[iNode]._parent;
+  }
+}
+
+// Rotate the subtree of the 'iNode'-th node of the PBPhysBVHTree 'that' 
+// if its children's heights differ by more than one, and return the 
+// index of the node at the root of the subtree
+long PBPhysBVHTreeBalance(PBPhysBVHTree* const that, const long iNode) {
+  PBPhysBVHNode* nodes = that->_nodes;
+  PBPhysBVHNode* node = nodes + iNode;
+  if (node->_child[0] == -1 || node->_height < 2)
+    return iNode;
+  // Get the highest child, which becomes the root of the subtree
+  int iHigh = (nodes[node->_child[1]]._height > 
+    nodes[node->_child[0]]._height ? 1 : 0);
+  long iUp = node->_child[iHigh];
+  PBPhysBVHNode* up = nodes + iUp;
+  if (up->_height - nodes[node->_child[1 - iHigh]]._height <= 1)
+    return iNode;
+  // The node becomes the child of its highest child, which takes its 
+  // place in the tree
+  up->_parent = node->_parent;
+  node->_parent = iUp;
+  if (up->_parent != -1) {
+    PBPhysBVHNode* parent = nodes + up->_parent;
+    parent->_child[(parent->_child[0] == iNode ? 0 : 1)] = iUp;
+  } else {
+    that->_root = iUp;
+  }
+  // The highest grand child stays under the child, the other one 
+  // replaces the child under the node
+  int iKeep = (nodes[up->_child[1]]._height > 
+    nodes[up->_child[0]]._height ? 1 : 0);
+  long iMove = up->_child[1 - iKeep];
+  node->_child[iHigh] = iMove;
+  nodes[iMove]._parent = iNode;
+  up->_child[1 - iKeep] = iNode;
+  PBPhysBVHTreeRefit(that, iNode);
+  PBPhysBVHTreeRefit(that, iUp);
+  return iUp;
+}
+
+// Update the box and height of the 'iNode'-th node of the 
+// PBPhysBVHTree 'that' from its children
+void PBPhysBVHTreeRefit(PBPhysBVHTree* const that, const long iNode) {
+  int dim = that->_dim;
+  PBPhysBVHNode* node = that->_nodes + iNode;
+  long iA = node->_child[0];
+  long iB = node->_child[1];
+  int heightA = that->_nodes[iA]._height;
+  int heightB = that->_nodes[iB]._height;
+  node->_height = 1 + (heightA > heightB ? heightA : heightB);
+  for (int iDim = dim; iDim--;) {
+    float minA = that->_boxMin[dim * iA + iDim];
+    float minB = that->_boxMin[dim * iB + iDim];
+    float maxA = that->_boxMax[dim * iA + iDim];
+    float maxB = that->_boxMax[dim * iB + iDim];
+    that->_boxMin[dim * iNode + iDim] = (minA < minB ? minA : minB);
+    that->_boxMax[dim * iNode + iDim] = (maxA > maxB ? maxA : maxB);
+  }
+}
+
+// Return true if the boxes 'minA', 'maxA' and 'minB', 'maxB' in 
+// dimension 'dim' overlap, else false
+bool PBPhysBVHIsOverlap(const int dim, const float* const minA, 
+  const float* const maxA, const float* const minB, 
+  const float* const maxB) {
+  for (int iDim = dim; iDim--;)
+    if (minA[iDim] > maxB[iDim] || minB[iDim] > maxA[iDim])
+      return false;
+  return true;
+}
+
+// Ensure the PBPhysBVH 'that' can hold the boxes of 'nb' particles 
+// and set its number of particles to 'nb'
+// If the number of particles changes the trees of the previous step 
+// are discarded
+void PBPhysBVHSetNbPart(PBPhysBVH* const that, const long nb) {
+  if (nb > that->_partCapacity) {
+    free(that->_boxMin);
+    free(that->_boxMax);
+    free(that->_fixed);
+    free(that->_leaf);
+    free(that->_inStatic);
+    that->_boxMin = 
+      PBErrMalloc(PBPhysErr, sizeof(float) * that->_dim * nb);
+    that->_boxMax = 
+      PBErrMalloc(PBPhysErr, sizeof(float) * that->_dim * nb);
+    that->_fixed = PBErrMalloc(PBPhysErr, sizeof(bool) * nb);
+    that->_leaf = PBErrMalloc(PBPhysErr, sizeof(long) * nb);
+    that->_inStatic = PBErrMalloc(PBPhysErr, sizeof(bool) * nb);
+    PBPHYS_STATS_ALLOC(5);
+    that->_partCapacity = nb;
+  }
+  if (nb != that->_nbPart) {
+    PBPhysBVHTreeClear(&(that->_dynamic));
+    PBPhysBVHTreeClear(&(that->_static));
+    for (long iPart = nb; iPart--;) {
+      that->_leaf[iPart] = -1;
+      that->_inStatic[iPart] = false;
+    }
+  }
+  that->_nbPart = nb;
+}
+
+// Update the trees of the PBPhysBVH 'that' according to its boxes and 
+// the flags of its fixed particles
+void PBPhysBVHUpdate(PBPhysBVH* const that) {
+  int dim = that->_dim;
+  PBPhysBVHTree* tree = &(that->_dynamic);
+  bool rebuild = false;
+  that->_nbReinsert = 0;
+  for (long iPart = 0; iPart < that->_nbPart; ++iPart) {
+    const float* boxMin = that->_boxMin + dim * iPart;
+    const float* boxMax = that->_boxMax + dim * iPart;
+    long iLeaf = that->_leaf[iPart];
+    if (that->_fixed[iPart]) {
+      // If the particle has become fixed, remove it from the dynamic 
+      // tree
+      if (!that->_inStatic[iPart] && iLeaf != -1) {
+        PBPhysBVHTreeRemove(tree, iLeaf);
+        PBPhysBVHTreeFreeNode(tree, iLeaf);
+        that->_leaf[iPart] = -1;
+      }
+      // The static tree is rebuilt if the particle has become fixed or 
+      // its box has changed
+      if (!that->_inStatic[iPart] || 
+        memcmp(that->_static._boxMin + dim * iLeaf, boxMin, 
+        sizeof(float) * dim) != 0 || 
+        memcmp(that->_static._boxMax + dim * iLeaf, boxMax, 
+        sizeof(float) * dim) != 0)
+        rebuild = true;
+    } else {
+      // If the particle is not fixed anymore, the static tree is 
+      // rebuilt without it
+      if (that->_inStatic[iPart]) {
+        rebuild = true;
+        that->_inStatic[iPart] = false;
+        iLeaf = -1;
+      }
+      // Insert the particle if it's not in the dynamic tree yet, or 
+      // again if it has left its enlarged box
+      if (iLeaf == -1) {
+        that->_leaf[iPart] = PBPhysBVHTreeAddLeaf(tree, iPart, 
+          boxMin, boxMax, PBPHYS_BVHMARGIN);
+        ++(that->_nbReinsert);
+      } else if (!PBPhysBVHIsOverlap(dim, boxMin, boxMin, 
+        tree->_boxMin + dim * iLeaf, tree->_boxMax + dim * iLeaf) || 
+        !PBPhysBVHIsOverlap(dim, boxMax, boxMax, 
+        tree->_boxMin + dim * iLeaf, tree->_boxMax + dim * iLeaf)) {
+        PBPhysBVHTreeRemove(tree, iLeaf);
+        PBPhysBVHTreeSetBox(tree, iLeaf, boxMin, boxMax, 
+          PBPHYS_BVHMARGIN);
+        PBPhysBVHTreeInsert(tree, iLeaf);
+        ++(that->_nbReinsert);
+      }
+    }
+  }
+  // Rebuild the static tree with the exact boxes of the fixed particles
+  if (rebuild) {
+    PBPhysBVHTreeClear(&(that->_static));
+    for (long iPart = 0; iPart < that->_nbPart; ++iPart) {
+      if (that->_fixed[iPart]) {
+        that->_leaf[iPart] = PBPhysBVHTreeAddLeaf(&(that->_static), 
+          iPart, that->_boxMin + dim * iPart, 
+          that->_boxMax + dim * iPart, 0.0);
+        that->_inStatic[iPart] = true;
+      }
+    }
+    ++(that->_nbStaticBuild);
+  }
+}
+
+// Add to the array of pairs '*pairs' of '*nbPair' pairs and capacity 
+// '*capacity' the pairs of particles whose boxes overlap in the 
+// PBPhysBVH 'that', except the pairs of fixed particles
+// Each pair is added once, with the lowest index first
+void PBPhysBVHGetPairs(PBPhysBVH* const that, 
+  long** const pairs, long* const nbPair, long* const capacity) {
+  // Pairs of moving particles
+  PBPhysBVHGetTreePairs(that, &(that->_dynamic), &(that->_dynamic), 
+    pairs, nbPair, capacity);
+  // Pairs of a moving particle and a fixed particle
+  PBPhysBVHGetTreePairs(that, &(that->_dynamic), &(that->_static), 
+    pairs, nbPair, capacity);
+}
+
+// Add to the array of pairs '*pairs' of '*nbPair' pairs and capacity 
+// '*capacity' the pairs of particles of the PBPhysBVH 'that' made of a 
+// leaf of the tree 'treeA' and a leaf of the tree 'treeB' whose boxes 
+// overlap
+// If 'treeA' and 'treeB' are the same tree, each pair of its leaves is 
+// considered once
+void PBPhysBVHGetTreePairs(PBPhysBVH* const that, 
+  const PBPhysBVHTree* const treeA, const PBPhysBVHTree* const treeB, 
+  long** const pairs, long* const nbPair, long* const capacity) {
+  if (treeA->_root == -1 || treeB->_root == -1)
+    return;
+  int dim = that->_dim;
+  bool self = (treeA == treeB);
+  // The two trees are descended together from their roots, a pair of 
+  // nodes is pushed on the stack only if their boxes overlap, and in 
+  // the same tree a node is pushed with itself to get the pairs within 
+  // its subtree
+  if (that->_stackCapacity == 0) {
+    that->_stack = PBPhysSoAGrowArr(that->_stack, sizeof(long) * 2, 0, 
+      PBPHYS_SOACAPACITY);
+    that->_stackCapacity = PBPHYS_SOACAPACITY;
+  }
+  long nbStack = 0;
+  if (self ? treeA->_nodes[treeA->_root]._child[0] != -1 : 
+    PBPhysBVHIsOverlap(dim, 
+    treeA->_boxMin + dim * treeA->_root, 
+    treeA->_boxMax + dim * treeA->_root, 
+    treeB->_boxMin + dim * treeB->_root, 
+    treeB->_boxMax + dim * treeB->_root)) {
+    that->_stack[0] = treeA->_root;
+    that->_stack[1] = treeB->_root;
+    nbStack = 1;
+  }
+  while (nbStack > 0) {
+    // Ensure there is room for the children of the popped pair
+    if (nbStack + 2 > that->_stackCapacity) {
+      that->_stack = PBPhysSoAGrowArr(that->_stack, sizeof(long) * 2, 
+        nbStack, 2 * that->_stackCapacity);
+      that->_stackCapacity *= 2;
+    }
+    long* stack = that->_stack;
+    --nbStack;
+    long iNode = stack[2 * nbStack];
+    long jNode = stack[2 * nbStack + 1];
+    const PBPhysBVHNode* nodeA = treeA->_nodes + iNode;
+    const PBPhysBVHNode* nodeB = treeB->_nodes + jNode;
+    if (self && iNode == jNode) {
+      // Pairs within the subtree of the node, the node is not a leaf
+      long iChild = nodeA->_child[0];
+      long jChild = nodeA->_child[1];
+      if (treeA->_nodes[iChild]._child[0] != -1) {
+        stack[2 * nbStack] = iChild;
+        stack[2 * nbStack + 1] = iChild;
+        ++nbStack;
+      }
+      if (treeA->_nodes[jChild]._child[0] != -1) {
+        stack[2 * nbStack] = jChild;
+        stack[2 * nbStack + 1] = jChild;
+        ++nbStack;
+      }
+      if (PBPhysBVHIsOverlap(dim, 
+        treeA->_boxMin + dim * iChild, treeA->_boxMax + dim * iChild, 
+        treeA->_boxMin + dim * jChild, treeA->_boxMax + dim * jChild)) {
+        stack[2 * nbStack] = iChild;
+        stack[2 * nbStack + 1] = jChild;
+        ++nbStack;
+      }
+      continue;
+    }
+    bool leafA = (nodeA->_child[0] == -1);
+    bool leafB = (nodeB->_child[0] == -1);
+    if (leafA && leafB) {
+      // The boxes of the leaves may be enlarged, check the boxes of the 
+      // particles
+      long iPart = nodeA->_part;
+      long jPart = nodeB->_part;
+      if (PBPhysBVHIsOverlap(dim, 
+        that->_boxMin + dim * iPart, that->_boxMax + dim * iPart, 
+        that->_boxMin + dim * jPart, that->_boxMax + dim * jPart))
+        PBPhysAddPair(pairs, nbPair, capacity, iPart, jPart);
+    } else if (leafB || (!leafA && nodeA->_height >= nodeB->_height)) {
+      // Descend the highest subtree, with the children whose box 
+      // overlaps the box of the other node
+      for (int iChild = 2; iChild--;) {
+        long kNode = nodeA->_child[iChild];
+        if (PBPhysBVHIsOverlap(dim, 
+          treeA->_boxMin + dim * kNode, treeA->_boxMax + dim * kNode, 
+          treeB->_boxMin + dim * jNode, treeB->_boxMax + dim * jNode)) {
+          stack[2 * nbStack] = kNode;
+          stack[2 * nbStack + 1] = jNode;
+          ++nbStack;
+        }
+      }
+    } else {
+      for (int iChild = 2; iChild--;) {
+        long kNode = nodeB->_child[iChild];
+        if (PBPhysBVHIsOverlap(dim, 
+          treeA->_boxMin + dim * iNode, treeA->_boxMax + dim * iNode, 
+          treeB->_boxMin + dim * kNode, treeB->_boxMax + dim * kNode)) {
+          stack[2 * nbStack] = iNode;
+          stack[2 * nbStack + 1] = kNode;
+          ++nbStack;
+        }
+      }
+    }
+  }
+}
+
+// ------------ PBPhysVerlet
+
+// ================ Functions declaration ====================
+
+// Ensure the PBPhysVerlet 'that' can hold the state of 'nb' particles 
+// and set its number of particles to 'nb'
+void PBPhysVerletSetNbPart(PBPhysVerlet* const that, const long nb);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysVerlet for space dimension 'dim'
+PBPhysVerlet* PBPhysVerletCreate(const int dim) {
+#if BUILDMODE == 0
+  if (dim <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'dim' is invalid (0<%d)", dim);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate memory
+  PBPhysVerlet* that = PBErrMalloc(PBPhysErr, sizeof(PBPhysVerlet));
+  PBPHYS_STATS_ALLOC(1);
+  // Set properties
+  that->_dim = dim;
+  that->_nbPart = 0;
+  that->_partCapacity = 0;
+  that->_isBuilt = false;
+  that->_part = NULL;
+  that->_pos = NULL;
+  that->_radius = NULL;
+  that->_inactive = NULL;
+  that->_margin = NULL;
+  that->_grid = NULL;
+  that->_nbUpdate = 0;
+  that->_nbBuild = 0;
+  // Return the new PBPhysVerlet
+  return that;
+}
+
+// Free the memory used by the PBPhysVerlet 'that'
+void PBPhysVerletFree(PBPhysVerlet** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Free memory
+  free((*that)->_part);
+  free((*that)->_pos);
+  free((*that)->_radius);
+  free((*that)->_inactive);
+  free((*that)->_margin);
+  PBPhysGridFree(&((*that)->_grid));
+  free(*that);
+  *that = NULL;
+}
+
+// Ensure the PBPhysVerlet 'that' can hold the state of 'nb' particles 
+// and set its number of particles to 'nb'
+void PBPhysVerletSetNbPart(PBPhysVerlet* const that, const long nb) {
+  if (nb > that->_partCapacity) {
+    free(that->_part);
+    free(that->_pos);
+    free(that->_radius);
+    free(that->_inactive);
+    free(that->_margin);
+    that->_part = PBErrMalloc(PBPhysErr, sizeof(PBPhysParticle*) * nb);
+    that->_pos = PBErrMalloc(PBPhysErr, sizeof(float) * that->_dim * nb);
+    that->_radius = PBErrMalloc(PBPhysErr, sizeof(float) * nb);
+    that->_inactive = PBErrMalloc(PBPhysErr, sizeof(bool) * nb);
+    that->_margin = PBErrMalloc(PBPhysErr, sizeof(float) * nb);
+    PBPHYS_STATS_ALLOC(5);
+    that->_partCapacity = nb;
+  }
+  that->_nbPart = nb;
+}
+
+// ------------ PBPhysEventQueue
+
+// ================ Functions declaration ====================
+
+// Ensure the PBPhysEventQueue 'that' can hold the events of 'nb' 
+// particles and set its number of particles to 'nb'
+void PBPhysEventQueueSetNbPart(PBPhysEventQueue* const that, 
+  const long nb);
+
+// Return true if the next collision of the 'iPart'-th particle is 
+// before the one of the 'jPart'-th particle in the PBPhysEventQueue 
+// 'that', particles with same time are ordered by index
+bool PBPhysEventQueueIsBefore(const PBPhysEventQueue* const that, 
+  const long iPart, const long jPart);
+
+// Swap the 'iNode'-th and 'jNode'-th nodes of the heap of the 
+// PBPhysEventQueue 'that'
+void PBPhysEventQueueSwap(PBPhysEventQueue* const that, 
+  const long iNode, const long jNode);
+
+// Reset the heap of the PBPhysEventQueue 'that' with all its particles
+// The time of the particles must be all equal
+void PBPhysEventQueueInit(PBPhysEventQueue* const that);
+
+// Move the 'iPart'-th particle at its place in the heap of the 
+// PBPhysEventQueue 'that' after its time has changed
+void PBPhysEventQueueUpdate(PBPhysEventQueue* const that, 
+  const long iPart);
+
+// Set the neighbours of the particles of the PBPhysEventQueue 'that' 
+// to the 'nbPair' pairs of particles 'pairs'
+void PBPhysEventQueueSetNeighbours(PBPhysEventQueue* const that, 
+  const long* const pairs, const long nbPair);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysEventQueue for space dimension 'dim'
+PBPhysEventQueue* PBPhysEventQueueCreate(const int dim) {
+#if BUILDMODE == 0
+  if (dim <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'dim' is invalid (0<%d)", dim);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate memory
+  PBPhysEventQueue* that = 
+    PBErrMalloc(PBPhysErr, sizeof(PBPhysEventQueue));
+  PBPHYS_STATS_ALLOC(1);
+  // Set properties
+  that->_dim = dim;
+  that->_nbPart = 0;
+  that->_partCapacity = 0;
+  that->_time = NULL;
+  that->_partner = NULL;
+  that->_partnerCount = NULL;
+  that->_count = NULL;
+  that->_localTime = NULL;
+  that->_reachPos = NULL;
+  that->_reach = NULL;
+  that->_neighbourFirst = NULL;
+  that->_neighbour = NULL;
+  that->_neighbourCapacity = 0;
+  that->_heap = NULL;
+  that->_heapPos = NULL;
+  that->_nbCollision = 0;
+  that->_nbTest = 0;
+  that->_nbBuild = 0;
+  // Return the new PBPhysEventQueue
+  return that;
+}
+
+// Free the memory used by the PBPhysEventQueue 'that'
+void PBPhysEventQueueFree(PBPhysEventQueue** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Free memory
+  free((*that)->_time);
+  free((*that)->_partner);
+  free((*that)->_partnerCount);
+  free((*that)->_count);
+  free((*that)->_localTime);
+  free((*that)->_reachPos);
+  free((*that)->_reach);
+  free((*that)->_neighbourFirst);
+  free((*that)->_neighbour);
+  free((*that)->_heap);
+  free((*that)->_heapPos);
+  free(*that);
+  *that = NULL;
+}
+
+// Ensure the PBPhysEventQueue 'that' can hold the events of 'nb' 
+// particles and set its number of particles to 'nb'
+void PBPhysEventQueueSetNbPart(PBPhysEventQueue* const that, 
+  const long nb) {
+  if (nb > that->_partCapacity) {
+    free(that->_time);
+    free(that->_partner);
+    free(that->_partnerCount);
+    free(that->_count);
+    free(that->_localTime);
+    free(that->_reachPos);
+    free(that->_reach);
+    free(that->_neighbourFirst);
+    free(that->_heap);
+    free(that->_heapPos);
+    that->_time = PBErrMalloc(PBPhysErr, sizeof(float) * nb);
+    that->_partner = PBErrMalloc(PBPhysErr, sizeof(long) * nb);
+    that->_partnerCount = PBErrMalloc(PBPhysErr, sizeof(long) * nb);
+    that->_count = PBErrMalloc(PBPhysErr, sizeof(long) * nb);
+    that->_localTime = PBErrMalloc(PBPhysErr, sizeof(float) * nb);
+    that->_reachPos = 
+      PBErrMalloc(PBPhysErr, sizeof(float) * that->_dim * nb);
+    that->_reach = PBErrMalloc(PBPhysErr, sizeof(float) * nb);
+    that->_neighbourFirst = 
+      PBErrMalloc(PBPhysErr, sizeof(long) * (nb + 1));
+    that->_heap = PBErrMalloc(PBPhysErr, sizeof(long) * nb);
+    that->_heapPos = PBErrMalloc(PBPhysErr, sizeof(long) * nb);
+    PBPHYS_STATS_ALLOC(10);
+    that->_partCapacity = nb;
+  }
+  that->_nbPart = nb;
+}
+
+// Return true if the next collision of the 'iPart'-th particle is 
+// before the one of the 'jPart'-th particle in the PBPhysEventQueue 
+// 'that', particles with same time are ordered by index
+bool PBPhysEventQueueIsBefore(const PBPhysEventQueue* const that, 
+  const long iPart, const long jPart) {
+  return (that->_time[iPart] < that->_time[jPart] || 
+    (that->_time[iPart] == that->_time[jPart] && iPart < jPart));
+}
+
+// Swap the 'iNode'-th and 'jNode'-th nodes of the heap of the 
+// PBPhysEventQueue 'that'
+void PBPhysEventQueueSwap(PBPhysEventQueue* const that, 
+  const long iNode, const long jNode) {
+  long iPart = that->_heap[iNode];
+  that->_heap[iNode] = that->_heap[jNode];
+  that->_heap[jNode] = iPart;
+  that->_heapPos[that->_heap[iNode]] = iNode;
+  that->_heapPos[that->_heap[jNode]] = jNode;
+}
+
+// Reset the heap of the PBPhysEventQueue 'that' with all its particles
+// The time of the particles must be all equal
+void PBPhysEventQueueInit(PBPhysEventQueue* const that) {
+  // With equal times the particles in order of index form a valid heap
+  for (long iPart = that->_nbPart; iPart--;) {
+    that->_heap[iPart] = iPart;
+    that->_heapPos[iPart] = iPart;
+  }
+}
+
+// Move the 'iPart'-th particle at its place in the heap of the 
+// PBPhysEventQueue 'that' after its time has changed
+void PBPhysEventQueueUpdate(PBPhysEventQueue* const that, 
+  const long iPart) {
+  long iNode = that->_heapPos[iPart];
+  // Move up while the particle is before its parent
+  while (iNode > 0 && 
+    PBPhysEventQueueIsBefore(that, iPart, that->_heap[(iNode - 1) / 2])) {
+    PBPhysEventQueueSwap(that, iNode, (iNode - 1) / 2);
+    iNode = (iNode - 1) / 2;
+  }
+  // Move down while one of its children is before the particle
+  bool flag = true;
+  while (flag) {
+    long iFirst = iNode;
+    for (long iChild = 2 * iNode + 1; 
+      iChild <= 2 * iNode + 2 && iChild < that->_nbPart; ++iChild)
+      if (PBPhysEventQueueIsBefore(that, that->_heap[iChild], 
+        that->_heap[iFirst]))
+        iFirst = iChild;
+    if (iFirst != iNode) {
+      PBPhysEventQueueSwap(that, iNode, iFirst);
+      iNode = iFirst;
+    } else {
+      flag = false;
+    }
+  }
+}
+
+// Set the neighbours of the particles of the PBPhysEventQueue 'that' 
+// to the 'nbPair' pairs of particles 'pairs'
+void PBPhysEventQueueSetNeighbours(PBPhysEventQueue* const that, 
+  const long* const pairs, const long nbPair) {
+  // Ensure there is room for the neighbours, each pair gives one 
+  // neighbour to each of its particles
+  if (2 * nbPair > that->_neighbourCapacity) {
+    free(that->_neighbour);
+    that->_neighbour = PBErrMalloc(PBPhysErr, sizeof(long) * 2 * nbPair);
+    PBPHYS_STATS_ALLOC(1);
+    that->_neighbourCapacity = 2 * nbPair;
+  }
+  // Count the neighbours of each particle, then get the index of the 
+  // first one of each particle from the running sum of the counts
+  long* first = that->_neighbourFirst;
+  for (long iPart = that->_nbPart + 1; iPart--;)
+    first[iPart] = 0;
+  for (long iPair = 2 * nbPair; iPair--;)
+    ++(first[pairs[iPair] + 1]);
+  for (long iPart = 0; iPart < that->_nbPart; ++iPart)
+    first[iPart + 1] += first[iPart];
+  // Fill the neighbours, using the index of the first neighbour as 
+  // the insertion index and shifting it back afterward
+  for (long iPair = 0; iPair < nbPair; ++iPair) {
+    long iPart = pairs[2 * iPair];
+    long jPart = pairs[2 * iPair + 1];
+    that->_neighbour[(first[iPart])++] = jPart;
+    that->_neighbour[(first[jPart])++] = iPart;
+  }
+  for (long iPart = that->_nbPart; iPart > 0; --iPart)
+    first[iPart] = first[iPart - 1];
+  first[0] = 0;
+}
+
+// ------------ PBPhysThreadPool
+
+// ================ Functions declaration ====================
+
+// Main function of the worker threads of a PBPhysThreadPool, 'arg' is 
+// the PBPhysThreadPoolWorker of the thread
+void* PBPhysThreadPoolWork(void* arg);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysThreadPool of 'nbThread' threads, including the 
+// calling thread
+PBPhysThreadPool* PBPhysThreadPoolCreate(const int nbThread) {
+#if BUILDMODE == 0
+  if (nbThread <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'nbThread' is invalid (0<%d)", nbThread);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate memory
+  PBPhysThreadPool* that = 
+    PBErrMalloc(PBPhysErr, sizeof(PBPhysThreadPool));
+  // Set properties
+  that->_nbThread = nbThread;
+  that->_nbJob = 0;
+  that->_nbRunning = 0;
+  that->_stop = false;
+  that->_job = NULL;
+  that->_data = NULL;
+  pthread_mutex_init(&(that->_mutex), NULL);
+  pthread_cond_init(&(that->_condJob), NULL);
+  pthread_cond_init(&(that->_condDone), NULL);
+  that->_threads = NULL;
+  that->_workers = NULL;
+  // Start the workers
+  if (nbThread > 1) {
+    that->_threads = 
+      PBErrMalloc(PBPhysErr, sizeof(pthread_t) * (nbThread - 1));
+    that->_workers = PBErrMalloc(PBPhysErr, 
+      sizeof(PBPhysThreadPoolWorker) * (nbThread - 1));
+    for (int iThread = 1; iThread < nbThread; ++iThread) {
+      PBPhysThreadPoolWorker* worker = that->_workers + iThread - 1;
+      worker->_pool = that;
+      worker->_iThread = iThread;
+      if (pthread_create(that->_threads + iThread - 1, NULL, 
+        PBPhysThreadPoolWork, worker) != 0) {
+        PBPhysErr->_type = PBErrTypeOther;
+        sprintf(PBPhysErr->_msg, "Can't create the thread %d", iThread);
+        PBErrCatch(PBPhysErr);
+      }
+    }
+  }
+  // Return the new PBPhysThreadPool
+  return that;
+}
+
+// Free the memory used by the PBPhysThreadPool 'that' and stop its 
+// workers
+void PBPhysThreadPoolFree(PBPhysThreadPool** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Stop the workers and wait for them
+  pthread_mutex_lock(&((*that)->_mutex));
+  (*that)->_stop = true;
+  pthread_cond_broadcast(&((*that)->_condJob));
+  pthread_mutex_unlock(&((*that)->_mutex));
+  for (int iThread = 1; iThread < (*that)->_nbThread; ++iThread)
+    pthread_join((*that)->_threads[iThread - 1], NULL);
+  // Free memory
+  pthread_mutex_destroy(&((*that)->_mutex));
+  pthread_cond_destroy(&((*that)->_condJob));
+  pthread_cond_destroy(&((*that)->_condDone));
+  free((*that)->_threads);
+  free((*that)->_workers);
+  free(*that);
+  *that = NULL;
+}
+
+// Run the job 'job' with data 'data' on all the threads of the 
+// PBPhysThreadPool 'that' and wait for its completion
+void PBPhysThreadPoolRun(PBPhysThreadPool* const that, 
+  const PBPhysJob job, void* const data) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (job == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'job' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Submit the job to the workers
+  pthread_mutex_lock(&(that->_mutex));
+  that->_job = job;
+  that->_data = data;
+  that->_nbRunning = that->_nbThread - 1;
+  ++(that->_nbJob);
+  pthread_cond_broadcast(&(that->_condJob));
+  pthread_mutex_unlock(&(that->_mutex));
+  // Run the share of the calling thread
+  job(data, 0, that->_nbThread);
+  // Wait for the workers
+  pthread_mutex_lock(&(that->_mutex));
+  while (that->_nbRunning > 0)
+    pthread_cond_wait(&(that->_condDone), &(that->_mutex));
+  pthread_mutex_unlock(&(that->_mutex));
+}
+
+// Main function of the worker threads of a PBPhysThreadPool, 'arg' is 
+// the PBPhysThreadPoolWorker of the thread
+void* PBPhysThreadPoolWork(void* arg) {
+  PBPhysThreadPoolWorker* worker = arg;
+  PBPhysThreadPool* pool = worker->_pool;
+  // Number of jobs run by this worker, the pool had no job when the 
+  // worker has been created
+  unsigned long nbJob = 0;
+  pthread_mutex_lock(&(pool->_mutex));
+  while (true) {
+    // Wait for a new job
+    while (!pool->_stop && pool->_nbJob == nbJob)
+      pthread_cond_wait(&(pool->_condJob), &(pool->_mutex));
+    if (pool->_stop)
+      break;
+    nbJob = pool->_nbJob;
+    PBPhysJob job = pool->_job;
+    void* data = pool->_data;
+    // Run the job
+    pthread_mutex_unlock(&(pool->_mutex));
+    job(data, worker->_iThread, pool->_nbThread);
+    pthread_mutex_lock(&(pool->_mutex));
+    // Signal the completion of the job
+    --(pool->_nbRunning);
+    if (pool->_nbRunning == 0)
+      pthread_cond_signal(&(pool->_condDone));
+  }
+  pthread_mutex_unlock(&(pool->_mutex));
+  return NULL;
+}
+
+// ------------ PBPhysJSONReader
+
+// ================ Functions declaration ====================
+
+// Init the PBPhysJSONReader 'that' on the stream 'stream'
+void PBPhysJSONReaderInit(PBPhysJSONReader* const that, 
+  FILE* const stream);
+
+// Return the current token of the PBPhysJSONReader 'that', reading it 
+// from the stream if necessary
+int PBPhysJSONReaderPeek(PBPhysJSONReader* const that);
+
+// Consume the current token of the PBPhysJSONReader 'that'
+// Return true if it is 'tok', false else
+bool PBPhysJSONReaderEat(PBPhysJSONReader* const that, const int tok);
+
+// Read the label of the next property of the current object of the 
+// PBPhysJSONReader 'that' into 'lbl' of 'size' bytes, and the ':' 
+// following it, 'first' is true for the first property of the object
+// The label is truncated if it's longer than 'size'
+// Return false at the end of the object or on error, true else
+bool PBPhysJSONReaderNextLbl(PBPhysJSONReader* const that, 
+  char* const lbl, const size_t size, const bool first);
+
+// Move to the next element of the current array of the 
+// PBPhysJSONReader 'that', 'first' is true for the first element of the 
+// array
+// Return false at the end of the array or on error, true else
+bool PBPhysJSONReaderNextElem(PBPhysJSONReader* const that, 
+  const bool first);
+
+// Skip the current value of the PBPhysJSONReader 'that'
+// Return true if we could skip it, false else
+bool PBPhysJSONReaderSkip(PBPhysJSONReader* const that);
+
+// Read the current value of the PBPhysJSONReader 'that' as a long into 
+// 'val'
+// Return true if we could read it, false else
+bool PBPhysJSONReaderGetLong(PBPhysJSONReader* const that, 
+  long* const val);
+
+// Read the current value of the PBPhysJSONReader 'that' as a float into 
+// 'val'
+// Return true if we could read it, false else
+bool PBPhysJSONReaderGetFloat(PBPhysJSONReader* const that, 
+  float* const val);
+
+// Read the current value of the PBPhysJSONReader 'that', encoded as 
+// VecEncodeAsJSON, into the vector 'v' which must have the same 
+// dimension
+// Return true if we could read it, false else
+bool PBPhysJSONReaderGetVec(PBPhysJSONReader* const that, 
+  VecFloat* const v);
+
+// Read the current value of the PBPhysJSONReader 'that', encoded as 
+// ShapoidEncodeAsJSON, into the shape 'shape' which must have the same 
+// dimension and type, 'v' is a vector of the same dimension used as a 
+// scratch
+// Return true if we could read it, false else
+bool PBPhysJSONReaderGetShapoid(PBPhysJSONReader* const that, 
+  Shapoid* const shape, VecFloat* const v);
+
+// Read the current value of the PBPhysJSONReader 'that', encoded as 
+// PBPhysParticleEncodeAsJSON, into a new particle 'part' of dimension 
+// 'dim'
+// 'part' must be initialised to NULL and the particle created before a 
+// failure must be freed by the caller
+// Return true if we could read it, false else, in particular if the 
+// dimension of the particle is not 'dim' or its type of shape is 
+// invalid
+bool PBPhysJSONReaderGetParticle(PBPhysJSONReader* const that, 
+  PBPhysParticle** const part, const int dim);
+
+// ================ Functions implementation ====================
+
+// Init the PBPhysJSONReader 'that' on the stream 'stream'
+void PBPhysJSONReaderInit(PBPhysJSONReader* const that, 
+  FILE* const stream) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_stream = stream;
+  that->_tok = 0;
+  that->_str[0] = '\0';
+  that->_nbByte = 0;
+  that->_error = false;
+}
+
+// Return the current token of the PBPhysJSONReader 'that', reading it 
+// from the stream if necessary
+int PBPhysJSONReaderPeek(PBPhysJSONReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // If the current token has already been read, nothing to do
+  if (that->_tok != 0)
+    return that->_tok;
+  // Skip the white spaces
+  int c = getc(that->_stream);
+  while (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+    ++(that->_nbByte);
+    c = getc(that->_stream);
+  }
+  if (c == EOF) {
+    that->_tok = EOF;
+  } else if (strchr("{}[]:,", c) != NULL) {
+    ++(that->_nbByte);
+    that->_tok = c;
+  } else if (c == '"') {
+    ++(that->_nbByte);
+    // Read the string up to the closing quote, a backslash escapes the 
+    // following character
+    int len = 0;
+    c = getc(that->_stream);
+    while (c != '"' && c != EOF && len < PBPHYS_JSONSTRLEN - 1) {
+      ++(that->_nbByte);
+      if (c == '\\') {
+        c = getc(that->_stream);
+        if (c == EOF)
+          break;
+        ++(that->_nbByte);
+      }
+      that->_str[len++] = c;
+      c = getc(that->_stream);
+    }
+    that->_str[len] = '\0';
+    if (c == '"') {
+      ++(that->_nbByte);
+      that->_tok = '"';
+    } else {
+      that->_error = true;
+      that->_tok = EOF;
+    }
+  } else {
+    that->_error = true;
+    that->_tok = EOF;
+  }
+  return that->_tok;
+}
+
+// Consume the current token of the PBPhysJSONReader 'that'
+// Return true if it is 'tok', false else
+bool PBPhysJSONReaderEat(PBPhysJSONReader* const that, const int tok) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (PBPhysJSONReaderPeek(that) != tok) {
+    that->_error = true;
+    return false;
+  }
+  // The end of the stream is never consumed
+  if (tok != EOF)
+    that->_tok = 0;
+  return true;
+}
+
+// Read the label of the next property of the current object of the 
+// PBPhysJSONReader 'that' into 'lbl' of 'size' bytes, and the ':' 
+// following it, 'first' is true for the first property of the object
+// The label is truncated if it's longer than 'size'
+// Return false at the end of the object or on error, true else
+bool PBPhysJSONReaderNextLbl(PBPhysJSONReader* const that, 
+  char* const lbl, const size_t size, const bool first) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (lbl == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'lbl' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (PBPhysJSONReaderPeek(that) == '}') {
+    (void)PBPhysJSONReaderEat(that, '}');
+    return false;
+  }
+  if (!first && !PBPhysJSONReaderEat(that, ','))
+    return false;
+  if (PBPhysJSONReaderPeek(that) != '"') {
+    that->_error = true;
+    return false;
+  }
+  snprintf(lbl, size, "%s", that->_str);
+  (void)PBPhysJSONReaderEat(that, '"');
+  return PBPhysJSONReaderEat(that, ':');
+}
+
+// Move to the next element of the current array of the 
+// PBPhysJSONReader 'that', 'first' is true for the first element of the 
+// array
+// Return false at the end of the array or on error, true else
+bool PBPhysJSONReaderNextElem(PBPhysJSONReader* const that, 
+  const bool first) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (PBPhysJSONReaderPeek(that) == ']') {
+    (void)PBPhysJSONReaderEat(that, ']');
+    return false;
+  }
+  if (!first && !PBPhysJSONReaderEat(that, ','))
+    return false;
+  return true;
+}
+
+// Skip the current value of the PBPhysJSONReader 'that'
+// Return true if we could skip it, false else
+bool PBPhysJSONReaderSkip(PBPhysJSONReader* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Consume the tokens until the end of the value, without checking 
+  // the syntax of the nested objects and arrays
+  int depth = 0;
+  do {
+    int tok = PBPhysJSONReaderPeek(that);
+    if (tok == EOF || tok == '}' || tok == ']') {
+      if (depth == 0 || tok == EOF) {
+        that->_error = true;
+        return false;
+      }
+      --depth;
+    } else if (tok == '{' || tok == '[') {
+      ++depth;
+    }
+    (void)PBPhysJSONReaderEat(that, tok);
+  } while (depth > 0);
+  return true;
+}
+
+// Read the current value of the PBPhysJSONReader 'that' as a long into 
+// 'val'
+// Return true if we could read it, false else
+bool PBPhysJSONReaderGetLong(PBPhysJSONReader* const that, 
+  long* const val) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (val == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'val' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (PBPhysJSONReaderPeek(that) != '"') {
+    that->_error = true;
+    return false;
+  }
+  *val = atol(that->_str);
+  return PBPhysJSONReaderEat(that, '"');
+}
+
+// Read the current value of the PBPhysJSONReader 'that' as a float into 
+// 'val'
+// Return true if we could read it, false else
+bool PBPhysJSONReaderGetFloat(PBPhysJSONReader* const that, 
+  float* const val) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (val == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'val' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (PBPhysJSONReaderPeek(that) != '"') {
+    that->_error = true;
+    return false;
+  }
+  *val = atof(that->_str);
+  return PBPhysJSONReaderEat(that, '"');
+}
+
+// Read the current value of the PBPhysJSONReader 'that', encoded as 
+// VecEncodeAsJSON, into the vector 'v' which must have the same 
+// dimension
+// Return true if we could read it, false else
+bool PBPhysJSONReaderGetVec(PBPhysJSONReader* const that, 
+  VecFloat* const v) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (v == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'v' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (!PBPhysJSONReaderEat(that, '{'))
+    return false;
+  char lbl[PBPHYS_JSONSTRLEN];
+  bool hasDim = false;
+  long nbVal = -1;
+  for (bool first = true; 
+    PBPhysJSONReaderNextLbl(that, lbl, sizeof(lbl), first); 
+    first = false) {
+    if (strcmp(lbl, "_dim") == 0) {
+      long dim = 0;
+      if (!PBPhysJSONReaderGetLong(that, &dim) || dim != VecGetDim(v))
+        return false;
+      hasDim = true;
+    } else if (strcmp(lbl, "_val") == 0) {
+      if (!PBPhysJSONReaderEat(that, '['))
+        return false;
+      nbVal = 0;
+      for (bool firstVal = true; 
+        PBPhysJSONReaderNextElem(that, firstVal); firstVal = false) {
+        float val = 0.0;
+        if (nbVal >= VecGetDim(v) || 
+          !PBPhysJSONReaderGetFloat(that, &val))
+          return false;
+        VecSet(v, nbVal, val);
+        ++nbVal;
+      }
+    } else if (!PBPhysJSONReaderSkip(that)) {
+      return false;
+    }
+  }
+  return !(that->_error) && hasDim && nbVal == VecGetDim(v);
+}
+
+// Read the current value of the PBPhysJSONReader 'that', encoded as 
+// ShapoidEncodeAsJSON, into the shape 'shape' which must have the same 
+// dimension and type, 'v' is a vector of the same dimension used as a 
+// scratch
+// Return true if we could read it, false else
+bool PBPhysJSONReaderGetShapoid(PBPhysJSONReader* const that, 
+  Shapoid* const shape, VecFloat* const v) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (shape == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'shape' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (v == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'v' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (!PBPhysJSONReaderEat(that, '{'))
+    return false;
+  char lbl[PBPHYS_JSONSTRLEN];
+  // Flags of the properties read so far
+  int props = 0;
+  for (bool first = true; 
+    PBPhysJSONReaderNextLbl(that, lbl, sizeof(lbl), first); 
+    first = false) {
+    long val = 0;
+    if (strcmp(lbl, "_dim") == 0) {
+      if (!PBPhysJSONReaderGetLong(that, &val) || 
+        val != ShapoidGetDim(shape))
+        return false;
+      props |= 1;
+    } else if (strcmp(lbl, "_type") == 0) {
+      if (!PBPhysJSONReaderGetLong(that, &val) || 
+        val != ShapoidGetType(shape))
+        return false;
+      props |= 2;
+    } else if (strcmp(lbl, "_pos") == 0) {
+      if (!PBPhysJSONReaderGetVec(that, v))
+        return false;
+      ShapoidSetPos(shape, v);
+      props |= 4;
+    } else if (strcmp(lbl, "_axis") == 0) {
+      if (!PBPhysJSONReaderEat(that, '['))
+        return false;
+      int iAxis = 0;
+      for (bool firstAxis = true; 
+        PBPhysJSONReaderNextElem(that, firstAxis); firstAxis = false) {
+        if (iAxis >= ShapoidGetDim(shape) || 
+          !PBPhysJSONReaderGetVec(that, v))
+          return false;
+        ShapoidSetAxis(shape, iAxis, v);
+        ++iAxis;
+      }
+      if (iAxis != ShapoidGetDim(shape))
+        return false;
+      props |= 8;
+    } else if (!PBPhysJSONReaderSkip(that)) {
+      return false;
+    }
+  }
+  return !(that->_error) && props == 15;
+}
+
+// Read the current value of the PBPhysJSONReader 'that', encoded as 
+// PBPhysParticleEncodeAsJSON, into a new particle 'part' of dimension 
+// 'dim'
+// 'part' must be initialised to NULL and the particle created before a 
+// failure must be freed by the caller
+// Return true if we could read it, false else, in particular if the 
+// dimension of the particle is not 'dim' or its type of shape is 
+// invalid
+bool PBPhysJSONReaderGetParticle(PBPhysJSONReader* const that, 
+  PBPhysParticle** const part, const int dim) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (part == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'part' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (!PBPhysJSONReaderEat(that, '{'))
+    return false;
+  char lbl[PBPHYS_JSONSTRLEN];
+  long partDim = 0;
+  long type = -1;
+  float mass = 0.0;
+  float drag = 0.0;
+  long fixed = 0;
+  // Flags of the properties read so far
+  int props = 0;
+  // Scratch vector for the shape
+  VecFloat* v = NULL;
+  bool ret = true;
+  for (bool first = true; 
+    ret && PBPhysJSONReaderNextLbl(that, lbl, sizeof(lbl), first); 
+    first = false) {
+    if (strcmp(lbl, "_dim") == 0) {
+      ret = PBPhysJSONReaderGetLong(that, &partDim) && 
+        partDim == dim && *part == NULL;
+      props |= 1;
+    } else if (strcmp(lbl, "_type") == 0) {
+      ret = PBPhysJSONReaderGetLong(that, &type) && 
+        (type == ShapoidTypeFacoid || type == ShapoidTypeSpheroid || 
+        type == ShapoidTypePyramidoid) && *part == NULL;
+      props |= 2;
+    } else if (strcmp(lbl, "_shape") == 0 || 
+      strcmp(lbl, "_speed") == 0 || strcmp(lbl, "_accel") == 0) {
+      // The dimension and type, saved first, are needed to create the 
+      // particle before reading its shape and vectors
+      if (*part == NULL) {
+        if ((props & 3) != 3) {
+          ret = false;
+          break;
+        }
+        *part = PBPhysParticleCreate(dim, (ShapoidType)type);
+        v = VecFloatCreate(dim);
+      }
+      if (strcmp(lbl, "_shape") == 0) {
+        ret = PBPhysJSONReaderGetShapoid(that, (*part)->_shape, v);
+        props |= 4;
+      } else if (strcmp(lbl, "_speed") == 0) {
+        ret = PBPhysJSONReaderGetVec(that, (*part)->_speed);
+        props |= 8;
+      } else {
+        ret = PBPhysJSONReaderGetVec(that, (*part)->_accel);
+        props |= 16;
+      }
+    } else if (strcmp(lbl, "_mass") == 0) {
+      ret = PBPhysJSONReaderGetFloat(that, &mass);
+      props |= 32;
+    } else if (strcmp(lbl, "_drag") == 0) {
+      ret = PBPhysJSONReaderGetFloat(that, &drag);
+      props |= 64;
+    } else if (strcmp(lbl, "_fixed") == 0) {
+      ret = PBPhysJSONReaderGetLong(that, &fixed);
+      props |= 128;
+    } else {
+      ret = PBPhysJSONReaderSkip(that);
+    }
+  }
+  if (v != NULL)
+    VecFree(&v);
+  if (!ret || that->_error || props != 255)
+    return false;
+  (*part)->_mass = mass;
+  (*part)->_drag = drag;
+  (*part)->_fixed = fixed;
+  return true;
+}
+
+// ------------ PBPhysTrace
+
+// ================ Functions declaration ====================
+
+// Return the current wall time in seconds, used by the statistics and 
+// the traces of the steps
+double PBPhysGetWallTime(void);
+
+// Add to the buffer of the 'iThread'-th thread of the PBPhysTrace 
+// 'that' the begin (if 'type' equals 'B') or the end (if 'type' equals 
+// 'E') of the event 'name' at current time
+// 'name' must be a static string
+void PBPhysTraceAdd(PBPhysTrace* const that, const int iThread, 
+  const char* const name, const char type);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysTrace for 'nbThread' threads
+PBPhysTrace* PBPhysTraceCreate(const int nbThread) {
+#if BUILDMODE == 0
+  if (nbThread <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'nbThread' is invalid (0<%d)", nbThread);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate memory
+  PBPhysTrace* that = PBErrMalloc(PBPhysErr, sizeof(PBPhysTrace));
+  // Set properties
+  that->_origin = PBPhysGetWallTime();
+  that->_nbBuffer = 0;
+  that->_buffers = NULL;
+  PBPhysTraceSetNbThread(that, nbThread);
+  // Return the new PBPhysTrace
+  return that;
+}
+
+// Free the memory used by the PBPhysTrace 'that'
+void PBPhysTraceFree(PBPhysTrace** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Free memory
+  for (int iBuffer = 0; iBuffer < (*that)->_nbBuffer; ++iBuffer)
+    free((*that)->_buffers[iBuffer]._events);
+  free((*that)->_buffers);
+  free(*that);
+  *that = NULL;
+}
+
+// Ensure the PBPhysTrace 'that' has a buffer for each of 'nbThread' 
+// threads
+// Must not be called while threads are recording events
+void PBPhysTraceSetNbThread(PBPhysTrace* const that, 
+  const int nbThread) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (nbThread <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'nbThread' is invalid (0<%d)", nbThread);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // The buffers of the threads which don't exist anymore are kept with 
+  // their events
+  if (nbThread <= that->_nbBuffer)
+    return;
+  PBPhysTraceBuffer* buffers = 
+    PBErrMalloc(PBPhysErr, sizeof(PBPhysTraceBuffer) * nbThread);
+  if (that->_nbBuffer > 0)
+    memcpy(buffers, that->_buffers, 
+      sizeof(PBPhysTraceBuffer) * that->_nbBuffer);
+  for (int iBuffer = that->_nbBuffer; iBuffer < nbThread; ++iBuffer) {
+    buffers[iBuffer]._events = PBErrMalloc(PBPhysErr, 
+      sizeof(PBPhysTraceEvent) * PBPHYS_TRACECAPACITY);
+    buffers[iBuffer]._nb = 0;
+    buffers[iBuffer]._capacity = PBPHYS_TRACECAPACITY;
+  }
+  free(that->_buffers);
+  that->_buffers = buffers;
+  that->_nbBuffer = nbThread;
+}
+
+// Remove all the events of the PBPhysTrace 'that'
+void PBPhysTraceReset(PBPhysTrace* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  for (int iBuffer = 0; iBuffer < that->_nbBuffer; ++iBuffer)
+    that->_buffers[iBuffer]._nb = 0;
+  that->_origin = PBPhysGetWallTime();
+}
+
+// Return the number of events recorded by the PBPhysTrace 'that' (a 
+// begin and an end count as two events)
+long PBPhysTraceGetNbEvent(const PBPhysTrace* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  long nb = 0;
+  for (int iBuffer = 0; iBuffer < that->_nbBuffer; ++iBuffer)
+    nb += that->_buffers[iBuffer]._nb;
+  return nb;
+}
+
+// Save the events of the PBPhysTrace 'that' on the stream 'stream' in 
+// the Chrome trace event format (JSON), the thread of the events is 
+// their index in the thread pool and their timestamp is in 
+// microseconds since the creation of the trace
+// Return true if we could save, false else
+bool PBPhysTraceSave(const PBPhysTrace* const that, FILE* const stream) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  fprintf(stream, "{\"traceEvents\":[");
+  for (int iBuffer = 0; iBuffer < that->_nbBuffer; ++iBuffer) {
+    // Name the thread in the viewer
+    fprintf(stream, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\","
+      "\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", 
+      (iBuffer > 0 ? "," : ""), iBuffer, iBuffer);
+    const PBPhysTraceBuffer* buffer = that->_buffers + iBuffer;
+    for (long iEvent = 0; iEvent < buffer->_nb; ++iEvent) {
+      const PBPhysTraceEvent* event = buffer->_events + iEvent;
+      fprintf(stream, ",\n{\"name\":\"%s\",\"ph\":\"%c\","
+        "\"ts\":%.3f,\"pid\":0,\"tid\":%d}", event->_name, 
+        event->_type, 1e6 * (event->_time - that->_origin), iBuffer);
+    }
+  }
+  fprintf(stream, "\n],\"displayTimeUnit\":\"ms\"}\n");
+  return !ferror(stream);
+}
+
+// Return the current wall time in seconds, used by the statistics and 
+// the traces of the steps
+double PBPhysGetWallTime(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)(t.tv_sec) + 1e-9 * (double)(t.tv_nsec);
+}
+
+// Add to the buffer of the 'iThread'-th thread of the PBPhysTrace 
+// 'that' the begin (if 'type' equals 'B') or the end (if 'type' equals 
+// 'E') of the event 'name' at current time
+// 'name' must be a static string
+void PBPhysTraceAdd(PBPhysTrace* const that, const int iThread, 
+  const char* const name, const char type) {
+  PBPhysTraceBuffer* buffer = that->_buffers + iThread;
+  // Grow the buffer if it's full, only the thread owning the buffer 
+  // writes in it
+  if (buffer->_nb == buffer->_capacity) {
+    long capacity = 2 * buffer->_capacity;
+    PBPhysTraceEvent* events = 
+      PBErrMalloc(PBPhysErr, sizeof(PBPhysTraceEvent) * capacity);
+    memcpy(events, buffer->_events, 
+      sizeof(PBPhysTraceEvent) * buffer->_nb);
+    free(buffer->_events);
+    buffer->_events = events;
+    buffer->_capacity = capacity;
+  }
+  PBPhysTraceEvent* event = buffer->_events + buffer->_nb;
+  event->_name = name;
+  event->_time = PBPhysGetWallTime();
+  event->_type = type;
+  ++(buffer->_nb);
+}
+
+// ------------ PBPhysHisto
+
+// ================ Functions declaration ====================
+
+// Return the index of the bucket of the value 'val' in a PBPhysHisto
+int PBPhysHistoGetBucket(const unsigned long val);
+
+// Get in 'low' and 'high' the lowest and highest values of the 
+// 'iBucket'-th bucket of a PBPhysHisto
+void PBPhysHistoGetBucketRange(const int iBucket, 
+  unsigned long* const low, unsigned long* const high);
+
+// ================ Functions implementation ====================
+
+// Create a new empty PBPhysHisto
+PBPhysHisto* PBPhysHistoCreate(void) {
+  // Allocate memory
+  PBPhysHisto* that = PBErrMalloc(PBPhysErr, sizeof(PBPhysHisto));
+  // Set properties
+  PBPhysHistoReset(that);
+  // Return the new PBPhysHisto
+  return that;
+}
+
+// Free the memory used by the PBPhysHisto 'that'
+void PBPhysHistoFree(PBPhysHisto** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Free memory
+  free(*that);
+  *that = NULL;
+}
+
+// Remove all the values of the PBPhysHisto 'that'
+void PBPhysHistoReset(PBPhysHisto* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  memset(that->_count, 0, sizeof(that->_count));
+  that->_nb = 0;
+  that->_min = 0;
+  that->_max = 0;
+  that->_sum = 0.0;
+}
+
+// Record the value 'val' in the PBPhysHisto 'that'
+void PBPhysHistoAdd(PBPhysHisto* const that, const unsigned long val) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  ++(that->_count[PBPhysHistoGetBucket(val)]);
+  if (that->_nb == 0 || val < that->_min)
+    that->_min = val;
+  if (val > that->_max)
+    that->_max = val;
+  ++(that->_nb);
+  that->_sum += (double)val;
+}
+
+// Return the value below or equal to which 'percent' percents of the 
+// values recorded in the PBPhysHisto 'that' are, within the precision 
+// of the histogram (0 if it is empty)
+// The returned value is the highest value of its bucket, bounded by 
+// the lowest and highest values recorded
+unsigned long PBPhysHistoGetPercentile(const PBPhysHisto* const that, 
+  const float percent) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (percent < 0.0 || percent > 100.0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'percent' is invalid (0<=%f<=100)", 
+      percent);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (that->_nb == 0)
+    return 0;
+  // Get the rank of the value, at least the first one
+  unsigned long rank = 
+    (unsigned long)ceil((double)percent * (double)(that->_nb) / 100.0);
+  if (rank < 1)
+    rank = 1;
+  // Search the bucket containing the value of this rank
+  unsigned long nb = 0;
+  int iBucket = 0;
+  while (iBucket < PBPHYS_HISTONBBUCKET - 1) {
+    nb += that->_count[iBucket];
+    if (nb >= rank)
+      break;
+    ++iBucket;
+  }
+  unsigned long low = 0;
+  unsigned long high = 0;
+  PBPhysHistoGetBucketRange(iBucket, &low, &high);
+  // The values above the range of the histogram are in the last bucket
+  if (high > that->_max || iBucket == PBPHYS_HISTONBBUCKET - 1)
+    high = that->_max;
+  if (high < that->_min)
+    high = that->_min;
+  return high;
+}
+
+// Print the number of values, the lowest, mean, 50th, 90th, 99th, 
+// 99.9th percentile and highest values of the PBPhysHisto 'that' on 
+// the stream 'stream', followed by one line per non empty bucket with 
+// its range of values, number of values and cumulated percentage
+void PBPhysHistoPrintln(const PBPhysHisto* const that, 
+  FILE* const stream) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  fprintf(stream, "nb: %lu\n", that->_nb);
+  fprintf(stream, "min: %lu\n", PBPhysHistoGetMin(that));
+  fprintf(stream, "mean: %f\n", PBPhysHistoGetMean(that));
+  fprintf(stream, "p50: %lu\n", PBPhysHistoGetPercentile(that, 50.0));
+  fprintf(stream, "p90: %lu\n", PBPhysHistoGetPercentile(that, 90.0));
+  fprintf(stream, "p99: %lu\n", PBPhysHistoGetPercentile(that, 99.0));
+  fprintf(stream, "p99.9: %lu\n", 
+    PBPhysHistoGetPercentile(that, 99.9));
+  fprintf(stream, "max: %lu\n", PBPhysHistoGetMax(that));
+  unsigned long nb = 0;
+  for (int iBucket = 0; iBucket < PBPHYS_HISTONBBUCKET; ++iBucket) {
+    if (that->_count[iBucket] > 0) {
+      nb += that->_count[iBucket];
+      unsigned long low = 0;
+      unsigned long high = 0;
+      PBPhysHistoGetBucketRange(iBucket, &low, &high);
+      fprintf(stream, "[%lu,%lu]: %lu %.3f%%\n", low, high, 
+        that->_count[iBucket], 
+        100.0 * (double)nb / (double)(that->_nb));
+    }
+  }
+}
+
+// Return the index of the bucket of the value 'val' in a PBPhysHisto
+int PBPhysHistoGetBucket(const unsigned long val) {
+  unsigned long nbSub = 1UL << PBPHYS_HISTOSUBBITS;
+  unsigned long maxVal = (1UL << (PBPHYS_HISTOMAXBIT + 1)) - 1;
+  unsigned long v = (val > maxVal ? maxVal : val);
+  // The lowest values have their own bucket
+  if (v < nbSub)
+    return (int)v;
+  // Get the shift bringing the value below nbSub, the buckets of this 
+  // power of two have a width of 2^shift
+  int shift = 1;
+  while ((v >> shift) >= nbSub)
+    ++shift;
+  return (int)(nbSub + (shift - 1) * (nbSub / 2) + 
+    ((v >> shift) - nbSub / 2));
+}
+
+// Get in 'low' and 'high' the lowest and highest values of the 
+// 'iBucket'-th bucket of a PBPhysHisto
+void PBPhysHistoGetBucketRange(const int iBucket, 
+  unsigned long* const low, unsigned long* const high) {
+  unsigned long nbSub = 1UL << PBPHYS_HISTOSUBBITS;
+  if ((unsigned long)iBucket < nbSub) {
+    *low = (unsigned long)iBucket;
+    *high = (unsigned long)iBucket;
+  } else {
+    unsigned long i = (unsigned long)iBucket - nbSub;
+    int shift = (int)(i / (nbSub / 2)) + 1;
+    unsigned long top = i % (nbSub / 2) + nbSub / 2;
+    *low = top << shift;
+    *high = ((top + 1) << shift) - 1;
+  }
+}
+
+// ------------ PBPhys
+
+// ================ Functions declaration ====================
+
+// Calculate the system acceleration of the 'iPart'-th particle of the 
+// table of particles of the PBPhys 'that'
+void PBPhysUpdateSysAccel(const PBPhys* const that, const long iPart);
+
+// If the gravity between particles of the PBPhys 'that' is active and 
+// calculated with the Barnes-Hut tree, calculate it for all the 
+// particles from their current state
+// The table of particles of 'that' must be up to date
+void PBPhysUpdateGravityBH(PBPhys* const that);
+
+// Add the gravity between particles to the system acceleration of the 
+// particle 'particle' in the PBPhys 'that' whose particles' state is 
+// stored in its structure of arrays
+void PBPhysUpdateSysAccelSoA(const PBPhys* const that, 
+  PBPhysParticle* const particle);
+
+// Return the time to collision between two particles of radius 'rA' 
+// and 'rB' and the polynom of the square distance between particles 
+// over time 'distPoly'
+float PBPhysGetTimeToHit(float rA, float rB, VecFloat3D* distPoly);
+
+// Update the table of particles of the PBPhys 'that' from its set of 
+// particles and return it
+// If the state of the particles is stored in the PBPhys, the arrays 
+// are rebuilt if they are not in the order of the set anymore, and 
+// the data depending on the shapes are updated
+PBPhysParticle** PBPhysUpdateTable(PBPhys* const that);
+
+// Update the partition of the particles 'parts' of the PBPhys 'that' 
+// between the fixed or asleep particles and the other ones
+void PBPhysUpdatePartition(PBPhys* const that, 
+  PBPhysParticle** const parts);
+
+// Update the sleep state of the particles of the PBPhys 'that' at the 
+// end of a step: the particles whose speed and acceleration have 
+// stayed under the sleep threshold during the sleep delay fall asleep
+// The table of particles of 'that' and its partition must be the ones 
+// of the last sub-step
+void PBPhysUpdateSleep(PBPhys* const that);
+
+// Return the position in the array of the particles which are not 
+// fixed of the PBPhys 'that' of the first one whose index in the table 
+// is greater than or equal to 'iPart'
+long PBPhysGetFirstDynamic(const PBPhys* const that, const long iPart);
+
+// Return the time at which two particles at 'posA' and 'posB', moving 
+// at speed 'vA' and 'vB' and of bounding radius 'rA' and 'rB' hit 
+// each other if it's sooner than 'deltat', else return 'deltat'
+// Positions and speeds are arrays of 'dim' values
+float PBPhysGetPairTimeToHit(const int dim, const float* const posA, 
+  const float* const vA, const float rA, const float* const posB, 
+  const float* const vB, const float rB, const float deltat);
+
+// Return the bounding radius of the 'iPart'-th particle in the table 
+// of particles of the PBPhys 'that'
+float PBPhysGetBoundingRadius(const PBPhys* const that, 
+  const long iPart);
+
+// Update the pairs of particles of the PBPhys 'that' selected by its 
+// broad phase, the swept boxes are enlarged by 'margin'
+// The table of particles of 'that' and the system acceleration of the 
+// particles must be up to date
+void PBPhysUpdatePairs(PBPhys* const that, const float margin);
+
+// Set the arrays 'boxMin' and 'boxMax' (dim values per particle) to 
+// the bounding boxes of the particles 'parts' of the PBPhys 'that' 
+// swept over its deltaT and enlarged by 'margin'
+void PBPhysGetSweptBoxes(const PBPhys* const that, 
+  PBPhysParticle** const parts, const float margin, 
+  float* const boxMin, float* const boxMax);
+
+// Return true if the Verlet neighbour lists of the PBPhys 'that' 
+// still contain all the pairs of particles which can collide before 
+// the end of its deltaT
+// Return false else
+// The scratch of 'that' must be up to date
+bool PBPhysIsVerletValid(const PBPhys* const that, 
+  PBPhysParticle** const parts);
+
+// Build the Verlet neighbour lists of the particles 'parts' of the 
+// PBPhys 'that' into its array of pairs
+// The scratch of 'that' must be up to date
+void PBPhysBuildVerlet(PBPhys* const that, 
+  PBPhysParticle** const parts);
+
+// Step the PBPhys 'that' by that->_deltaT managing collision(s) with 
+// the event driven scheduler
+// Return the number of collisions resolved
+long PBPhysStepEventDriven(PBPhys* const that);
+
+// Update the scratch of the PBPhys 'that' with the position, the 
+// displacement over 'deltat' per time unit and the bounding radius of 
+// its particles
+// The table of particles of 'that' and the system acceleration of the 
+// particles must be up to date
+void PBPhysUpdateScratch(PBPhys* const that, const float deltat);
+
+// Update the scratch of the PBPhys 'that' for its 'iPart'-th particle 
+// in the table 'parts', the scratch must be large enough
+void PBPhysUpdateScratchOf(PBPhys* const that, 
+  PBPhysParticle** const parts, const long iPart, const float deltat);
+
+// Move the particles 'parts' of the PBPhys 'that' to its current time, 
+// select their neighbours and predict again all their collisions 
+// before 'goalT' in its event queue
+// The system acceleration of the particles must be up to date
+void PBPhysInitEvents(PBPhys* const that, 
+  PBPhysParticle** const parts, const float goalT);
+
+// Return true if the 'iPart'-th particle of the PBPhys 'that' stays 
+// until 'goalT' in the ball where its neighbours in the event queue 
+// are valid
+// Return false else
+// The scratch of the particle must be up to date
+bool PBPhysIsInReach(const PBPhys* const that, const long iPart, 
+  const float goalT);
+
+// Predict the collision before 'goalT' of the 'iPart'-th and 
+// 'jPart'-th particles of the PBPhys 'that', and update the next 
+// collision of the particles in its event queue if it's sooner than 
+// their current one
+void PBPhysPredictPair(PBPhys* const that, const long iPart, 
+  const long jPart, const float goalT);
+
+// Predict the collisions before 'goalT' of the 'iPart'-th particle 
+// with its neighbours in the event queue of the PBPhys 'that' (all the 
+// other particles if there is no broad phase), and update the next 
+// collision of the particles if it's sooner than their current one
+// The pairs of fixed particles are skipped
+void PBPhysPredictCollision(PBPhys* const that, const long iPart, 
+  const float goalT);
+
+// Step the PBPhys 'that' for that->_deltaT or until the earliest 
+// collision
+// If 'all' equals false return the earliest collision, else return 
+// all the collisions occuring within 'tolerance' of the earliest one
+// If no collision occured return NULL
+GSetPBPhysParticle* PBPhysStepToContacts(PBPhys* const that, 
+  const float tolerance, const bool all);
+
+// Search the collisions in the PBPhys 'that' between the pairs of 
+// particles from the 'iFirst'-th to the ('iEnd'-1)-th and memorize 
+// them in 'contacts'
+// If a broad phase is used the indices are the ones of the pairs it 
+// has selected, else they are the indices of the first particle of 
+// the pairs, each one paired with all the following particles except 
+// the pairs of fixed particles
+// If 'all' equals false only the earliest collision is memorized, 
+// else all the collisions occuring within 'tolerance' of the earliest 
+// one found so far are memorized
+// The scratch of 'that' must be up to date
+void PBPhysSearchContacts(const PBPhys* const that, const long iFirst, 
+  const long iEnd, const float tolerance, const bool all, 
+  PBPhysContacts* const contacts);
+
+// Merge the collisions found by the threads of the PBPhys 'that' into 
+// that->_contacts, in the order of the threads
+// If 'all' equals false only the earliest collision is kept
+void PBPhysMergeContacts(PBPhys* const that, const bool all);
+
+// Memorize the collision at time 'tHit' between the 'iPart'-th and 
+// 'jPart'-th particles in the table of particles into 'contacts'
+// If 'all' equals false the collision replaces the previous ones
+void PBPhysAddContact(PBPhysContacts* const contacts, const long iPart, 
+  const long jPart, const float tHit, const bool all);
+
+// Run the job 'job' on the data 'data' with the threads of the PBPhys 
+// 'that', or with the current thread if it has no thread pool
+void PBPhysRunJob(PBPhys* const that, const PBPhysJob job, 
+  PBPhysStepJob* const data);
+
+// Get in 'iFirst' and 'iEnd' the range of the 'nb' elements processed 
+// by the 'iThread'-th thread among 'nbThread' threads
+void PBPhysGetJobRange(const long nb, const int iThread, 
+  const int nbThread, long* const iFirst, long* const iEnd);
+
+// Return the index of the first particle of the PBPhys 'that' whose 
+// pairs with the following particles are after the 'iPair'-th pair, 
+// the pairs of fixed particles being excluded
+// The partition of the particles of 'that' must be up to date
+long PBPhysGetFirstRow(const PBPhys* const that, const long iPair);
+
+// Job calculating the system acceleration of the particles which are 
+// not fixed, 'data' is a PBPhysStepJob
+void PBPhysJobUpdateSysAccel(void* const data, const int iThread, 
+  const int nbThread);
+
+// Job moving the particles which are not fixed by job->_deltat, 
+// 'data' is a PBPhysStepJob
+void PBPhysJobMove(void* const data, const int iThread, 
+  const int nbThread);
+
+// Job searching the collisions, 'data' is a PBPhysStepJob
+void PBPhysJobSearchContacts(void* const data, const int iThread, 
+  const int nbThread);
+
+// Initialise the empty PBPhysContacts 'that'
+void PBPhysContactsInit(PBPhysContacts* const that);
+
+// Free the memory used by the arrays of the PBPhysContacts 'that'
+void PBPhysContactsFreeArr(PBPhysContacts* const that);
+
+// Free the pool of threads of the PBPhys 'that' and the contacts of 
+// its threads
+void PBPhysFreeThreads(PBPhys* const that);
+
+// Record the trajectory and archive the state of the PBPhys 'that' at 
+// the end of a step if it has a recorder or an archive
+void PBPhysEndStep(PBPhys* const that);
+
+// Record in the latency histograms of the PBPhys 'that', if they are 
+// recorded, the duration of the step started at 'tStart' and its 
+// number of sub-steps 'nbIter' (0 for PBPhysNext, which isn't split)
+void PBPhysAddStepLatency(PBPhys* const that, const double tStart, 
+  const long nbIter);
+
+#if PBPHYS_STATS
+// Add the statistics of the last search of collisions of the PBPhys 
+// 'that' to its statistics
+void PBPhysStatsAddSearch(PBPhys* const that);
+#endif
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhys for space dimension 'dim'
+// Default values: _deltaT = 0.01, _downGravity = 0.0, _gravity = 0.0,
+// _curTime = 0.0, _gravitySolver = PBPhysGravitySolverExact, 
+// _gravityTheta = PBPHYS_BHTHETA, _broadPhase = PBPhysBroadPhaseNone, 
+// _verletSkin = PBPHYS_VERLETSKIN, 
+// _scheduler = PBPhysSchedulerSequential, _contactTolerance = 0.0, 
+// _sleepSpeed = 0.0, _sleepDelay = PBPHYS_SLEEPDELAY, single threaded
+PBPhys* PBPhysCreate(const int dim) {
+#if BUILDMODE == 0
+  if (dim <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'dim' is invalid (0<%d)", dim);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate memory
+  PBPhys* that = PBErrMalloc(PBPhysErr, sizeof(PBPhys));
+  // Set properties
+  *(int*)&(that->_dim) = dim;
+  that->_particles = GSetPBPhysParticleCreateStatic();
+  that->_deltaT = PBPHYS_DELTAT;
+  that->_downGravity = 0.0; 
+  that->_gravity = false;
+  that->_curTime = 0.0;
+  that->_soa = NULL;
+  that->_table = NULL;
+  that->_tableCapacity = 0;
+  that->_tableInactive = NULL;
+  that->_dynamicPart = NULL;
+  that->_nbDynamic = 0;
+  that->_partitionCapacity = 0;
+  that->_gravitySolver = PBPhysGravitySolverExact;
+  that->_gravityTheta = PBPHYS_BHTHETA;
+  that->_bhTree = NULL;
+  that->_broadPhase = PBPhysBroadPhaseNone;
+  that->_grid = NULL;
+  that->_sap = NULL;
+  that->_bvh = NULL;
+  that->_verlet = NULL;
+  that->_verletSkin = PBPHYS_VERLETSKIN;
+  that->_pairs = NULL;
+  that->_nbPair = 0;
+  that->_pairCapacity = 0;
+  that->_scheduler = PBPhysSchedulerSequential;
+  that->_events = NULL;
+  that->_contactTolerance = 0.0;
+  that->_sleepSpeed = 0.0;
+  that->_sleepDelay = PBPHYS_SLEEPDELAY;
+  PBPhysContactsInit(&(that->_contacts));
+  that->_threadPool = NULL;
+  that->_threadContacts = NULL;
+  that->_scratchPos = NULL;
+  that->_scratchSpeed = NULL;
+  that->_scratchRadius = NULL;
+  that->_scratchCapacity = 0;
+  that->_recorder = NULL;
+  that->_archive = NULL;
+  memset(&(that->_stats), 0, sizeof(PBPhysStats));
+  that->_tracing = false;
+  that->_trace = NULL;
+  that->_stepTimeHisto = NULL;
+  that->_stepIterHisto = NULL;
+  // Return the new PBPhys
+  return that;
+}
+
+// Free memory used by the PBPhys 'that'
+void PBPhysFree(PBPhys** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Stop the recorder
+  if ((*that)->_recorder != NULL)
+    PBPhysRecorderStop((*that)->_recorder);
+  // Detach the archive, it can still be closed
+  if ((*that)->_archive != NULL)
+    (*that)->_archive->_phys = NULL;
+  // Free memory
+  PBPhysSoAFree(&((*that)->_soa));
+  free((*that)->_table);
+  free((*that)->_tableInactive);
+  free((*that)->_dynamicPart);
+  PBPhysBHTreeFree(&((*that)->_bhTree));
+  PBPhysGridFree(&((*that)->_grid));
+  PBPhysSAPFree(&((*that)->_sap));
+  PBPhysBVHFree(&((*that)->_bvh));
+  PBPhysVerletFree(&((*that)->_verlet));
+  free((*that)->_pairs);
+  PBPhysEventQueueFree(&((*that)->_events));
+  PBPhysContactsFreeArr(&((*that)->_contacts));
+  PBPhysFreeThreads(*that);
+  PBPhysTraceFree(&((*that)->_trace));
+  PBPhysHistoFree(&((*that)->_stepTimeHisto));
+  PBPhysHistoFree(&((*that)->_stepIterHisto));
+  free((*that)->_scratchPos);
+  free((*that)->_scratchSpeed);
+  free((*that)->_scratchRadius);
+  while (PBPhysGetNbParticle(*that) > 0) {
+    PBPhysParticle* particle = GSetPop(PBPhysParticles(*that));
+    PBPhysParticleFree(&particle);
+  }
+  free(*that);
+  *that = NULL;
+}
+
+// Return a clone of the PBPhys 'that'
+PBPhys* PBPhysClone(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Declare the clone
+  PBPhys* clone = PBPhysCreate(PBPhysGetDim(that));
+  // Copy the properties
+  PBPhysSetGravity(clone, PBPhysGetGravity(that));
+  PBPhysSetCurTime(clone, PBPhysGetCurTime(that));
   PBPhysSetDeltaT(clone, PBPhysGetDeltaT(that));
   PBPhysSetDownGravity(clone, PBPhysGetDownGravity(that));
+  PBPhysSetGravitySolver(clone, PBPhysGetGravitySolver(that));
+  PBPhysSetGravityTheta(clone, PBPhysGetGravityTheta(that));
+  PBPhysSetBroadPhase(clone, PBPhysGetBroadPhase(that));
+  PBPhysSetVerletSkin(clone, PBPhysGetVerletSkin(that));
+  PBPhysSetScheduler(clone, PBPhysGetScheduler(that));
+  PBPhysSetContactTolerance(clone, PBPhysGetContactTolerance(that));
+  PBPhysSetSleepSpeed(clone, PBPhysGetSleepSpeed(that));
+  PBPhysSetSleepDelay(clone, PBPhysGetSleepDelay(that));
+  PBPhysSetNbThread(clone, PBPhysGetNbThread(that));
   // Copy the particles
   if (PBPhysGetNbParticle(that) > 0) {
-    GSetIterForward iter = 
+    GSetIterForward iter = 
+      GSetIterForwardCreateStatic(PBPhysParticles(that));
+    do {
+      PBPhysParticle* part = GSetIterGet(&iter);
+      PBPhysParticle* clonePart = PBPhysParticleClone(part);
+      GSetAppend(PBPhysParticles(clone), clonePart);
+    } while (GSetIterStep(&iter));
+  }
+  // Copy the storage mode
+  PBPhysSetStorage(clone, PBPhysGetStorage(that));
+  // Return the clone
+  return clone;
+}
+
+// Print the PBPhys 'that' on the stream 'stream'
+void PBPhysPrintln(const PBPhys* const that, FILE* const stream) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  fprintf(stream, "dimension: %d\n", PBPhysGetDim(that));
+  fprintf(stream, "t: %f\n", PBPhysGetCurTime(that));
+  fprintf(stream, "dt: %f\n", PBPhysGetDeltaT(that));
+  fprintf(stream, "down gravity: %f\n", PBPhysGetDownGravity(that));
+  fprintf(stream, "gravity: %f\n", PBPhysGetGravity(that));
+  fprintf(stream, "nb particles: %d\n", PBPhysGetNbParticle(that));
+  if (PBPhysGetNbParticle(that) > 0) {
+    GSetIterForward iter = 
+      GSetIterForwardCreateStatic(PBPhysParticles(that));
+    int iPart = 0;
+    do {
+      fprintf(stream, "particle #%d:\n", iPart);
+      PBPhysParticle* part = GSetIterGet(&iter);
+      PBPhysParticlePrintln(part, stream);
+      ++iPart;
+    } while (GSetIterStep(&iter));
+  }
+}
+
+// Function which return the JSON encoding of 'that' 
+JSONNode* PBPhysEncodeAsJSON(const PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBMathErr->_type = PBErrTypeNullPointer;
+    sprintf(PBMathErr->_msg, "'that' is null");
+    PBErrCatch(PBMathErr);
+  }
+#endif
+  // Create the JSON structure
+  JSONNode* json = JSONCreate();
+  // Declare a buffer to convert value into string
+  char val[100];
+  // Encode the dimension
+  sprintf(val, "%d", that->_dim);
+  JSONAddProp(json, "_dim", val);
+  // Encode the curTime
+  sprintf(val, "%f", that->_curTime);
+  JSONAddProp(json, "_curTime", val);
+  // Encode the deltat
+  sprintf(val, "%f", that->_deltaT);
+  JSONAddProp(json, "_deltaT", val);
+  // Encode the downGravity
+  sprintf(val, "%f", that->_downGravity);
+  JSONAddProp(json, "_downGravity", val);
+  // Encode the gravity
+  sprintf(val, "%f", that->_gravity);
+  JSONAddProp(json, "_gravity", val);
+  // Encode the nbParticle
+  sprintf(val, "%d", PBPhysGetNbParticle(that));
+  JSONAddProp(json, "_nbParticle", val);
+  // Encode the particles
+  // Declare an array of structures converted to string
+  JSONArrayStruct setPart = JSONArrayStructCreateStatic();
+  if (PBPhysGetNbParticle(that) > 0) {
+    GSetIterForward iter = 
+      GSetIterForwardCreateStatic(PBPhysParticles(that));
+    do {
+      PBPhysParticle* part = GSetIterGet(&iter);
+      JSONArrayStructAdd(&setPart, 
+        PBPhysParticleEncodeAsJSON(part));
+
+    } while (GSetIterStep(&iter));
+  }
+  // Add a key with the array of structures
+  JSONAddProp(json, "_particles", &setPart);
+  // Free memory
+  JSONArrayStructFlush(&setPart);
+  // Return the created JSON 
+  return json;
+}
+
+// Function which decode from JSON encoding 'json' to 'that'
+bool PBPhysDecodeAsJSON(PBPhys** that, const JSONNode* const json) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBMathErr->_type = PBErrTypeNullPointer;
+    sprintf(PBMathErr->_msg, "'that' is null");
+    PBErrCatch(PBMathErr);
+  }
+  if (json == NULL) {
+    PBMathErr->_type = PBErrTypeNullPointer;
+    sprintf(PBMathErr->_msg, "'json' is null");
+    PBErrCatch(PBMathErr);
+  }
+#endif
+  // If 'that' is already allocated
+  if (*that != NULL)
+    // Free memory
+    PBPhysFree(that);
+  // Decode the dimension
+  JSONNode* prop = JSONProperty(json, "_dim");
+  if (prop == NULL) {
+    return false;
+  }
+  int dim = atoi(JSONLblVal(prop));
+  // If data is invalid
+  if (dim <= 0)
+    return false;
+  // Allocate memory
+  *that = PBPhysCreate(dim);
+  // Decode the curTime
+  prop = JSONProperty(json, "_curTime");
+  if (prop == NULL) {
+    return false;
+  }
+  (*that)->_curTime = atof(JSONLblVal(prop));
+  // Decode the deltaT
+  prop = JSONProperty(json, "_deltaT");
+  if (prop == NULL) {
+    return false;
+  }
+  (*that)->_deltaT = atof(JSONLblVal(prop));
+  // Decode the downGravity
+  prop = JSONProperty(json, "_downGravity");
+  if (prop == NULL) {
+    return false;
+  }
+  (*that)->_downGravity = atof(JSONLblVal(prop));
+  // Decode the gravity
+  prop = JSONProperty(json, "_gravity");
+  if (prop == NULL) {
+    return false;
+  }
+  (*that)->_gravity = atof(JSONLblVal(prop));
+  // Decode the nbParticle
+  prop = JSONProperty(json, "_nbParticle");
+  if (prop == NULL) {
+    return false;
+  }
+  int nbParticle = atoi(JSONLblVal(prop));
+  // Decode the particle
+  prop = JSONProperty(json, "_particles");
+  if (prop == NULL) {
+    return false;
+  }
+  if (JSONGetNbValue(prop) != nbParticle) {
+    return false;
+  }
+  for (int iPart = 0; iPart < nbParticle; ++iPart) {
+    JSONNode* part = JSONValue(prop, iPart);
+    PBPhysParticle* p = NULL;
+    if (!PBPhysParticleDecodeAsJSON(&p, part))
+      return false;
+    GSetAppend(PBPhysParticles(*that), p);
+  }
+  // Return the success code
+  return true;
+}
+
+// Save the PBPhys 'that' on the stream 'stream'
+// If 'compact' equals true it saves in compact form, else it saves in 
+// readable form
+// Return true if we could save the PBPhys
+// Return false else
+// The JSON is written while iterating on the particles, without 
+// creating the JSONNode of PBPhysEncodeAsJSON
+bool PBPhysSave(const PBPhys* const that, FILE* const stream, 
+  const bool compact) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Write the properties of the PBPhys, with the same text as 
+  // PBPhysEncodeAsJSON saved with JSONSave
+  char val[100];
+  fprintf(stream, "{");
+  PBPhysJSONWriteEndProp(stream, true, compact);
+  sprintf(val, "%d", that->_dim);
+  PBPhysJSONWriteProp(stream, "_dim", val, 0, false, compact);
+  sprintf(val, "%f", that->_curTime);
+  PBPhysJSONWriteProp(stream, "_curTime", val, 0, false, compact);
+  sprintf(val, "%f", that->_deltaT);
+  PBPhysJSONWriteProp(stream, "_deltaT", val, 0, false, compact);
+  sprintf(val, "%f", that->_downGravity);
+  PBPhysJSONWriteProp(stream, "_downGravity", val, 0, false, compact);
+  sprintf(val, "%f", that->_gravity);
+  PBPhysJSONWriteProp(stream, "_gravity", val, 0, false, compact);
+  sprintf(val, "%d", PBPhysGetNbParticle(that));
+  PBPhysJSONWriteProp(stream, "_nbParticle", val, 0, false, compact);
+  // Write the particles one after the other while iterating on the 
+  // set, instead of creating the JSONNode of all the particles
+  PBPhysJSONWriteLbl(stream, "_particles", 0, compact);
+  fprintf(stream, "[");
+  PBPhysJSONWriteEndProp(stream, true, compact);
+  if (PBPhysGetNbParticle(that) > 0) {
+    GSetIterForward iter = 
+      GSetIterForwardCreateStatic(PBPhysParticles(that));
+    do {
+      PBPhysParticle* part = GSetIterGet(&iter);
+      PBPhysJSONWriteIndent(stream, 2, compact);
+      PBPhysParticleJSONWrite(part, stream, 2, compact);
+      PBPhysJSONWriteEndProp(stream, 
+        GSetIterIsLast(&iter), compact);
+    } while (GSetIterStep(&iter));
+  } else {
+    PBPhysJSONWriteEndProp(stream, true, compact);
+  }
+  PBPhysJSONWriteIndent(stream, 1, compact);
+  fprintf(stream, "]");
+  PBPhysJSONWriteEndProp(stream, true, compact);
+  fprintf(stream, "}\n");
+  // Return success code
+  return !ferror(stream);
+}
+
+// Load the PBPhys 'that' from the stream 'stream'
+// Return true if we could load the PBPhys
+// Return false else
+// The particles are created while the JSON text is read, without 
+// creating the JSONNode of the whole PBPhys
+bool PBPhysLoad(PBPhys** that, FILE* const stream) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return PBPhysLoadWithProgress(that, stream, NULL, NULL);
+}
+
+// Load the PBPhys 'that' from the stream 'stream' as PBPhysLoad, 
+// calling 'progress' (if not null) with 'data' after each loaded 
+// particle
+// Return true if we could load the PBPhys
+// Return false else
+bool PBPhysLoadWithProgress(PBPhys** that, FILE* const stream, 
+  const PBPhysLoadProgress progress, void* const data) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // If 'that' is already allocated
+  if (*that != NULL)
+    // Free memory
+    PBPhysFree(that);
+  PBPhysJSONReader reader;
+  PBPhysJSONReaderInit(&reader, stream);
+  if (!PBPhysJSONReaderEat(&reader, '{'))
+    return false;
+  char lbl[PBPHYS_JSONSTRLEN];
+  float curTime = 0.0;
+  float deltaT = 0.0;
+  float downGravity = 0.0;
+  float gravity = 0.0;
+  long nbParticle = -1;
+  long nbLoaded = 0;
+  // Flags of the properties read so far
+  int props = 0;
+  bool ret = true;
+  for (bool first = true; 
+    ret && PBPhysJSONReaderNextLbl(&reader, lbl, sizeof(lbl), first); 
+    first = false) {
+    if (strcmp(lbl, "_dim") == 0) {
+      long dim = 0;
+      ret = PBPhysJSONReaderGetLong(&reader, &dim) && dim > 0 && 
+        *that == NULL;
+      if (ret)
+        *that = PBPhysCreate((int)dim);
+      props |= 1;
+    } else if (strcmp(lbl, "_curTime") == 0) {
+      ret = PBPhysJSONReaderGetFloat(&reader, &curTime);
+      props |= 2;
+    } else if (strcmp(lbl, "_deltaT") == 0) {
+      ret = PBPhysJSONReaderGetFloat(&reader, &deltaT);
+      props |= 4;
+    } else if (strcmp(lbl, "_downGravity") == 0) {
+      ret = PBPhysJSONReaderGetFloat(&reader, &downGravity);
+      props |= 8;
+    } else if (strcmp(lbl, "_gravity") == 0) {
+      ret = PBPhysJSONReaderGetFloat(&reader, &gravity);
+      props |= 16;
+    } else if (strcmp(lbl, "_nbParticle") == 0) {
+      ret = PBPhysJSONReaderGetLong(&reader, &nbParticle) && 
+        nbParticle >= 0;
+      props |= 32;
+    } else if (strcmp(lbl, "_particles") == 0) {
+      // The particles are added to the PBPhys as soon as they are read, 
+      // which needs the dimension saved before them
+      ret = (*that != NULL) && PBPhysJSONReaderEat(&reader, '[');
+      for (bool firstPart = true; 
+        ret && PBPhysJSONReaderNextElem(&reader, firstPart); 
+        firstPart = false) {
+        PBPhysParticle* part = NULL;
+        ret = PBPhysJSONReaderGetParticle(&reader, &part, 
+          PBPhysGetDim(*that)) && 
+          (nbParticle < 0 || nbLoaded < nbParticle);
+        if (ret) {
+          GSetAppend(PBPhysParticles(*that), part);
+          ++nbLoaded;
+          if (progress != NULL)
+            progress(data, nbLoaded, nbParticle, reader._nbByte);
+        } else if (part != NULL) {
+          PBPhysParticleFree(&part);
+        }
+      }
+      props |= 64;
+    } else {
+      ret = PBPhysJSONReaderSkip(&reader);
+    }
+  }
+  if (!ret || reader._error || props != 127 || nbLoaded != nbParticle)
+    return false;
+  (*that)->_curTime = curTime;
+  (*that)->_deltaT = deltaT;
+  (*that)->_downGravity = downGravity;
+  (*that)->_gravity = gravity;
+  // Return the success code
+  return true;
+}
+
+// Save the PBPhys 'that' on the stream 'stream' in binary format
+// The binary format is made of the magic number PBPHYS_BINMAGIC, the 
+// version (uint32), the dimension (int32), the current time, the delta 
+// t, the down gravity, the gravity (float), the number of particles 
+// (int64), and the fields of the particles in the order of 
+// PBPhysBinField, each as a packed array over all the particles, all 
+// in little endian
+// Values are saved exactly, a PBPhys saved and loaded in binary format 
+// is the same as the original one
+// Return true if we could save the PBPhys
+// Return false else
+bool PBPhysSaveBinary(const PBPhys* const that, FILE* const stream) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Save the header
+  int32_t dim = PBPhysGetDim(that);
+  float prop[4] = {that->_curTime, that->_deltaT, that->_downGravity, 
+    that->_gravity};
+  int64_t nbPart = PBPhysGetNbParticle(that);
+  if (!PBPhysWriteBinaryHeader(PBPHYS_BINMAGIC, stream) ||
+    !PBPhysWriteLE(&dim, sizeof(int32_t), 1, stream) ||
+    !PBPhysWriteLE(prop, sizeof(float), 4, stream) ||
+    !PBPhysWriteLE(&nbPart, sizeof(int64_t), 1, stream))
+    return false;
+  if (nbPart == 0)
+    return true;
+  // Get the particles in the order of the set, they must all have the 
+  // dimension of the PBPhys
+  PBPhysParticle** parts = 
+    PBErrMalloc(PBPhysErr, sizeof(PBPhysParticle*) * nbPart);
+  bool ret = true;
+  GSetIterForward iter = 
+    GSetIterForwardCreateStatic(PBPhysParticles(that));
+  long iPart = 0;
+  do {
+    parts[iPart] = GSetIterGet(&iter);
+    if (PBPhysParticleGetDim(parts[iPart]) != dim)
+      ret = false;
+    ++iPart;
+  } while (GSetIterStep(&iter));
+  // Save the particles
+  if (ret)
+    ret = PBPhysParticlesSaveBinary(parts, nbPart, dim, stream);
+  // Free memory
+  free(parts);
+  // Return the success code
+  return ret;
+}
+
+// Load the PBPhys 'that' from the stream 'stream' in binary format
+// Return true if we could load the PBPhys
+// Return false else
+bool PBPhysLoadBinary(PBPhys** that, FILE* const stream) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // If 'that' is already allocated
+  if (*that != NULL)
+    // Free memory
+    PBPhysFree(that);
+  // Load the header
+  int32_t dim = 0;
+  float prop[4] = {0.0};
+  int64_t nbPart = 0;
+  if (!PBPhysReadBinaryHeader(PBPHYS_BINMAGIC, stream) ||
+    !PBPhysReadLE(&dim, sizeof(int32_t), 1, stream) ||
+    !PBPhysReadLE(prop, sizeof(float), 4, stream) ||
+    !PBPhysReadLE(&nbPart, sizeof(int64_t), 1, stream) ||
+    dim <= 0 || nbPart < 0)
+    return false;
+  // Allocate memory
+  *that = PBPhysCreate(dim);
+  (*that)->_curTime = prop[0];
+  (*that)->_deltaT = prop[1];
+  (*that)->_downGravity = prop[2];
+  (*that)->_gravity = prop[3];
+  if (nbPart == 0)
+    return true;
+  // Load the particles
+  PBPhysParticle** parts = 
+    PBErrMalloc(PBPhysErr, sizeof(PBPhysParticle*) * nbPart);
+  for (long iPart = 0; iPart < nbPart; ++iPart)
+    parts[iPart] = NULL;
+  bool ret = PBPhysParticlesLoadBinary(parts, nbPart, dim, stream);
+  // Add the particles to the PBPhys, or free them if the loading failed
+  for (long iPart = 0; iPart < nbPart; ++iPart) {
+    if (ret)
+      GSetAppend(PBPhysParticles(*that), parts[iPart]);
+    else
+      PBPhysParticleFree(parts + iPart);
+  }
+  free(parts);
+  if (!ret)
+    PBPhysFree(that);
+  // Return the success code
+  return ret;
+}
+
+// Step the PBPhys 'that' by that->_deltaT ignoring collision
+// The system acceleration of all the particles is calculated from 
+// their state at the beginning of the step before any particle is 
+// moved, then the result doesn't depend on the order of the particles
+void PBPhysNext(PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  PBPHYS_TRACE_BEGIN(that, 0, "next");
+  // Memorize the start time of the step if its latency is recorded
+  double tStart = 
+    (that->_stepTimeHisto != NULL ? PBPhysGetWallTime() : 0.0);
+#if PBPHYS_STATS
+  unsigned long nbAlloc = pbphysNbAlloc;
+#endif
+  PBPHYS_PHASE_START(that, PBPhysPhaseSysAccel, tSysAccel);
+  // Get the table of particles
+  PBPhysParticle** parts = PBPhysUpdateTable(that);
+  // Calculate the gravity between particles if the Barnes-Hut tree 
+  // is used
+  PBPhysUpdateGravityBH(that);
+  // Declare the data of the jobs run by the threads
+  PBPhysStepJob job;
+  job._phys = that;
+  job._parts = parts;
+  job._deltat = PBPhysGetDeltaT(that);
+  job._tolerance = 0.0;
+  job._all = false;
+  // Calculate the system acceleration of all the particles, their 
+  // state is only read during this phase
+  PBPhysRunJob(that, PBPhysJobUpdateSysAccel, &job);
+  PBPHYS_PHASE_STOP(that, PBPhysPhaseSysAccel, tSysAccel);
+  // Move the particles, each one only depends on its own state during 
+  // this phase
+  PBPHYS_PHASE_START(that, PBPhysPhaseMove, tMove);
+  PBPhysRunJob(that, PBPhysJobMove, &job);
+  PBPHYS_PHASE_STOP(that, PBPhysPhaseMove, tMove);
+#if PBPHYS_STATS
+  that->_stats._nbAlloc += pbphysNbAlloc - nbAlloc;
+#endif
+  // Update current time
+  PBPhysSetCurTime(that, 
+    PBPhysGetCurTime(that) + PBPhysGetDeltaT(that));
+  // Put to sleep the particles at rest
+  PBPhysUpdateSleep(that);
+  // Record the trajectory and archive the state
+  PBPhysEndStep(that);
+  PBPhysAddStepLatency(that, tStart, 0);
+  PBPHYS_TRACE_END(that, 0, "next");
+}
+
+// Calculate the system acceleration of the 'iPart'-th particle of the 
+// table of particles of the PBPhys 'that'
+// The table of particles of 'that' must be up to date, and the gravity 
+// calculated by PBPhysUpdateGravityBH if the Barnes-Hut tree is used
+void PBPhysUpdateSysAccel(const PBPhys* const that, const long iPart) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (iPart < 0 || iPart >= PBPhysGetNbParticle(that)) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'iPart' is invalid (0<=%ld<%d)",
+      iPart, PBPhysGetNbParticle(that));
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  PBPhysParticle* particle = (that->_soa != NULL ? 
+    that->_soa->_particles[iPart] : that->_table[iPart]);
+  // Reset the system acceleration
+  PBPhysParticleResetSysAccel(particle);
+  // If the particle is fixed there is nothing to do
+  if (PBPhysParticleIsFixed(particle))
+    return;
+  // If the down gravity is active
+  if (fabs(PBPhysGetDownGravity(that)) > PBMATH_EPSILON) {
+    // Substract the down gravity to the y axis of the system 
+    // acceleration
+    PBPhysParticleApplyGravity(particle, PBPhysGetDownGravity(that));
+  }
+  // If the gravity is active and calculated with the Barnes-Hut tree
+  if (fabs(PBPhysGetGravity(that)) > PBMATH_EPSILON && 
+    PBPhysGetGravitySolver(that) == PBPhysGravitySolverBarnesHut) {
+    // Apply the force calculated with the tree
+    const float* force = that->_bhTree->_force + 
+      PBPhysGetDim(that) * iPart;
+    for (int iDim = PBPhysGetDim(that); iDim--;)
+      VecSetAdd(particle->_sysAccel, iDim, force[iDim]);
+  // Else, if the gravity is active and the particles' state is stored 
+  // in the PBPhys
+  } else if (fabs(PBPhysGetGravity(that)) > PBMATH_EPSILON && 
+    that->_soa != NULL) {
+    // Apply the gravity using directly the arrays
+    PBPhysUpdateSysAccelSoA(that, particle);
+  // Else, if the gravity is active
+  } else if (fabs(PBPhysGetGravity(that)) > PBMATH_EPSILON) {
+    // Get the center pos of the particle
+    VecFloat* centerParticle = PBPhysParticleGetPos(particle);
+    // Loop on particles
+    for (long jPart = 0; jPart < PBPhysGetNbParticle(that); ++jPart) {
+      PBPhysParticle* part = that->_table[jPart];
+      // If the current particle is not the particle in argument
+      if (particle != part) {
+        // Get the distance between the two particles
+        VecFloat* centerPart = PBPhysParticleGetPos(part);
+        float dist = VecDist(centerParticle, centerPart);
+        if (fabs(dist) > PBMATH_EPSILON) {
+          // Get the magnitude of the attraction
+          float mag = PBPhysGetGravity(that) * 
+            PBPhysParticleGetMass(particle) * 
+            PBPhysParticleGetMass(part) / fsquare(dist);
+          // Apply the attraction toward the other particle
+          VecOp(centerPart, 1.0, centerParticle, -1.0);
+          VecNormalise(centerPart);
+          PBPhysParticleAddSysAccel(particle, centerPart, mag);
+        }
+        // Free memory
+        VecFree(&centerPart);
+      }
+    }
+    // Free memory
+    VecFree(&centerParticle);
+  }
+}
+
+// If the gravity between particles of the PBPhys 'that' is active and 
+// calculated with the Barnes-Hut tree, calculate it for all the 
+// particles from their current state
+// The table of particles of 'that' must be up to date
+void PBPhysUpdateGravityBH(PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (fabs(PBPhysGetGravity(that)) <= PBMATH_EPSILON || 
+    PBPhysGetGravitySolver(that) != PBPhysGravitySolverBarnesHut)
+    return;
+  // Create the tree at first use
+  if (that->_bhTree == NULL)
+    that->_bhTree = PBPhysBHTreeCreate(PBPhysGetDim(that));
+  // Build the tree and calculate the forces
+  PBPhysParticle** parts = (that->_soa != NULL ? 
+    that->_soa->_particles : that->_table);
+  PBPhysBHTreeBuild(that->_bhTree, parts, PBPhysGetNbParticle(that));
+  PBPhysBHTreeUpdateForce(that->_bhTree, PBPhysGetGravity(that), 
+    PBPhysGetGravityTheta(that));
+}
+
+// Return the accuracy of the Barnes-Hut tree against the exact sum for 
+// the gravity between the particles of the PBPhys 'that' in their 
+// current state
+// The state of the particles is not modified
+PBPhysGravityReport PBPhysGetGravityReport(PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Declare the report
+  PBPhysGravityReport report;
+  report._nbParticle = PBPhysGetNbParticle(that);
+  report._maxRelErr = 0.0;
+  report._meanRelErr = 0.0;
+  report._nbInteraction = 0;
+  report._nbInteractionExact = 0;
+  if (report._nbParticle == 0)
+    return report;
+  // Calculate the forces with the tree
+  PBPhysParticle** parts = PBPhysUpdateTable(that);
+  if (that->_bhTree == NULL)
+    that->_bhTree = PBPhysBHTreeCreate(PBPhysGetDim(that));
+  PBPhysBHTree* tree = that->_bhTree;
+  PBPhysBHTreeBuild(tree, parts, report._nbParticle);
+  PBPhysBHTreeUpdateForce(tree, PBPhysGetGravity(that), 
+    PBPhysGetGravityTheta(that));
+  report._nbInteraction = tree->_nbInteraction;
+  // Compare with the exact sum, calculated in double precision from 
+  // the same bodies
+  int dim = PBPhysGetDim(that);
+  for (long iBody = 0; iBody < tree->_nbBody; ++iBody) {
+    const float* pos = tree->_bodyPos + dim * iBody;
+    double exact[dim];
+    for (int iDim = dim; iDim--;)
+      exact[iDim] = 0.0;
+    for (long jBody = 0; jBody < tree->_nbBody; ++jBody) {
+      if (jBody == iBody)
+        continue;
+      ++(report._nbInteractionExact);
+      const float* posJ = tree->_bodyPos + dim * jBody;
+      double dist = 0.0;
+      for (int iDim = dim; iDim--;)
+        dist += (posJ[iDim] - pos[iDim]) * (posJ[iDim] - pos[iDim]);
+      dist = sqrt(dist);
+      if (dist > PBMATH_EPSILON) {
+        double mag = (double)PBPhysGetGravity(that) * 
+          tree->_bodyMass[iBody] * tree->_bodyMass[jBody] / 
+          (dist * dist);
+        for (int iDim = dim; iDim--;)
+          exact[iDim] += mag * (posJ[iDim] - pos[iDim]) / dist;
+      }
+    }
+    // Get the relative error, or the absolute one if the exact force 
+    // is null
+    double normExact = 0.0;
+    double normErr = 0.0;
+    for (int iDim = dim; iDim--;) {
+      normExact += exact[iDim] * exact[iDim];
+      normErr += (tree->_force[dim * iBody + iDim] - exact[iDim]) *
+        (tree->_force[dim * iBody + iDim] - exact[iDim]);
+    }
+    normExact = sqrt(normExact);
+    normErr = sqrt(normErr);
+    float err = (normExact > PBMATH_EPSILON ? 
+      normErr / normExact : normErr);
+    if (err > report._maxRelErr)
+      report._maxRelErr = err;
+    report._meanRelErr += err;
+  }
+  report._meanRelErr /= (float)report._nbParticle;
+  // Return the report
+  return report;
+}
+
+// Add the gravity between particles to the system acceleration of the 
+// particle 'particle' in the PBPhys 'that' whose particles' state is 
+// stored in its structure of arrays
+void PBPhysUpdateSysAccelSoA(const PBPhys* const that, 
+  PBPhysParticle* const particle) {
+  const PBPhysSoA* soa = that->_soa;
+  long iParticle = particle->_iSoA;
+  // Loop on particles
+  for (long iPart = 0; iPart < soa->_nb; ++iPart) {
+    // If the current particle is not the particle in argument
+    if (iPart != iParticle) {
+      // Get the distance between the two particles
+      float dist = 0.0;
+      for (int iDim = soa->_dim; iDim--;)
+        dist += fsquare(PBPhysSoAGetCenter(soa, iPart, iDim) - 
+          PBPhysSoAGetCenter(soa, iParticle, iDim));
+      dist = sqrt(dist);
+      if (fabs(dist) > PBMATH_EPSILON) {
+        // Get the magnitude of the attraction
+        float mag = PBPhysGetGravity(that) * soa->_mass[iParticle] * 
+          soa->_mass[iPart] / fsquare(dist);
+        // Apply the attraction toward the other particle
+        for (int iDim = soa->_dim; iDim--;)
+          VecSetAdd(particle->_sysAccel, iDim, mag * 
+            (PBPhysSoAGetCenter(soa, iPart, iDim) - 
+            PBPhysSoAGetCenter(soa, iParticle, iDim)) / dist);
+      }
+    }
+  }
+}
+
+// Step the PBPhys 'that' by that->_deltaT managing collision(s)
+void PBPhysStep(PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  PBPHYS_TRACE_BEGIN(that, 0, "step");
+  // Memorize the start time of the step if its latency is recorded
+  double tStart = 
+    (that->_stepTimeHisto != NULL ? PBPhysGetWallTime() : 0.0);
+  // If the event driven scheduler is used
+  if (PBPhysGetScheduler(that) == PBPhysSchedulerEventDriven) {
+    long nbCollision = PBPhysStepEventDriven(that);
+    PBPhysUpdateSleep(that);
+    PBPhysEndStep(that);
+    PBPhysAddStepLatency(that, tStart, nbCollision + 1);
+    PBPHYS_TRACE_END(that, 0, "step");
+    return;
+  }
+  // Declare a variable to memorize the goal time
+  float goalT = PBPhysGetCurTime(that) + PBPhysGetDeltaT(that);
+  // Declare a variable to memorize the initial deltat
+  float origDeltaT = PBPhysGetDeltaT(that);
+  // Declare a variable to memorize the tolerance on the time of 
+  // collisions
+  float tolerance = PBPhysGetContactTolerance(that);
+  // Declare a variable to memorize the number of sub-steps
+  long nbIter = 0;
+  // Loop until we reach the goal time
+  while (PBPhysGetCurTime(that) < goalT) {
+    ++nbIter;
+    // Step until next collision(s)
+    GSetPBPhysParticle* set = (tolerance > 0.0 ? 
+      PBPhysStepToCollisions(that, tolerance) : 
+      PBPhysStepToCollision(that));
+    // If there has been collision
+    if (set != NULL) {
+      // Manage the collision(s)
+      PBPHYS_PHASE_START(that, PBPhysPhaseResolve, tResolve);
+      PBPhysParticleApplyElasticCollisions(set);
+      PBPHYS_STATS_ADD(that, _nbCollision, GSetNbElem(set) / 2);
+      // Correct the deltat to reach the initial goal time
+      PBPhysSetDeltaT(that, goalT - PBPhysGetCurTime(that));
+      // Free the set
+      GSetFree(&set);
+      PBPHYS_PHASE_STOP(that, PBPhysPhaseResolve, tResolve);
+    }
+  }
+  // Reset the initial deltat
+  PBPhysSetDeltaT(that, origDeltaT);
+  // Put to sleep the particles at rest
+  PBPhysUpdateSleep(that);
+  // Record the trajectory and archive the state
+  PBPhysEndStep(that);
+  PBPhysAddStepLatency(that, tStart, nbIter);
+  PBPHYS_TRACE_END(that, 0, "step");
+}
+
+// Record the trajectory and archive the state of the PBPhys 'that' at 
+// the end of a step if it has a recorder or an archive
+void PBPhysEndStep(PBPhys* const that) {
+  PBPHYS_STATS_ADD(that, _nbStep, 1);
+  PBPHYS_PHASE_START(that, PBPhysPhaseRecord, tRecord);
+  if (that->_recorder != NULL)
+    PBPhysRecorderRecord(that->_recorder);
+  // A failure is memorized by the archive and reported when it's closed
+  if (that->_archive != NULL)
+    (void)PBPhysArchiveAdd(that->_archive);
+  PBPHYS_PHASE_STOP(that, PBPhysPhaseRecord, tRecord);
+}
+
+// Record in the latency histograms of the PBPhys 'that', if they are 
+// recorded, the duration of the step started at 'tStart' and its 
+// number of sub-steps 'nbIter' (0 for PBPhysNext, which isn't split)
+void PBPhysAddStepLatency(PBPhys* const that, const double tStart, 
+  const long nbIter) {
+  if (that->_stepTimeHisto == NULL)
+    return;
+  double duration = PBPhysGetWallTime() - tStart;
+  PBPhysHistoAdd(that->_stepTimeHisto, 
+    (unsigned long)(duration > 0.0 ? 1e9 * duration : 0.0));
+  if (nbIter > 0)
+    PBPhysHistoAdd(that->_stepIterHisto, (unsigned long)nbIter);
+}
+
+#if PBPHYS_STATS
+// Add the statistics of the last search of collisions of the PBPhys 
+// 'that' to its statistics
+void PBPhysStatsAddSearch(PBPhys* const that) {
+  ++(that->_stats._nbSweep);
+  if (that->_threadPool == NULL) {
+    that->_stats._nbPairTest += that->_contacts._nbPairTest;
+    that->_stats._nbTOISolve += that->_contacts._nbTOISolve;
+  } else {
+    for (int iThread = PBPhysGetNbThread(that); iThread--;) {
+      PBPhysContacts* contacts = that->_threadContacts + iThread;
+      that->_stats._nbPairTest += contacts->_nbPairTest;
+      that->_stats._nbTOISolve += contacts->_nbTOISolve;
+      // The allocations of the calling thread, the thread 0, are 
+      // already counted by its own counter
+      if (iThread > 0)
+        that->_stats._nbAlloc += contacts->_nbAlloc;
+    }
+  }
+}
+#endif
+
+// Print the statistics of the steps 'that' on the stream 'stream'
+void PBPhysStatsPrintln(const PBPhysStats* const that, 
+  FILE* const stream) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  for (int iPhase = 0; iPhase < PBPhysPhaseNb; ++iPhase)
+    fprintf(stream, "time %s: %fs\n", pbphysPhaseName[iPhase], 
+      that->_time[iPhase]);
+  fprintf(stream, "nb step: %lu\n", that->_nbStep);
+  fprintf(stream, "nb sweep: %lu\n", that->_nbSweep);
+  fprintf(stream, "nb pair test: %lu\n", that->_nbPairTest);
+  fprintf(stream, "nb TOI solve: %lu\n", that->_nbTOISolve);
+  fprintf(stream, "nb collision: %lu\n", that->_nbCollision);
+  fprintf(stream, "nb alloc: %lu\n", that->_nbAlloc);
+}
+
+// Start (if 'flag' equals true) or stop (if 'flag' equals false) the 
+// recording of the phases of the steps of the PBPhys 'that' and of 
+// each PBPhysStepToCollision in its trace, one buffer per thread
+// The recorded events are kept when the tracing is stopped, until the 
+// trace is reset or 'that' is freed
+void PBPhysSetTracing(PBPhys* const that, const bool flag) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Create the trace at first use
+  if (flag && that->_trace == NULL)
+    that->_trace = PBPhysTraceCreate(PBPhysGetNbThread(that));
+  that->_tracing = flag;
+}
+
+// Save the trace of the PBPhys 'that' on the stream 'stream' in the 
+// Chrome trace event format, which can be opened with chrome://tracing 
+// or Perfetto
+// Return true if we could save, false else
+bool PBPhysSaveTrace(const PBPhys* const that, FILE* const stream) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (stream == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'stream' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // If 'that' has never been traced, save an empty trace
+  if (that->_trace == NULL) {
+    fprintf(stream, "{\"traceEvents\":[],\"displayTimeUnit\":\"ms\"}\n");
+    return !ferror(stream);
+  }
+  return PBPhysTraceSave(that->_trace, stream);
+}
+
+// Start (if 'flag' equals true) or stop (if 'flag' equals false) the 
+// recording of the latency histograms of the PBPhys 'that': the 
+// duration in nanoseconds of each PBPhysStep and PBPhysNext, and the 
+// number of sub-steps of each PBPhysStep (calls to 
+// PBPhysStepToCollision with the sequential scheduler, moves between 
+// collisions with the event driven scheduler)
+// The histograms are freed when the recording is stopped
+void PBPhysSetStepHistos(PBPhys* const that, const bool flag) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (flag && that->_stepTimeHisto == NULL) {
+    that->_stepTimeHisto = PBPhysHistoCreate();
+    that->_stepIterHisto = PBPhysHistoCreate();
+  } else if (!flag) {
+    PBPhysHistoFree(&(that->_stepTimeHisto));
+    PBPhysHistoFree(&(that->_stepIterHisto));
+  }
+}
+
+// Step the PBPhys 'that' for that->_deltaT or until a collision occured
+// If no collision occured return NULL
+// If a collision occured one can check the collision time with the 
+// current time that->_curTime, and the returned GSet contains the 
+// particles wich have collided
+GSetPBPhysParticle* PBPhysStepToCollision(PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return PBPhysStepToContacts(that, 0.0, false);
+}
+
+// Step the PBPhys 'that' for that->_deltaT or until the earliest 
+// collision, and return all the collisions occuring within 'tolerance' 
+// of the earliest one
+// If no collision occured return NULL
+// If collisions occured one can check the time of the earliest one 
+// with the current time that->_curTime, and the returned GSet contains 
+// the pairs of particles wich have collided, as consecutive elements 
+// in the order of the table of particles
+// The particles are moved to the time of the earliest collision, the 
+// other ones are considered to occur at the same time
+GSetPBPhysParticle* PBPhysStepToCollisions(PBPhys* const that, 
+  const float tolerance) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (tolerance < 0.0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'tolerance' is invalid (0.0<=%f)", 
+      tolerance);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  return PBPhysStepToContacts(that, tolerance, true);
+}
+
+// Step the PBPhys 'that' for that->_deltaT or until the earliest 
+// collision
+// If 'all' equals false return the earliest collision, else return 
+// all the collisions occuring within 'tolerance' of the earliest one
+// If no collision occured return NULL
+GSetPBPhysParticle* PBPhysStepToContacts(PBPhys* const that, 
+  const float tolerance, const bool all) {
+  PBPHYS_TRACE_BEGIN(that, 0, "step to collision");
+#if PBPHYS_STATS
+  unsigned long nbAlloc = pbphysNbAlloc;
+#endif
+  // Declare a variable to memorize the deltat until next collision
+  float deltat = PBPhysGetDeltaT(that);
+  // Reset the contacts, the set returned is created only if there is 
+  // a collision
+  that->_contacts._nb = 0;
+  // Get the table of particles
+  PBPhysParticle** parts = PBPhysUpdateTable(that);
+  long nbPart = PBPhysGetNbParticle(that);
+  // Declare the data of the jobs run by the threads
+  PBPhysStepJob job;
+  job._phys = that;
+  job._parts = parts;
+  job._deltat = deltat;
+  job._tolerance = tolerance;
+  job._all = all;
+  // If there is particle
+  if (nbPart > 0) {
+    // Calculate the gravity between particles if the Barnes-Hut tree 
+    // is used
+    PBPHYS_PHASE_START(that, PBPhysPhaseSysAccel, tSysAccel);
+    PBPhysUpdateGravityBH(that);
+    // Calculate the system acceleration of the particles
+    PBPhysRunJob(that, PBPhysJobUpdateSysAccel, &job);
+    PBPHYS_PHASE_STOP(that, PBPhysPhaseSysAccel, tSysAccel);
+    // If there is at least two particles
+    if (nbPart > 1) {
+      PBPHYS_PHASE_START(that, PBPhysPhaseSearch, tSearch);
+      // Get the position, displacement per time unit and bounding 
+      // radius of the particles
+      PBPhysUpdateScratch(that, PBPhysGetDeltaT(that));
+      // Get the pairs selected by the broad phase if one is used
+      if (PBPhysGetBroadPhase(that) != PBPhysBroadPhaseNone)
+        PBPhysUpdatePairs(that, 0.0);
+      // Search the collisions
+      PBPhysRunJob(that, PBPhysJobSearchContacts, &job);
+      // If the collisions have been searched by several threads, 
+      // merge their results
+      if (that->_threadPool != NULL)
+        PBPhysMergeContacts(that, all);
+      deltat = that->_contacts._tMin;
+      PBPHYS_PHASE_STOP(that, PBPhysPhaseSearch, tSearch);
+#if PBPHYS_STATS
+      PBPhysStatsAddSearch(that);
+#endif
+    }
+    // Move the particles
+    PBPHYS_PHASE_START(that, PBPhysPhaseMove, tMove);
+    job._deltat = deltat;
+    PBPhysRunJob(that, PBPhysJobMove, &job);
+    PBPHYS_PHASE_STOP(that, PBPhysPhaseMove, tMove);
+  }
+  // Update current time
+  PBPhysSetCurTime(that, PBPhysGetCurTime(that) + deltat);
+  // If there is collision, create the set of colliding particles, 
+  // discarding the collisions found before the earliest one and 
+  // occuring after the tolerance
+  GSetPBPhysParticle* setCollision = NULL;
+  if (that->_contacts._nb > 0) {
+    setCollision = GSetPBPhysParticleCreate();
+    PBPhysContacts* contacts = &(that->_contacts);
+    for (long iContact = 0; iContact < contacts->_nb; ++iContact) {
+      if (contacts->_time[iContact] - deltat <= tolerance) {
+        GSetAppend(setCollision, 
+          parts[contacts->_pairs[2 * iContact]]);
+        GSetAppend(setCollision, 
+          parts[contacts->_pairs[2 * iContact + 1]]);
+      }
+    }
+    // The set and each of its elements are allocated
+    PBPHYS_STATS_ALLOC(1 + GSetNbElem(setCollision));
+  }
+#if PBPHYS_STATS
+  that->_stats._nbAlloc += pbphysNbAlloc - nbAlloc;
+#endif
+  PBPHYS_TRACE_END(that, 0, "step to collision");
+  // Return the set of colliding particles
+  return setCollision;
+}
+
+// Search the collisions in the PBPhys 'that' between the pairs of 
+// particles from the 'iFirst'-th to the ('iEnd'-1)-th and memorize 
+// them in 'contacts'
+// If a broad phase is used the indices are the ones of the pairs it 
+// has selected, else they are the indices of the first particle of 
+// the pairs, each one paired with all the following particles except 
+// the pairs of fixed particles
+// If 'all' equals false only the earliest collision is memorized, 
+// else all the collisions occuring within 'tolerance' of the earliest 
+// one found so far are memorized
+// The scratch of 'that' must be up to date
+void PBPhysSearchContacts(const PBPhys* const that, const long iFirst, 
+  const long iEnd, const float tolerance, const bool all, 
+  PBPhysContacts* const contacts) {
+  // Declare a variable to memorize the time of the earliest collision
+  float deltat = PBPhysGetDeltaT(that);
+  // Declare a variable to memorize the limit of time of the 
+  // collisions, it's equal to deltat if only the earliest collision 
+  // is searched
+  float limit = deltat;
+  // Reset the contacts
+  contacts->_nb = 0;
+#if PBPHYS_STATS
+  unsigned long nbTOISolve = pbphysNbTOISolve;
+  unsigned long nbAlloc = pbphysNbAlloc;
+  contacts->_nbPairTest = 0;
+#endif
+  long nbPart = PBPhysGetNbParticle(that);
+  int dim = PBPhysGetDim(that);
+  // Loop on the pairs
+  for (long iPart = iFirst; iPart < iEnd; ++iPart) {
+    // Get the pairs of particles to check, a fixed particle is only 
+    // paired with the following particles which are not fixed
+    long iA = iPart;
+    long iB = iPart + 1;
+    long iBEnd = nbPart;
+    bool onlyDynamic = that->_tableInactive[iA];
+    if (PBPhysGetBroadPhase(that) != PBPhysBroadPhaseNone) {
+      iA = that->_pairs[2 * iPart];
+      iB = that->_pairs[2 * iPart + 1];
+      iBEnd = iB + 1;
+      onlyDynamic = false;
+    } else if (onlyDynamic) {
+      iB = PBPhysGetFirstDynamic(that, iB);
+      iBEnd = that->_nbDynamic;
+    }
+    const float* posA = that->_scratchPos + dim * iA;
+    const float* vA = that->_scratchSpeed + dim * iA;
+    float radA = that->_scratchRadius[iA];
+#if PBPHYS_STATS
+    contacts->_nbPairTest += iBEnd - iB;
+#endif
+    // Loop through the paired particles
+    for (; iB < iBEnd; ++iB) {
+      long jB = (onlyDynamic ? that->_dynamicPart[iB] : iB);
+      // Get the time at which the particles hit
+      float tHit = PBPhysGetPairTimeToHit(dim, posA, vA, radA, 
+        that->_scratchPos + dim * jB, that->_scratchSpeed + dim * jB, 
+        that->_scratchRadius[jB], limit);
+      // If the time at hit is sooner than the limit
+      if (tHit < limit) {
+        // Memorize the collision
+        PBPhysAddContact(contacts, iA, jB, tHit, all);
+        // Update the time of the earliest collision and the limit
+        if (tHit < deltat)
+          deltat = tHit;
+        limit = deltat;
+        if (all && deltat + tolerance < PBPhysGetDeltaT(that))
+          limit = deltat + tolerance;
+        else if (all)
+          limit = PBPhysGetDeltaT(that);
+      }
+    }
+  }
+  // Memorize the time of the earliest collision
+  contacts->_tMin = deltat;
+#if PBPHYS_STATS
+  contacts->_nbTOISolve = pbphysNbTOISolve - nbTOISolve;
+  contacts->_nbAlloc = pbphysNbAlloc - nbAlloc;
+#endif
+}
+
+// Merge the collisions found by the threads of the PBPhys 'that' into 
+// that->_contacts, in the order of the threads
+// If 'all' equals false only the earliest collision is kept
+void PBPhysMergeContacts(PBPhys* const that, const bool all) {
+  PBPhysContacts* contacts = &(that->_contacts);
+  int nbThread = PBPhysGetNbThread(that);
+  // Get the time of the earliest collision
+  contacts->_nb = 0;
+  contacts->_tMin = PBPhysGetDeltaT(that);
+  for (int iThread = 0; iThread < nbThread; ++iThread)
+    if (that->_threadContacts[iThread]._tMin < contacts->_tMin)
+      contacts->_tMin = that->_threadContacts[iThread]._tMin;
+  // Loop on the collisions found by the threads
+  for (int iThread = 0; iThread < nbThread; ++iThread) {
+    PBPhysContacts* threadContacts = that->_threadContacts + iThread;
+    for (long iContact = 0; iContact < threadContacts->_nb; 
+      ++iContact) {
+      // Keep all the collisions, or the first earliest one
+      if (all || (contacts->_nb == 0 && 
+        threadContacts->_time[iContact] == contacts->_tMin))
+        PBPhysAddContact(contacts, threadContacts->_pairs[2 * iContact],
+          threadContacts->_pairs[2 * iContact + 1], 
+          threadContacts->_time[iContact], true);
+    }
+  }
+}
+
+// Memorize the collision at time 'tHit' between the 'iPart'-th and 
+// 'jPart'-th particles in the table of particles into 'contacts'
+// If 'all' equals false the collision replaces the previous ones
+void PBPhysAddContact(PBPhysContacts* const contacts, const long iPart, 
+  const long jPart, const float tHit, const bool all) {
+  if (!all)
+    contacts->_nb = 0;
+  if (contacts->_nb == contacts->_capacity) {
+    long newCapacity = (contacts->_capacity == 0 ? 
+      PBPHYS_SOACAPACITY : 2 * contacts->_capacity);
+    contacts->_pairs = PBPhysSoAGrowArr(contacts->_pairs, 
+      sizeof(long) * 2, contacts->_nb, newCapacity);
+    contacts->_time = PBPhysSoAGrowArr(contacts->_time, 
+      sizeof(float), contacts->_nb, newCapacity);
+    contacts->_capacity = newCapacity;
+  }
+  contacts->_pairs[2 * contacts->_nb] = iPart;
+  contacts->_pairs[2 * contacts->_nb + 1] = jPart;
+  contacts->_time[contacts->_nb] = tHit;
+  ++(contacts->_nb);
+}
+
+// Run the job 'job' on the data 'data' with the threads of the PBPhys 
+// 'that', or with the current thread if it has no thread pool
+void PBPhysRunJob(PBPhys* const that, const PBPhysJob job, 
+  PBPhysStepJob* const data) {
+  if (that->_threadPool != NULL)
+    PBPhysThreadPoolRun(that->_threadPool, job, data);
+  else
+    job(data, 0, 1);
+}
+
+// Get in 'iFirst' and 'iEnd' the range of the 'nb' elements processed 
+// by the 'iThread'-th thread among 'nbThread' threads
+void PBPhysGetJobRange(const long nb, const int iThread, 
+  const int nbThread, long* const iFirst, long* const iEnd) {
+  *iFirst = nb * iThread / nbThread;
+  *iEnd = nb * (iThread + 1) / nbThread;
+}
+
+// Return the index of the first particle of the PBPhys 'that' whose 
+// pairs with the following particles are after the 'iPair'-th pair, 
+// the pairs of fixed particles being excluded
+// The partition of the particles of 'that' must be up to date
+long PBPhysGetFirstRow(const PBPhys* const that, const long iPair) {
+  long nbPart = PBPhysGetNbParticle(that);
+  long iRow = 0;
+  long nbPair = 0;
+  // Number of particles which are not fixed after the current row
+  long nbDynamic = that->_nbDynamic;
+  while (iRow < nbPart - 1 && nbPair < iPair) {
+    if (that->_tableInactive[iRow]) {
+      nbPair += nbDynamic;
+    } else {
+      nbPair += nbPart - 1 - iRow;
+      --nbDynamic;
+    }
+    ++iRow;
+  }
+  return iRow;
+}
+
+// Job calculating the system acceleration of the particles which are 
+// not fixed, 'data' is a PBPhysStepJob
+void PBPhysJobUpdateSysAccel(void* const data, const int iThread, 
+  const int nbThread) {
+  PBPhysStepJob* job = data;
+  PBPHYS_TRACE_BEGIN(job->_phys, iThread, "sys accel job");
+  long iFirst = 0;
+  long iEnd = 0;
+  PBPhysGetJobRange(job->_phys->_nbDynamic, iThread, nbThread,
+    &iFirst, &iEnd);
+  for (long iPart = iFirst; iPart < iEnd; ++iPart)
+    PBPhysUpdateSysAccel(job->_phys, job->_phys->_dynamicPart[iPart]);
+  PBPHYS_TRACE_END(job->_phys, iThread, "sys accel job");
+}
+
+// Job moving the particles which are not fixed by job->_deltat, 
+// 'data' is a PBPhysStepJob
+void PBPhysJobMove(void* const data, const int iThread, 
+  const int nbThread) {
+  PBPhysStepJob* job = data;
+  PBPHYS_TRACE_BEGIN(job->_phys, iThread, "move job");
+  long iFirst = 0;
+  long iEnd = 0;
+  PBPhysGetJobRange(job->_phys->_nbDynamic, iThread, nbThread,
+    &iFirst, &iEnd);
+  for (long iPart = iFirst; iPart < iEnd; ++iPart)
+    PBPhysParticleMove(job->_parts[job->_phys->_dynamicPart[iPart]], 
+      job->_deltat);
+  PBPHYS_TRACE_END(job->_phys, iThread, "move job");
+}
+
+// Job searching the collisions, 'data' is a PBPhysStepJob
+// The pairs are split between the threads so that they all check the 
+// same number of pairs, and each thread memorizes its collisions in 
+// its own PBPhysContacts
+void PBPhysJobSearchContacts(void* const data, const int iThread, 
+  const int nbThread) {
+  PBPhysStepJob* job = data;
+  PBPhys* that = job->_phys;
+  PBPHYS_TRACE_BEGIN(that, iThread, "search job");
+  PBPhysContacts* contacts = (nbThread == 1 ? 
+    &(that->_contacts) : that->_threadContacts + iThread);
+  long iFirst = 0;
+  long iEnd = 0;
+  if (PBPhysGetBroadPhase(that) != PBPhysBroadPhaseNone) {
+    PBPhysGetJobRange(that->_nbPair, iThread, nbThread, 
+      &iFirst, &iEnd);
+  } else {
+    long nbPart = PBPhysGetNbParticle(that);
+    long nbFixed = nbPart - that->_nbDynamic;
+    PBPhysGetJobRange(nbPart * (nbPart - 1) / 2 - 
+      nbFixed * (nbFixed - 1) / 2, iThread, nbThread, &iFirst, &iEnd);
+    iFirst = PBPhysGetFirstRow(that, iFirst);
+    iEnd = PBPhysGetFirstRow(that, iEnd);
+  }
+  PBPhysSearchContacts(that, iFirst, iEnd, job->_tolerance, job->_all,
+    contacts);
+  PBPHYS_TRACE_END(that, iThread, "search job");
+}
+
+// Set the number of threads used by the PBPhys 'that' to 'nbThread'
+// The system acceleration, the move of the particles and the search of 
+// collisions are split between the threads, which are kept alive 
+// until the number of threads is changed or 'that' is freed
+// The results are the same whatever the number of threads
+// The event driven scheduler stays single threaded
+void PBPhysSetNbThread(PBPhys* const that, const int nbThread) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (nbThread < 1) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'nbThread' is invalid (1<=%d)", 
+      nbThread);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // If the number of threads doesn't change, nothing to do
+  if (nbThread == PBPhysGetNbThread(that))
+    return;
+  // Free the current threads
+  PBPhysFreeThreads(that);
+  // If several threads are requested
+  if (nbThread > 1) {
+    // Create the pool of threads and their contacts
+    that->_threadPool = PBPhysThreadPoolCreate(nbThread);
+    that->_threadContacts = 
+      PBErrMalloc(PBPhysErr, sizeof(PBPhysContacts) * nbThread);
+    for (int iThread = 0; iThread < nbThread; ++iThread)
+      PBPhysContactsInit(that->_threadContacts + iThread);
+    // Give a buffer of the trace to the new threads
+    if (that->_trace != NULL)
+      PBPhysTraceSetNbThread(that->_trace, nbThread);
+  }
+}
+
+// Initialise the empty PBPhysContacts 'that'
+void PBPhysContactsInit(PBPhysContacts* const that) {
+  that->_pairs = NULL;
+  that->_time = NULL;
+  that->_nb = 0;
+  that->_capacity = 0;
+  that->_tMin = 0.0;
+  that->_nbPairTest = 0;
+  that->_nbTOISolve = 0;
+  that->_nbAlloc = 0;
+}
+
+// Free the memory used by the arrays of the PBPhysContacts 'that'
+void PBPhysContactsFreeArr(PBPhysContacts* const that) {
+  free(that->_pairs);
+  free(that->_time);
+  PBPhysContactsInit(that);
+}
+
+// Free the pool of threads of the PBPhys 'that' and the contacts of 
+// its threads
+void PBPhysFreeThreads(PBPhys* const that) {
+  if (that->_threadContacts != NULL) {
+    for (int iThread = 0; iThread < PBPhysGetNbThread(that); ++iThread)
+      PBPhysContactsFreeArr(that->_threadContacts + iThread);
+    free(that->_threadContacts);
+    that->_threadContacts = NULL;
+  }
+  PBPhysThreadPoolFree(&(that->_threadPool));
+}
+
+// Return the time at which two particles at 'posA' and 'posB', moving 
+// at speed 'vA' and 'vB' and of bounding radius 'rA' and 'rB' hit 
+// each other if it's sooner than 'deltat', else return 'deltat'
+// Positions and speeds are arrays of 'dim' values
+float PBPhysGetPairTimeToHit(const int dim, const float* const posA, 
+  const float* const vA, const float rA, const float* const posB, 
+  const float* const vB, const float rB, const float deltat) {
+  // Check the pair trajectory to determine at what time they
+  // are at the closest and what is this closest distance, same 
+  // operations as PBPhysGetDistPoly
+  VecFloat3D distPoly = VecFloatCreateStatic3D();
+  for (int iDim = dim; iDim--;) {
+    VecSetAdd(&distPoly, 0, fsquare(posA[iDim] - posB[iDim]));
+    VecSetAdd(&distPoly, 1, 
+      (posA[iDim] - posB[iDim]) * (vA[iDim] - vB[iDim]));
+    VecSetAdd(&distPoly, 2, fsquare(vA[iDim] - vB[iDim]));
+  }
+  VecSet(&distPoly, 1, VecGet(&distPoly, 1) * 2.0);
+  float tNearest = deltat;
+  if (fabs(VecGet(&distPoly, 2)) > PBMATH_EPSILON)
+    tNearest = -0.5 * VecGet(&distPoly, 1) / VecGet(&distPoly, 2);
+  float distNearest = sqrt(VecGet(&distPoly, 0) + 
+    tNearest * VecGet(&distPoly, 1) +
+    fsquare(tNearest) * VecGet(&distPoly, 2));
+  // If there is an impact in future
+  if (tNearest > 0.0 && distNearest < rA + rB) {
+    // Get the exact time at which particles hit
+#if PBPHYS_STATS
+    ++pbphysNbTOISolve;
+#endif
+    float tHit = PBPhysGetTimeToHit(rA, rB, &distPoly);
+    // If the time at hit is sooner than current delta
+    if (tHit < deltat)
+      return tHit;
+  }
+  return deltat;
+}
+
+// Return the bounding radius of the 'iPart'-th particle in the table 
+// of particles of the PBPhys 'that'
+float PBPhysGetBoundingRadius(const PBPhys* const that, 
+  const long iPart) {
+  if (that->_soa != NULL)
+    return that->_soa->_radius[iPart];
+  return ShapoidGetBoundingRadius(
+    PBPhysParticleShape(that->_table[iPart]));
+}
+
+// Update the pairs of particles of the PBPhys 'that' selected by its 
+// broad phase, the swept boxes are enlarged by 'margin'
+// The table of particles of 'that' and the system acceleration of the 
+// particles must be up to date
+void PBPhysUpdatePairs(PBPhys* const that, const float margin) {
+  long nbPart = PBPhysGetNbParticle(that);
+  PBPhysParticle** parts = (that->_soa != NULL ? 
+    that->_soa->_particles : that->_table);
+  int dim = PBPhysGetDim(that);
+  // The Verlet neighbour lists are kept as long as they are valid, 
+  // they are consumed directly from the array of pairs
+  if (PBPhysGetBroadPhase(that) == PBPhysBroadPhaseVerlet) {
+    // Create the lists at first use
+    if (that->_verlet == NULL)
+      that->_verlet = PBPhysVerletCreate(dim);
+    ++(that->_verlet->_nbUpdate);
+    if (PBPhysIsVerletValid(that, parts))
+      return;
+  }
+  that->_nbPair = 0;
+  switch (PBPhysGetBroadPhase(that)) {
+    case PBPhysBroadPhaseGrid:
+      // Create the grid at first use
+      if (that->_grid == NULL)
+        that->_grid = PBPhysGridCreate(dim);
+      PBPhysGrid* grid = that->_grid;
+      // Set the boxes to the bounding boxes of the particles swept 
+      // over deltaT
+      PBPhysGridSetNbPart(grid, nbPart);
+      PBPhysGetSweptBoxes(that, parts, margin, 
+        grid->_boxMin, grid->_boxMax);
+      // Build the grid and get the pairs
+      PBPhysGridBuild(grid);
+      PBPhysGridGetPairs(grid, that->_tableInactive, 
+        &(that->_pairs), &(that->_nbPair), 
+        &(that->_pairCapacity));
+      break;
+    case PBPhysBroadPhaseSAP:
+      // Create the sweep and prune at first use
+      if (that->_sap == NULL)
+        that->_sap = PBPhysSAPCreate(dim);
+      PBPhysSAP* sap = that->_sap;
+      // Set the boxes to the bounding boxes of the particles swept 
+      // over deltaT
+      PBPhysSAPSetNbPart(sap, nbPart);
+      PBPhysGetSweptBoxes(that, parts, margin, 
+        sap->_boxMin, sap->_boxMax);
+      // Sort the boxes and get the pairs
+      PBPhysSAPBuild(sap);
+      PBPhysSAPGetPairs(sap, that->_tableInactive, 
+        &(that->_pairs), &(that->_nbPair), 
+        &(that->_pairCapacity));
+      break;
+    case PBPhysBroadPhaseBVH:
+      // Create the bounding volume hierarchy at first use
+      if (that->_bvh == NULL)
+        that->_bvh = PBPhysBVHCreate(dim);
+      PBPhysBVH* bvh = that->_bvh;
+      // Set the boxes to the bounding boxes of the particles swept 
+      // over deltaT, and the flags of the fixed particles
+      PBPhysBVHSetNbPart(bvh, nbPart);
+      PBPhysGetSweptBoxes(that, parts, margin, 
+        bvh->_boxMin, bvh->_boxMax);
+      memcpy(bvh->_fixed, that->_tableInactive, sizeof(bool) * nbPart);
+      // Update the trees and get the pairs
+      PBPhysBVHUpdate(bvh);
+      PBPhysBVHGetPairs(bvh, &(that->_pairs), &(that->_nbPair), 
+        &(that->_pairCapacity));
+      break;
+    case PBPhysBroadPhaseVerlet:
+      PBPhysBuildVerlet(that, parts);
+      break;
+    default:
+      break;
+  }
+  // Sort the pairs in the order of the table, to get the same result 
+  // as without broad phase when several pairs hit at the same time
+  if (that->_nbPair > 1)
+    qsort(that->_pairs, that->_nbPair, sizeof(long) * 2, 
+      PBPhysComparePairs);
+}
+
+// Set the arrays 'boxMin' and 'boxMax' (dim values per particle) to 
+// the bounding boxes of the particles 'parts' of the PBPhys 'that' 
+// swept over its deltaT and enlarged by 'margin'
+void PBPhysGetSweptBoxes(const PBPhys* const that, 
+  PBPhysParticle** const parts, const float margin, 
+  float* const boxMin, float* const boxMax) {
+  int dim = PBPhysGetDim(that);
+  for (long iPart = PBPhysGetNbParticle(that); iPart--;) {
+    float* partMin = boxMin + dim * iPart;
+    float* partMax = boxMax + dim * iPart;
+    PBPhysParticleCopyPos(parts[iPart], partMin);
+    float rad = PBPhysGetBoundingRadius(that, iPart) + margin + 
+      PBMATH_EPSILON;
+    for (int iDim = dim; iDim--;) {
+      float disp = PBPhysParticleGetNextDisplacementAt(
+        parts[iPart], PBPhysGetDeltaT(that), iDim);
+      partMax[iDim] = partMin[iDim] + rad;
+      partMin[iDim] -= rad;
+      if (disp < 0.0)
+        partMin[iDim] += disp;
+      else
+        partMax[iDim] += disp;
+    }
+  }
+}
+
+// Return true if the Verlet neighbour lists of the PBPhys 'that' 
+// still contain all the pairs of particles which can collide before 
+// the end of its deltaT
+// Return false else
+// The scratch of 'that' must be up to date
+bool PBPhysIsVerletValid(const PBPhys* const that, 
+  PBPhysParticle** const parts) {
+  const PBPhysVerlet* verlet = that->_verlet;
+  long nbPart = PBPhysGetNbParticle(that);
+  if (!verlet->_isBuilt || verlet->_nbPart != nbPart)
+    return false;
+  int dim = PBPhysGetDim(that);
+  float deltat = PBPhysGetDeltaT(that);
+  for (long iPart = 0; iPart < nbPart; ++iPart) {
+    // The lists are built again if the table, the bounding radius or 
+    // the partition have changed
+    if (parts[iPart] != verlet->_part[iPart] || 
+      that->_scratchRadius[iPart] != verlet->_radius[iPart] || 
+      that->_tableInactive[iPart] != verlet->_inactive[iPart])
+      return false;
+    // Get the distance from the position at the build, and the 
+    // displacement until the end of the step, and check that the 
+    // particle stays within its margin
+    float moved = 0.0;
+    float disp = 0.0;
+    for (int iDim = dim; iDim--;) {
+      moved += fsquare(that->_scratchPos[dim * iPart + iDim] - 
+        verlet->_pos[dim * iPart + iDim]);
+      disp += fsquare(that->_scratchSpeed[dim * iPart + iDim]);
+    }
+    if (sqrt(moved) + sqrt(disp) * deltat > verlet->_margin[iPart])
+      return false;
+  }
+  return true;
+}
+
+// Build the Verlet neighbour lists of the particles 'parts' of the 
+// PBPhys 'that' into its array of pairs
+// The scratch of 'that' must be up to date
+void PBPhysBuildVerlet(PBPhys* const that, 
+  PBPhysParticle** const parts) {
+  PBPhysVerlet* verlet = that->_verlet;
+  long nbPart = PBPhysGetNbParticle(that);
+  int dim = PBPhysGetDim(that);
+  float deltat = PBPhysGetDeltaT(that);
+  float halfSkin = 0.5 * PBPhysGetVerletSkin(that);
+  // Create the grid at first use
+  if (verlet->_grid == NULL)
+    verlet->_grid = PBPhysGridCreate(dim);
+  PBPhysGrid* grid = verlet->_grid;
+  PBPhysVerletSetNbPart(verlet, nbPart);
+  PBPhysGridSetNbPart(grid, nbPart);
+  // Memorize the state of the particles, and set the boxes of the 
+  // grid to the bounding boxes of the particles enlarged by their 
+  // margin
+  for (long iPart = 0; iPart < nbPart; ++iPart) {
+    const float* pos = that->_scratchPos + dim * iPart;
+    float disp = 0.0;
+    for (int iDim = dim; iDim--;)
+      disp += fsquare(that->_scratchSpeed[dim * iPart + iDim]);
+    disp = sqrt(disp) * deltat;
+    float margin = (disp > halfSkin ? disp : halfSkin);
+    float rad = that->_scratchRadius[iPart] + margin + PBMATH_EPSILON;
+    for (int iDim = dim; iDim--;) {
+      grid->_boxMin[dim * iPart + iDim] = pos[iDim] - rad;
+      grid->_boxMax[dim * iPart + iDim] = pos[iDim] + rad;
+    }
+    memcpy(verlet->_pos + dim * iPart, pos, sizeof(float) * dim);
+    verlet->_part[iPart] = parts[iPart];
+    verlet->_radius[iPart] = that->_scratchRadius[iPart];
+    verlet->_inactive[iPart] = that->_tableInactive[iPart];
+    verlet->_margin[iPart] = margin;
+  }
+  // Get the pairs whose boxes overlap
+  PBPhysGridBuild(grid);
+  PBPhysGridGetPairs(grid, that->_tableInactive, 
+    &(that->_pairs), &(that->_nbPair), &(that->_pairCapacity));
+  // Keep only the pairs whose enlarged bounding spheres overlap
+  long nbPair = 0;
+  for (long iPair = 0; iPair < that->_nbPair; ++iPair) {
+    long iPart = that->_pairs[2 * iPair];
+    long jPart = that->_pairs[2 * iPair + 1];
+    float dist = 0.0;
+    for (int iDim = dim; iDim--;)
+      dist += fsquare(that->_scratchPos[dim * iPart + iDim] - 
+        that->_scratchPos[dim * jPart + iDim]);
+    float reach = that->_scratchRadius[iPart] + verlet->_margin[iPart] + 
+      that->_scratchRadius[jPart] + verlet->_margin[jPart] + 
+      2.0 * PBMATH_EPSILON;
+    if (dist <= fsquare(reach)) {
+      that->_pairs[2 * nbPair] = iPart;
+      that->_pairs[2 * nbPair + 1] = jPart;
+      ++nbPair;
+    }
+  }
+  that->_nbPair = nbPair;
+  verlet->_isBuilt = true;
+  ++(verlet->_nbBuild);
+}
+
+// Step the PBPhys 'that' by that->_deltaT managing collision(s) with 
+// the event driven scheduler
+// Return the number of collisions resolved
+long PBPhysStepEventDriven(PBPhys* const that) {
+#if PBPHYS_STATS
+  unsigned long nbTOISolve = pbphysNbTOISolve;
+  unsigned long nbAlloc = pbphysNbAlloc;
+#endif
+  // Declare a variable to memorize the number of collisions
+  long nbCollision = 0;
+  // Declare a variable to memorize the goal time
+  float goalT = PBPhysGetCurTime(that) + PBPhysGetDeltaT(that);
+  // Get the table of particles
+  PBPhysParticle** parts = PBPhysUpdateTable(that);
+  long nbPart = PBPhysGetNbParticle(that);
+  // If there is particle
+  if (nbPart > 0) {
+    // Calculate the system acceleration of the particles, once for 
+    // the whole step
+    PBPHYS_PHASE_START(that, PBPhysPhaseSysAccel, tSysAccel);
+    PBPhysUpdateGravityBH(that);
+    for (long iPart = 0; iPart < that->_nbDynamic; ++iPart)
+      PBPhysUpdateSysAccel(that, that->_dynamicPart[iPart]);
+    PBPHYS_PHASE_STOP(that, PBPhysPhaseSysAccel, tSysAccel);
+    PBPHYS_PHASE_START(that, PBPhysPhaseSearch, tSearch);
+    // Create the event queue at first use
+    if (that->_events == NULL)
+      that->_events = PBPhysEventQueueCreate(PBPhysGetDim(that));
+    PBPhysEventQueue* events = that->_events;
+    PBPhysEventQueueSetNbPart(events, nbPart);
+    events->_nbCollision = 0;
+    events->_nbTest = 0;
+    events->_nbBuild = 0;
+    for (long iPart = nbPart; iPart--;) {
+      events->_count[iPart] = 0;
+      events->_localTime[iPart] = PBPhysGetCurTime(that);
+    }
+    // Select the neighbours and predict the collisions between them
+    PBPhysInitEvents(that, parts, goalT);
+    PBPHYS_PHASE_STOP(that, PBPhysPhaseSearch, tSearch);
+    // Loop on the events, until there is no more collision before the 
+    // end of the step
+    while (events->_partner[events->_heap[0]] != -1) {
+      // Get the particles of the next collision
+      long iPart = events->_heap[0];
+      long jPart = events->_partner[iPart];
+      // If the partner has collided since the prediction
+      if (events->_partnerCount[iPart] != events->_count[jPart]) {
+        // Predict again the next collision of the particle
+        PBPHYS_PHASE_START(that, PBPhysPhaseSearch, tPredict);
+        events->_time[iPart] = goalT;
+        events->_partner[iPart] = -1;
+        PBPhysEventQueueUpdate(events, iPart);
+        PBPhysPredictCollision(that, iPart, goalT);
+        PBPHYS_PHASE_STOP(that, PBPhysPhaseSearch, tPredict);
+      } else {
+        // Move the two particles until the collision, the other ones 
+        // stay at their local time
+        PBPHYS_PHASE_START(that, PBPhysPhaseMove, tMove);
+        float t = events->_time[iPart];
+        PBPhysSetCurTime(that, t);
+        long pair[2] = {iPart, jPart};
+        for (int iPair = 2; iPair--;) {
+          long kPart = pair[iPair];
+          if (!that->_tableInactive[kPart])
+            PBPhysParticleMove(parts[kPart], 
+              t - events->_localTime[kPart]);
+          events->_localTime[kPart] = t;
+        }
+        PBPHYS_PHASE_STOP(that, PBPhysPhaseMove, tMove);
+        // Manage the collision
+        PBPHYS_PHASE_START(that, PBPhysPhaseResolve, tResolve);
+        bool wakeUp = PBPhysParticleIsAsleep(parts[iPart]) || 
+          PBPhysParticleIsAsleep(parts[jPart]);
+        PBPhysParticleApplyElasticCollision(parts[iPart], parts[jPart]);
+        ++(events->_count[iPart]);
+        ++(events->_count[jPart]);
+        ++(events->_nbCollision);
+        // If the collision has woken up a particle, it moves with its 
+        // system acceleration until the end of the step
+        if (wakeUp) {
+          if (that->_tableInactive[iPart])
+            PBPhysUpdateSysAccel(that, iPart);
+          if (that->_tableInactive[jPart])
+            PBPhysUpdateSysAccel(that, jPart);
+          PBPhysUpdatePartition(that, parts);
+        }
+        PBPHYS_PHASE_STOP(that, PBPhysPhaseResolve, tResolve);
+        // Predict again the next collision of the two particles
+        PBPHYS_PHASE_START(that, PBPhysPhaseSearch, tPredict);
+        PBPhysUpdateScratchOf(that, parts, iPart, goalT - t);
+        PBPhysUpdateScratchOf(that, parts, jPart, goalT - t);
+        // If a particle leaves the ball where its neighbours are valid, 
+        // or a particle woken up needs the pairs with the inactive 
+        // ones, select the neighbours again
+        if (wakeUp || !PBPhysIsInReach(that, iPart, goalT) || 
+          !PBPhysIsInReach(that, jPart, goalT)) {
+          PBPhysInitEvents(that, parts, goalT);
+        } else {
+          for (int iPair = 2; iPair--;) {
+            events->_time[pair[iPair]] = goalT;
+            events->_partner[pair[iPair]] = -1;
+            PBPhysEventQueueUpdate(events, pair[iPair]);
+          }
+          PBPhysPredictCollision(that, iPart, goalT);
+          PBPhysPredictCollision(that, jPart, goalT);
+        }
+        PBPHYS_PHASE_STOP(that, PBPhysPhaseSearch, tPredict);
+      }
+    }
+    // Move the particles until the end of the step
+    PBPHYS_PHASE_START(that, PBPhysPhaseMove, tMove);
+    for (long iPart = 0; iPart < that->_nbDynamic; ++iPart) {
+      long kPart = that->_dynamicPart[iPart];
+      if (events->_localTime[kPart] < goalT)
+        PBPhysParticleMove(parts[kPart], 
+          goalT - events->_localTime[kPart]);
+    }
+    PBPHYS_PHASE_STOP(that, PBPhysPhaseMove, tMove);
+    nbCollision = events->_nbCollision;
+#if PBPHYS_STATS
+    that->_stats._nbPairTest += events->_nbTest;
+    that->_stats._nbCollision += events->_nbCollision;
+    that->_stats._nbSweep += events->_nbBuild;
+#endif
+  }
+  // Update current time
+  if (PBPhysGetCurTime(that) < goalT)
+    PBPhysSetCurTime(that, goalT);
+#if PBPHYS_STATS
+  that->_stats._nbTOISolve += pbphysNbTOISolve - nbTOISolve;
+  that->_stats._nbAlloc += pbphysNbAlloc - nbAlloc;
+#endif
+  // Return the number of collisions
+  return nbCollision;
+}
+
+// Update the scratch of the PBPhys 'that' with the position, the 
+// displacement over 'deltat' per time unit and the bounding radius of 
+// its particles
+// The table of particles of 'that' and the system acceleration of the 
+// particles must be up to date
+void PBPhysUpdateScratch(PBPhys* const that, const float deltat) {
+  long nbPart = PBPhysGetNbParticle(that);
+  PBPhysParticle** parts = (that->_soa != NULL ? 
+    that->_soa->_particles : that->_table);
+  int dim = PBPhysGetDim(that);
+  // Ensure there is room for the particles
+  if (nbPart > that->_scratchCapacity) {
+    free(that->_scratchPos);
+    free(that->_scratchSpeed);
+    free(that->_scratchRadius);
+    that->_scratchPos = 
+      PBErrMalloc(PBPhysErr, sizeof(float) * dim * nbPart);
+    that->_scratchSpeed = 
+      PBErrMalloc(PBPhysErr, sizeof(float) * dim * nbPart);
+    that->_scratchRadius = PBErrMalloc(PBPhysErr, sizeof(float) * nbPart);
+    PBPHYS_STATS_ALLOC(3);
+    that->_scratchCapacity = nbPart;
+  }
+  for (long iPart = nbPart; iPart--;)
+    PBPhysUpdateScratchOf(that, parts, iPart, deltat);
+}
+
+// Update the scratch of the PBPhys 'that' for its 'iPart'-th particle 
+// in the table 'parts', the scratch must be large enough
+void PBPhysUpdateScratchOf(PBPhys* const that, 
+  PBPhysParticle** const parts, const long iPart, const float deltat) {
+  int dim = PBPhysGetDim(that);
+  // Same operations as PBPhysParticleGetNextDisplacement followed by 
+  // VecScale to get the same rounding
+  float invDeltaT = 1.0 / deltat;
+  PBPhysParticleCopyPos(parts[iPart], that->_scratchPos + dim * iPart);
+  // The fixed or asleep particles don't move
+  for (int iDim = dim; iDim--;)
+    that->_scratchSpeed[dim * iPart + iDim] = 
+      (that->_tableInactive[iPart] ? 0.0 : 
+      PBPhysParticleGetNextDisplacementAt(parts[iPart], deltat, 
+      iDim) * invDeltaT);
+  that->_scratchRadius[iPart] = PBPhysGetBoundingRadius(that, iPart);
+}
+
+// Move the particles 'parts' of the PBPhys 'that' to its current time, 
+// select their neighbours and predict again all their collisions 
+// before 'goalT' in its event queue
+// The system acceleration of the particles must be up to date
+void PBPhysInitEvents(PBPhys* const that, 
+  PBPhysParticle** const parts, const float goalT) {
+  PBPhysEventQueue* events = that->_events;
+  long nbPart = events->_nbPart;
+  int dim = PBPhysGetDim(that);
+  float curTime = PBPhysGetCurTime(that);
+  ++(events->_nbBuild);
+  // Move the particles to the current time
+  for (long iPart = 0; iPart < that->_nbDynamic; ++iPart) {
+    long kPart = that->_dynamicPart[iPart];
+    if (events->_localTime[kPart] < curTime)
+      PBPhysParticleMove(parts[kPart], 
+        curTime - events->_localTime[kPart]);
+  }
+  for (long iPart = nbPart; iPart--;)
+    events->_localTime[iPart] = curTime;
+  PBPhysUpdateScratch(that, goalT - curTime);
+  // Reset the events
+  for (long iPart = nbPart; iPart--;) {
+    events->_time[iPart] = goalT;
+    events->_partner[iPart] = -1;
+  }
+  PBPhysEventQueueInit(events);
+  // Without broad phase all the pairs of particles are predicted
+  if (PBPhysGetBroadPhase(that) == PBPhysBroadPhaseNone) {
+    for (long iPart = 0; iPart < nbPart - 1; ++iPart) {
+      // A fixed particle is only paired with the particles which are 
+      // not fixed
+      bool onlyDynamic = that->_tableInactive[iPart];
+      long kFirst = (onlyDynamic ? 
+        PBPhysGetFirstDynamic(that, iPart + 1) : iPart + 1);
+      long kEnd = (onlyDynamic ? that->_nbDynamic : nbPart);
+      for (long kPart = kFirst; kPart < kEnd; ++kPart)
+        PBPhysPredictPair(that, iPart, 
+          (onlyDynamic ? that->_dynamicPart[kPart] : kPart), goalT);
+    }
+    return;
+  }
+  // The swept boxes are enlarged by the longest displacement of the 
+  // particles until the end of the step, so the neighbours stay valid 
+  // as long as the collisions don't speed up a particle beyond the 
+  // fastest one
+  float margin = 0.0;
+  for (long iPart = nbPart; iPart--;) {
+    float disp = 0.0;
+    for (int iDim = dim; iDim--;)
+      disp += fsquare(that->_scratchSpeed[dim * iPart + iDim]);
+    if (margin < disp)
+      margin = disp;
+  }
+  margin = sqrt(margin) * (goalT - curTime);
+  // Get the pairs of the broad phase and their ball of validity: the 
+  // Verlet neighbour lists are valid while the particles stay within 
+  // their margin of their position at the build, the other broad 
+  // phases while they stay within the margin of their current position
+  PBPhysUpdatePairs(that, margin);
+  PBPhysEventQueueSetNeighbours(events, that->_pairs, that->_nbPair);
+  if (PBPhysGetBroadPhase(that) == PBPhysBroadPhaseVerlet) {
+    memcpy(events->_reachPos, that->_verlet->_pos, 
+      sizeof(float) * dim * nbPart);
+    memcpy(events->_reach, that->_verlet->_margin, 
+      sizeof(float) * nbPart);
+  } else {
+    memcpy(events->_reachPos, that->_scratchPos, 
+      sizeof(float) * dim * nbPart);
+    for (long iPart = nbPart; iPart--;)
+      events->_reach[iPart] = margin;
+  }
+  for (long iPair = 0; iPair < that->_nbPair; ++iPair)
+    PBPhysPredictPair(that, that->_pairs[2 * iPair], 
+      that->_pairs[2 * iPair + 1], goalT);
+}
+
+// Return true if the 'iPart'-th particle of the PBPhys 'that' stays 
+// until 'goalT' in the ball where its neighbours in the event queue 
+// are valid
+// Return false else
+// The scratch of the particle must be up to date
+bool PBPhysIsInReach(const PBPhys* const that, const long iPart, 
+  const float goalT) {
+  // Without broad phase all the particles are neighbours
+  if (PBPhysGetBroadPhase(that) == PBPhysBroadPhaseNone)
+    return true;
+  // The particle is in the ball at the current time, and moves along 
+  // a segment, it stays in the ball if the end of the segment is in it
+  const PBPhysEventQueue* events = that->_events;
+  int dim = PBPhysGetDim(that);
+  float deltat = goalT - events->_localTime[iPart];
+  float dist = 0.0;
+  for (int iDim = dim; iDim--;)
+    dist += fsquare(that->_scratchPos[dim * iPart + iDim] + 
+      that->_scratchSpeed[dim * iPart + iDim] * deltat - 
+      events->_reachPos[dim * iPart + iDim]);
+  return (dist <= fsquare(events->_reach[iPart]));
+}
+
+// Predict the collision before 'goalT' of the 'iPart'-th and 
+// 'jPart'-th particles of the PBPhys 'that', and update the next 
+// collision of the particles in its event queue if it's sooner than 
+// their current one
+void PBPhysPredictPair(PBPhys* const that, const long iPart, 
+  const long jPart, const float goalT) {
+  PBPhysEventQueue* events = that->_events;
+  int dim = PBPhysGetDim(that);
+  float curTime = PBPhysGetCurTime(that);
+  float deltat = goalT - curTime;
+  ++(events->_nbTest);
+  // Get the position of the particles at the current time from their 
+  // position at their local time
+  float posI[dim];
+  float posJ[dim];
+  for (int iDim = dim; iDim--;) {
+    posI[iDim] = that->_scratchPos[dim * iPart + iDim] + 
+      that->_scratchSpeed[dim * iPart + iDim] * 
+      (curTime - events->_localTime[iPart]);
+    posJ[iDim] = that->_scratchPos[dim * jPart + iDim] + 
+      that->_scratchSpeed[dim * jPart + iDim] * 
+      (curTime - events->_localTime[jPart]);
+  }
+  // Get the time at which the particles hit
+  float tHit = PBPhysGetPairTimeToHit(dim, 
+    posI, that->_scratchSpeed + dim * iPart, that->_scratchRadius[iPart], 
+    posJ, that->_scratchSpeed + dim * jPart, that->_scratchRadius[jPart], 
+    deltat);
+  // If they hit before the end of the step
+  if (tHit < deltat) {
+    float t = curTime + tHit;
+    // Update the next collision of the particles if it's sooner than 
+    // the current one
+    if (t < events->_time[iPart]) {
+      events->_time[iPart] = t;
+      events->_partner[iPart] = jPart;
+      events->_partnerCount[iPart] = events->_count[jPart];
+      PBPhysEventQueueUpdate(events, iPart);
+    }
+    if (t < events->_time[jPart]) {
+      events->_time[jPart] = t;
+      events->_partner[jPart] = iPart;
+      events->_partnerCount[jPart] = events->_count[iPart];
+      PBPhysEventQueueUpdate(events, jPart);
+    }
+  }
+}
+
+// Predict the collisions before 'goalT' of the 'iPart'-th particle 
+// with its neighbours in the event queue of the PBPhys 'that' (all the 
+// other particles if there is no broad phase), and update the next 
+// collision of the particles if it's sooner than their current one
+// The pairs of fixed particles are skipped
+void PBPhysPredictCollision(PBPhys* const that, const long iPart, 
+  const float goalT) {
+  PBPhysEventQueue* events = that->_events;
+  // The neighbours selected by the broad phase exclude already the 
+  // pairs of fixed particles
+  if (PBPhysGetBroadPhase(that) != PBPhysBroadPhaseNone) {
+    for (long iNeighbour = events->_neighbourFirst[iPart]; 
+      iNeighbour < events->_neighbourFirst[iPart + 1]; ++iNeighbour)
+      PBPhysPredictPair(that, iPart, events->_neighbour[iNeighbour], 
+        goalT);
+    return;
+  }
+  // A fixed particle is only paired with the particles which are not 
+  // fixed
+  bool onlyDynamic = that->_tableInactive[iPart];
+  long kEnd = (onlyDynamic ? that->_nbDynamic : events->_nbPart);
+  for (long kPart = 0; kPart < kEnd; ++kPart) {
+    long jPart = (onlyDynamic ? that->_dynamicPart[kPart] : kPart);
+    if (jPart != iPart)
+      PBPhysPredictPair(that, iPart, jPart, goalT);
+  }
+}
+
+// Update the table of particles of the PBPhys 'that' from its set of 
+// particles and return it
+// If the state of the particles is stored in the PBPhys, the arrays 
+// are rebuilt if they are not in the order of the set anymore, and 
+// the data depending on the shapes are updated
+PBPhysParticle** PBPhysUpdateTable(PBPhys* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  long nbPart = PBPhysGetNbParticle(that);
+  // If the state of the particles is stored in the PBPhys
+  if (that->_soa != NULL) {
+    PBPhysSoA* soa = that->_soa;
+    // Check the arrays are in sync with the set of particles
+    bool inSync = (soa->_nb == nbPart);
+    if (inSync && nbPart > 0) {
+      GSetIterForward iter = 
+        GSetIterForwardCreateStatic(PBPhysParticles(that));
+      long iPart = 0;
+      do {
+        inSync = (soa->_particles[iPart] == GSetIterGet(&iter));
+        ++iPart;
+      } while (inSync && GSetIterStep(&iter));
+    }
+    // If particles have been added or removed directly through the 
+    // set of particles, rebuild the arrays in the order of the set
+    if (!inSync) {
+      while (soa->_nb > 0)
+        PBPhysSoADetach(soa, soa->_particles[soa->_nb - 1]);
+      PBPhysSoAReserve(soa, nbPart);
+      if (nbPart > 0) {
+        GSetIterForward iter = 
+          GSetIterForwardCreateStatic(PBPhysParticles(that));
+        do {
+          PBPhysParticle* part = GSetIterGet(&iter);
+          PBPhysSoAAttach(soa, that, part);
+        } while (GSetIterStep(&iter));
+      }
+    }
+    PBPhysUpdatePartition(that, soa->_particles);
+    // The table of particles is the one of the arrays
+    return soa->_particles;
+  }
+  // Ensure the table is large enough
+  if (nbPart > that->_tableCapacity) {
+    free(that->_table);
+    that->_table = 
+      PBErrMalloc(PBPhysErr, sizeof(PBPhysParticle*) * nbPart);
+    PBPHYS_STATS_ALLOC(1);
+    that->_tableCapacity = nbPart;
+  }
+  // Copy the particles into the table
+  if (nbPart > 0) {
+    GSetIterForward iter = 
+      GSetIterForwardCreateStatic(PBPhysParticles(that));
+    long iPart = 0;
+    do {
+      that->_table[iPart] = GSetIterGet(&iter);
+      ++iPart;
+    } while (GSetIterStep(&iter));
+  }
+  PBPhysUpdatePartition(that, that->_table);
+  // Return the table
+  return that->_table;
+}
+
+// Update the partition of the particles 'parts' of the PBPhys 'that' 
+// between the fixed or asleep particles and the other ones
+void PBPhysUpdatePartition(PBPhys* const that, 
+  PBPhysParticle** const parts) {
+  long nbPart = PBPhysGetNbParticle(that);
+  // Ensure the arrays are large enough
+  if (nbPart > that->_partitionCapacity) {
+    free(that->_tableInactive);
+    free(that->_dynamicPart);
+    that->_tableInactive = PBErrMalloc(PBPhysErr, sizeof(bool) * nbPart);
+    that->_dynamicPart = PBErrMalloc(PBPhysErr, sizeof(long) * nbPart);
+    PBPHYS_STATS_ALLOC(2);
+    that->_partitionCapacity = nbPart;
+  }
+  // The flags are read again at each update of the table, so a 
+  // particle moves to the other partition as soon as its flag changes
+  that->_nbDynamic = 0;
+  for (long iPart = 0; iPart < nbPart; ++iPart) {
+    bool inactive = PBPhysParticleIsFixed(parts[iPart]) || 
+      PBPhysParticleIsAsleep(parts[iPart]);
+    that->_tableInactive[iPart] = inactive;
+    if (!inactive) {
+      that->_dynamicPart[that->_nbDynamic] = iPart;
+      ++(that->_nbDynamic);
+    }
+  }
+}
+
+// Return the position in the array of the particles which are not 
+// fixed of the PBPhys 'that' of the first one whose index in the table 
+// is greater than or equal to 'iPart'
+long PBPhysGetFirstDynamic(const PBPhys* const that, const long iPart) {
+  // Binary search in the array, sorted in the order of the table
+  long iLow = 0;
+  long iHigh = that->_nbDynamic;
+  while (iLow < iHigh) {
+    long iMid = (iLow + iHigh) / 2;
+    if (that->_dynamicPart[iMid] < iPart)
+      iLow = iMid + 1;
+    else
+      iHigh = iMid;
+  }
+  return iLow;
+}
+
+// Update the sleep state of the particles of the PBPhys 'that' at the 
+// end of a step: the particles whose speed and acceleration have 
+// stayed under the sleep threshold during the sleep delay fall asleep
+// The table of particles of 'that' and its partition must be the ones 
+// of the last sub-step
+void PBPhysUpdateSleep(PBPhys* const that) {
+  float sleepSpeed = PBPhysGetSleepSpeed(that);
+  // If the sleep is disabled there is nothing to do
+  if (sleepSpeed <= 0.0)
+    return;
+  PBPhysParticle** parts = (that->_soa != NULL ? 
+    that->_soa->_particles : that->_table);
+  // The particles woken up during the step are not in the partition 
+  // but their idle time has just been reset, so only the particles 
+  // awake since the last sub-step need to be checked
+  float deltaT = PBPhysGetDeltaT(that);
+  int dim = PBPhysGetDim(that);
+  for (long iPart = 0; iPart < that->_nbDynamic; ++iPart) {
+    PBPhysParticle* part = parts[that->_dynamicPart[iPart]];
+    // Get the speed gained over a step from the user and system 
+    // accelerations, a particle which is accelerating never sleeps
+    float gain = 0.0;
+    for (int iDim = dim; iDim--;)
+      gain += fsquare(VecGet(part->_accel, iDim) + 
+        VecGet(part->_sysAccel, iDim));
+    gain = sqrt(gain) * deltaT;
+    if (VecNorm(part->_speed) < sleepSpeed && gain < sleepSpeed) {
+      part->_idleTime += deltaT;
+      // The particle falls asleep at rest, without going through the 
+      // setters which would wake it up, its user acceleration is kept 
+      // for when it's woken up
+      if (part->_idleTime >= PBPhysGetSleepDelay(that)) {
+        part->_asleep = true;
+        VecSetNull(part->_speed);
+        VecSetNull(part->_sysAccel);
+      }
+    } else {
+      part->_idleTime = 0.0;
+    }
+  }
+}
+
+// Set the speed under which the particles of the PBPhys 'that' fall 
+// asleep to 'speed'
+// A particle whose speed, and the speed it gains over a step from its 
+// accelerations, stay under 'speed' during the sleep delay at the end 
+// of the steps falls asleep: its speed and system acceleration are set 
+// to null, its user acceleration is kept, and it's excluded from the 
+// integration and the broad phase until it's woken up by a collision 
+// or by setting its speed, acceleration or position
+// If 'speed' equals 0.0 the sleep is disabled (default) and all the 
+// particles are woken up
+void PBPhysSetSleepSpeed(PBPhys* const that, const float speed) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (speed < 0.0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'speed' is invalid (0.0<=%f)", speed);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  that->_sleepSpeed = speed;
+  // Wake up all the particles if the sleep is disabled
+  if (speed <= 0.0 && PBPhysGetNbParticle(that) > 0) {
+    GSetIterForward iter = 
+      GSetIterForwardCreateStatic(PBPhysParticles(that));
+    do {
+      PBPhysParticleWakeUp(GSetIterGet(&iter));
+    } while (GSetIterStep(&iter));
+  }
+}
+
+// Set the storage mode of the particles of the PBPhys 'that' to 
+// 'storage'
+// With PBPhysStorageSoA the vectors of the particles become views on 
+// the arrays of the PBPhys, pointers previously returned by the 
+// particles' accessors are invalidated
+// Particles added or removed directly through the set of particles 
+// are taken into account at the next step
+void PBPhysSetStorage(PBPhys* const that, const PBPhysStorage storage) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // If the storage mode doesn't change there is nothing to do
+  if (storage == PBPhysGetStorage(that))
+    return;
+  if (storage == PBPhysStorageSoA) {
+    // Move the state of the particles into the arrays
+    that->_soa = PBPhysSoACreate(PBPhysGetDim(that));
+    (void)PBPhysUpdateTable(that);
+  } else {
+    // Give back their state to the particles
+    PBPhysSoAFree(&(that->_soa));
+  }
+}
+
+// Return the time to collision between two particles of radius 'rA' 
+// and 'rB' and the polynom of the square distance between particles 
+// over time 'distPoly'
+float PBPhysGetTimeToHit(float rA, float rB, VecFloat3D* distPoly) {
+  float dist = fsquare(rA + rB);
+  float tHit = (-1.0 * VecGet(distPoly, 1) - 
+    sqrt(fsquare(VecGet(distPoly, 1)) - 4.0 * VecGet(distPoly, 2) * 
+    (VecGet(distPoly, 0) - dist))) / (2.0 * VecGet(distPoly, 2));
+  return tHit;
+}
+
+// Return the coefficients of the polynom describing the square of the 
+// distance between two lines passing through 'posA' and 'posB' and 
+// colinear to 'dirA' and 'dirB' respectively
+// Return a vector such as dist^2(t)=v[0]+v[1]t+v[2]t^2
+VecFloat3D PBPhysGetDistPoly(const VecFloat* const posA, 
+  const VecFloat* const dirA, const VecFloat* const posB, 
+  const VecFloat* const dirB) {
+#if BUILDMODE == 0
+  if (posA == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'posA' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (posB == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'posB' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (dirA == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'dirA' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (dirB == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'dirB' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Declare the vector result
+  VecFloat3D res = VecFloatCreateStatic3D();
+  // Loop on dimensions
+  for (long iDim = VecGetDim(posA); iDim--;) {
+    VecSetAdd(&res, 0, 
+      fsquare(VecGet(posA, iDim) - VecGet(posB, iDim)));
+    VecSetAdd(&res, 1, 
+      (VecGet(posA, iDim) - VecGet(posB, iDim)) *
+      (VecGet(dirA, iDim) - VecGet(dirB, iDim)));
+    VecSetAdd(&res, 2, 
+      fsquare(VecGet(dirA, iDim) - VecGet(dirB, iDim)));
+  }
+  VecSet(&res, 1, VecGet(&res, 1) * 2.0);
+  // Return the result
+  return res;
+}
+
+// Return true if the PBPhys 'that' is the same as PBPhys 'tho'
+bool PBPhysIsSame(const PBPhys* const that, const PBPhys* const tho) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  if (that->_dim != tho->_dim ||
+    !ISEQUALF(that->_deltaT, tho->_deltaT) ||
+    !ISEQUALF(that->_curTime, tho->_curTime) ||
+    !ISEQUALF(that->_downGravity, tho->_downGravity) ||
+    that->_gravity != tho->_gravity ||
+    PBPhysGetNbParticle(that) != PBPhysGetNbParticle(tho))
+    return false;
+  if (PBPhysGetNbParticle(that) > 0) {
+    GSetIterForward iterA = 
       GSetIterForwardCreateStatic(PBPhysParticles(that));
+    GSetIterForward iterB = 
+      GSetIterForwardCreateStatic(PBPhysParticles(tho));
     do {
-      PBPhysParticle* part = GSetIterGet(&iter);
-      PBPhysParticle* clonePart = PBPhysParticleClone(part);
-      GSetAppend(PBPhysParticles(clone), clonePart);
-    } while (GSetIterStep(&iter));
+      PBPhysParticle* partA = GSetIterGet(&iterA);
+      PBPhysParticle* partB = GSetIterGet(&iterB);
+      if (!PBPhysParticleIsSame(partA, partB))
+        return false;
+    } while (GSetIterStep(&iterA) && GSetIterStep(&iterB));
+  }
+  return true;
+}
+
+
+// ------------ PBPhysSnapshot
+
+// ================ Functions declaration ====================
+
+// Copy the 'nb' values of 'size' bytes in little endian order at 'ptr' 
+// into 'data' and return the address following them
+const char* PBPhysSnapshotCopy(const char* const ptr, void* const data, 
+  const size_t size, const size_t nb);
+
+// Decode the field 'field' of the 'iPart'-th particle of the 
+// PBPhysSnapshot 'that' into the particle 'part'
+// If the field is the type the particle is created, else it must 
+// already exist
+// Return false if the saved value is invalid, true else
+bool PBPhysSnapshotUnpack(PBPhysSnapshot* const that, const long iPart, 
+  const PBPhysBinField field, PBPhysParticle** const part);
+
+// ================ Functions implementation ====================
+
+// Open the snapshot of a PBPhys saved with PBPhysSaveBinary in the 
+// file 'path'
+// The file is mapped in memory, only its header is read
+// Return NULL if the file couldn't be mapped or is not a valid snapshot
+PBPhysSnapshot* PBPhysSnapshotOpen(const char* const path) {
+#if BUILDMODE == 0
+  if (path == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'path' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Map the file, the mapping stays valid once the file is closed
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+    close(fd);
+    return NULL;
+  }
+  size_t size = st.st_size;
+  char* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return NULL;
+  // Read the header
+  size_t lenMagic = strlen(PBPHYS_BINMAGIC);
+  size_t sizeHeader = lenMagic + sizeof(uint32_t) + sizeof(int32_t) + 
+    sizeof(float) * 4 + sizeof(int64_t);
+  uint32_t version = 0;
+  int32_t dim = 0;
+  float prop[4] = {0.0};
+  int64_t nbPart = 0;
+  bool valid = (size >= sizeHeader && 
+    memcmp(map, PBPHYS_BINMAGIC, lenMagic) == 0);
+  if (valid) {
+    const char* ptr = map + lenMagic;
+    ptr = PBPhysSnapshotCopy(ptr, &version, sizeof(uint32_t), 1);
+    ptr = PBPhysSnapshotCopy(ptr, &dim, sizeof(int32_t), 1);
+    ptr = PBPhysSnapshotCopy(ptr, prop, sizeof(float), 4);
+    ptr = PBPhysSnapshotCopy(ptr, &nbPart, sizeof(int64_t), 1);
+    valid = (version >= 1 && version <= PBPHYS_BINVERSION && dim > 0 &&
+      nbPart >= 0);
+  }
+  // Check the size of the file matches the number of particles
+  size_t sizePart = 0;
+  if (valid) {
+    for (int iField = 0; iField < PBPhysBinFieldNb; ++iField)
+      sizePart += PBPhysBinFieldGetNbVal((PBPhysBinField)iField, dim) *
+        PBPhysBinFieldGetSize((PBPhysBinField)iField);
+    valid = ((size - sizeHeader) / sizePart >= (uint64_t)nbPart && 
+      sizeHeader + sizePart * nbPart == size);
+  }
+  if (!valid) {
+    munmap(map, size);
+    return NULL;
+  }
+  // Allocate memory
+  PBPhysSnapshot* that = PBErrMalloc(PBPhysErr, sizeof(PBPhysSnapshot));
+  // Set properties
+  that->_map = map;
+  that->_size = size;
+  that->_dim = dim;
+  that->_curTime = prop[0];
+  that->_deltaT = prop[1];
+  that->_downGravity = prop[2];
+  that->_gravity = prop[3];
+  that->_nbParticle = nbPart;
+  // Locate the packed arrays of the fields
+  const char* field = map + sizeHeader;
+  for (int iField = 0; iField < PBPhysBinFieldNb; ++iField) {
+    that->_fields[iField] = field;
+    field += PBPhysBinFieldGetNbVal((PBPhysBinField)iField, dim) *
+      PBPhysBinFieldGetSize((PBPhysBinField)iField) * nbPart;
+  }
+  // The table of materialised particles is allocated on the first 
+  // access
+  that->_particles = NULL;
+  that->_buffer = PBErrMalloc(PBPhysErr, sizeof(float) * dim * dim);
+  that->_v = VecFloatCreate(dim);
+  // Return the new PBPhysSnapshot
+  return that;
+}
+
+// Close the PBPhysSnapshot 'that' and free the particles materialised 
+// by PBPhysSnapshotParticle
+void PBPhysSnapshotClose(PBPhysSnapshot** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Free memory
+  if ((*that)->_particles != NULL) {
+    for (long iPart = (*that)->_nbParticle; iPart--;)
+      PBPhysParticleFree((*that)->_particles + iPart);
+    free((*that)->_particles);
+  }
+  free((*that)->_buffer);
+  VecFree(&((*that)->_v));
+  munmap((*that)->_map, (*that)->_size);
+  free(*that);
+  *that = NULL;
+}
+
+// Return the 'iPart'-th particle of the PBPhysSnapshot 'that'
+// The particle is materialised from the mapped file on the first 
+// access, it belongs to 'that' and is freed when 'that' is closed
+// Return NULL if the saved data of the particle is invalid
+PBPhysParticle* PBPhysSnapshotParticle(PBPhysSnapshot* const that, 
+  const long iPart) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (iPart < 0 || iPart >= that->_nbParticle) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'iPart' is invalid (0<=%ld<%ld)",
+      iPart, that->_nbParticle);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate the table of materialised particles on the first access, 
+  // calloc leaves the pages untouched until they are used
+  if (that->_particles == NULL) {
+    that->_particles = calloc(that->_nbParticle, 
+      sizeof(PBPhysParticle*));
+    if (that->_particles == NULL) {
+      PBPhysErr->_type = PBErrTypeMallocFailed;
+      sprintf(PBPhysErr->_msg, "calloc failed");
+      PBErrCatch(PBPhysErr);
+    }
+  }
+  // If the particle hasn't been materialised yet
+  if (that->_particles[iPart] == NULL) {
+    // Decode all its fields
+    PBPhysParticle* part = NULL;
+    for (int iField = 0; iField < PBPhysBinFieldNb; ++iField) {
+      if (!PBPhysSnapshotUnpack(that, iPart, (PBPhysBinField)iField, 
+        &part)) {
+        PBPhysParticleFree(&part);
+        return NULL;
+      }
+    }
+    that->_particles[iPart] = part;
+  }
+  // Return the particle
+  return that->_particles[iPart];
+}
+
+// Return a new PBPhys restored from the PBPhysSnapshot 'that' with the 
+// storage mode 'storage'
+// The particles are materialised from the mapped file, with the 
+// PBPhysStorageSoA mode their state is written directly into the 
+// arrays of the PBPhys
+// Return NULL if the saved data of a particle is invalid
+PBPhys* PBPhysSnapshotGetPBPhys(PBPhysSnapshot* const that, 
+  const PBPhysStorage storage) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Create the PBPhys
+  PBPhys* phys = PBPhysCreate(that->_dim);
+  phys->_curTime = that->_curTime;
+  phys->_deltaT = that->_deltaT;
+  phys->_downGravity = that->_downGravity;
+  phys->_gravity = that->_gravity;
+  // If the state of the particles is stored in the PBPhys, allocate 
+  // the arrays for all the particles at once
+  PBPhysSoA* soa = NULL;
+  if (storage == PBPhysStorageSoA) {
+    PBPhysSetStorage(phys, PBPhysStorageSoA);
+    soa = phys->_soa;
+    PBPhysSoAReserve(soa, that->_nbParticle);
+  }
+  // Fields decoded into the particle once its state is in the arrays
+  PBPhysBinField fields[6] = {PBPhysBinFieldPos, PBPhysBinFieldSpeed, 
+    PBPhysBinFieldAccel, PBPhysBinFieldMass, PBPhysBinFieldDrag, 
+    PBPhysBinFieldFixed};
+  // Loop on the particles
+  for (long iPart = 0; iPart < that->_nbParticle; ++iPart) {
+    // Create the particle and its shape
+    PBPhysParticle* part = NULL;
+    if (!PBPhysSnapshotUnpack(that, iPart, PBPhysBinFieldType, &part) ||
+      !PBPhysSnapshotUnpack(that, iPart, PBPhysBinFieldAxis, &part)) {
+      PBPhysParticleFree(&part);
+      PBPhysFree(&phys);
+      return NULL;
+    }
+    // Add the particle to the PBPhys, and move its state into the 
+    // arrays
+    GSetAppend(PBPhysParticles(phys), part);
+    if (soa != NULL)
+      PBPhysSoAAttach(soa, phys, part);
+    // Decode the state of the particle, directly into the arrays if 
+    // they are used
+    for (int iField = 0; iField < 6; ++iField) {
+      if (!PBPhysSnapshotUnpack(that, iPart, fields[iField], &part)) {
+        PBPhysFree(&phys);
+        return NULL;
+      }
+    }
+  }
+  // Return the PBPhys
+  return phys;
+}
+
+// Copy the 'nb' values of 'size' bytes in little endian order at 'ptr' 
+// into 'data' and return the address following them
+const char* PBPhysSnapshotCopy(const char* const ptr, void* const data, 
+  const size_t size, const size_t nb) {
+  memcpy(data, ptr, size * nb);
+  PBPhysFromLE(data, size, nb);
+  return ptr + size * nb;
+}
+
+// Decode the field 'field' of the 'iPart'-th particle of the 
+// PBPhysSnapshot 'that' into the particle 'part'
+// If the field is the type the particle is created, else it must 
+// already exist
+// Return false if the saved value is invalid, true else
+bool PBPhysSnapshotUnpack(PBPhysSnapshot* const that, const long iPart, 
+  const PBPhysBinField field, PBPhysParticle** const part) {
+  long nbVal = PBPhysBinFieldGetNbVal(field, that->_dim);
+  size_t size = PBPhysBinFieldGetSize(field);
+  (void)PBPhysSnapshotCopy(that->_fields[field] + iPart * nbVal * size,
+    that->_buffer, size, nbVal);
+  return PBPhysParticleUnpackField(part, that->_dim, field, 
+    that->_buffer, that->_v);
+}
+
+// ------------ PBPhysRecorder
+
+// ================ Functions declaration ====================
+
+// Main function of the writer thread of a PBPhysRecorder, 'arg' is 
+// the PBPhysRecorder
+void* PBPhysRecorderWork(void* arg);
+
+// Write the record 'record' of the PBPhysRecorder 'that' on its stream
+// Return true if we could write the record, false else
+bool PBPhysRecorderWrite(const PBPhysRecorder* const that, 
+  const char* const record);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysRecorder of the PBPhys 'phys'
+// Default values: _fields = PBPHYS_RECFIELDS, all the particles, 
+// _stride = 1, _drop = false, _ringSize = PBPHYS_RECRING
+PBPhysRecorder* PBPhysRecorderCreate(PBPhys* const phys) {
+#if BUILDMODE == 0
+  if (phys == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'phys' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Allocate memory
+  PBPhysRecorder* that = PBErrMalloc(PBPhysErr, sizeof(PBPhysRecorder));
+  // Set properties
+  that->_phys = phys;
+  that->_fields = PBPHYS_RECFIELDS;
+  that->_parts = NULL;
+  that->_nbPart = 0;
+  that->_stride = 1;
+  that->_drop = false;
+  that->_ringSize = PBPHYS_RECRING;
+  that->_sizeRecord = 0;
+  that->_sizeSlot = 0;
+  that->_ring = NULL;
+  atomic_init(&(that->_head), 0);
+  atomic_init(&(that->_tail), 0);
+  that->_stream = NULL;
+  atomic_init(&(that->_error), false);
+  that->_nbStep = 0;
+  that->_nbDropped = 0;
+  that->_nbStall = 0;
+  that->_maxPending = 0;
+  // Return the new PBPhysRecorder
+  return that;
+}
+
+// Free the memory used by the PBPhysRecorder 'that', stop it first if 
+// it is running
+void PBPhysRecorderFree(PBPhysRecorder** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Stop the recorder
+  PBPhysRecorderStop(*that);
+  // Free memory
+  free((*that)->_parts);
+  free(*that);
+  *that = NULL;
+}
+
+// Set the particles recorded by the PBPhysRecorder 'that' to the 'nb' 
+// particles at indices 'parts' in the PBPhys
+// If 'parts' is NULL all the particles are recorded
+// The recorder must not be running
+void PBPhysRecorderSetParticles(PBPhysRecorder* const that, 
+  const long nb, const long* const parts) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (that->_stream != NULL) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'that' is running");
+    PBErrCatch(PBPhysErr);
+  }
+  if (parts != NULL && nb <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'nb' is invalid (0<%ld)", nb);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  free(that->_parts);
+  that->_parts = NULL;
+  that->_nbPart = 0;
+  if (parts != NULL) {
+    that->_parts = PBErrMalloc(PBPhysErr, sizeof(long) * nb);
+    memcpy(that->_parts, parts, sizeof(long) * nb);
+    that->_nbPart = nb;
+  }
+}
+
+// Start the PBPhysRecorder 'that' on the file 'path'
+// The recorder is attached to its PBPhys which calls 
+// PBPhysRecorderRecord after each PBPhysStep and PBPhysNext
+// Only one recorder can be attached to a PBPhys, and the recorded 
+// particles must stay in the PBPhys until the recorder is stopped
+// Return true if the file could be opened and its header written, 
+// false else
+bool PBPhysRecorderStart(PBPhysRecorder* const that, 
+  const char* const path) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (path == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'path' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (that->_stream != NULL) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'that' is already running");
+    PBErrCatch(PBPhysErr);
+  }
+  if (that->_phys->_recorder != NULL) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "the PBPhys already has a recorder");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Number of recorded particles
+  if (that->_parts == NULL)
+    that->_nbPart = PBPhysGetNbParticle(that->_phys);
+  // Open the file and write the header
+  FILE* stream = fopen(path, "wb");
+  if (stream == NULL)
+    return false;
+  int32_t dim = PBPhysGetDim(that->_phys);
+  uint32_t fields = that->_fields;
+  int64_t nbPart = that->_nbPart;
+  bool ret = PBPhysWriteBinaryHeader(PBPHYS_BINMAGICRECORD, stream) &&
+    PBPhysWriteLE(&dim, sizeof(int32_t), 1, stream) &&
+    PBPhysWriteLE(&fields, sizeof(uint32_t), 1, stream) &&
+    PBPhysWriteLE(&nbPart, sizeof(int64_t), 1, stream);
+  for (long iPart = 0; ret && iPart < that->_nbPart; ++iPart) {
+    int64_t index = (that->_parts == NULL ? iPart : that->_parts[iPart]);
+    ret = PBPhysWriteLE(&index, sizeof(int64_t), 1, stream);
+  }
+  if (!ret) {
+    fclose(stream);
+    return false;
+  }
+  // Size of a record, the fields are stored in the order of 
+  // PBPhysBinField which puts the fields of one byte last, then the 
+  // floats of the record are aligned if the slots are
+  that->_sizeRecord = sizeof(float);
+  for (int iField = 0; iField < PBPhysBinFieldNb; ++iField)
+    if (that->_fields & (1 << iField))
+      that->_sizeRecord += 
+        PBPhysBinFieldGetNbVal((PBPhysBinField)iField, dim) *
+        PBPhysBinFieldGetSize((PBPhysBinField)iField) * that->_nbPart;
+  that->_sizeSlot = 
+    (that->_sizeRecord + sizeof(float) - 1) / sizeof(float) * 
+    sizeof(float);
+  // Create the ring
+  that->_ring = PBErrMalloc(PBPhysErr, that->_sizeSlot * that->_ringSize);
+  atomic_store(&(that->_head), 0);
+  atomic_store(&(that->_tail), 0);
+  atomic_store(&(that->_error), false);
+  that->_nbStep = 0;
+  that->_nbDropped = 0;
+  that->_nbStall = 0;
+  that->_maxPending = 0;
+  sem_init(&(that->_sem), 0, 0);
+  that->_stream = stream;
+  // Start the writer
+  if (pthread_create(&(that->_thread), NULL, PBPhysRecorderWork, 
+    that) != 0) {
+    PBPhysErr->_type = PBErrTypeOther;
+    sprintf(PBPhysErr->_msg, "Can't create the writer thread");
+    PBErrCatch(PBPhysErr);
+  }
+  // Attach the recorder to the PBPhys
+  that->_phys->_recorder = that;
+  return true;
+}
+
+// Stop the PBPhysRecorder 'that', wait for the writer to drain the 
+// ring, close the file and detach the recorder from its PBPhys
+void PBPhysRecorderStop(PBPhysRecorder* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // If the recorder is not running, nothing to do
+  if (that->_stream == NULL)
+    return;
+  // The writer stops when it finds the ring empty after the last post
+  sem_post(&(that->_sem));
+  pthread_join(that->_thread, NULL);
+  sem_destroy(&(that->_sem));
+  if (fclose(that->_stream) != 0)
+    atomic_store(&(that->_error), true);
+  that->_stream = NULL;
+  free(that->_ring);
+  that->_ring = NULL;
+  // Detach the recorder from the PBPhys
+  that->_phys->_recorder = NULL;
+}
+
+// Record the state of the PBPhys of the PBPhysRecorder 'that' if the 
+// number of steps seen since the start is a multiple of the stride
+// If the ring is full the record is dropped or waits for the writer 
+// according to _drop
+void PBPhysRecorderRecord(PBPhysRecorder* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (that->_stream == NULL) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'that' is not running");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Skip the steps between two records
+  long iStep = (that->_nbStep)++;
+  if (iStep % that->_stride != 0)
+    return;
+  // Get a free slot in the ring
+  long head = atomic_load_explicit(&(that->_head), memory_order_relaxed);
+  long pending = head - 
+    atomic_load_explicit(&(that->_tail), memory_order_acquire);
+  if (pending >= that->_ringSize) {
+    // If the writer is late, drop the record or wait for it
+    if (that->_drop) {
+      ++(that->_nbDropped);
+      return;
+    }
+    ++(that->_nbStall);
+    do {
+      sched_yield();
+      pending = head - 
+        atomic_load_explicit(&(that->_tail), memory_order_acquire);
+    } while (pending >= that->_ringSize);
+  }
+  if (pending + 1 > that->_maxPending)
+    that->_maxPending = pending + 1;
+  // Copy the current time and the fields of the particles into the slot
+  char* slot = that->_ring + (head % that->_ringSize) * that->_sizeSlot;
+  float curTime = PBPhysGetCurTime(that->_phys);
+  memcpy(slot, &curTime, sizeof(float));
+  char* ptr = slot + sizeof(float);
+  PBPhysParticle** parts = PBPhysUpdateTable(that->_phys);
+  int dim = PBPhysGetDim(that->_phys);
+  for (int iField = 0; iField < PBPhysBinFieldNb; ++iField) {
+    if (that->_fields & (1 << iField)) {
+      size_t size = PBPhysBinFieldGetNbVal((PBPhysBinField)iField, dim) *
+        PBPhysBinFieldGetSize((PBPhysBinField)iField);
+      for (long iPart = 0; iPart < that->_nbPart; ++iPart) {
+        long index = (that->_parts == NULL ? iPart : that->_parts[iPart]);
+#if BUILDMODE == 0
+        if (index < 0 || index >= PBPhysGetNbParticle(that->_phys)) {
+          PBPhysErr->_type = PBErrTypeInvalidArg;
+          sprintf(PBPhysErr->_msg, 
+            "recorded particle is invalid (0<=%ld<%d)", index, 
+            PBPhysGetNbParticle(that->_phys));
+          PBErrCatch(PBPhysErr);
+        }
+#endif
+        PBPhysParticlePackField(parts[index], (PBPhysBinField)iField, 
+          ptr);
+        ptr += size;
+      }
+    }
+  }
+  // Publish the record and wake up the writer
+  atomic_store_explicit(&(that->_head), head + 1, memory_order_release);
+  sem_post(&(that->_sem));
+}
+
+// Return the statistics of the PBPhysRecorder 'that'
+PBPhysRecorderStats PBPhysRecorderGetStats(
+  const PBPhysRecorder* const that) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  PBPhysRecorderStats stats;
+  stats._nbStep = that->_nbStep;
+  stats._nbRecord = 
+    atomic_load_explicit(&(that->_head), memory_order_relaxed);
+  stats._nbWritten = 
+    atomic_load_explicit(&(that->_tail), memory_order_acquire);
+  stats._nbDropped = that->_nbDropped;
+  stats._nbStall = that->_nbStall;
+  stats._maxPending = that->_maxPending;
+  stats._error = atomic_load(&(that->_error));
+  return stats;
+}
+
+// Main function of the writer thread of a PBPhysRecorder, 'arg' is 
+// the PBPhysRecorder
+void* PBPhysRecorderWork(void* arg) {
+  PBPhysRecorder* that = arg;
+  long tail = 0;
+  while (true) {
+    // Wait for a record or the stop
+    while (sem_wait(&(that->_sem)) != 0 && errno == EINTR);
+    // The stop is posted after the last record, then the ring is empty 
+    // only when stopping
+    if (atomic_load_explicit(&(that->_head), memory_order_acquire) == 
+      tail)
+      break;
+    // Write the record, after a failure the records are discarded to 
+    // keep the stepping thread running
+    const char* record = 
+      that->_ring + (tail % that->_ringSize) * that->_sizeSlot;
+    if (!atomic_load_explicit(&(that->_error), memory_order_relaxed) &&
+      !PBPhysRecorderWrite(that, record))
+      atomic_store(&(that->_error), true);
+    // Release the slot
+    ++tail;
+    atomic_store_explicit(&(that->_tail), tail, memory_order_release);
+  }
+  return NULL;
+}
+
+// Write the record 'record' of the PBPhysRecorder 'that' on its stream
+// Return true if we could write the record, false else
+bool PBPhysRecorderWrite(const PBPhysRecorder* const that, 
+  const char* const record) {
+  if (!PBPhysWriteLE(record, sizeof(float), 1, that->_stream))
+    return false;
+  const char* ptr = record + sizeof(float);
+  int dim = PBPhysGetDim(that->_phys);
+  for (int iField = 0; iField < PBPhysBinFieldNb; ++iField) {
+    if (that->_fields & (1 << iField)) {
+      long nbVal = PBPhysBinFieldGetNbVal((PBPhysBinField)iField, dim) *
+        that->_nbPart;
+      size_t size = PBPhysBinFieldGetSize((PBPhysBinField)iField);
+      if (nbVal > 0 && 
+        !PBPhysWriteLE(ptr, size, nbVal, that->_stream))
+        return false;
+      ptr += nbVal * size;
+    }
+  }
+  return true;
+}
+
+// ------------ PBPhysTraj
+
+// ================ Functions declaration ====================
+
+// Initialise the PBPhysBitBuffer 'that' as empty
+void PBPhysBitBufferInit(PBPhysBitBuffer* const that);
+
+// Free the bytes of the PBPhysBitBuffer 'that'
+void PBPhysBitBufferFreeArr(PBPhysBitBuffer* const that);
+
+// Empty the PBPhysBitBuffer 'that' without freeing its bytes
+void PBPhysBitBufferReset(PBPhysBitBuffer* const that);
+
+// Ensure the PBPhysBitBuffer 'that' can hold 'capacity' bytes without 
+// reallocation
+void PBPhysBitBufferReserve(PBPhysBitBuffer* const that, 
+  const size_t capacity);
+
+// Append the 'nbBit' (<= 64) lowest bits of 'val' to the 
+// PBPhysBitBuffer 'that'
+void PBPhysBitBufferWrite(PBPhysBitBuffer* const that, 
+  const uint64_t val, const int nbBit);
+
+// Append the pending bits of the PBPhysBitBuffer 'that' to its bytes, 
+// padded with 0
+void PBPhysBitBufferFlush(PBPhysBitBuffer* const that);
+
+// Read the next 'nbBit' (<= 64) bits of the PBPhysBitBuffer 'that'
+// Bits read beyond the end of the bytes are 0 and the position is 
+// moved past the end
+uint64_t PBPhysBitBufferRead(PBPhysBitBuffer* const that, 
+  const int nbBit);
+
+// Code the 'nb' values 'res' with a Rice code in the PBPhysBitBuffer 
+// 'bits', preceded by the parameter of the code
+void PBPhysTrajWriteRice(PBPhysBitBuffer* const bits, 
+  const uint64_t* const res, const long nb);
+
+// Decode a value coded with the Rice code of parameter 'k' from the 
+// PBPhysBitBuffer 'bits'
+uint64_t PBPhysTrajReadRice(PBPhysBitBuffer* const bits, const int k);
+
+// Decode the frame at the current position in the file of the 
+// PBPhysTrajReader 'that', which must be the frame following the 
+// current one
+// Return true if the frame could be decoded, false else
+bool PBPhysTrajReaderDecode(PBPhysTrajReader* const that);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysTrajWriter of the trajectory of the particles of 
+// the PBPhys 'phys' in the file 'path'
+// The positions are coded within 'errPos' and the speeds within 
+// 'errSpeed' (up to the rounding of floats), and a keyframe is coded 
+// every 'keyInterval' frames
+// Return NULL if the file couldn't be opened or its header written
+PBPhysTrajWriter* PBPhysTrajWriterOpen(const char* const path, 
+  const PBPhys* const phys, const float errPos, const float errSpeed, 
+  const int keyInterval) {
+#if BUILDMODE == 0
+  if (path == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'path' is null");
+    PBErrCatch(PBPhysErr);
   }
-  // Return the clone
-  return clone;
+  if (phys == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'phys' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (errPos <= 0.0 || errSpeed <= 0.0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "error bounds are invalid (0<%f, 0<%f)",
+      errPos, errSpeed);
+    PBErrCatch(PBPhysErr);
+  }
+  if (keyInterval <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'keyInterval' is invalid (0<%d)", 
+      keyInterval);
+    PBErrCatch(PBPhysErr);
+  }
+#endif
+  // Open the file and write the header
+  FILE* stream = fopen(path, "wb");
+  if (stream == NULL)
+    return NULL;
+  int32_t dim = PBPhysGetDim(phys);
+  int64_t nbPart = PBPhysGetNbParticle(phys);
+  float err[2] = {errPos, errSpeed};
+  int32_t key = keyInterval;
+  if (!PBPhysWriteBinaryHeader(PBPHYS_BINMAGICTRAJ, stream) ||
+    !PBPhysWriteLE(&dim, sizeof(int32_t), 1, stream) ||
+    !PBPhysWriteLE(&nbPart, sizeof(int64_t), 1, stream) ||
+    !PBPhysWriteLE(err, sizeof(float), 2, stream) ||
+    !PBPhysWriteLE(&key, sizeof(int32_t), 1, stream)) {
+    fclose(stream);
+    return NULL;
+  }
+  // Allocate memory
+  PBPhysTrajWriter* that = 
+    PBErrMalloc(PBPhysErr, sizeof(PBPhysTrajWriter));
+  // Set properties
+  that->_stream = stream;
+  that->_dim = dim;
+  that->_nbPart = nbPart;
+  that->_errPos = errPos;
+  that->_errSpeed = errSpeed;
+  that->_keyInterval = keyInterval;
+  that->_nbFrame = 0;
+  that->_q = PBErrMalloc(PBPhysErr, 
+    sizeof(int64_t) * 2 * dim * (nbPart > 0 ? nbPart : 1));
+  that->_res = PBErrMalloc(PBPhysErr, 
+    sizeof(uint64_t) * dim * (nbPart > 0 ? nbPart : 1));
+  PBPhysBitBufferInit(&(that->_bits));
+  that->_keyOffset = NULL;
+  that->_keyTime = NULL;
+  that->_keyCapacity = 0;
+  that->_error = false;
+  // Return the new PBPhysTrajWriter
+  return that;
 }
 
-// Print the PBPhys 'that' on the stream 'stream'
-void PBPhysPrintln(const PBPhys* const that, FILE* const stream) {
+// Write the index and close the PBPhysTrajWriter 'that'
+// Return true if all the writes succeeded, false else
+bool PBPhysTrajWriterClose(PBPhysTrajWriter** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return true;
+  // Write the index of the keyframes
+  PBPhysTrajWriter* w = *that;
+  int64_t nbKey = 
+    (w->_nbFrame + w->_keyInterval - 1) / w->_keyInterval;
+  int64_t nbFrame = w->_nbFrame;
+  bool ret = !(w->_error);
+  for (long iKey = 0; ret && iKey < nbKey; ++iKey)
+    ret = PBPhysWriteLE(w->_keyOffset + iKey, sizeof(int64_t), 1, 
+      w->_stream) &&
+      PBPhysWriteLE(w->_keyTime + iKey, sizeof(float), 1, w->_stream);
+  ret = ret && PBPhysWriteLE(&nbKey, sizeof(int64_t), 1, w->_stream) &&
+    PBPhysWriteLE(&nbFrame, sizeof(int64_t), 1, w->_stream) &&
+    fwrite(PBPHYS_BINMAGICTRAJINDEX, 1, 
+      strlen(PBPHYS_BINMAGICTRAJINDEX), w->_stream) == 
+      strlen(PBPHYS_BINMAGICTRAJINDEX);
+  if (fclose(w->_stream) != 0)
+    ret = false;
+  // Free memory
+  free(w->_q);
+  free(w->_res);
+  PBPhysBitBufferFreeArr(&(w->_bits));
+  free(w->_keyOffset);
+  free(w->_keyTime);
+  free(w);
+  *that = NULL;
+  return ret;
+}
+
+// Code the current state of the particles of the PBPhys 'phys' as a 
+// new frame of the PBPhysTrajWriter 'that'
+// 'phys' must have the dimension and number of particles 'that' has 
+// been opened with
+// Return true if the frame could be written, false else
+bool PBPhysTrajWriterAdd(PBPhysTrajWriter* const that, 
+  const PBPhys* const phys) {
 #if BUILDMODE == 0
   if (that == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
     sprintf(PBPhysErr->_msg, "'that' is null");
     PBErrCatch(PBPhysErr);
   }
-  if (stream == NULL) {
+  if (phys == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
-    sprintf(PBPhysErr->_msg, "'stream' is null");
+    sprintf(PBPhysErr->_msg, "'phys' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (PBPhysGetDim(phys) != that->_dim || 
+    PBPhysGetNbParticle(phys) != that->_nbPart) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, 
+      "'phys' doesn't match the trajectory (%d==%d, %d==%ld)",
+      PBPhysGetDim(phys), that->_dim, PBPhysGetNbParticle(phys),
+      that->_nbPart);
     PBErrCatch(PBPhysErr);
   }
 #endif
-  fprintf(stream, "dimension: %d\n", PBPhysGetDim(that));
-  fprintf(stream, "t: %f\n", PBPhysGetCurTime(that));
-  fprintf(stream, "dt: %f\n", PBPhysGetDeltaT(that));
-  fprintf(stream, "down gravity: %f\n", PBPhysGetDownGravity(that));
-  fprintf(stream, "gravity: %f\n", PBPhysGetGravity(that));
-  fprintf(stream, "nb particles: %d\n", PBPhysGetNbParticle(that));
-  if (PBPhysGetNbParticle(that) > 0) {
-    GSetIterForward iter = 
-      GSetIterForwardCreateStatic(PBPhysParticles(that));
-    int iPart = 0;
-    do {
-      fprintf(stream, "particle #%d:\n", iPart);
-      PBPhysParticle* part = GSetIterGet(&iter);
-      PBPhysParticlePrintln(part, stream);
-      ++iPart;
-    } while (GSetIterStep(&iter));
+  if (that->_error)
+    return false;
+  float curTime = PBPhysGetCurTime(phys);
+  // If it's a keyframe, add it to the index
+  bool isKey = (that->_nbFrame % that->_keyInterval == 0);
+  if (isKey) {
+    long iKey = that->_nbFrame / that->_keyInterval;
+    if (iKey == that->_keyCapacity) {
+      long capacity = (that->_keyCapacity == 0 ? 
+        PBPHYS_SOACAPACITY : 2 * that->_keyCapacity);
+      that->_keyOffset = PBPhysSoAGrowArr(that->_keyOffset, 
+        sizeof(int64_t), iKey, capacity);
+      that->_keyTime = PBPhysSoAGrowArr(that->_keyTime, 
+        sizeof(float), iKey, capacity);
+      that->_keyCapacity = capacity;
+    }
+    that->_keyOffset[iKey] = ftell(that->_stream);
+    that->_keyTime[iKey] = curTime;
+  }
+  // Code the positions then the speeds
+  PBPhysBitBufferReset(&(that->_bits));
+  long nbVal = that->_dim * that->_nbPart;
+  for (int iField = 0; iField < 2; ++iField) {
+    double step = 2.0 * (iField == 0 ? that->_errPos : that->_errSpeed);
+    int64_t* prev = that->_q + iField * nbVal;
+    if (nbVal > 0) {
+      GSetIterForward iter = 
+        GSetIterForwardCreateStatic(PBPhysParticles(phys));
+      long iVal = 0;
+      do {
+        const PBPhysParticle* part = GSetIterGet(&iter);
+        const VecFloat* v = (iField == 0 ? 
+          ShapoidPos(PBPhysParticleShape(part)) : 
+          PBPhysParticleSpeed(part));
+        for (int iDim = 0; iDim < that->_dim; ++iDim, ++iVal) {
+          // Quantise the component and take the difference with the 
+          // previous frame, zigzag coded to get a small unsigned value
+          int64_t q = llround((double)VecGet(v, iDim) / step);
+          int64_t r = (isKey ? q : q - prev[iVal]);
+          that->_res[iVal] = 
+            ((uint64_t)r << 1) ^ (uint64_t)(r >> 63);
+          prev[iVal] = q;
+        }
+      } while (GSetIterStep(&iter));
+    }
+    PBPhysTrajWriteRice(&(that->_bits), that->_res, nbVal);
   }
+  PBPhysBitBufferFlush(&(that->_bits));
+  // Write the frame
+  uint32_t size = that->_bits._nb;
+  uint8_t flag = isKey;
+  that->_error = 
+    !PBPhysWriteLE(&size, sizeof(uint32_t), 1, that->_stream) ||
+    !PBPhysWriteLE(&flag, sizeof(uint8_t), 1, that->_stream) ||
+    !PBPhysWriteLE(&curTime, sizeof(float), 1, that->_stream) ||
+    fwrite(that->_bits._bytes, 1, size, that->_stream) != size;
+  ++(that->_nbFrame);
+  return !(that->_error);
 }
 
-// Function which return the JSON encoding of 'that' 
-JSONNode* PBPhysEncodeAsJSON(const PBPhys* const that) {
+// Open the compressed trajectory in the file 'path'
+// No frame is decoded until PBPhysTrajReaderNext or 
+// PBPhysTrajReaderSeek is called
+// Return NULL if the file couldn't be opened or is not a valid 
+// compressed trajectory
+PBPhysTrajReader* PBPhysTrajReaderOpen(const char* const path) {
 #if BUILDMODE == 0
-  if (that == NULL) {
-    PBMathErr->_type = PBErrTypeNullPointer;
-    sprintf(PBMathErr->_msg, "'that' is null");
-    PBErrCatch(PBMathErr);
+  if (path == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'path' is null");
+    PBErrCatch(PBPhysErr);
   }
 #endif
-  // Create the JSON structure
-  JSONNode* json = JSONCreate();
-  // Declare a buffer to convert value into string
-  char val[100];
-  // Encode the dimension
-  sprintf(val, "%d", that->_dim);
-  JSONAddProp(json, "_dim", val);
-  // Encode the curTime
-  sprintf(val, "%f", that->_curTime);
-  JSONAddProp(json, "_curTime", val);
-  // Encode the deltat
-  sprintf(val, "%f", that->_deltaT);
-  JSONAddProp(json, "_deltaT", val);
-  // Encode the downGravity
-  sprintf(val, "%f", that->_downGravity);
-  JSONAddProp(json, "_downGravity", val);
-  // Encode the gravity
-  sprintf(val, "%f", that->_gravity);
-  JSONAddProp(json, "_gravity", val);
-  // Encode the nbParticle
-  sprintf(val, "%d", PBPhysGetNbParticle(that));
-  JSONAddProp(json, "_nbParticle", val);
-  // Encode the particles
-  // Declare an array of structures converted to string
-  JSONArrayStruct setPart = JSONArrayStructCreateStatic();
-  if (PBPhysGetNbParticle(that) > 0) {
-    GSetIterForward iter = 
-      GSetIterForwardCreateStatic(PBPhysParticles(that));
-    do {
-      PBPhysParticle* part = GSetIterGet(&iter);
-      JSONArrayStructAdd(&setPart, 
-        PBPhysParticleEncodeAsJSON(part));
-
-    } while (GSetIterStep(&iter));
+  FILE* stream = fopen(path, "rb");
+  if (stream == NULL)
+    return NULL;
+  // Read the header
+  int32_t dim = 0;
+  int64_t nbPart = 0;
+  float err[2] = {0.0};
+  int32_t keyInterval = 0;
+  bool ret = PBPhysReadBinaryHeader(PBPHYS_BINMAGICTRAJ, stream) &&
+    PBPhysReadLE(&dim, sizeof(int32_t), 1, stream) &&
+    PBPhysReadLE(&nbPart, sizeof(int64_t), 1, stream) &&
+    PBPhysReadLE(err, sizeof(float), 2, stream) &&
+    PBPhysReadLE(&keyInterval, sizeof(int32_t), 1, stream) &&
+    dim > 0 && nbPart >= 0 && err[0] > 0.0 && err[1] > 0.0 && 
+    keyInterval > 0;
+  long sizeHeader = ftell(stream);
+  // Read the number of keyframes and frames at the end of the file
+  long lenMagic = strlen(PBPHYS_BINMAGICTRAJINDEX);
+  int64_t nbKey = 0;
+  int64_t nbFrame = 0;
+  char magic[8] = {0};
+  ret = ret && 
+    fseek(stream, -(2 * (long)sizeof(int64_t) + lenMagic), SEEK_END) == 0 &&
+    PBPhysReadLE(&nbKey, sizeof(int64_t), 1, stream) &&
+    PBPhysReadLE(&nbFrame, sizeof(int64_t), 1, stream) &&
+    fread(magic, 1, lenMagic, stream) == (size_t)lenMagic &&
+    memcmp(magic, PBPHYS_BINMAGICTRAJINDEX, lenMagic) == 0 &&
+    nbFrame >= 0 && 
+    nbKey == (nbFrame + keyInterval - 1) / keyInterval;
+  // Read the index of the keyframes
+  long sizeEntry = sizeof(int64_t) + sizeof(float);
+  ret = ret && fseek(stream, -(2 * (long)sizeof(int64_t) + lenMagic + 
+    sizeEntry * nbKey), SEEK_END) == 0;
+  int64_t* keyOffset = NULL;
+  float* keyTime = NULL;
+  if (ret) {
+    keyOffset = PBErrMalloc(PBPhysErr, 
+      sizeof(int64_t) * (nbKey > 0 ? nbKey : 1));
+    keyTime = PBErrMalloc(PBPhysErr, 
+      sizeof(float) * (nbKey > 0 ? nbKey : 1));
+    for (long iKey = 0; ret && iKey < nbKey; ++iKey)
+      ret = PBPhysReadLE(keyOffset + iKey, sizeof(int64_t), 1, stream) &&
+        PBPhysReadLE(keyTime + iKey, sizeof(float), 1, stream) &&
+        keyOffset[iKey] >= 
+          (iKey == 0 ? sizeHeader : keyOffset[iKey - 1] + 1);
   }
-  // Add a key with the array of structures
-  JSONAddProp(json, "_particles", &setPart);
+  if (!ret) {
+    free(keyOffset);
+    free(keyTime);
+    fclose(stream);
+    return NULL;
+  }
+  // Allocate memory
+  PBPhysTrajReader* that = 
+    PBErrMalloc(PBPhysErr, sizeof(PBPhysTrajReader));
+  // Set properties
+  that->_stream = stream;
+  that->_dim = dim;
+  that->_nbPart = nbPart;
+  that->_errPos = err[0];
+  that->_errSpeed = err[1];
+  that->_keyInterval = keyInterval;
+  that->_nbFrame = nbFrame;
+  that->_nbKey = nbKey;
+  that->_keyOffset = keyOffset;
+  that->_keyTime = keyTime;
+  that->_iFrame = -1;
+  that->_curTime = 0.0;
+  long nbVal = dim * (nbPart > 0 ? nbPart : 1);
+  that->_q = PBErrMalloc(PBPhysErr, sizeof(int64_t) * 2 * nbVal);
+  that->_pos = PBErrMalloc(PBPhysErr, sizeof(float) * nbVal);
+  that->_speed = PBErrMalloc(PBPhysErr, sizeof(float) * nbVal);
+  PBPhysBitBufferInit(&(that->_bits));
+  // Return the new PBPhysTrajReader
+  return that;
+}
+
+// Close the PBPhysTrajReader 'that'
+void PBPhysTrajReaderClose(PBPhysTrajReader** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
   // Free memory
-  JSONArrayStructFlush(&setPart);
-  // Return the created JSON 
-  return json;
+  fclose((*that)->_stream);
+  free((*that)->_keyOffset);
+  free((*that)->_keyTime);
+  free((*that)->_q);
+  free((*that)->_pos);
+  free((*that)->_speed);
+  PBPhysBitBufferFreeArr(&((*that)->_bits));
+  free(*that);
+  *that = NULL;
 }
 
-// Function which decode from JSON encoding 'json' to 'that'
-bool PBPhysDecodeAsJSON(PBPhys** that, const JSONNode* const json) {
+// Decode the frame following the current one of the PBPhysTrajReader 
+// 'that'
+// Return false if there is no more frame or the frame couldn't be 
+// decoded, true else
+bool PBPhysTrajReaderNext(PBPhysTrajReader* const that) {
 #if BUILDMODE == 0
   if (that == NULL) {
-    PBMathErr->_type = PBErrTypeNullPointer;
-    sprintf(PBMathErr->_msg, "'that' is null");
-    PBErrCatch(PBMathErr);
-  }
-  if (json == NULL) {
-    PBMathErr->_type = PBErrTypeNullPointer;
-    sprintf(PBMathErr->_msg, "'json' is null");
-    PBErrCatch(PBMathErr);
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
   }
 #endif
-  // If 'that' is already allocated
-  if (*that != NULL)
-    // Free memory
-    PBPhysFree(that);
-  // Decode the dimension
-  JSONNode* prop = JSONProperty(json, "_dim");
-  if (prop == NULL) {
-    return false;
-  }
-  int dim = atoi(JSONLblVal(prop));
-  // If data is invalid
-  if (dim <= 0)
-    return false;
-  // Allocate memory
-  *that = PBPhysCreate(dim);
-  // Decode the curTime
-  prop = JSONProperty(json, "_curTime");
-  if (prop == NULL) {
-    return false;
-  }
-  (*that)->_curTime = atof(JSONLblVal(prop));
-  // Decode the deltaT
-  prop = JSONProperty(json, "_deltaT");
-  if (prop == NULL) {
-    return false;
-  }
-  (*that)->_deltaT = atof(JSONLblVal(prop));
-  // Decode the downGravity
-  prop = JSONProperty(json, "_downGravity");
-  if (prop == NULL) {
-    return false;
-  }
-  (*that)->_downGravity = atof(JSONLblVal(prop));
-  // Decode the gravity
-  prop = JSONProperty(json, "_gravity");
-  if (prop == NULL) {
-    return false;
-  }
-  (*that)->_gravity = atof(JSONLblVal(prop));
-  // Decode the nbParticle
-  prop = JSONProperty(json, "_nbParticle");
-  if (prop == NULL) {
+  if (that->_iFrame + 1 >= that->_nbFrame)
     return false;
-  }
-  int nbParticle = atoi(JSONLblVal(prop));
-  // Decode the particle
-  prop = JSONProperty(json, "_particles");
-  if (prop == NULL) {
+  // The first frame is the first keyframe
+  if (that->_iFrame == -1 && 
+    fseek(that->_stream, that->_keyOffset[0], SEEK_SET) != 0)
     return false;
+  return PBPhysTrajReaderDecode(that);
+}
+
+// Decode the 'iFrame'-th frame of the PBPhysTrajReader 'that', 
+// starting from the keyframe preceding it
+// Return false if the frame couldn't be decoded, true else
+bool PBPhysTrajReaderSeek(PBPhysTrajReader* const that, 
+  const long iFrame) {
+#if BUILDMODE == 0
+  if (that == NULL) {
+    PBPhysErr->_type = PBErrTypeNullPointer;
+    sprintf(PBPhysErr->_msg, "'that' is null");
+    PBErrCatch(PBPhysErr);
   }
-  if (JSONGetNbValue(prop) != nbParticle) {
-    return false;
+  if (iFrame < 0 || iFrame >= that->_nbFrame) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'iFrame' is invalid (0<=%ld<%ld)", 
+      iFrame, that->_nbFrame);
+    PBErrCatch(PBPhysErr);
   }
-  for (int iPart = 0; iPart < nbParticle; ++iPart) {
-    JSONNode* part = JSONValue(prop, iPart);
-    PBPhysParticle* p = NULL;
-    if (!PBPhysParticleDecodeAsJSON(&p, part))
+#endif
+  // If the frame is after the current one and there is no keyframe 
+  // between them, decode from the current frame, else jump to the 
+  // keyframe preceding the frame
+  long iKey = iFrame / that->_keyInterval;
+  if (that->_iFrame < 0 || iFrame < that->_iFrame || 
+    that->_iFrame / that->_keyInterval != iKey) {
+    if (fseek(that->_stream, that->_keyOffset[iKey], SEEK_SET) != 0)
       return false;
-    GSetAppend(PBPhysParticles(*that), p);
+    that->_iFrame = iKey * that->_keyInterval - 1;
   }
-  // Return the success code
+  while (that->_iFrame < iFrame)
+    if (!PBPhysTrajReaderDecode(that))
+      return false;
   return true;
 }
 
-// Save the PBPhys 'that' on the stream 'stream'
-// If 'compact' equals true it saves in compact form, else it saves in 
-// readable form
-// Return true if we could save the PBPhys
-// Return false else
-bool PBPhysSave(const PBPhys* const that, FILE* const stream, 
-  const bool compact) {
+// Return the index of the keyframe preceding the time 't' in the 
+// PBPhysTrajReader 'that', or 0 if 't' is before the first keyframe
+long PBPhysTrajReaderGetKeyAt(const PBPhysTrajReader* const that, 
+  const float t) {
 #if BUILDMODE == 0
   if (that == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
     sprintf(PBPhysErr->_msg, "'that' is null");
     PBErrCatch(PBPhysErr);
   }
-  if (stream == NULL) {
-    PBPhysErr->_type = PBErrTypeNullPointer;
-    sprintf(PBPhysErr->_msg, "'stream' is null");
-    PBErrCatch(PBPhysErr);
-  }
 #endif
-  // Get the JSON encoding
-  JSONNode* json = PBPhysEncodeAsJSON(that);
-  // Save the JSON
-  if (!JSONSave(json, stream, compact)) {
-    return false;
+  // Binary search of the last keyframe whose time is not after 't'
+  long iFirst = 0;
+  long iLast = that->_nbKey - 1;
+  while (iFirst < iLast) {
+    long iMid = (iFirst + iLast + 1) / 2;
+    if (that->_keyTime[iMid] <= t)
+      iFirst = iMid;
+    else
+      iLast = iMid - 1;
   }
-  // Free memory
-  JSONFree(&json);
-  // Return success code
-  return true;
+  return iFirst;
 }
 
-// Load the PBPhys 'that' from the stream 'stream'
-// Return true if we could load the PBPhys
-// Return false else
-bool PBPhysLoad(PBPhys** that, FILE* const stream) {
+// Set the positions and speeds of the particles of the PBPhys 'phys' 
+// to those of the current frame of the PBPhysTrajReader 'that', and 
+// its current time to the time of the frame
+// 'phys' must have the dimension and number of particles of the 
+// trajectory
+void PBPhysTrajReaderApply(const PBPhysTrajReader* const that, 
+  PBPhys* const phys) {
 #if BUILDMODE == 0
   if (that == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
     sprintf(PBPhysErr->_msg, "'that' is null");
     PBErrCatch(PBPhysErr);
   }
-  if (stream == NULL) {
+  if (phys == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
-    sprintf(PBPhysErr->_msg, "'stream' is null");
+    sprintf(PBPhysErr->_msg, "'phys' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (PBPhysGetDim(phys) != that->_dim || 
+    PBPhysGetNbParticle(phys) != that->_nbPart) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, 
+      "'phys' doesn't match the trajectory (%d==%d, %d==%ld)",
+      PBPhysGetDim(phys), that->_dim, PBPhysGetNbParticle(phys),
+      that->_nbPart);
+    PBErrCatch(PBPhysErr);
+  }
+  if (that->_iFrame < 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "no frame has been decoded");
     PBErrCatch(PBPhysErr);
   }
 #endif
-  // Declare a json to load the encoded data
-  JSONNode* json = JSONCreate();
-  // Load the whole encoded data
-  if (!JSONLoad(json, stream)) {
+  if (that->_nbPart > 0) {
+    VecFloat* v = VecFloatCreate(that->_dim);
+    GSetIterForward iter = 
+      GSetIterForwardCreateStatic(PBPhysParticles(phys));
+    long iVal = 0;
+    do {
+      PBPhysParticle* part = GSetIterGet(&iter);
+      for (int iDim = 0; iDim < that->_dim; ++iDim)
+        VecSet(v, iDim, that->_pos[iVal + iDim]);
+      PBPhysParticleSetPos(part, v);
+      for (int iDim = 0; iDim < that->_dim; ++iDim)
+        VecSet(v, iDim, that->_speed[iVal + iDim]);
+      PBPhysParticleSetSpeed(part, v);
+      iVal += that->_dim;
+    } while (GSetIterStep(&iter));
+    VecFree(&v);
+  }
+  PBPhysSetCurTime(phys, that->_curTime);
+}
+
+// Decode the frame at the current position in the file of the 
+// PBPhysTrajReader 'that', which must be the frame following the 
+// current one
+// Return true if the frame could be decoded, false else
+bool PBPhysTrajReaderDecode(PBPhysTrajReader* const that) {
+  // Read the frame
+  uint32_t size = 0;
+  uint8_t flag = 0;
+  float curTime = 0.0;
+  if (!PBPhysReadLE(&size, sizeof(uint32_t), 1, that->_stream) ||
+    !PBPhysReadLE(&flag, sizeof(uint8_t), 1, that->_stream) ||
+    !PBPhysReadLE(&curTime, sizeof(float), 1, that->_stream))
+    return false;
+  long iFrame = that->_iFrame + 1;
+  bool isKey = (iFrame % that->_keyInterval == 0);
+  if (flag != isKey)
+    return false;
+  PBPhysBitBufferReset(&(that->_bits));
+  PBPhysBitBufferReserve(&(that->_bits), size);
+  if (fread(that->_bits._bytes, 1, size, that->_stream) != size)
     return false;
+  that->_bits._nb = size;
+  // Decode the positions then the speeds
+  long nbVal = that->_dim * that->_nbPart;
+  for (int iField = 0; iField < 2; ++iField) {
+    double step = 2.0 * (iField == 0 ? that->_errPos : that->_errSpeed);
+    int64_t* q = that->_q + iField * nbVal;
+    float* val = (iField == 0 ? that->_pos : that->_speed);
+    int k = PBPhysBitBufferRead(&(that->_bits), 6);
+    for (long iVal = 0; iVal < nbVal; ++iVal) {
+      uint64_t res = PBPhysTrajReadRice(&(that->_bits), k);
+      int64_t r = (int64_t)(res >> 1) ^ -(int64_t)(res & 1);
+      q[iVal] = (isKey ? r : q[iVal] + r);
+      val[iVal] = (double)(q[iVal]) * step;
+    }
+  }
+  // The coded values must fill the frame
+  if (that->_bits._pos != that->_bits._nb)
+    return false;
+  that->_iFrame = iFrame;
+  that->_curTime = curTime;
+  return true;
+}
+
+// Code the 'nb' values 'res' with a Rice code in the PBPhysBitBuffer 
+// 'bits', preceded by the parameter of the code
+void PBPhysTrajWriteRice(PBPhysBitBuffer* const bits, 
+  const uint64_t* const res, const long nb) {
+  // The parameter is the log2 of the mean of the values, which 
+  // minimises the length of the code for geometrically distributed 
+  // values
+  double mean = 0.0;
+  for (long iVal = nb; iVal--;)
+    mean += (double)(res[iVal]);
+  if (nb > 0)
+    mean /= (double)nb;
+  int k = 0;
+  while (k < 63 && (double)(2ULL << k) <= mean)
+    ++k;
+  PBPhysBitBufferWrite(bits, k, 6);
+  // Code the values as their quotient in unary and their remainder on 
+  // k bits, or raw if the quotient is too large
+  for (long iVal = 0; iVal < nb; ++iVal) {
+    uint64_t quot = res[iVal] >> k;
+    if (quot < PBPHYS_TRAJESCAPE) {
+      PBPhysBitBufferWrite(bits, (1ULL << quot) - 1, quot + 1);
+      PBPhysBitBufferWrite(bits, res[iVal], k);
+    } else {
+      PBPhysBitBufferWrite(bits, (1ULL << PBPHYS_TRAJESCAPE) - 1, 
+        PBPHYS_TRAJESCAPE);
+      PBPhysBitBufferWrite(bits, res[iVal], 64);
+    }
+  }
+}
+
+// Decode a value coded with the Rice code of parameter 'k' from the 
+// PBPhysBitBuffer 'bits'
+uint64_t PBPhysTrajReadRice(PBPhysBitBuffer* const bits, const int k) {
+  // Count the 1s of the quotient
+  uint64_t quot = 0;
+  while (quot < PBPHYS_TRAJESCAPE && PBPhysBitBufferRead(bits, 1) == 1)
+    ++quot;
+  if (quot == PBPHYS_TRAJESCAPE)
+    return PBPhysBitBufferRead(bits, 64);
+  return (quot << k) | PBPhysBitBufferRead(bits, k);
+}
+
+// Initialise the PBPhysBitBuffer 'that' as empty
+void PBPhysBitBufferInit(PBPhysBitBuffer* const that) {
+  that->_bytes = NULL;
+  that->_capacity = 0;
+  PBPhysBitBufferReset(that);
+}
+
+// Free the bytes of the PBPhysBitBuffer 'that'
+void PBPhysBitBufferFreeArr(PBPhysBitBuffer* const that) {
+  free(that->_bytes);
+  PBPhysBitBufferInit(that);
+}
+
+// Empty the PBPhysBitBuffer 'that' without freeing its bytes
+void PBPhysBitBufferReset(PBPhysBitBuffer* const that) {
+  that->_nb = 0;
+  that->_acc = 0;
+  that->_nbBit = 0;
+  that->_pos = 0;
+}
+
+// Ensure the PBPhysBitBuffer 'that' can hold 'capacity' bytes without 
+// reallocation
+void PBPhysBitBufferReserve(PBPhysBitBuffer* const that, 
+  const size_t capacity) {
+  if (capacity <= that->_capacity)
+    return;
+  size_t grown = (that->_capacity == 0 ? 
+    PBPHYS_SOACAPACITY : 2 * that->_capacity);
+  if (grown < capacity)
+    grown = capacity;
+  that->_bytes = PBPhysSoAGrowArr(that->_bytes, 1, that->_nb, grown);
+  that->_capacity = grown;
+}
+
+// Append the 'nbBit' (<= 64) lowest bits of 'val' to the 
+// PBPhysBitBuffer 'that'
+void PBPhysBitBufferWrite(PBPhysBitBuffer* const that, 
+  const uint64_t val, const int nbBit) {
+  // Split the values larger than 32 bits to keep the accumulator from 
+  // overflowing
+  if (nbBit > 32) {
+    PBPhysBitBufferWrite(that, val, 32);
+    PBPhysBitBufferWrite(that, val >> 32, nbBit - 32);
+    return;
   }
-  // Decode the data from the JSON
-  if (!PBPhysDecodeAsJSON(that, json)) {
-    return false;
+  uint64_t mask = (nbBit == 0 ? 0 : (~0ULL >> (64 - nbBit)));
+  that->_acc |= (val & mask) << that->_nbBit;
+  that->_nbBit += nbBit;
+  PBPhysBitBufferReserve(that, that->_nb + 5);
+  while (that->_nbBit >= 8) {
+    that->_bytes[(that->_nb)++] = that->_acc & 0xFF;
+    that->_acc >>= 8;
+    that->_nbBit -= 8;
   }
-  // Free the memory used by the JSON
-  JSONFree(&json);
-  // Return the success code
-  return true;
 }
 
-// Step the PBPhys 'that' by that->_deltaT ignoring collision
-void PBPhysNext(PBPhys* const that) {
-#if BUILDMODE == 0
-  if (that == NULL) {
-    PBPhysErr->_type = PBErrTypeNullPointer;
-    sprintf(PBPhysErr->_msg, "'that' is null");
-    PBErrCatch(PBPhysErr);
+// Append the pending bits of the PBPhysBitBuffer 'that' to its bytes, 
+// padded with 0
+void PBPhysBitBufferFlush(PBPhysBitBuffer* const that) {
+  if (that->_nbBit > 0)
+    PBPhysBitBufferWrite(that, 0, 8 - that->_nbBit);
+}
+
+// Read the next 'nbBit' (<= 64) bits of the PBPhysBitBuffer 'that'
+// Bits read beyond the end of the bytes are 0 and the position is 
+// moved past the end
+uint64_t PBPhysBitBufferRead(PBPhysBitBuffer* const that, 
+  const int nbBit) {
+  if (nbBit > 32) {
+    uint64_t low = PBPhysBitBufferRead(that, 32);
+    return low | (PBPhysBitBufferRead(that, nbBit - 32) << 32);
   }
-#endif
-  // If there is particle
-  if (PBPhysGetNbParticle(that) > 0) {
-    // Loop on particles
-    GSetIterForward iter = 
-      GSetIterForwardCreateStatic(PBPhysParticles(that));
-    do {
-      PBPhysParticle* part = GSetIterGet(&iter);
-      // Calculate the system acceleration of the particle
-      PBPhysUpdateSysAccel(that, part);
-      // Move the particle
-      PBPhysParticleMove(part, PBPhysGetDeltaT(that));
-    } while (GSetIterStep(&iter));
+  while (that->_nbBit < nbBit) {
+    if (that->_pos < that->_nb)
+      that->_acc |= (uint64_t)(that->_bytes[that->_pos]) << that->_nbBit;
+    ++(that->_pos);
+    that->_nbBit += 8;
   }
-  // Update current time
-  PBPhysSetCurTime(that, 
-    PBPhysGetCurTime(that) + PBPhysGetDeltaT(that));
+  uint64_t mask = (nbBit == 0 ? 0 : (~0ULL >> (64 - nbBit)));
+  uint64_t val = that->_acc & mask;
+  that->_acc >>= nbBit;
+  that->_nbBit -= nbBit;
+  return val;
 }
 
-// Calculate the system acceleration of the particle 'part' in the 
-// PBPhys 'that'
-void PBPhysUpdateSysAccel(const PBPhys* const that, 
-  PBPhysParticle* particle) {
+// ------------ PBPhysArchive
+
+// ================ Functions declaration ====================
+
+// Return the field 'iField' (position, speed or acceleration) of the 
+// particle 'part' as stored in the deltas of an archive
+const VecFloat* PBPhysArchiveField(const PBPhysParticle* const part, 
+  const int iField);
+
+// Copy the bits of the fields stored in the deltas of an archive of 
+// the particles of the PBPhys 'phys' into 'bits', field by field
+void PBPhysArchiveGetBits(const PBPhys* const phys, 
+  uint32_t* const bits);
+
+// Set the fields stored in the deltas of an archive of the particles 
+// of the PBPhys 'phys' from their bits 'bits', field by field
+void PBPhysArchiveSetBits(PBPhys* const phys, 
+  const uint32_t* const bits);
+
+// Decode the body of the record with flag 'isKey' at the current 
+// position in the file of the PBPhysArchiveReader 'that'
+// Return true if the record could be decoded, false else
+bool PBPhysArchiveReaderDecode(PBPhysArchiveReader* const that, 
+  const bool isKey);
+
+// ================ Functions implementation ====================
+
+// Create a new PBPhysArchive of the PBPhys 'phys' in the file 'path' 
+// with a keyframe every 'keyInterval' steps
+// The current state of 'phys' is archived as the first keyframe, and 
+// the archive is attached to 'phys' which calls PBPhysArchiveAdd after 
+// each PBPhysStep and PBPhysNext
+// Only one archive can be attached to a PBPhys
+// Return NULL if the file couldn't be opened or the first keyframe 
+// written
+PBPhysArchive* PBPhysArchiveOpen(PBPhys* const phys, 
+  const char* const path, const int keyInterval) {
 #if BUILDMODE == 0
-  if (that == NULL) {
+  if (phys == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
-    sprintf(PBPhysErr->_msg, "'that' is null");
+    sprintf(PBPhysErr->_msg, "'phys' is null");
     PBErrCatch(PBPhysErr);
   }
-  if (particle == NULL) {
+  if (path == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
-    sprintf(PBPhysErr->_msg, "'particle' is null");
+    sprintf(PBPhysErr->_msg, "'path' is null");
+    PBErrCatch(PBPhysErr);
+  }
+  if (keyInterval <= 0) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "'keyInterval' is invalid (0<%d)", 
+      keyInterval);
+    PBErrCatch(PBPhysErr);
+  }
+  if (phys->_archive != NULL) {
+    PBPhysErr->_type = PBErrTypeInvalidArg;
+    sprintf(PBPhysErr->_msg, "the PBPhys already has an archive");
     PBErrCatch(PBPhysErr);
   }
 #endif
-  // Reset the system acceleration
-  PBPhysParticleResetSysAccel(particle);
-  // If the particle is fixed there is nothing to do
-  if (PBPhysParticleIsFixed(particle))
-    return;
-  // If the down gravity is active
-  if (fabs(PBPhysGetDownGravity(that)) > PBMATH_EPSILON) {
-    // Substract the down gravity to the y axis of the system 
-    // acceleration
-    PBPhysParticleApplyGravity(particle, PBPhysGetDownGravity(that));
+  // Open the file and write the header
+  FILE* stream = fopen(path, "wb");
+  if (stream == NULL)
+    return NULL;
+  int32_t key = keyInterval;
+  if (!PBPhysWriteBinaryHeader(PBPHYS_BINMAGICARCHIVE, stream) ||
+    !PBPhysWriteLE(&key, sizeof(int32_t), 1, stream)) {
+    fclose(stream);
+    return NULL;
   }
-  // If the gravity is active
-  if (fabs(PBPhysGetGravity(that)) > PBMATH_EPSILON) {
-    // Get the center pos of the particle
-    VecFloat* centerParticle = PBPhysParticleGetPos(particle);
-    // Loop on particles
-    GSetIterForward iter = 
-      GSetIterForwardCreateStatic(PBPhysParticles(that));
-    do {
-      PBPhysParticle* part = GSetIterGet(&iter);
-      // If the current particle is not the particle in argument
-      if (particle != part) {
-        // Get the distance between the two particles
-        VecFloat* centerPart = PBPhysParticleGetPos(part);
-        float dist = VecDist(centerParticle, centerPart);
-        if (fabs(dist) > PBMATH_EPSILON) {
-          // Get the magnitude of the attraction
-          float mag = PBPhysGetGravity(that) * 
-            PBPhysParticleGetMass(particle) * 
-            PBPhysParticleGetMass(part) / fsquare(dist);
-          // Apply the attraction toward the other particle
-          VecOp(centerPart, 1.0, centerParticle, -1.0);
-          VecNormalise(centerPart);
-          PBPhysParticleAddSysAccel(particle, centerPart, mag);
-        }
-        // Free memory
-        VecFree(&centerPart);
-      }
-    } while (GSetIterStep(&iter));
-    // Free memory
-    VecFree(&centerParticle);
+  // Allocate memory
+  PBPhysArchive* that = PBErrMalloc(PBPhysErr, sizeof(PBPhysArchive));
+  // Set properties
+  that->_phys = phys;
+  that->_stream = stream;
+  that->_keyInterval = keyInterval;
+  that->_nbRecord = 0;
+  that->_iLastKey = 0;
+  that->_lastTime = 0.0;
+  that->_nbPart = -1;
+  that->_prev = NULL;
+  that->_cur = NULL;
+  that->_res = NULL;
+  PBPhysBitBufferInit(&(that->_bits));
+  that->_keyOffset = NULL;
+  that->_keyTime = NULL;
+  that->_keyRecord = NULL;
+  that->_nbKey = 0;
+  that->_keyCapacity = 0;
+  that->_error = false;
+  // Archive the current state as the first keyframe
+  if (!PBPhysArchiveAddKey(that)) {
+    (void)PBPhysArchiveClose(&that);
+    return NULL;
   }
+  // Attach the archive to the PBPhys
+  phys->_archive = that;
+  // Return the new PBPhysArchive
+  return that;
 }
 
-// Step the PBPhys 'that' by that->_deltaT managing collision(s)
-void PBPhysStep(PBPhys* const that) {
+// Write the index, close the PBPhysArchive 'that' and detach it from 
+// its PBPhys
+// Return true if all the writes succeeded, false else
+bool PBPhysArchiveClose(PBPhysArchive** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return true;
+  // Write the index of the keyframes
+  PBPhysArchive* a = *that;
+  int64_t nb[2] = {a->_nbKey, a->_nbRecord};
+  bool ret = !(a->_error);
+  for (long iKey = 0; ret && iKey < a->_nbKey; ++iKey)
+    ret = PBPhysWriteLE(a->_keyOffset + iKey, sizeof(int64_t), 1, 
+      a->_stream) &&
+      PBPhysWriteLE(a->_keyTime + iKey, sizeof(float), 1, a->_stream) &&
+      PBPhysWriteLE(a->_keyRecord + iKey, sizeof(int64_t), 1, 
+      a->_stream);
+  ret = ret && PBPhysWriteLE(nb, sizeof(int64_t), 2, a->_stream) &&
+    PBPhysWriteLE(&(a->_lastTime), sizeof(float), 1, a->_stream) &&
+    fwrite(PBPHYS_BINMAGICARCHIVEINDEX, 1, 
+      strlen(PBPHYS_BINMAGICARCHIVEINDEX), a->_stream) == 
+      strlen(PBPHYS_BINMAGICARCHIVEINDEX);
+  if (fclose(a->_stream) != 0)
+    ret = false;
+  // Detach the archive from the PBPhys
+  if (a->_phys != NULL && a->_phys->_archive == a)
+    a->_phys->_archive = NULL;
+  // Free memory
+  free(a->_prev);
+  free(a->_cur);
+  free(a->_res);
+  PBPhysBitBufferFreeArr(&(a->_bits));
+  free(a->_keyOffset);
+  free(a->_keyTime);
+  free(a->_keyRecord);
+  free(a);
+  *that = NULL;
+  return ret;
+}
+
+// Archive the current state of the PBPhys of the PBPhysArchive 'that' 
+// as a keyframe, to use after modifying the particles otherwise than 
+// by stepping
+// Return true if the state could be archived, false else
+bool PBPhysArchiveAddKey(PBPhysArchive* const that) {
 #if BUILDMODE == 0
   if (that == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
@@ -851,35 +8452,61 @@ void PBPhysStep(PBPhys* const that) {
     PBErrCatch(PBPhysErr);
   }
 #endif
-  // Declare a variable to memorize the goal time
-  float goalT = PBPhysGetCurTime(that) + PBPhysGetDeltaT(that);
-  // Declare a variable to memorize the initial deltat
-  float origDeltaT = PBPhysGetDeltaT(that);
-  // Loop until we reach the goal time
-  while (PBPhysGetCurTime(that) < goalT) {
-    // Step until next collision
-    GSetPBPhysParticle* set = PBPhysStepToCollision(that);
-    // If there has been collision
-    if (set != NULL) {
-      // Manage the collision
-      PBPhysParticleApplyElasticCollision(
-        GSetGet(set, 0), GSetGet(set, 1));
-      // Correct the deltat to reach the initial goal time
-      PBPhysSetDeltaT(that, goalT - PBPhysGetCurTime(that));
-      // Free the set
-      GSetFree(&set);
-    }
+  if (that->_error || that->_phys == NULL)
+    return false;
+  PBPhys* phys = that->_phys;
+  // Add the keyframe to the index
+  if (that->_nbKey == that->_keyCapacity) {
+    long capacity = (that->_keyCapacity == 0 ? 
+      PBPHYS_SOACAPACITY : 2 * that->_keyCapacity);
+    that->_keyOffset = PBPhysSoAGrowArr(that->_keyOffset, 
+      sizeof(int64_t), that->_nbKey, capacity);
+    that->_keyTime = PBPhysSoAGrowArr(that->_keyTime, 
+      sizeof(float), that->_nbKey, capacity);
+    that->_keyRecord = PBPhysSoAGrowArr(that->_keyRecord, 
+      sizeof(int64_t), that->_nbKey, capacity);
+    that->_keyCapacity = capacity;
   }
-  // Reset the initial deltat
-  PBPhysSetDeltaT(that, origDeltaT);
+  float curTime = PBPhysGetCurTime(phys);
+  that->_keyOffset[that->_nbKey] = ftell(that->_stream);
+  that->_keyTime[that->_nbKey] = curTime;
+  that->_keyRecord[that->_nbKey] = that->_nbRecord;
+  // Write the keyframe
+  uint8_t flag = 1;
+  that->_error = 
+    !PBPhysWriteLE(&flag, sizeof(uint8_t), 1, that->_stream) ||
+    !PBPhysWriteLE(&curTime, sizeof(float), 1, that->_stream) ||
+    !PBPhysSaveBinary(phys, that->_stream);
+  if (that->_error)
+    return false;
+  // Memorize the bits of the fields for the following deltas
+  long nbPart = PBPhysGetNbParticle(phys);
+  long nbVal = PBPhysGetDim(phys) * (nbPart > 0 ? nbPart : 1);
+  if (nbPart != that->_nbPart) {
+    free(that->_prev);
+    free(that->_cur);
+    free(that->_res);
+    that->_prev = PBErrMalloc(PBPhysErr, 
+      sizeof(uint32_t) * PBPHYS_ARCHIVENBFIELD * nbVal);
+    that->_cur = PBErrMalloc(PBPhysErr, 
+      sizeof(uint32_t) * PBPHYS_ARCHIVENBFIELD * nbVal);
+    that->_res = PBErrMalloc(PBPhysErr, sizeof(uint64_t) * nbVal);
+    that->_nbPart = nbPart;
+  }
+  PBPhysArchiveGetBits(phys, that->_prev);
+  ++(that->_nbKey);
+  that->_iLastKey = that->_nbRecord;
+  ++(that->_nbRecord);
+  that->_lastTime = curTime;
+  return true;
 }
 
-// Step the PBPhys 'that' for that->_deltaT or until a collision occured
-// If no collision occured return NULL
-// If a collision occured one can check the collision time with the 
-// current time that->_curTime, and the returned GSet contains the 
-// particles wich have collided
-GSetPBPhysParticle* PBPhysStepToCollision(PBPhys* const that) {
+// Archive the current state of the PBPhys of the PBPhysArchive 'that', 
+// as a keyframe if _keyInterval steps have been archived since the 
+// last keyframe or the number of particles has changed, else as a 
+// delta
+// Return true if the state could be archived, false else
+bool PBPhysArchiveAdd(PBPhysArchive* const that) {
 #if BUILDMODE == 0
   if (that == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
@@ -887,165 +8514,148 @@ GSetPBPhysParticle* PBPhysStepToCollision(PBPhys* const that) {
     PBErrCatch(PBPhysErr);
   }
 #endif
-  // Declare a variable to memorize the deltat until next collision
-  float deltat = PBPhysGetDeltaT(that);
-  // Declare a set to memorize the colliding particle
-  GSetPBPhysParticle* setCollision = GSetPBPhysParticleCreate();
-  // If there is particle
-  if (PBPhysGetNbParticle(that) > 0) {
-    // Loop on particles
-    GSetIterForward iter = 
-      GSetIterForwardCreateStatic(PBPhysParticles(that));
-    do {
-      PBPhysParticle* part = GSetIterGet(&iter);
-      // Calculate the system acceleration of the particle
-      PBPhysUpdateSysAccel(that, part);
-    } while (GSetIterStep(&iter));
-    // If there is at least two particles
-    if (PBPhysGetNbParticle(that) > 1) {
-      // Declare a variabe to memorize the inverse of deltat
-      float invDeltaT = 1.0 / PBPhysGetDeltaT(that);
-      // Loop on particles once again from the beginning
-      GSetIterReset(&iter);
-      do {
-        PBPhysParticle* part = GSetIterGet(&iter);
-        // Get the pos of the center of the particle
-        VecFloat* posPart = PBPhysParticleGetPos(part);
-        // Get the displacement vector for the current particle
-        VecFloat* vPart = PBPhysParticleGetNextDisplacement(part, 
-          PBPhysGetDeltaT(that));
-        // Scale to have the displacement per time unit
-        VecScale(vPart, invDeltaT);
-        // Get the bounding radius of the particle
-        float radPart = 
-          ShapoidGetBoundingRadius(PBPhysParticleShape(part));
-        // Create a new iterator to loop through following particles
-        GSetIterForward iterPair = iter;
-        GSetIterStep(&iterPair);
-        do {
-          PBPhysParticle* pair = GSetIterGet(&iterPair);
-          // Get the pos of the center of the particle
-          VecFloat* posPair = PBPhysParticleGetPos(pair);
-          // Get the displacement vector for the current pair
-          VecFloat* vPair = PBPhysParticleGetNextDisplacement(pair,
-            PBPhysGetDeltaT(that));
-          // Scale to have the displacement per time unit
-          VecScale(vPair, invDeltaT);
-          // Get the bounding radius of the pair
-          float radPair = 
-            ShapoidGetBoundingRadius(PBPhysParticleShape(pair));
-          // Check the pair trajectory to determine at what time they
-          // are at the closest and what is this closest distance
-          VecFloat3D distPoly = PBPhysGetDistPoly(posPart, vPart,
-            posPair, vPair);
-          float tNearest = deltat;
-          if (fabs(VecGet(&distPoly, 2)) > PBMATH_EPSILON)
-            tNearest = -0.5 * VecGet(&distPoly, 1) / 
-              VecGet(&distPoly, 2);
-          float distNearest = sqrt(VecGet(&distPoly, 0) + 
-            tNearest * VecGet(&distPoly, 1) +
-            fsquare(tNearest) * VecGet(&distPoly, 2));
-          // If there is an impact in future
-          if (tNearest > 0.0 && distNearest < radPart + radPair) {
-            // Get the exact time at which particles hit
-            float tHit = 
-              PBPhysGetTimeToHit(radPart, radPair, &distPoly);
-            // If the time at hit is sooner than current delta
-            if (tHit < deltat) {
-              // Remove the eventual previous colliding particles
-              GSetFlush(setCollision);
-              // Add the colliding particles
-              GSetAppend(setCollision, part);
-              GSetAppend(setCollision, pair);
-              // Update the time at hit
-              deltat = tHit;
-            }
-          }
-          // Free memory
-          VecFree(&vPair);
-          VecFree(&posPair);
-        } while (GSetIterStep(&iterPair));
-        // Free memory
-        VecFree(&posPart);
-        VecFree(&vPart);
-      } while (GSetIterStep(&iter) && !GSetIterIsLast(&iter));
-    }
-    // Move the particles
-    GSetIterReset(&iter);
-    do {
-      PBPhysParticle* part = GSetIterGet(&iter);
-      // Move the particle
-      PBPhysParticleMove(part, deltat);
-    } while (GSetIterStep(&iter));
+  if (that->_error || that->_phys == NULL)
+    return false;
+  PBPhys* phys = that->_phys;
+  if (that->_nbRecord - that->_iLastKey >= that->_keyInterval ||
+    PBPhysGetNbParticle(phys) != that->_nbPart)
+    return PBPhysArchiveAddKey(that);
+  // Code the xor of the bits of each field with the previous record
+  long nbVal = PBPhysGetDim(phys) * that->_nbPart;
+  PBPhysArchiveGetBits(phys, that->_cur);
+  PBPhysBitBufferReset(&(that->_bits));
+  for (int iField = 0; iField < PBPHYS_ARCHIVENBFIELD; ++iField) {
+    const uint32_t* cur = that->_cur + iField * nbVal;
+    const uint32_t* prev = that->_prev + iField * nbVal;
+    for (long iVal = nbVal; iVal--;)
+      that->_res[iVal] = cur[iVal] ^ prev[iVal];
+    PBPhysTrajWriteRice(&(that->_bits), that->_res, nbVal);
   }
-  // Update current time
-  PBPhysSetCurTime(that, PBPhysGetCurTime(that) + deltat);
-  // If the set of collision is empty free it
-  if (GSetNbElem(setCollision) == 0)
-    GSetFree(&setCollision);
-  // Return the set of colliding particles
-  return setCollision;
-}
-
-// Return the time to collision between two particles of radius 'rA' 
-// and 'rB' and the polynom of the square distance between particles 
-// over time 'distPoly'
-float PBPhysGetTimeToHit(float rA, float rB, VecFloat3D* distPoly) {
-  float dist = fsquare(rA + rB);
-  float tHit = (-1.0 * VecGet(distPoly, 1) - 
-    sqrt(fsquare(VecGet(distPoly, 1)) - 4.0 * VecGet(distPoly, 2) * 
-    (VecGet(distPoly, 0) - dist))) / (2.0 * VecGet(distPoly, 2));
-  return tHit;
+  PBPhysBitBufferFlush(&(that->_bits));
+  uint32_t* swap = that->_prev;
+  that->_prev = that->_cur;
+  that->_cur = swap;
+  // Write the delta
+  float curTime = PBPhysGetCurTime(phys);
+  uint8_t flag = 0;
+  uint32_t size = that->_bits._nb;
+  that->_error = 
+    !PBPhysWriteLE(&flag, sizeof(uint8_t), 1, that->_stream) ||
+    !PBPhysWriteLE(&curTime, sizeof(float), 1, that->_stream) ||
+    !PBPhysWriteLE(&size, sizeof(uint32_t), 1, that->_stream) ||
+    fwrite(that->_bits._bytes, 1, size, that->_stream) != size;
+  ++(that->_nbRecord);
+  that->_lastTime = curTime;
+  return !(that->_error);
 }
 
-// Return the coefficients of the polynom describing the square of the 
-// distance between two lines passing through 'posA' and 'posB' and 
-// colinear to 'dirA' and 'dirB' respectively
-// Return a vector such as dist^2(t)=v[0]+v[1]t+v[2]t^2
-VecFloat3D PBPhysGetDistPoly(const VecFloat* const posA, 
-  const VecFloat* const dirA, const VecFloat* const posB, 
-  const VecFloat* const dirB) {
+// Open the archive in the file 'path'
+// Return NULL if the file couldn't be opened or is not a valid archive
+PBPhysArchiveReader* PBPhysArchiveReaderOpen(const char* const path) {
 #if BUILDMODE == 0
-  if (posA == NULL) {
-    PBPhysErr->_type = PBErrTypeNullPointer;
-    sprintf(PBPhysErr->_msg, "'posA' is null");
-    PBErrCatch(PBPhysErr);
-  }
-  if (posB == NULL) {
-    PBPhysErr->_type = PBErrTypeNullPointer;
-    sprintf(PBPhysErr->_msg, "'posB' is null");
-    PBErrCatch(PBPhysErr);
-  }
-  if (dirA == NULL) {
+  if (path == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
-    sprintf(PBPhysErr->_msg, "'dirA' is null");
-    PBErrCatch(PBPhysErr);
-  }
-  if (dirB == NULL) {
-    PBPhysErr->_type = PBErrTypeNullPointer;
-    sprintf(PBPhysErr->_msg, "'dirB' is null");
+    sprintf(PBPhysErr->_msg, "'path' is null");
     PBErrCatch(PBPhysErr);
   }
 #endif
-  // Declare the vector result
-  VecFloat3D res = VecFloatCreateStatic3D();
-  // Loop on dimensions
-  for (long iDim = VecGetDim(posA); iDim--;) {
-    VecSetAdd(&res, 0, 
-      fsquare(VecGet(posA, iDim) - VecGet(posB, iDim)));
-    VecSetAdd(&res, 1, 
-      (VecGet(posA, iDim) - VecGet(posB, iDim)) *
-      (VecGet(dirA, iDim) - VecGet(dirB, iDim)));
-    VecSetAdd(&res, 2, 
-      fsquare(VecGet(dirA, iDim) - VecGet(dirB, iDim)));
+  FILE* stream = fopen(path, "rb");
+  if (stream == NULL)
+    return NULL;
+  // Read the header
+  int32_t keyInterval = 0;
+  bool ret = PBPhysReadBinaryHeader(PBPHYS_BINMAGICARCHIVE, stream) &&
+    PBPhysReadLE(&keyInterval, sizeof(int32_t), 1, stream) &&
+    keyInterval > 0;
+  long sizeHeader = ftell(stream);
+  // Read the number of keyframes and records at the end of the file
+  long lenMagic = strlen(PBPHYS_BINMAGICARCHIVEINDEX);
+  long sizeTrailer = 2 * sizeof(int64_t) + sizeof(float) + lenMagic;
+  int64_t nb[2] = {0};
+  float lastTime = 0.0;
+  char magic[8] = {0};
+  ret = ret && fseek(stream, -sizeTrailer, SEEK_END) == 0 &&
+    PBPhysReadLE(nb, sizeof(int64_t), 2, stream) &&
+    PBPhysReadLE(&lastTime, sizeof(float), 1, stream) &&
+    fread(magic, 1, lenMagic, stream) == (size_t)lenMagic &&
+    memcmp(magic, PBPHYS_BINMAGICARCHIVEINDEX, lenMagic) == 0 &&
+    nb[0] > 0 && nb[1] >= nb[0];
+  // Read the index of the keyframes
+  long sizeEntry = 2 * sizeof(int64_t) + sizeof(float);
+  ret = ret && 
+    fseek(stream, -(sizeTrailer + sizeEntry * nb[0]), SEEK_END) == 0;
+  int64_t* keyOffset = NULL;
+  float* keyTime = NULL;
+  int64_t* keyRecord = NULL;
+  if (ret) {
+    keyOffset = PBErrMalloc(PBPhysErr, sizeof(int64_t) * nb[0]);
+    keyTime = PBErrMalloc(PBPhysErr, sizeof(float) * nb[0]);
+    keyRecord = PBErrMalloc(PBPhysErr, sizeof(int64_t) * nb[0]);
+    for (long iKey = 0; ret && iKey < nb[0]; ++iKey)
+      ret = PBPhysReadLE(keyOffset + iKey, sizeof(int64_t), 1, stream) &&
+        PBPhysReadLE(keyTime + iKey, sizeof(float), 1, stream) &&
+        PBPhysReadLE(keyRecord + iKey, sizeof(int64_t), 1, stream) &&
+        keyOffset[iKey] >= 
+          (iKey == 0 ? sizeHeader : keyOffset[iKey - 1] + 1) &&
+        (iKey > 0 || keyRecord[iKey] == 0) &&
+        (iKey == 0 || keyRecord[iKey] > keyRecord[iKey - 1]) &&
+        keyRecord[iKey] < nb[1];
   }
-  VecSet(&res, 1, VecGet(&res, 1) * 2.0);
-  // Return the result
-  return res;
+  if (!ret) {
+    free(keyOffset);
+    free(keyTime);
+    free(keyRecord);
+    fclose(stream);
+    return NULL;
+  }
+  // Allocate memory
+  PBPhysArchiveReader* that = 
+    PBErrMalloc(PBPhysErr, sizeof(PBPhysArchiveReader));
+  // Set properties
+  that->_stream = stream;
+  that->_keyInterval = keyInterval;
+  that->_nbKey = nb[0];
+  that->_nbRecord = nb[1];
+  that->_lastTime = lastTime;
+  that->_keyOffset = keyOffset;
+  that->_keyTime = keyTime;
+  that->_keyRecord = keyRecord;
+  that->_phys = NULL;
+  that->_iRecord = -1;
+  PBPhysBitBufferInit(&(that->_bits));
+  that->_val = NULL;
+  that->_valCapacity = 0;
+  // Return the new PBPhysArchiveReader
+  return that;
 }
 
-// Return true if the PBPhys 'that' is the same as PBPhys 'tho'
-bool PBPhysIsSame(const PBPhys* const that, const PBPhys* const tho) {
+// Close the PBPhysArchiveReader 'that' and free its PBPhys
+void PBPhysArchiveReaderClose(PBPhysArchiveReader** that) {
+  // Check argument
+  if (that == NULL || *that == NULL)
+    // Nothing to do
+    return;
+  // Free memory
+  fclose((*that)->_stream);
+  free((*that)->_keyOffset);
+  free((*that)->_keyTime);
+  free((*that)->_keyRecord);
+  PBPhysFree(&((*that)->_phys));
+  PBPhysBitBufferFreeArr(&((*that)->_bits));
+  free((*that)->_val);
+  free(*that);
+  *that = NULL;
+}
+
+// Restore in the PBPhysArchiveReader 'that' the state of the PBPhys at 
+// the last record whose time is not after 't'
+// The state is decoded from the current record if 't' is after it and 
+// there is no keyframe between them, else from the keyframe preceding 
+// 't', so at most _keyInterval records are decoded
+// Return false if 't' is before the first record or the records 
+// couldn't be decoded, true else
+bool PBPhysArchiveReaderSeek(PBPhysArchiveReader* const that, 
+  const float t) {
 #if BUILDMODE == 0
   if (that == NULL) {
     PBPhysErr->_type = PBErrTypeNullPointer;
@@ -1053,25 +8663,165 @@ bool PBPhysIsSame(const PBPhys* const that, const PBPhys* const tho) {
     PBErrCatch(PBPhysErr);
   }
 #endif
-  if (that->_dim != tho->_dim ||
-    !ISEQUALF(that->_deltaT, tho->_deltaT) ||
-    !ISEQUALF(that->_curTime, tho->_curTime) ||
-    !ISEQUALF(that->_downGravity, tho->_downGravity) ||
-    that->_gravity != tho->_gravity ||
-    PBPhysGetNbParticle(that) != PBPhysGetNbParticle(tho))
+  if (t < that->_keyTime[0])
     return false;
-  if (PBPhysGetNbParticle(that) > 0) {
-    GSetIterForward iterA = 
-      GSetIterForwardCreateStatic(PBPhysParticles(that));
-    GSetIterForward iterB = 
-      GSetIterForwardCreateStatic(PBPhysParticles(tho));
-    do {
-      PBPhysParticle* partA = GSetIterGet(&iterA);
-      PBPhysParticle* partB = GSetIterGet(&iterB);
-      if (!PBPhysParticleIsSame(partA, partB))
+  // Binary search of the last keyframe whose time is not after 't'
+  long iFirst = 0;
+  long iLast = that->_nbKey - 1;
+  while (iFirst < iLast) {
+    long iMid = (iFirst + iLast + 1) / 2;
+    if (that->_keyTime[iMid] <= t)
+      iFirst = iMid;
+    else
+      iLast = iMid - 1;
+  }
+  // If the current record is not between this keyframe and 't', jump 
+  // to the keyframe
+  if (that->_phys == NULL || that->_iRecord < that->_keyRecord[iFirst] ||
+    PBPhysGetCurTime(that->_phys) > t) {
+    if (fseek(that->_stream, that->_keyOffset[iFirst], SEEK_SET) != 0)
+      return false;
+    that->_iRecord = that->_keyRecord[iFirst] - 1;
+  }
+  // Decode the records until the next one is after 't'
+  while (that->_iRecord + 1 < that->_nbRecord) {
+    long offset = ftell(that->_stream);
+    uint8_t flag = 0;
+    float curTime = 0.0;
+    bool ret = 
+      PBPhysReadLE(&flag, sizeof(uint8_t), 1, that->_stream) &&
+      PBPhysReadLE(&curTime, sizeof(float), 1, that->_stream);
+    if (ret && curTime > t) {
+      ret = (fseek(that->_stream, offset, SEEK_SET) == 0);
+      if (ret)
+        break;
+    }
+    ret = ret && flag <= 1 && PBPhysArchiveReaderDecode(that, flag);
+    if (!ret) {
+      PBPhysFree(&(that->_phys));
+      that->_iRecord = -1;
+      return false;
+    }
+    PBPhysSetCurTime(that->_phys, curTime);
+    ++(that->_iRecord);
+  }
+  return true;
+}
+
+// Decode the body of the record with flag 'isKey' at the current 
+// position in the file of the PBPhysArchiveReader 'that'
+// Return true if the record could be decoded, false else
+bool PBPhysArchiveReaderDecode(PBPhysArchiveReader* const that, 
+  const bool isKey) {
+  // A keyframe replaces the PBPhys
+  if (isKey)
+    return PBPhysLoadBinary(&(that->_phys), that->_stream);
+  // A delta needs the previous record
+  if (that->_phys == NULL)
+    return false;
+  uint32_t size = 0;
+  if (!PBPhysReadLE(&size, sizeof(uint32_t), 1, that->_stream))
+    return false;
+  PBPhysBitBufferReset(&(that->_bits));
+  PBPhysBitBufferReserve(&(that->_bits), size);
+  if (fread(that->_bits._bytes, 1, size, that->_stream) != size)
+    return false;
+  that->_bits._nb = size;
+  // Xor the bits of the fields with the decoded values
+  long nbVal = PBPhysGetDim(that->_phys) * 
+    PBPhysGetNbParticle(that->_phys);
+  if (PBPHYS_ARCHIVENBFIELD * nbVal > that->_valCapacity) {
+    free(that->_val);
+    that->_valCapacity = PBPHYS_ARCHIVENBFIELD * nbVal;
+    that->_val = 
+      PBErrMalloc(PBPhysErr, sizeof(uint32_t) * that->_valCapacity);
+  }
+  PBPhysArchiveGetBits(that->_phys, that->_val);
+  for (int iField = 0; iField < PBPHYS_ARCHIVENBFIELD; ++iField) {
+    uint32_t* val = that->_val + iField * nbVal;
+    int k = PBPhysBitBufferRead(&(that->_bits), 6);
+    for (long iVal = 0; iVal < nbVal; ++iVal) {
+      uint64_t res = PBPhysTrajReadRice(&(that->_bits), k);
+      if (res > UINT32_MAX)
         return false;
-    } while (GSetIterStep(&iterA) && GSetIterStep(&iterB));
+      val[iVal] ^= res;
+    }
   }
+  // The coded values must fill the record
+  if (that->_bits._pos != that->_bits._nb)
+    return false;
+  PBPhysArchiveSetBits(that->_phys, that->_val);
   return true;
 }
 
+// Return the field 'iField' (position, speed or acceleration) of the 
+// particle 'part' as stored in the deltas of an archive
+const VecFloat* PBPhysArchiveField(const PBPhysParticle* const part, 
+  const int iField) {
+  switch (iField) {
+    case 0:
+      return ShapoidPos(PBPhysParticleShape(part));
+    case 1:
+      return PBPhysParticleSpeed(part);
+    default:
+      return PBPhysParticleAccel(part);
+  }
+}
+
+// Copy the bits of the fields stored in the deltas of an archive of 
+// the particles of the PBPhys 'phys' into 'bits', field by field
+void PBPhysArchiveGetBits(const PBPhys* const phys, 
+  uint32_t* const bits) {
+  long nbPart = PBPhysGetNbParticle(phys);
+  if (nbPart == 0)
+    return;
+  int dim = PBPhysGetDim(phys);
+  long nbVal = dim * nbPart;
+  GSetIterForward iter = 
+    GSetIterForwardCreateStatic(PBPhysParticles(phys));
+  long iVal = 0;
+  do {
+    const PBPhysParticle* part = GSetIterGet(&iter);
+    for (int iField = 0; iField < PBPHYS_ARCHIVENBFIELD; ++iField) {
+      const VecFloat* v = PBPhysArchiveField(part, iField);
+      for (int iDim = 0; iDim < dim; ++iDim) {
+        float val = VecGet(v, iDim);
+        memcpy(bits + iField * nbVal + iVal + iDim, &val, sizeof(float));
+      }
+    }
+    iVal += dim;
+  } while (GSetIterStep(&iter));
+}
+
+// Set the fields stored in the deltas of an archive of the particles 
+// of the PBPhys 'phys' from their bits 'bits', field by field
+void PBPhysArchiveSetBits(PBPhys* const phys, 
+  const uint32_t* const bits) {
+  long nbPart = PBPhysGetNbParticle(phys);
+  if (nbPart == 0)
+    return;
+  int dim = PBPhysGetDim(phys);
+  long nbVal = dim * nbPart;
+  VecFloat* v = VecFloatCreate(dim);
+  GSetIterForward iter = 
+    GSetIterForwardCreateStatic(PBPhysParticles(phys));
+  long iVal = 0;
+  do {
+    PBPhysParticle* part = GSetIterGet(&iter);
+    for (int iField = 0; iField < PBPHYS_ARCHIVENBFIELD; ++iField) {
+      for (int iDim = 0; iDim < dim; ++iDim) {
+        float val = 0.0;
+        memcpy(&val, bits + iField * nbVal + iVal + iDim, sizeof(float));
+        VecSet(v, iDim, val);
+      }
+      if (iField == 0)
+        PBPhysParticleSetPos(part, v);
+      else if (iField == 1)
+        PBPhysParticleSetSpeed(part, v);
+      else
+        PBPhysParticleSetAccel(part, v);
+    }
+    iVal += dim;
+  } while (GSetIterStep(&iter));
+  VecFree(&v);
+}
@@ -10,6 +10,10 @@
 #include <math.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
 #include "pberr.h"
 #include "shapoid.h"
 
@@ -17,8 +21,38 @@
 
 // ================= Define ==================
 
+// Magic numbers of the binary format of a particle and a PBPhys, and 
+// version of the binary format
+#define PBPHYS_BINMAGICPARTICLE "PBPP"
+#define PBPHYS_BINMAGIC "PBPS"
+#define PBPHYS_BINVERSION 1
+// Number of particles packed together in memory when saving or loading 
+// in binary format
+#define PBPHYS_BINBLOCK 1024
+
 // ================= Data structure ===================
 
+// Fields of the particles in the binary format, each field is saved as 
+// a packed array over all the particles, in this order
+typedef enum PBPhysBinField {
+  // Type of the shape (int32)
+  PBPhysBinFieldType,
+  // Position of the shape (dim float)
+  PBPhysBinFieldPos,
+  // Axis of the shape (dim*dim float)
+  PBPhysBinFieldAxis,
+  // Speed and user acceleration (dim float)
+  PBPhysBinFieldSpeed,
+  PBPhysBinFieldAccel,
+  // Mass and drag (float)
+  PBPhysBinFieldMass,
+  PBPhysBinFieldDrag,
+  // Fixed flag (uint8)
+  PBPhysBinFieldFixed,
+  // Number of fields
+  PBPhysBinFieldNb
+} PBPhysBinField;
+
 typedef struct PBPhysParticle {
   // Shapoid
   Shapoid* _shape;
@@ -34,15 +68,27 @@ typedef struct PBPhysParticle {
   float _drag;
   // Flag for fixed particle
   bool _fixed;
+  // Flag for asleep particle, excluded from the steps until it's woken 
+  // up
+  bool _asleep;
+  // Time during which the speed of the particle has stayed under the 
+  // sleep threshold of its PBPhys
+  float _idleTime;
   // User data
   void* _data;
+  // PBPhys storing the state of the particle in its structure of
+  // arrays (NULL if the particle owns its state)
+  struct PBPhys* _phys;
+  // Index of the particle in the structure of arrays of _phys
+  long _iSoA;
 } PBPhysParticle;
 
 // ================ Functions declaration ====================
 
 // Create a new PBPhysParticle with dimension 'dim' and a 'shapeType'
 // shapoid as shape 
-// Default values: _mass = 0.0, _drag = 0.0, _fixed = false
+// Default values: _mass = 0.0, _drag = 0.0, _fixed = false, 
+// _asleep = false
 PBPhysParticle* PBPhysParticleCreate(const int dim, 
   const ShapoidType shapeType);
 
@@ -78,6 +124,25 @@ bool PBPhysParticleSave(const PBPhysParticle* const that,
 // If user data is attached to the particle it must be loaded by the user
 bool PBPhysParticleLoad(PBPhysParticle** that, FILE* const stream); 
 
+// Save the particle 'that' on the stream 'stream' in binary format
+// The binary format is made of the magic number 
+// PBPHYS_BINMAGICPARTICLE, the version (uint32), the dimension (int32) 
+// and the fields of the particle in the order of PBPhysBinField, all 
+// in little endian
+// Return true if we could save the particle
+// Return false else
+// If user data is attached to the particle it must be saved by the user
+bool PBPhysParticleSaveBinary(const PBPhysParticle* const that, 
+  FILE* const stream);
+
+// Load the particle 'that' from the stream 'stream' in binary format
+// Return true if we could load the particle
+// Return false else
+// If user data is attached to the particle it must be loaded by the 
+// user
+bool PBPhysParticleLoadBinary(PBPhysParticle** that, 
+  FILE* const stream);
+
 // Return the dimension of the particle 'that'
 #if BUILDMODE != 0
 static inline
@@ -127,21 +192,21 @@ static inline
 #endif
 VecFloat* PBPhysParticleGetPos(const PBPhysParticle* const that);
 
-// Set the speed of the particle 'that' to 'speed'
+// Set the speed of the particle 'that' to 'speed' and wake it up
 // If the particle is fixed do nothing
 #if BUILDMODE != 0
 static inline
 #endif
-void _PBPhysParticleSetSpeed(const PBPhysParticle* const that, 
+void _PBPhysParticleSetSpeed(PBPhysParticle* const that, 
   const VecFloat* const speed);
 
 // Add to the speed of the particle 'that' the vector 'v' multiplied 
-// by 'c'
+// by 'c' and wake it up
 // If the particle is fixed do nothing
 #if BUILDMODE != 0
 static inline
 #endif
-void _PBPhysParticleAddSpeed(const PBPhysParticle* const that, 
+void _PBPhysParticleAddSpeed(PBPhysParticle* const that, 
   const VecFloat* const v, const float c);
 
 // Add to the system accel of the particle 'that' the vector 'v' 
@@ -153,7 +218,8 @@ static inline
 void _PBPhysParticleAddSysAccel(const PBPhysParticle* const that, 
   const VecFloat* const v, const float c);
 
-// Set the acceleration of the particle 'that' to 'accel'
+// Set the acceleration of the particle 'that' to 'accel' and wake it 
+// up
 // If the particle is fixed do nothing
 #if BUILDMODE != 0
 static inline
@@ -176,7 +242,8 @@ static inline
 void PBPhysParticleApplyGravity(PBPhysParticle* const that, 
   const float gravity);
 
-// Set the position of the center of the particle 'that' to 'pos'
+// Set the position of the center of the particle 'that' to 'pos' and 
+// wake it up
 #if BUILDMODE != 0
 static inline
 #endif
@@ -184,7 +251,7 @@ void _PBPhysParticleSetPos(PBPhysParticle* const that,
   const VecFloat* const pos);
 
 // Add to the position of the center of the particle 'that' the vector 
-// 'v' multiplied by 'c'
+// 'v' multiplied by 'c' and wake it up
 #if BUILDMODE != 0
 static inline
 #endif
@@ -255,6 +322,20 @@ static inline
 void PBPhysParticleSetFixed(PBPhysParticle* const that, 
   const bool fixed);
 
+// Return true if the particle 'that' is asleep
+// Return false else
+#if BUILDMODE != 0
+static inline
+#endif
+bool PBPhysParticleIsAsleep(const PBPhysParticle* const that);
+
+// Wake up the particle 'that' if it's asleep, and restart the count of 
+// the time during which its speed stays under the sleep threshold
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysParticleWakeUp(PBPhysParticle* const that);
+
 // Set the user data of the particle 'that' to 'data'
 #if BUILDMODE != 0
 static inline
@@ -270,15 +351,815 @@ void* PBPhysParticleData(const PBPhysParticle* const that);
 // Correct the current speed of the two colliding particles 'that' and 
 // 'tho' under the hypothesis of elastic collision
 // If at least one of the particle as a null mass, do nothing
+// The particles which are not fixed are woken up
 void PBPhysParticleApplyElasticCollision(PBPhysParticle* const that, 
   PBPhysParticle* const tho);
 
+// Correct the current speed of the colliding particles in the set 
+// 'contacts' under the hypothesis of elastic collision
+// The set contains pairs of colliding particles as consecutive 
+// elements, the collisions are applied in the order of the set
+// Particles' mass must not be null
+void PBPhysParticleApplyElasticCollisions(
+  GSetPBPhysParticle* const contacts);
+
 // Return the coefficients of the polynom describing the square of the 
 // distance between particles 'that' and 'tho'
 // Return a vector such as dist^2(t)=v[0]+v[1]t+v[2]t^2
 VecFloat3D PBPhysParticleGetDistPoly(const PBPhysParticle* const that, 
   const PBPhysParticle* const tho);
 
+// ------------ PBPhysSoA
+
+// ================= Define ==================
+
+// Initial number of particles allocated in a PBPhysSoA
+#define PBPHYS_SOACAPACITY 64
+
+// ================= Data structure ===================
+
+// Storage mode of the particles of a PBPhys
+typedef enum PBPhysStorage {
+  // Each particle owns its shape, speed and accelerations
+  PBPhysStorageAoS,
+  // The state of the particles lives in contiguous per component
+  // arrays, the vectors of the particles are views on these arrays
+  PBPhysStorageSoA
+} PBPhysStorage;
+
+typedef struct PBPhysSoA {
+  // Dimension of the vectors
+  int _dim;
+  // Number of particles in the arrays
+  long _nb;
+  // Number of particles the arrays can hold without reallocation
+  long _capacity;
+  // Size in bytes of one VecFloat record in the arrays of vectors
+  size_t _stride;
+  // Arrays of VecFloat records for the position of the shape, the
+  // speed, the user acceleration and the system acceleration
+  char* _pos;
+  char* _speed;
+  char* _accel;
+  char* _sysAccel;
+  // Array of offsets from the position of the shape to its center
+  // (_dim values per particle)
+  float* _centerOffset;
+  // Arrays of mass, drag, bounding radius and fixed flag
+  float* _mass;
+  float* _drag;
+  float* _radius;
+  bool* _fixed;
+  // Array of the particles viewing the arrays
+  PBPhysParticle** _particles;
+} PBPhysSoA;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysSoA for particles of dimension 'dim'
+PBPhysSoA* PBPhysSoACreate(const int dim);
+
+// Free the memory used by the PBPhysSoA 'that'
+// The particles stored in 'that' get back the ownership of their state
+void PBPhysSoAFree(PBPhysSoA** that);
+
+// Ensure the PBPhysSoA 'that' can hold 'capacity' particles without
+// reallocation
+void PBPhysSoAReserve(PBPhysSoA* const that, const long capacity);
+
+// Move the state of the particle 'part' into the arrays of the
+// PBPhysSoA 'that' of the PBPhys 'phys'
+void PBPhysSoAAttach(PBPhysSoA* const that, struct PBPhys* const phys,
+  PBPhysParticle* const part);
+
+// Give back to the particle 'part' the ownership of its state stored
+// in the PBPhysSoA 'that'
+void PBPhysSoADetach(PBPhysSoA* const that, PBPhysParticle* const part);
+
+// Update the bounding radius and center offset of the 'iPart'-th
+// particle of the PBPhysSoA 'that' according to its current shape
+// It is called when the particle is attached and when its size is set
+void PBPhysSoAUpdateShapeOf(PBPhysSoA* const that, const long iPart);
+
+// Return the VecFloat record of the 'iPart'-th particle in the array
+// of records 'arr' of the PBPhysSoA 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+VecFloat* PBPhysSoAVec(const PBPhysSoA* const that, char* const arr,
+  const long iPart);
+
+// Return the 'iDim'-th coordinate of the center of the 'iPart'-th
+// particle in the PBPhysSoA 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysSoAGetCenter(const PBPhysSoA* const that, const long iPart,
+  const int iDim);
+
+// ------------ PBPhysBHTree
+
+// ================= Define ==================
+
+// Default opening angle of the Barnes-Hut tree
+#define PBPHYS_BHTHETA 0.5
+// Maximum depth of the Barnes-Hut tree, bodies which can't be 
+// separated at this depth are merged into one leaf
+#define PBPHYS_BHMAXDEPTH 32
+
+// ================= Data structure ===================
+
+// Solver used for the gravity between particles
+typedef enum PBPhysGravitySolver {
+  // Exact sum over all the pairs of particles, O(N^2)
+  PBPhysGravitySolverExact,
+  // Barnes-Hut tree, O(N.log(N)), approximation controlled by the 
+  // opening angle
+  PBPhysGravitySolverBarnesHut
+} PBPhysGravitySolver;
+
+// Barnes-Hut tree with 2^dim children per cell
+// All the data are in flat arrays reused from one step to the next
+typedef struct PBPhysBHTree {
+  // Dimension of space
+  int _dim;
+  // Number of children per cell (2^dim)
+  long _nbChild;
+  // Number of nodes in the tree
+  long _nbNode;
+  // Number of nodes the arrays can hold without reallocation
+  long _nodeCapacity;
+  // Arrays of the center of the cells (_dim values per node)
+  float* _cellCenter;
+  // Array of the half size of the cells
+  float* _halfSize;
+  // Array of the total mass of the bodies in the cells
+  float* _mass;
+  // Array of the center of mass of the bodies in the cells (_dim 
+  // values per node)
+  float* _com;
+  // Array of the index of the first child of the cells (-1 for leaves)
+  long* _firstChild;
+  // Array of the index of the body in the leaves (-1 if the leaf is 
+  // empty, -2 if the leaf contains several merged bodies)
+  long* _body;
+  // Number of bodies
+  long _nbBody;
+  // Number of bodies the arrays can hold without reallocation
+  long _bodyCapacity;
+  // Arrays of the position of the bodies (_dim values per body)
+  float* _bodyPos;
+  // Array of the mass of the bodies
+  float* _bodyMass;
+  // Array of the gravity force applied on the bodies (_dim values per 
+  // body)
+  float* _force;
+  // Stack of nodes used to walk the tree
+  long* _stack;
+  // Number of nodes the stack can hold without reallocation
+  long _stackCapacity;
+  // Number of body-body or body-cell interactions evaluated during 
+  // the last calculation of the forces
+  long _nbInteraction;
+} PBPhysBHTree;
+
+// Accuracy of the Barnes-Hut tree against the exact sum
+typedef struct PBPhysGravityReport {
+  // Number of particles taken into account
+  long _nbParticle;
+  // Maximum and mean of the relative error on the gravity force 
+  // applied on the particles
+  float _maxRelErr;
+  float _meanRelErr;
+  // Number of interactions evaluated by the tree and by the exact sum
+  long _nbInteraction;
+  long _nbInteractionExact;
+} PBPhysGravityReport;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysBHTree for space dimension 'dim'
+PBPhysBHTree* PBPhysBHTreeCreate(const int dim);
+
+// Free the memory used by the PBPhysBHTree 'that'
+void PBPhysBHTreeFree(PBPhysBHTree** that);
+
+// Set the bodies of the PBPhysBHTree 'that' to the 'nb' particles in 
+// the table 'parts' and build the tree
+void PBPhysBHTreeBuild(PBPhysBHTree* const that, 
+  PBPhysParticle** const parts, const long nb);
+
+// Calculate the gravity force applied on each body of the 
+// PBPhysBHTree 'that' for the gravity constant 'gravity' and the 
+// opening angle 'theta'
+// The tree must have been built
+void PBPhysBHTreeUpdateForce(PBPhysBHTree* const that, 
+  const float gravity, const float theta);
+
+// ------------ PBPhysGrid
+
+// ================= Define ==================
+
+// ================= Data structure ===================
+
+// Broad phase used to select the pairs of particles tested for 
+// collision
+typedef enum PBPhysBroadPhase {
+  // All the pairs are tested, O(N^2)
+  PBPhysBroadPhaseNone,
+  // Only the pairs whose swept bounding boxes share a cell of a hashed 
+  // uniform grid are tested
+  PBPhysBroadPhaseGrid,
+  // Only the pairs whose swept bounding boxes overlap are tested, they 
+  // are found by sweeping the boxes kept sorted along one axis from 
+  // one step to the next (sweep and prune)
+  PBPhysBroadPhaseSAP,
+  // Only the pairs whose swept bounding boxes overlap are tested, they 
+  // are found with a tree of boxes of the moving particles updated 
+  // from one step to the next and a tree of the fixed particles 
+  // rebuilt only when they change (dynamic bounding volume hierarchy)
+  // The pairs of fixed particles are not tested
+  PBPhysBroadPhaseBVH,
+  // Only the pairs of particles closer than the sum of their bounding 
+  // radius and a skin distance when the neighbour lists were built are 
+  // tested, the lists are kept from one step to the next and built 
+  // again only when a particle has moved more than half the skin 
+  // (Verlet neighbour lists)
+  PBPhysBroadPhaseVerlet
+} PBPhysBroadPhase;
+
+// Hashed uniform grid
+// All the data are in flat arrays reused from one step to the next
+typedef struct PBPhysGrid {
+  // Dimension of space
+  int _dim;
+  // Size of the cells
+  float _cellSize;
+  // Number of particles
+  long _nbPart;
+  // Number of particles the arrays can hold without reallocation
+  long _partCapacity;
+  // Arrays of the swept bounding boxes of the particles (_dim values 
+  // per particle)
+  float* _boxMin;
+  float* _boxMax;
+  // Number of (particle, cell) entries
+  long _nbEntry;
+  // Number of entries the arrays can hold without reallocation
+  long _entryCapacity;
+  // Arrays of the particle, cell coordinates (_dim values per entry) 
+  // and bucket of the entries, in order of insertion
+  long* _entryPart;
+  long* _entryCell;
+  long* _entryBucket;
+  // Same arrays sorted per bucket
+  long* _sortedPart;
+  long* _sortedCell;
+  // Number of buckets of the hash table (a power of 2)
+  long _nbBucket;
+  // Number of buckets the array can hold without reallocation
+  long _bucketCapacity;
+  // Index of the first entry of each bucket in the sorted arrays 
+  // (_nbBucket + 1 values)
+  long* _bucketStart;
+} PBPhysGrid;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysGrid for space dimension 'dim'
+PBPhysGrid* PBPhysGridCreate(const int dim);
+
+// Free the memory used by the PBPhysGrid 'that'
+void PBPhysGridFree(PBPhysGrid** that);
+
+// ------------ PBPhysSAP
+
+// ================= Define ==================
+
+// Ratio of the spread of the particles along another axis to their 
+// spread along the current axis above which a PBPhysSAP changes its 
+// axis
+#define PBPHYS_SAPAXISRATIO 2.0
+
+// ================= Data structure ===================
+
+// Particle sorted by a PBPhysSAP
+typedef struct PBPhysSAPEntry {
+  // Lowest bound of the box of the particle along the axis of sort
+  float _min;
+  // Index of the particle
+  long _part;
+} PBPhysSAPEntry;
+
+// Sweep and prune
+// The particles are kept sorted by the lowest bound of their box along 
+// one axis from one step to the next, so the insertion sort updating 
+// the order is near linear when the particles move little between 
+// two steps
+// All the data are in flat arrays reused from one step to the next
+typedef struct PBPhysSAP {
+  // Dimension of space
+  int _dim;
+  // Number of particles
+  long _nbPart;
+  // Number of particles the arrays can hold without reallocation
+  long _partCapacity;
+  // Arrays of the swept bounding boxes of the particles (_dim values 
+  // per particle)
+  float* _boxMin;
+  float* _boxMax;
+  // Array of the particles sorted along the axis _axis
+  PBPhysSAPEntry* _entries;
+  // Axis of sort, the one along which the particles are the most 
+  // spread (-1 if the particles are not sorted yet)
+  int _axis;
+  // Number of swaps of the last insertion sort (-1 if the particles 
+  // have been fully sorted)
+  long _nbSwap;
+} PBPhysSAP;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysSAP for space dimension 'dim'
+PBPhysSAP* PBPhysSAPCreate(const int dim);
+
+// Free the memory used by the PBPhysSAP 'that'
+void PBPhysSAPFree(PBPhysSAP** that);
+
+// ------------ PBPhysBVH
+
+// ================= Define ==================
+
+// Margin added on each side of the boxes of the moving particles in 
+// the tree of a PBPhysBVH, relatively to the size of the box, the 
+// particles are moved in the tree only when they leave their enlarged 
+// box
+#define PBPHYS_BVHMARGIN 0.25
+
+// ================= Data structure ===================
+
+// Node of a PBPhysBVHTree
+typedef struct PBPhysBVHNode {
+  // Index of the parent node (-1 for the root), or of the next free 
+  // node if the node is free
+  long _parent;
+  // Indices of the two children (-1 for a leaf)
+  long _child[2];
+  // Index of the particle of a leaf (-1 for the other nodes)
+  long _part;
+  // Height of the subtree of the node (0 for a leaf)
+  int _height;
+} PBPhysBVHNode;
+
+// Balanced binary tree of boxes, each leaf holds the box of one 
+// particle and each node the union of the boxes of its children
+// All the data are in flat arrays reused from one step to the next
+typedef struct PBPhysBVHTree {
+  // Dimension of space
+  int _dim;
+  // Index of the root node (-1 if the tree is empty)
+  long _root;
+  // Array of nodes
+  PBPhysBVHNode* _nodes;
+  // Arrays of the boxes of the nodes (_dim values per node)
+  float* _boxMin;
+  float* _boxMax;
+  // Number of nodes in the arrays, including the free ones
+  long _nbNode;
+  // Number of nodes the arrays can hold without reallocation
+  long _nodeCapacity;
+  // Index of the first free node (-1 if there is none)
+  long _free;
+} PBPhysBVHTree;
+
+// Dynamic bounding volume hierarchy
+// The moving particles are in a tree whose leaves are enlarged by 
+// PBPHYS_BVHMARGIN, a particle is removed and inserted again only when 
+// it leaves its enlarged box, and the tree is kept balanced by 
+// rotations. The fixed particles are in a second tree, rebuilt only 
+// when a fixed particle has changed
+typedef struct PBPhysBVH {
+  // Dimension of space
+  int _dim;
+  // Number of particles
+  long _nbPart;
+  // Number of particles the arrays can hold without reallocation
+  long _partCapacity;
+  // Arrays of the swept bounding boxes of the particles (_dim values 
+  // per particle)
+  float* _boxMin;
+  float* _boxMax;
+  // Array of the flags of the fixed particles
+  bool* _fixed;
+  // Array of the leaf of the particles (-1 if the particle is in no 
+  // tree), in the static tree if the particle is fixed, else in the 
+  // dynamic tree
+  long* _leaf;
+  // Array of the flags of the particles in the static tree
+  bool* _inStatic;
+  // Tree of the moving particles
+  PBPhysBVHTree _dynamic;
+  // Tree of the fixed particles
+  PBPhysBVHTree _static;
+  // Stack of the pairs of nodes to visit during the search of pairs
+  long* _stack;
+  // Number of pairs of nodes the stack can hold without reallocation
+  long _stackCapacity;
+  // Number of particles inserted in the dynamic tree by the last update
+  long _nbReinsert;
+  // Number of times the static tree has been built
+  long _nbStaticBuild;
+} PBPhysBVH;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysBVH for space dimension 'dim'
+PBPhysBVH* PBPhysBVHCreate(const int dim);
+
+// Free the memory used by the PBPhysBVH 'that'
+void PBPhysBVHFree(PBPhysBVH** that);
+
+// ------------ PBPhysVerlet
+
+// ================= Define ==================
+
+// Default skin distance of the Verlet neighbour lists
+#define PBPHYS_VERLETSKIN 0.5
+
+// ================= Data structure ===================
+
+// Verlet neighbour lists
+// The pairs of particles closer than the sum of their bounding radius 
+// and the skin are selected with a PBPhysGrid when the lists are 
+// built, and kept from one step to the next until a particle has moved 
+// more than half the skin since the build, displacement until the end 
+// of the step included. The particle moving more than half the skin 
+// during the step of the build keep their whole displacement as 
+// margin
+// All the data are in flat arrays reused from one build to the next
+typedef struct PBPhysVerlet {
+  // Dimension of space
+  int _dim;
+  // Number of particles at the last build
+  long _nbPart;
+  // Number of particles the arrays can hold without reallocation
+  long _partCapacity;
+  // Flag to memorize if the lists are up to date (false before the 
+  // first build and after a change of the skin or of the broad phase)
+  bool _isBuilt;
+  // State of the particles at the last build: the particle in the 
+  // table, the position of its center (_dim values per particle), its 
+  // bounding radius, its inactive flag, and the distance it can move 
+  // before the lists must be built again
+  PBPhysParticle** _part;
+  float* _pos;
+  float* _radius;
+  bool* _inactive;
+  float* _margin;
+  // Grid used to build the lists (NULL until first used)
+  PBPhysGrid* _grid;
+  // Number of updates of the pairs
+  long _nbUpdate;
+  // Number of builds of the lists
+  long _nbBuild;
+} PBPhysVerlet;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysVerlet for space dimension 'dim'
+PBPhysVerlet* PBPhysVerletCreate(const int dim);
+
+// Free the memory used by the PBPhysVerlet 'that'
+void PBPhysVerletFree(PBPhysVerlet** that);
+
+// ------------ PBPhysEventQueue
+
+// ================= Define ==================
+
+// ================= Data structure ===================
+
+// Scheduler of the collisions in PBPhysStep
+typedef enum PBPhysScheduler {
+  // PBPhysStepToCollision is called until the end of the step, all the 
+  // pairs are tested again after each collision
+  PBPhysSchedulerSequential,
+  // The next collision of each particle is predicted once per step 
+  // against its neighbours selected by the broad phase (all the other 
+  // particles without broad phase) and kept in a priority queue. After 
+  // a collision only the two colliding particles are moved to its time 
+  // and predicted again against their neighbours, as well as the ones 
+  // whose predicted partner has collided
+  PBPhysSchedulerEventDriven
+} PBPhysScheduler;
+
+// Priority queue of the next collision predicted for each particle
+// All the data are in flat arrays reused from one step to the next
+typedef struct PBPhysEventQueue {
+  // Dimension of space
+  int _dim;
+  // Number of particles
+  long _nbPart;
+  // Number of particles the arrays can hold without reallocation
+  long _partCapacity;
+  // Array of the time of the next collision predicted for the 
+  // particles
+  float* _time;
+  // Array of the partner of the next collision predicted for the 
+  // particles (-1 if there is none before the end of the step)
+  long* _partner;
+  // Array of the number of collisions of the partner when the 
+  // collision was predicted, the prediction is invalid if it has 
+  // changed
+  long* _partnerCount;
+  // Array of the number of collisions of the particles during the step
+  long* _count;
+  // Array of the time up to which the particles have been moved
+  float* _localTime;
+  // Center and radius of the ball each particle must stay in during 
+  // the step for its neighbours to be valid (_dim values per particle 
+  // for the centers)
+  float* _reachPos;
+  float* _reach;
+  // Index in _neighbour of the first neighbour of the particles, the 
+  // neighbours of the 'iPart'-th particle are from _neighbourFirst[iPart] 
+  // to _neighbourFirst[iPart + 1] - 1 (_nbPart + 1 values)
+  long* _neighbourFirst;
+  // Array of the neighbours of the particles, from the pairs of the 
+  // broad phase
+  long* _neighbour;
+  // Number of neighbours the array can hold without reallocation
+  long _neighbourCapacity;
+  // Binary heap of the particles ordered by time of their next 
+  // collision
+  long* _heap;
+  // Array of the position of the particles in the heap
+  long* _heapPos;
+  // Number of collisions during the last step
+  long _nbCollision;
+  // Number of pairs of particles tested during the last step
+  long _nbTest;
+  // Number of times the neighbours have been selected during the last 
+  // step
+  long _nbBuild;
+} PBPhysEventQueue;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysEventQueue for space dimension 'dim'
+PBPhysEventQueue* PBPhysEventQueueCreate(const int dim);
+
+// Free the memory used by the PBPhysEventQueue 'that'
+void PBPhysEventQueueFree(PBPhysEventQueue** that);
+
+// ------------ PBPhysThreadPool
+
+// ================= Define ==================
+
+// ================= Data structure ===================
+
+// Job run by the threads of a PBPhysThreadPool, 'iThread' is the index 
+// of the thread running the job among the 'nbThread' threads of the 
+// pool, and 'data' is the data of the job
+typedef void (*PBPhysJob)(void* const data, const int iThread, 
+  const int nbThread);
+
+struct PBPhysThreadPool;
+
+// Argument of the worker threads of a PBPhysThreadPool
+typedef struct PBPhysThreadPoolWorker {
+  // Pool of the worker
+  struct PBPhysThreadPool* _pool;
+  // Index of the worker in the pool
+  int _iThread;
+} PBPhysThreadPoolWorker;
+
+// Persistent pool of threads, the calling thread is the thread 0 and 
+// the workers are the threads 1 to _nbThread - 1
+typedef struct PBPhysThreadPool {
+  // Number of threads
+  int _nbThread;
+  // Worker threads
+  pthread_t* _threads;
+  // Arguments of the worker threads
+  PBPhysThreadPoolWorker* _workers;
+  // Mutex protecting the pool
+  pthread_mutex_t _mutex;
+  // Condition signaled when a job is submitted or the pool stopped
+  pthread_cond_t _condJob;
+  // Condition signaled when all the workers have completed the job
+  pthread_cond_t _condDone;
+  // Number of jobs submitted since the creation of the pool
+  unsigned long _nbJob;
+  // Number of workers still running the current job
+  int _nbRunning;
+  // Flag to stop the workers
+  bool _stop;
+  // Current job and its data
+  PBPhysJob _job;
+  void* _data;
+} PBPhysThreadPool;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysThreadPool of 'nbThread' threads, including the 
+// calling thread
+PBPhysThreadPool* PBPhysThreadPoolCreate(const int nbThread);
+
+// Free the memory used by the PBPhysThreadPool 'that' and stop its 
+// workers
+void PBPhysThreadPoolFree(PBPhysThreadPool** that);
+
+// Run the job 'job' with data 'data' on all the threads of the 
+// PBPhysThreadPool 'that' and wait for its completion
+void PBPhysThreadPoolRun(PBPhysThreadPool* const that, 
+  const PBPhysJob job, void* const data);
+
+// ------------ PBPhysJSONReader
+
+// ================= Define ==================
+
+// Maximum length of the strings read by a PBPhysJSONReader, including 
+// the terminating null character
+#define PBPHYS_JSONSTRLEN 256
+
+// ================= Data structure ===================
+
+// Pull parser reading a JSON text token by token from a stream, used to 
+// load a PBPhys without creating the JSONNode of the whole text
+typedef struct PBPhysJSONReader {
+  // Stream
+  FILE* _stream;
+  // Current token: one of '{', '}', '[', ']', ':', ',', '"' for a 
+  // string, EOF at the end of the stream or on error, 0 if the next 
+  // token hasn't been read yet
+  int _tok;
+  // Value of the current token if it is a string
+  char _str[PBPHYS_JSONSTRLEN];
+  // Number of bytes read from the stream
+  long _nbByte;
+  // Flag set on a syntax error
+  bool _error;
+} PBPhysJSONReader;
+
+// ------------ PBPhysTrace
+
+// ================= Define ==================
+
+// Initial number of events a PBPhysTraceBuffer can hold
+#define PBPHYS_TRACECAPACITY 256
+
+// ================= Data structure ===================
+
+// Begin or end of an event recorded by a PBPhysTrace
+typedef struct PBPhysTraceEvent {
+  // Name of the event (static string)
+  const char* _name;
+  // Wall time in seconds
+  double _time;
+  // 'B' for the beginning of the event, 'E' for its end
+  char _type;
+} PBPhysTraceEvent;
+
+// Events recorded by one thread, only written by this thread
+typedef struct PBPhysTraceBuffer {
+  // Array of events
+  PBPhysTraceEvent* _events;
+  // Number of events
+  long _nb;
+  // Number of events the array can hold without reallocation
+  long _capacity;
+} PBPhysTraceBuffer;
+
+// Timeline of the phases of the steps of a PBPhys, with one buffer per 
+// thread
+typedef struct PBPhysTrace {
+  // Wall time in seconds of the creation of the trace, origin of the 
+  // timestamps
+  double _origin;
+  // Number of buffers
+  int _nbBuffer;
+  // Buffers of the threads, the i-th one for the i-th thread
+  PBPhysTraceBuffer* _buffers;
+} PBPhysTrace;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysTrace for 'nbThread' threads
+PBPhysTrace* PBPhysTraceCreate(const int nbThread);
+
+// Free the memory used by the PBPhysTrace 'that'
+void PBPhysTraceFree(PBPhysTrace** that);
+
+// Ensure the PBPhysTrace 'that' has a buffer for each of 'nbThread' 
+// threads
+// Must not be called while threads are recording events
+void PBPhysTraceSetNbThread(PBPhysTrace* const that, const int nbThread);
+
+// Remove all the events of the PBPhysTrace 'that'
+void PBPhysTraceReset(PBPhysTrace* const that);
+
+// Return the number of events recorded by the PBPhysTrace 'that' (a 
+// begin and an end count as two events)
+long PBPhysTraceGetNbEvent(const PBPhysTrace* const that);
+
+// Save the events of the PBPhysTrace 'that' on the stream 'stream' in 
+// the Chrome trace event format (JSON), the thread of the events is 
+// their index in the thread pool and their timestamp is in 
+// microseconds since the creation of the trace
+// Return true if we could save, false else
+bool PBPhysTraceSave(const PBPhysTrace* const that, FILE* const stream);
+
+// ------------ PBPhysHisto
+
+// ================= Define ==================
+
+// Number of bits of the values recorded exactly by a PBPhysHisto, the 
+// higher values are recorded with a relative precision of 
+// 2^-(PBPHYS_HISTOSUBBITS-1)
+#define PBPHYS_HISTOSUBBITS 7
+// Highest bit of the values recorded by a PBPhysHisto, the higher 
+// values are recorded as 2^(PBPHYS_HISTOMAXBIT+1)-1 (about 73 minutes 
+// for durations in nanoseconds)
+#define PBPHYS_HISTOMAXBIT 41
+// Number of buckets of a PBPhysHisto
+#define PBPHYS_HISTONBBUCKET ((1 << PBPHYS_HISTOSUBBITS) + \
+  (PBPHYS_HISTOMAXBIT - PBPHYS_HISTOSUBBITS + 1) * \
+  (1 << (PBPHYS_HISTOSUBBITS - 1)))
+
+// ================= Data structure ===================
+
+// Histogram of positive integer values with a constant relative 
+// precision (HDR histogram): the values lower than 
+// 2^PBPHYS_HISTOSUBBITS have their own bucket, each following power of 
+// two is split into 2^(PBPHYS_HISTOSUBBITS-1) buckets of equal width
+typedef struct PBPhysHisto {
+  // Number of values recorded in each bucket
+  unsigned long _count[PBPHYS_HISTONBBUCKET];
+  // Number of values recorded
+  unsigned long _nb;
+  // Lowest and highest values recorded
+  unsigned long _min;
+  unsigned long _max;
+  // Sum of the values recorded
+  double _sum;
+} PBPhysHisto;
+
+// ================ Functions declaration ====================
+
+// Create a new empty PBPhysHisto
+PBPhysHisto* PBPhysHistoCreate(void);
+
+// Free the memory used by the PBPhysHisto 'that'
+void PBPhysHistoFree(PBPhysHisto** that);
+
+// Remove all the values of the PBPhysHisto 'that'
+void PBPhysHistoReset(PBPhysHisto* const that);
+
+// Record the value 'val' in the PBPhysHisto 'that'
+void PBPhysHistoAdd(PBPhysHisto* const that, const unsigned long val);
+
+// Return the number of values recorded in the PBPhysHisto 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+unsigned long PBPhysHistoGetNb(const PBPhysHisto* const that);
+
+// Return the lowest value recorded in the PBPhysHisto 'that' (0 if it 
+// is empty)
+#if BUILDMODE != 0
+static inline
+#endif
+unsigned long PBPhysHistoGetMin(const PBPhysHisto* const that);
+
+// Return the highest value recorded in the PBPhysHisto 'that' (0 if it 
+// is empty)
+#if BUILDMODE != 0
+static inline
+#endif
+unsigned long PBPhysHistoGetMax(const PBPhysHisto* const that);
+
+// Return the mean of the values recorded in the PBPhysHisto 'that' (0 
+// if it is empty)
+#if BUILDMODE != 0
+static inline
+#endif
+double PBPhysHistoGetMean(const PBPhysHisto* const that);
+
+// Return the value below or equal to which 'percent' percents of the 
+// values recorded in the PBPhysHisto 'that' are, within the precision 
+// of the histogram (0 if it is empty)
+// The returned value is the highest value of its bucket, bounded by 
+// the lowest and highest values recorded
+unsigned long PBPhysHistoGetPercentile(const PBPhysHisto* const that, 
+  const float percent);
+
+// Print the number of values, the lowest, mean, 50th, 90th, 99th, 
+// 99.9th percentile and highest values of the PBPhysHisto 'that' on 
+// the stream 'stream', followed by one line per non empty bucket with 
+// its range of values, number of values and cumulated percentage
+void PBPhysHistoPrintln(const PBPhysHisto* const that, 
+  FILE* const stream);
+
 // ------------ PBPhys
 
 // ================= Define ==================
@@ -287,9 +1168,90 @@ VecFloat3D PBPhysParticleGetDistPoly(const PBPhysParticle* const that,
 #define PBPHYS_Gn 9.80665
 #define PBPHYS_G 6.6740831e-11
 #define PBPHYS_DELTAT 0.01
+// Default time during which the speed of a particle must stay under 
+// the sleep threshold before it falls asleep
+#define PBPHYS_SLEEPDELAY 0.5
+
+// Statistics of the steps (time per phase and counters), enabled by 
+// default in development mode only, define PBPHYS_STATS to 1 at 
+// compilation to enable them in the other modes
+#ifndef PBPHYS_STATS
+#if BUILDMODE == 0
+#define PBPHYS_STATS 1
+#else
+#define PBPHYS_STATS 0
+#endif
+#endif
 
 // ================= Data structure ===================
 
+// Phases of the steps timed by the statistics of a PBPhys
+typedef enum PBPhysPhase {
+  // Gravity and system acceleration of the particles
+  PBPhysPhaseSysAccel,
+  // Search of the collisions: scratch, broad phase and sweep on the 
+  // pairs, or predictions of the event driven scheduler
+  PBPhysPhaseSearch,
+  // Resolution of the collisions
+  PBPhysPhaseResolve,
+  // Move of the particles
+  PBPhysPhaseMove,
+  // Recorder and archive at the end of the steps
+  PBPhysPhaseRecord,
+  // Number of phases
+  PBPhysPhaseNb
+} PBPhysPhase;
+
+// Statistics of the steps of a PBPhys since its creation or the last 
+// reset, they stay null if PBPHYS_STATS is 0
+typedef struct PBPhysStats {
+  // Wall time spent in each phase, in seconds
+  double _time[PBPhysPhaseNb];
+  // Number of steps by PBPhysStep or PBPhysNext
+  unsigned long _nbStep;
+  // Number of sweeps on the pairs of particles searching the 
+  // collisions, PBPhysStep sweeps again after each collision with the 
+  // sequential scheduler
+  unsigned long _nbSweep;
+  // Number of pairs of particles tested for collision
+  unsigned long _nbPairTest;
+  // Number of tested pairs whose time of impact has been solved
+  unsigned long _nbTOISolve;
+  // Number of collisions resolved by PBPhysStep
+  unsigned long _nbCollision;
+  // Number of heap allocations by the PBPhys during the steps: growth 
+  // of its buffers and sets of colliding particles
+  unsigned long _nbAlloc;
+} PBPhysStats;
+
+// Collisions found by a search in PBPhysStepToCollision(s)
+typedef struct PBPhysContacts {
+  // Pairs of indices in the table of particles (2 values per 
+  // collision)
+  long* _pairs;
+  // Time of the collisions
+  float* _time;
+  // Number of collisions
+  long _nb;
+  // Number of collisions the arrays can hold without reallocation
+  long _capacity;
+  // Time of the earliest collision
+  float _tMin;
+  // Statistics of the search: number of pairs tested, of times of 
+  // impact solved and of heap allocations
+  unsigned long _nbPairTest;
+  unsigned long _nbTOISolve;
+  unsigned long _nbAlloc;
+} PBPhysContacts;
+
+// Function called by PBPhysLoadWithProgress after each loaded particle 
+// with the user data 'data', the number of particles loaded so far 
+// 'nbLoaded', the number of particles 'nbParticle' declared in the 
+// stream (-1 if it hasn't been read yet) and the number of bytes read 
+// so far 'nbByte'
+typedef void (*PBPhysLoadProgress)(void* const data, const long nbLoaded, 
+  const long nbParticle, const long nbByte);
+
 typedef struct PBPhys {
   // Dimension of space
   const int _dim;
@@ -303,13 +1265,123 @@ typedef struct PBPhys {
   float _gravity;
   // Current time
   float _curTime;
+  // Structure of arrays storing the state of the particles (NULL if
+  // the particles own their state)
+  PBPhysSoA* _soa;
+  // Table of the particles used by the stepping functions when the
+  // particles own their state
+  PBPhysParticle** _table;
+  // Number of particles the table can hold without reallocation
+  long _tableCapacity;
+  // Array of the flags of the particles in the table which don't move 
+  // during the step (fixed or asleep)
+  bool* _tableInactive;
+  // Array of the indices in the table of the particles which are 
+  // neither fixed nor asleep, in the order of the table
+  long* _dynamicPart;
+  // Number of particles which are neither fixed nor asleep
+  long _nbDynamic;
+  // Number of particles the partition arrays can hold without 
+  // reallocation
+  long _partitionCapacity;
+  // Solver used for the gravity between particles
+  PBPhysGravitySolver _gravitySolver;
+  // Opening angle of the Barnes-Hut tree
+  float _gravityTheta;
+  // Barnes-Hut tree (NULL until first used)
+  PBPhysBHTree* _bhTree;
+  // Broad phase used in PBPhysStepToCollision
+  PBPhysBroadPhase _broadPhase;
+  // Uniform grid (NULL until first used)
+  PBPhysGrid* _grid;
+  // Sweep and prune (NULL until first used)
+  PBPhysSAP* _sap;
+  // Bounding volume hierarchy (NULL until first used)
+  PBPhysBVH* _bvh;
+  // Verlet neighbour lists (NULL until first used)
+  PBPhysVerlet* _verlet;
+  // Skin distance of the Verlet neighbour lists
+  float _verletSkin;
+  // Pairs of indices in the table of particles selected by the broad 
+  // phase (2 values per pair, the lowest index first), sorted so that 
+  // the pairs of each particle with the following ones are contiguous 
+  // (concatenated neighbour lists of the Verlet broad phase)
+  long* _pairs;
+  // Number of pairs
+  long _nbPair;
+  // Number of pairs the array can hold without reallocation
+  long _pairCapacity;
+  // Scheduler of the collisions in PBPhysStep
+  PBPhysScheduler _scheduler;
+  // Priority queue of the event driven scheduler (NULL until first 
+  // used)
+  PBPhysEventQueue* _events;
+  // Tolerance on the time of the collisions resolved together in 
+  // PBPhysStep
+  float _contactTolerance;
+  // Speed under which the particles fall asleep (0.0 if the sleep is 
+  // disabled), and time during which their speed must stay under it
+  float _sleepSpeed;
+  float _sleepDelay;
+  // Collisions found by the last search
+  PBPhysContacts _contacts;
+  // Scratch of the stepping functions: arrays of the position of the 
+  // center of the particles and of their displacement per time unit 
+  // until the end of the step (_dim values per particle), and of their 
+  // bounding radius
+  float* _scratchPos;
+  float* _scratchSpeed;
+  float* _scratchRadius;
+  // Number of particles the scratch can hold without reallocation
+  long _scratchCapacity;
+  // Pool of threads (NULL if the PBPhys is single threaded)
+  PBPhysThreadPool* _threadPool;
+  // Collisions found by each thread during the last search (NULL if 
+  // the PBPhys is single threaded)
+  PBPhysContacts* _threadContacts;
+  // Recorder of the trajectory of the particles (NULL if the PBPhys is 
+  // not recorded)
+  struct PBPhysRecorder* _recorder;
+  // Archive of the states of the PBPhys (NULL if the PBPhys is not 
+  // archived)
+  struct PBPhysArchive* _archive;
+  // Statistics of the steps
+  PBPhysStats _stats;
+  // Flag to record the phases of the steps in _trace
+  bool _tracing;
+  // Trace of the phases of the steps (NULL until the PBPhys is traced)
+  PBPhysTrace* _trace;
+  // Histograms of the duration in nanoseconds of PBPhysStep and 
+  // PBPhysNext, and of the number of sub-steps of PBPhysStep (NULL if 
+  // they are not recorded)
+  PBPhysHisto* _stepTimeHisto;
+  PBPhysHisto* _stepIterHisto;
 } PBPhys;
 
+// Data of the jobs run by the threads of a PBPhys
+typedef struct PBPhysStepJob {
+  // The PBPhys
+  PBPhys* _phys;
+  // Table of particles of the PBPhys
+  PBPhysParticle** _parts;
+  // Period of time of the move of the particles
+  float _deltat;
+  // Tolerance on the time of the collisions and flag to search all the 
+  // collisions within the tolerance instead of the earliest one
+  float _tolerance;
+  bool _all;
+} PBPhysStepJob;
+
 // ================ Functions declaration ====================
 
 // Create a new PBPhys for space dimension 'dim'
 // Default values: _deltaT = PBPHYS_DELTAT, _downGravity = 0.0, 
-// _gravity = 0.0, _curTime = 0.0
+// _gravity = 0.0, _curTime = 0.0, 
+// _gravitySolver = PBPhysGravitySolverExact, 
+// _gravityTheta = PBPHYS_BHTHETA, _broadPhase = PBPhysBroadPhaseNone, 
+// _verletSkin = PBPHYS_VERLETSKIN, 
+// _scheduler = PBPhysSchedulerSequential, _contactTolerance = 0.0, 
+// _sleepSpeed = 0.0, _sleepDelay = PBPHYS_SLEEPDELAY, single threaded
 PBPhys* PBPhysCreate(const int dim);
 
 // Free memory used by the PBPhys 'that'
@@ -332,14 +1404,44 @@ bool PBPhysDecodeAsJSON(PBPhys** that, const JSONNode* const json);
 // readable form
 // Return true if we could save the PBPhys
 // Return false else
+// The JSON is written while iterating on the particles, without 
+// creating the JSONNode of PBPhysEncodeAsJSON
 bool PBPhysSave(const PBPhys* const that, FILE* const stream, 
   const bool compact); 
 
 // Load the PBPhys 'that' from the stream 'stream'
 // Return true if we could load the PBPhys
 // Return false else
+// The particles are created while the JSON text is read, without 
+// creating the JSONNode of the whole PBPhys
 bool PBPhysLoad(PBPhys** that, FILE* const stream); 
 
+// Load the PBPhys 'that' from the stream 'stream' as PBPhysLoad, 
+// calling 'progress' (if not null) with 'data' after each loaded 
+// particle
+// Return true if we could load the PBPhys
+// Return false else
+bool PBPhysLoadWithProgress(PBPhys** that, FILE* const stream, 
+  const PBPhysLoadProgress progress, void* const data);
+
+// Save the PBPhys 'that' on the stream 'stream' in binary format
+// The binary format is made of the magic number PBPHYS_BINMAGIC, the 
+// version (uint32), the dimension (int32), the current time, the delta 
+// t, the down gravity, the gravity (float), the number of particles 
+// (int64), and the fields of the particles in the order of 
+// PBPhysBinField, each as a packed array over all the particles, all 
+// in little endian
+// Values are saved exactly, a PBPhys saved and loaded in binary format 
+// is the same as the original one
+// Return true if we could save the PBPhys
+// Return false else
+bool PBPhysSaveBinary(const PBPhys* const that, FILE* const stream);
+
+// Load the PBPhys 'that' from the stream 'stream' in binary format
+// Return true if we could load the PBPhys
+// Return false else
+bool PBPhysLoadBinary(PBPhys** that, FILE* const stream);
+
 // Return the space dimension of the PBPhys 'that'
 #if BUILDMODE != 0
 static inline
@@ -405,6 +1507,9 @@ static inline
 void PBPhysSetGravity(PBPhys* const that, float gravity);
 
 // Step the PBPhys 'that' by that->_deltaT ignoring collision
+// The system acceleration of all the particles is calculated from 
+// their state at the beginning of the step before any particle is 
+// moved, then the result doesn't depend on the order of the particles
 void PBPhysNext(PBPhys* const that);
 
 // Step the PBPhys 'that' by that->_deltaT managing collision(s)
@@ -417,6 +1522,19 @@ void PBPhysStep(PBPhys* const that);
 // particles wich have collided
 GSetPBPhysParticle* PBPhysStepToCollision(PBPhys* const that);
 
+// Step the PBPhys 'that' for that->_deltaT or until the earliest 
+// collision, and return all the collisions occuring within 'tolerance' 
+// of the earliest one
+// If no collision occured return NULL
+// If collisions occured one can check the time of the earliest one 
+// with the current time that->_curTime, and the returned GSet contains 
+// the pairs of particles wich have collided, as consecutive elements 
+// in the order of the table of particles
+// The particles are moved to the time of the earliest collision, the 
+// other ones are considered to occur at the same time
+GSetPBPhysParticle* PBPhysStepToCollisions(PBPhys* const that, 
+  const float tolerance);
+
 // Return the 'iParticle'-th particle of the PBPhys 'that'
 #if BUILDMODE != 0
 static inline
@@ -437,6 +1555,955 @@ static inline
 void PBPhysAddParticles(PBPhys* const that, const int nb, 
   const ShapoidType shape);
 
+// Set the storage mode of the particles of the PBPhys 'that' to
+// 'storage'
+// With PBPhysStorageSoA the vectors of the particles become views on
+// the arrays of the PBPhys, pointers previously returned by the
+// particles' accessors are invalidated
+// Particles added or removed directly through the set of particles
+// are taken into account at the next step
+void PBPhysSetStorage(PBPhys* const that, const PBPhysStorage storage);
+
+// Return the storage mode of the particles of the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysStorage PBPhysGetStorage(const PBPhys* const that);
+
+// Set the solver used for the gravity between particles of the PBPhys 
+// 'that' to 'solver'
+// With the Barnes-Hut solver the gravity applied on all the particles 
+// is calculated from their positions at the beginning of the step
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetGravitySolver(PBPhys* const that, 
+  const PBPhysGravitySolver solver);
+
+// Return the solver used for the gravity between particles of the 
+// PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysGravitySolver PBPhysGetGravitySolver(const PBPhys* const that);
+
+// Set the opening angle of the Barnes-Hut tree of the PBPhys 'that' to 
+// 'theta'
+// A cell is approximated by its center of mass if its size divided by 
+// its distance to the particle is less than 'theta', 0.0 gives the 
+// exact sum
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetGravityTheta(PBPhys* const that, const float theta);
+
+// Return the opening angle of the Barnes-Hut tree of the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysGetGravityTheta(const PBPhys* const that);
+
+// Return the accuracy of the Barnes-Hut tree against the exact sum for 
+// the gravity between the particles of the PBPhys 'that' in their 
+// current state
+// The state of the particles is not modified
+PBPhysGravityReport PBPhysGetGravityReport(PBPhys* const that);
+
+// Set the broad phase used to select the pairs of particles tested for 
+// collision in the PBPhys 'that' to 'broadPhase'
+// The broad phase doesn't change the result of the steps
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetBroadPhase(PBPhys* const that, 
+  const PBPhysBroadPhase broadPhase);
+
+// Return the broad phase used to select the pairs of particles tested 
+// for collision in the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysBroadPhase PBPhysGetBroadPhase(const PBPhys* const that);
+
+// Set the skin distance of the Verlet neighbour lists of the PBPhys 
+// 'that' to 'skin'
+// A larger skin builds the lists less often but selects more pairs
+// The lists are built again at the next step
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetVerletSkin(PBPhys* const that, const float skin);
+
+// Return the skin distance of the Verlet neighbour lists of the PBPhys 
+// 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysGetVerletSkin(const PBPhys* const that);
+
+// Return the number of updates of the pairs with the Verlet broad 
+// phase of the PBPhys 'that', one per search of collisions
+// Return 0 if the Verlet broad phase has never been used
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysGetVerletNbUpdate(const PBPhys* const that);
+
+// Return the number of builds of the Verlet neighbour lists of the 
+// PBPhys 'that', divided by the number of updates it gives the rebuild 
+// frequency to tune the skin
+// Return 0 if the Verlet broad phase has never been used
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysGetVerletNbBuild(const PBPhys* const that);
+
+// Set the scheduler of the collisions in PBPhysStep of the PBPhys 
+// 'that' to 'scheduler'
+// With the event driven scheduler the system acceleration of the 
+// particles is calculated once at the beginning of the step, and the 
+// result may differ from the sequential scheduler by rounding errors
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetScheduler(PBPhys* const that, 
+  const PBPhysScheduler scheduler);
+
+// Return the scheduler of the collisions in PBPhysStep of the PBPhys 
+// 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysScheduler PBPhysGetScheduler(const PBPhys* const that);
+
+// Set the tolerance on the time of the collisions resolved together in 
+// PBPhysStep of the PBPhys 'that' to 'tolerance'
+// If 'tolerance' is greater than 0.0 PBPhysStep uses 
+// PBPhysStepToCollisions instead of PBPhysStepToCollision with the 
+// sequential scheduler
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetContactTolerance(PBPhys* const that, 
+  const float tolerance);
+
+// Return the tolerance on the time of the collisions resolved together 
+// in PBPhysStep of the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysGetContactTolerance(const PBPhys* const that);
+
+// Set the speed under which the particles of the PBPhys 'that' fall 
+// asleep to 'speed'
+// A particle whose speed, and the speed it gains over a step from its 
+// accelerations, stay under 'speed' during the sleep delay at the end 
+// of the steps falls asleep: its speed and system acceleration are set 
+// to null, its user acceleration is kept, and it's excluded from the 
+// integration and the broad phase until it's woken up by a collision 
+// or by setting its speed, acceleration or position
+// If 'speed' equals 0.0 the sleep is disabled (default) and all the 
+// particles are woken up
+void PBPhysSetSleepSpeed(PBPhys* const that, const float speed);
+
+// Return the speed under which the particles of the PBPhys 'that' fall 
+// asleep
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysGetSleepSpeed(const PBPhys* const that);
+
+// Set the time during which the speed of a particle of the PBPhys 
+// 'that' must stay under the sleep threshold before it falls asleep 
+// to 'delay'
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysSetSleepDelay(PBPhys* const that, const float delay);
+
+// Return the time during which the speed of a particle of the PBPhys 
+// 'that' must stay under the sleep threshold before it falls asleep
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysGetSleepDelay(const PBPhys* const that);
+
+// Set the number of threads used by the PBPhys 'that' to 'nbThread'
+// The system acceleration, the move of the particles and the search of 
+// collisions are split between the threads, which are kept alive 
+// until the number of threads is changed or 'that' is freed
+// The results are the same whatever the number of threads
+// The event driven scheduler stays single threaded
+void PBPhysSetNbThread(PBPhys* const that, const int nbThread);
+
+// Return the number of threads used by the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysGetNbThread(const PBPhys* const that);
+
+// Return the statistics of the steps of the PBPhys 'that'
+// They are null if PBPHYS_STATS is 0
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysStats PBPhysGetStats(const PBPhys* const that);
+
+// Reset the statistics of the steps of the PBPhys 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysResetStats(PBPhys* const that);
+
+// Print the statistics of the steps 'that' on the stream 'stream'
+void PBPhysStatsPrintln(const PBPhysStats* const that, 
+  FILE* const stream);
+
+// Start (if 'flag' equals true) or stop (if 'flag' equals false) the 
+// recording of the phases of the steps of the PBPhys 'that' and of 
+// each PBPhysStepToCollision in its trace, one buffer per thread
+// The recorded events are kept when the tracing is stopped, until the 
+// trace is reset or 'that' is freed
+void PBPhysSetTracing(PBPhys* const that, const bool flag);
+
+// Return true if the steps of the PBPhys 'that' are traced, else false
+#if BUILDMODE != 0
+static inline
+#endif
+bool PBPhysIsTracing(const PBPhys* const that);
+
+// Return the trace of the PBPhys 'that' (NULL if it has never been 
+// traced)
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysTrace* PBPhysGetTrace(const PBPhys* const that);
+
+// Save the trace of the PBPhys 'that' on the stream 'stream' in the 
+// Chrome trace event format, which can be opened with chrome://tracing 
+// or Perfetto
+// Return true if we could save, false else
+bool PBPhysSaveTrace(const PBPhys* const that, FILE* const stream);
+
+// Start (if 'flag' equals true) or stop (if 'flag' equals false) the 
+// recording of the latency histograms of the PBPhys 'that': the 
+// duration in nanoseconds of each PBPhysStep and PBPhysNext, and the 
+// number of sub-steps of each PBPhysStep (calls to 
+// PBPhysStepToCollision with the sequential scheduler, moves between 
+// collisions with the event driven scheduler)
+// The histograms are freed when the recording is stopped
+void PBPhysSetStepHistos(PBPhys* const that, const bool flag);
+
+// Return the histogram of the duration in nanoseconds of the steps 
+// of the PBPhys 'that' (NULL if it's not recorded)
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysHisto* PBPhysGetStepTimeHisto(const PBPhys* const that);
+
+// Return the histogram of the number of sub-steps of the steps of the 
+// PBPhys 'that' (NULL if it's not recorded)
+#if BUILDMODE != 0
+static inline
+#endif
+PBPhysHisto* PBPhysGetStepIterHisto(const PBPhys* const that);
+
+// ------------ PBPhysSnapshot
+
+// ================= Define ==================
+
+// ================= Data structure ===================
+
+// Snapshot of a PBPhys saved with PBPhysSaveBinary, the file is mapped 
+// in memory and the particles are decoded from the mapped packed arrays 
+// only when they are accessed
+typedef struct PBPhysSnapshot {
+  // Mapped file and its size in bytes
+  char* _map;
+  size_t _size;
+  // Dimension, current time, delta t, down gravity and gravity of the 
+  // saved PBPhys
+  int _dim;
+  float _curTime;
+  float _deltaT;
+  float _downGravity;
+  float _gravity;
+  // Number of particles
+  long _nbParticle;
+  // Packed arrays of the fields of the particles in the mapped file
+  const char* _fields[PBPhysBinFieldNb];
+  // Particles materialised on first access (NULL until accessed)
+  PBPhysParticle** _particles;
+  // Scratch used to decode the fields of a particle
+  float* _buffer;
+  VecFloat* _v;
+} PBPhysSnapshot;
+
+// ================ Functions declaration ====================
+
+// Open the snapshot of a PBPhys saved with PBPhysSaveBinary in the 
+// file 'path'
+// The file is mapped in memory, only its header is read
+// Return NULL if the file couldn't be mapped or is not a valid snapshot
+PBPhysSnapshot* PBPhysSnapshotOpen(const char* const path);
+
+// Close the PBPhysSnapshot 'that' and free the particles materialised 
+// by PBPhysSnapshotParticle
+void PBPhysSnapshotClose(PBPhysSnapshot** that);
+
+// Return the 'iPart'-th particle of the PBPhysSnapshot 'that'
+// The particle is materialised from the mapped file on the first 
+// access, it belongs to 'that' and is freed when 'that' is closed
+// Return NULL if the saved data of the particle is invalid
+PBPhysParticle* PBPhysSnapshotParticle(PBPhysSnapshot* const that, 
+  const long iPart);
+
+// Return a new PBPhys restored from the PBPhysSnapshot 'that' with the 
+// storage mode 'storage'
+// The particles are materialised from the mapped file, with the 
+// PBPhysStorageSoA mode their state is written directly into the 
+// arrays of the PBPhys
+// Return NULL if the saved data of a particle is invalid
+PBPhys* PBPhysSnapshotGetPBPhys(PBPhysSnapshot* const that, 
+  const PBPhysStorage storage);
+
+// Return the number of particles in the PBPhysSnapshot 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysSnapshotGetNbParticle(const PBPhysSnapshot* const that);
+
+// Return the space dimension of the PBPhysSnapshot 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysSnapshotGetDim(const PBPhysSnapshot* const that);
+
+// ------------ PBPhysRecorder
+
+// ================= Define ==================
+
+// Magic number of the trajectory files written by a PBPhysRecorder
+#define PBPHYS_BINMAGICRECORD "PBPR"
+
+// Default number of records the ring of a PBPhysRecorder can hold
+#define PBPHYS_RECRING 64
+
+// Default fields recorded by a PBPhysRecorder
+#define PBPHYS_RECFIELDS \
+  ((1 << PBPhysBinFieldPos) | (1 << PBPhysBinFieldSpeed))
+
+// ================= Data structure ===================
+
+// Statistics of a PBPhysRecorder since it has been started
+typedef struct PBPhysRecorderStats {
+  // Number of steps seen by the recorder
+  long _nbStep;
+  // Number of records copied into the ring
+  long _nbRecord;
+  // Number of records written on the file
+  long _nbWritten;
+  // Number of records dropped because the ring was full
+  long _nbDropped;
+  // Number of records which had to wait for a free slot in the ring
+  long _nbStall;
+  // Maximum number of records pending in the ring
+  long _maxPending;
+  // Flag raised if the writer failed to write on the file
+  bool _error;
+} PBPhysRecorderStats;
+
+// Recorder of the trajectory of the particles of a PBPhys
+// After each step the selected fields of the selected particles are 
+// copied into a ring of records, a background thread drains the ring 
+// to a binary file
+// The file starts with the magic number PBPHYS_BINMAGICRECORD, the 
+// version, the dimension (int32), the mask of recorded fields 
+// (uint32), the number of recorded particles (int64) and their index 
+// (int64 each), followed by the records
+// Each record is the current time (float) followed by the packed array 
+// of each recorded field, in the order of PBPhysBinField, all in 
+// little endian order
+typedef struct PBPhysRecorder {
+  // Recorded PBPhys
+  PBPhys* _phys;
+  // Mask of the recorded fields (1 << PBPhysBinField)
+  int _fields;
+  // Indices of the recorded particles in the PBPhys (NULL to record 
+  // all the particles)
+  long* _parts;
+  // Number of recorded particles
+  long _nbPart;
+  // Number of steps between two records
+  int _stride;
+  // Flag to drop the records when the ring is full instead of waiting 
+  // for the writer
+  bool _drop;
+  // Number of records the ring can hold
+  long _ringSize;
+  // Size in bytes of a record in the file, and of a slot of the ring
+  size_t _sizeRecord;
+  size_t _sizeSlot;
+  // Ring of records (NULL if the recorder is not running)
+  char* _ring;
+  // Number of records pushed into and pulled from the ring since the 
+  // recorder has been started, only written by the stepping thread 
+  // and the writer thread respectively
+  atomic_long _head;
+  atomic_long _tail;
+  // Semaphore posted for each record pushed into the ring and to stop 
+  // the writer
+  sem_t _sem;
+  // Writer thread
+  pthread_t _thread;
+  // Stream of the file (NULL if the recorder is not running)
+  FILE* _stream;
+  // Flag raised if the writer failed to write on the file
+  atomic_bool _error;
+  // Statistics maintained by the stepping thread
+  long _nbStep;
+  long _nbDropped;
+  long _nbStall;
+  long _maxPending;
+} PBPhysRecorder;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysRecorder of the PBPhys 'phys'
+// Default values: _fields = PBPHYS_RECFIELDS, all the particles, 
+// _stride = 1, _drop = false, _ringSize = PBPHYS_RECRING
+PBPhysRecorder* PBPhysRecorderCreate(PBPhys* const phys);
+
+// Free the memory used by the PBPhysRecorder 'that', stop it first if 
+// it is running
+void PBPhysRecorderFree(PBPhysRecorder** that);
+
+// Start the PBPhysRecorder 'that' on the file 'path'
+// The recorder is attached to its PBPhys which calls 
+// PBPhysRecorderRecord after each PBPhysStep and PBPhysNext
+// Only one recorder can be attached to a PBPhys, and the recorded 
+// particles must stay in the PBPhys until the recorder is stopped
+// Return true if the file could be opened and its header written, 
+// false else
+bool PBPhysRecorderStart(PBPhysRecorder* const that, 
+  const char* const path);
+
+// Stop the PBPhysRecorder 'that', wait for the writer to drain the 
+// ring, close the file and detach the recorder from its PBPhys
+void PBPhysRecorderStop(PBPhysRecorder* const that);
+
+// Record the state of the PBPhys of the PBPhysRecorder 'that' if the 
+// number of steps seen since the start is a multiple of the stride
+// If the ring is full the record is dropped or waits for the writer 
+// according to _drop
+void PBPhysRecorderRecord(PBPhysRecorder* const that);
+
+// Return the statistics of the PBPhysRecorder 'that'
+PBPhysRecorderStats PBPhysRecorderGetStats(
+  const PBPhysRecorder* const that);
+
+// Set the particles recorded by the PBPhysRecorder 'that' to the 'nb' 
+// particles at indices 'parts' in the PBPhys
+// If 'parts' is NULL all the particles are recorded
+// The recorder must not be running
+void PBPhysRecorderSetParticles(PBPhysRecorder* const that, 
+  const long nb, const long* const parts);
+
+// Set the mask of the fields recorded by the PBPhysRecorder 'that' to 
+// 'fields' (1 << PBPhysBinField)
+// The recorder must not be running
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysRecorderSetFields(PBPhysRecorder* const that, 
+  const int fields);
+
+// Return the mask of the fields recorded by the PBPhysRecorder 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysRecorderGetFields(const PBPhysRecorder* const that);
+
+// Set the number of steps between two records of the PBPhysRecorder 
+// 'that' to 'stride'
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysRecorderSetStride(PBPhysRecorder* const that, 
+  const int stride);
+
+// Return the number of steps between two records of the 
+// PBPhysRecorder 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysRecorderGetStride(const PBPhysRecorder* const that);
+
+// Set the flag to drop the records of the PBPhysRecorder 'that' when 
+// its ring is full to 'drop', if false the stepping thread waits for 
+// the writer
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysRecorderSetDrop(PBPhysRecorder* const that, const bool drop);
+
+// Return the flag to drop the records of the PBPhysRecorder 'that' 
+// when its ring is full
+#if BUILDMODE != 0
+static inline
+#endif
+bool PBPhysRecorderGetDrop(const PBPhysRecorder* const that);
+
+// Set the number of records the ring of the PBPhysRecorder 'that' can 
+// hold to 'size'
+// The recorder must not be running
+#if BUILDMODE != 0
+static inline
+#endif
+void PBPhysRecorderSetRingSize(PBPhysRecorder* const that, 
+  const long size);
+
+// Return the number of records the ring of the PBPhysRecorder 'that' 
+// can hold
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysRecorderGetRingSize(const PBPhysRecorder* const that);
+
+// Return true if the PBPhysRecorder 'that' is running, false else
+#if BUILDMODE != 0
+static inline
+#endif
+bool PBPhysRecorderIsRunning(const PBPhysRecorder* const that);
+
+// ------------ PBPhysTraj
+
+// ================= Define ==================
+
+// Magic numbers of the compressed trajectory files and of their index
+#define PBPHYS_BINMAGICTRAJ "PBPT"
+#define PBPHYS_BINMAGICTRAJINDEX "PBPI"
+
+// Default number of frames between two keyframes of a compressed 
+// trajectory
+#define PBPHYS_TRAJKEY 64
+
+// Number of bits of the quotient above which a residual is stored 
+// raw in a compressed trajectory
+#define PBPHYS_TRAJESCAPE 32
+
+// ================= Data structure ===================
+
+// Buffer of bits used to encode and decode the frames of a compressed 
+// trajectory
+typedef struct PBPhysBitBuffer {
+  // Bytes of the buffer
+  uint8_t* _bytes;
+  // Number of bytes in the buffer
+  size_t _nb;
+  // Number of bytes the buffer can hold without reallocation
+  size_t _capacity;
+  // Bits not yet flushed into the bytes when writing, or not yet 
+  // consumed when reading, and their number
+  uint64_t _acc;
+  int _nbBit;
+  // Position of the next byte to read
+  size_t _pos;
+} PBPhysBitBuffer;
+
+// Writer of a compressed trajectory of the positions and speeds of the 
+// particles of a PBPhys
+// Each component is quantised with a step of twice the error bound of 
+// its field, the quantised values of a keyframe are coded as they are 
+// and those of the other frames as their difference with the previous 
+// frame, and the residuals of each field are coded with a Rice code 
+// whose parameter is chosen per frame
+// The file starts with the magic number PBPHYS_BINMAGICTRAJ, the 
+// version, the dimension (int32), the number of particles (int64), the 
+// error bounds of the positions and speeds (float) and the number of 
+// frames between two keyframes (int32), followed by the frames
+// Each frame is the size of its coded values (uint32), a flag set for 
+// keyframes (uint8), the current time (float) and the coded values
+// The file ends with the index of the keyframes: their offset (int64) 
+// and time (float), the number of keyframes and of frames (int64) and 
+// the magic number PBPHYS_BINMAGICTRAJINDEX
+typedef struct PBPhysTrajWriter {
+  // Stream of the file
+  FILE* _stream;
+  // Dimension and number of particles
+  int _dim;
+  long _nbPart;
+  // Error bounds of the positions and speeds
+  float _errPos;
+  float _errSpeed;
+  // Number of frames between two keyframes
+  int _keyInterval;
+  // Number of frames written
+  long _nbFrame;
+  // Quantised positions and speeds of the previous frame (_dim values 
+  // per particle each)
+  int64_t* _q;
+  // Scratch of the residuals of a field
+  uint64_t* _res;
+  // Buffer of the coded values of a frame
+  PBPhysBitBuffer _bits;
+  // Offset in the file and time of the keyframes
+  int64_t* _keyOffset;
+  float* _keyTime;
+  // Number of keyframes the index can hold without reallocation
+  long _keyCapacity;
+  // Flag raised if a write failed
+  bool _error;
+} PBPhysTrajWriter;
+
+// Reader of a compressed trajectory written by a PBPhysTrajWriter
+typedef struct PBPhysTrajReader {
+  // Stream of the file
+  FILE* _stream;
+  // Dimension and number of particles
+  int _dim;
+  long _nbPart;
+  // Error bounds of the positions and speeds
+  float _errPos;
+  float _errSpeed;
+  // Number of frames between two keyframes
+  int _keyInterval;
+  // Number of frames and keyframes
+  long _nbFrame;
+  long _nbKey;
+  // Offset in the file and time of the keyframes
+  int64_t* _keyOffset;
+  float* _keyTime;
+  // Index of the current frame (-1 before the first frame)
+  long _iFrame;
+  // Time of the current frame
+  float _curTime;
+  // Quantised positions and speeds of the current frame
+  int64_t* _q;
+  // Decoded positions and speeds of the current frame (_dim values 
+  // per particle each)
+  float* _pos;
+  float* _speed;
+  // Buffer of the coded values of a frame
+  PBPhysBitBuffer _bits;
+} PBPhysTrajReader;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysTrajWriter of the trajectory of the particles of 
+// the PBPhys 'phys' in the file 'path'
+// The positions are coded within 'errPos' and the speeds within 
+// 'errSpeed' (up to the rounding of floats), and a keyframe is coded 
+// every 'keyInterval' frames
+// Return NULL if the file couldn't be opened or its header written
+PBPhysTrajWriter* PBPhysTrajWriterOpen(const char* const path, 
+  const PBPhys* const phys, const float errPos, const float errSpeed, 
+  const int keyInterval);
+
+// Write the index and close the PBPhysTrajWriter 'that'
+// Return true if all the writes succeeded, false else
+bool PBPhysTrajWriterClose(PBPhysTrajWriter** that);
+
+// Code the current state of the particles of the PBPhys 'phys' as a 
+// new frame of the PBPhysTrajWriter 'that'
+// 'phys' must have the dimension and number of particles 'that' has 
+// been opened with
+// Return true if the frame could be written, false else
+bool PBPhysTrajWriterAdd(PBPhysTrajWriter* const that, 
+  const PBPhys* const phys);
+
+// Return the number of frames written by the PBPhysTrajWriter 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysTrajWriterGetNbFrame(const PBPhysTrajWriter* const that);
+
+// Open the compressed trajectory in the file 'path'
+// No frame is decoded until PBPhysTrajReaderNext or 
+// PBPhysTrajReaderSeek is called
+// Return NULL if the file couldn't be opened or is not a valid 
+// compressed trajectory
+PBPhysTrajReader* PBPhysTrajReaderOpen(const char* const path);
+
+// Close the PBPhysTrajReader 'that'
+void PBPhysTrajReaderClose(PBPhysTrajReader** that);
+
+// Decode the frame following the current one of the PBPhysTrajReader 
+// 'that'
+// Return false if there is no more frame or the frame couldn't be 
+// decoded, true else
+bool PBPhysTrajReaderNext(PBPhysTrajReader* const that);
+
+// Decode the 'iFrame'-th frame of the PBPhysTrajReader 'that', 
+// starting from the keyframe preceding it
+// Return false if the frame couldn't be decoded, true else
+bool PBPhysTrajReaderSeek(PBPhysTrajReader* const that, 
+  const long iFrame);
+
+// Return the index of the keyframe preceding the time 't' in the 
+// PBPhysTrajReader 'that', or 0 if 't' is before the first keyframe
+long PBPhysTrajReaderGetKeyAt(const PBPhysTrajReader* const that, 
+  const float t);
+
+// Set the positions and speeds of the particles of the PBPhys 'phys' 
+// to those of the current frame of the PBPhysTrajReader 'that', and 
+// its current time to the time of the frame
+// 'phys' must have the dimension and number of particles of the 
+// trajectory
+void PBPhysTrajReaderApply(const PBPhysTrajReader* const that, 
+  PBPhys* const phys);
+
+// Return the number of frames of the PBPhysTrajReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysTrajReaderGetNbFrame(const PBPhysTrajReader* const that);
+
+// Return the number of frames between two keyframes of the 
+// PBPhysTrajReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysTrajReaderGetKeyInterval(const PBPhysTrajReader* const that);
+
+// Return the number of particles of the PBPhysTrajReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysTrajReaderGetNbParticle(const PBPhysTrajReader* const that);
+
+// Return the dimension of the PBPhysTrajReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysTrajReaderGetDim(const PBPhysTrajReader* const that);
+
+// Return the index of the current frame of the PBPhysTrajReader 
+// 'that' (-1 before the first frame)
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysTrajReaderGetIFrame(const PBPhysTrajReader* const that);
+
+// Return the time of the current frame of the PBPhysTrajReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysTrajReaderGetCurTime(const PBPhysTrajReader* const that);
+
+// Return the positions of the particles in the current frame of the 
+// PBPhysTrajReader 'that' (_dim values per particle)
+#if BUILDMODE != 0
+static inline
+#endif
+const float* PBPhysTrajReaderPos(const PBPhysTrajReader* const that);
+
+// Return the speeds of the particles in the current frame of the 
+// PBPhysTrajReader 'that' (_dim values per particle)
+#if BUILDMODE != 0
+static inline
+#endif
+const float* PBPhysTrajReaderSpeed(const PBPhysTrajReader* const that);
+
+// ------------ PBPhysArchive
+
+// ================= Define ==================
+
+// Magic numbers of the archive files and of their index
+#define PBPHYS_BINMAGICARCHIVE "PBPA"
+#define PBPHYS_BINMAGICARCHIVEINDEX "PBPX"
+
+// Default number of steps between two keyframes of an archive
+#define PBPHYS_ARCHIVEKEY 64
+
+// Number of fields of the particles stored in the deltas of an archive
+// (position, speed, acceleration)
+#define PBPHYS_ARCHIVENBFIELD 3
+
+// ================= Data structure ===================
+
+// Archive of the states of a PBPhys after each step, seekable by time
+// A keyframe stores the whole PBPhys in the format of PBPhysSaveBinary 
+// every _keyInterval steps, and the other steps store the position, 
+// speed and acceleration of the particles as the xor of their bits 
+// with the previous step, coded with the Rice code of the compressed 
+// trajectories, so the states are restored exactly
+// The other properties of the particles are those of the preceding 
+// keyframe, a keyframe is added automatically if the number of 
+// particles changes and can be forced with PBPhysArchiveAddKey
+// The file starts with the magic number PBPHYS_BINMAGICARCHIVE, the 
+// version and the number of steps between two keyframes (int32), 
+// followed by the records
+// Each record is a flag set for keyframes (uint8) and the current time 
+// (float), followed by the saved PBPhys for a keyframe, or by the size 
+// of the coded values (uint32) and the coded values for a delta
+// The file ends with the index of the keyframes: their offset (int64), 
+// time (float) and index of record (int64), the number of keyframes 
+// and of records (int64), the time of the last record (float) and the 
+// magic number PBPHYS_BINMAGICARCHIVEINDEX
+typedef struct PBPhysArchive {
+  // Archived PBPhys (NULL if it has been freed)
+  PBPhys* _phys;
+  // Stream of the file
+  FILE* _stream;
+  // Number of steps between two keyframes
+  int _keyInterval;
+  // Number of records, and index of the last keyframe
+  long _nbRecord;
+  long _iLastKey;
+  // Time of the last record
+  float _lastTime;
+  // Number of particles at the last keyframe
+  long _nbPart;
+  // Bits of the fields of the particles at the last record and at the 
+  // current step (PBPHYS_ARCHIVENBFIELD * dim values per particle, 
+  // field by field)
+  uint32_t* _prev;
+  uint32_t* _cur;
+  // Scratch of the residuals of a field
+  uint64_t* _res;
+  // Buffer of the coded values of a delta
+  PBPhysBitBuffer _bits;
+  // Offset in the file, time and index of record of the keyframes
+  int64_t* _keyOffset;
+  float* _keyTime;
+  int64_t* _keyRecord;
+  // Number of keyframes, and number of keyframes the index can hold 
+  // without reallocation
+  long _nbKey;
+  long _keyCapacity;
+  // Flag raised if a write failed
+  bool _error;
+} PBPhysArchive;
+
+// Reader of an archive written by a PBPhysArchive
+typedef struct PBPhysArchiveReader {
+  // Stream of the file
+  FILE* _stream;
+  // Number of steps between two keyframes
+  int _keyInterval;
+  // Number of records and keyframes
+  long _nbRecord;
+  long _nbKey;
+  // Time of the last record
+  float _lastTime;
+  // Offset in the file, time and index of record of the keyframes
+  int64_t* _keyOffset;
+  float* _keyTime;
+  int64_t* _keyRecord;
+  // State of the PBPhys at the current record (NULL until the first 
+  // seek)
+  PBPhys* _phys;
+  // Index of the current record (-1 until the first seek)
+  long _iRecord;
+  // Buffer of the coded values of a delta
+  PBPhysBitBuffer _bits;
+  // Bits of the fields of the particles, and the number of values it 
+  // can hold without reallocation
+  uint32_t* _val;
+  long _valCapacity;
+} PBPhysArchiveReader;
+
+// ================ Functions declaration ====================
+
+// Create a new PBPhysArchive of the PBPhys 'phys' in the file 'path' 
+// with a keyframe every 'keyInterval' steps
+// The current state of 'phys' is archived as the first keyframe, and 
+// the archive is attached to 'phys' which calls PBPhysArchiveAdd after 
+// each PBPhysStep and PBPhysNext
+// Only one archive can be attached to a PBPhys
+// Return NULL if the file couldn't be opened or the first keyframe 
+// written
+PBPhysArchive* PBPhysArchiveOpen(PBPhys* const phys, 
+  const char* const path, const int keyInterval);
+
+// Write the index, close the PBPhysArchive 'that' and detach it from 
+// its PBPhys
+// Return true if all the writes succeeded, false else
+bool PBPhysArchiveClose(PBPhysArchive** that);
+
+// Archive the current state of the PBPhys of the PBPhysArchive 'that', 
+// as a keyframe if _keyInterval steps have been archived since the 
+// last keyframe or the number of particles has changed, else as a 
+// delta
+// Return true if the state could be archived, false else
+bool PBPhysArchiveAdd(PBPhysArchive* const that);
+
+// Archive the current state of the PBPhys of the PBPhysArchive 'that' 
+// as a keyframe, to use after modifying the particles otherwise than 
+// by stepping
+// Return true if the state could be archived, false else
+bool PBPhysArchiveAddKey(PBPhysArchive* const that);
+
+// Return the number of records of the PBPhysArchive 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysArchiveGetNbRecord(const PBPhysArchive* const that);
+
+// Return the number of steps between two keyframes of the 
+// PBPhysArchive 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+int PBPhysArchiveGetKeyInterval(const PBPhysArchive* const that);
+
+// Open the archive in the file 'path'
+// Return NULL if the file couldn't be opened or is not a valid archive
+PBPhysArchiveReader* PBPhysArchiveReaderOpen(const char* const path);
+
+// Close the PBPhysArchiveReader 'that' and free its PBPhys
+void PBPhysArchiveReaderClose(PBPhysArchiveReader** that);
+
+// Restore in the PBPhysArchiveReader 'that' the state of the PBPhys at 
+// the last record whose time is not after 't'
+// The state is decoded from the current record if 't' is after it and 
+// there is no keyframe between them, else from the keyframe preceding 
+// 't', so at most _keyInterval records are decoded
+// Return false if 't' is before the first record or the records 
+// couldn't be decoded, true else
+bool PBPhysArchiveReaderSeek(PBPhysArchiveReader* const that, 
+  const float t);
+
+// Return the PBPhys restored by the last PBPhysArchiveReaderSeek of the 
+// PBPhysArchiveReader 'that' (NULL before the first seek)
+// The PBPhys belongs to 'that' and is replaced when a keyframe is 
+// decoded
+#if BUILDMODE != 0
+static inline
+#endif
+const PBPhys* PBPhysArchiveReaderPBPhys(
+  const PBPhysArchiveReader* const that);
+
+// Return the number of records of the PBPhysArchiveReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysArchiveReaderGetNbRecord(
+  const PBPhysArchiveReader* const that);
+
+// Return the index of the current record of the PBPhysArchiveReader 
+// 'that' (-1 before the first seek)
+#if BUILDMODE != 0
+static inline
+#endif
+long PBPhysArchiveReaderGetIRecord(
+  const PBPhysArchiveReader* const that);
+
+// Return the time of the first record of the PBPhysArchiveReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysArchiveReaderGetFirstTime(
+  const PBPhysArchiveReader* const that);
+
+// Return the time of the last record of the PBPhysArchiveReader 'that'
+#if BUILDMODE != 0
+static inline
+#endif
+float PBPhysArchiveReaderGetLastTime(
+  const PBPhysArchiveReader* const that);
+
 // ================= Polymorphism ==================
 
 #define PBPhysParticleSetAccel(Particle, Accel) _Generic(Accel, \
@@ -491,10 +2558,10 @@ void PBPhysAddParticles(PBPhys* const that, const int nb,
 
 #define PBPhysParticleAddPos(Particle, Vec, Coeff) _Generic(Vec, \
   VecFloat*: _PBPhysParticleAddPos, \
-  VecFloat2D*: _PBPhysParticlevPos, \
+  VecFloat2D*: _PBPhysParticleAddPos, \
   VecFloat3D*: _PBPhysParticleAddPos, \
   const VecFloat*: _PBPhysParticleAddPos, \
-  const VecFloat2D*: _PBPhysParticlevPos, \
+  const VecFloat2D*: _PBPhysParticleAddPos, \
   const VecFloat3D*: _PBPhysParticleAddPos, \
   default: PBErrInvalidPolymorphism)(Particle, \
     (const VecFloat* const)(Vec), Coeff)